@@ -0,0 +1,299 @@
+/**
+ * Asynchronní logování s dávkovým zápisem
+ *
+ * Každé vlákno zapisuje do vlastního kruhového bufferu (jeden zapisovatel,
+ * jeden čtenář, bez zámku). Vlákno flusheru buffery pravidelně vybírá a celou
+ * dávku zapíše jedním write() - obsluha klienta tak nečeká na zámek iostreamu
+ * ani na flush terminálu. Plný buffer záznam zahodí (a započítá), logování
+ * tedy nikdy nezpomalí doručování zpráv.
+ *
+ * Úrovně: debug (řádky na každou zprávu), info, warn, error. Error jde na
+ * stderr, ostatní na stdout. Před start() se zapisuje synchronně.
+ *
+ * Použití:
+ *   LOG_INFO("Klient připojen: " << username << ", fd " << fd);
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <cerrno>
+#include <unistd.h>
+
+enum class LogLevel {
+    DEBUG = 0,
+    INFO = 1,
+    WARN = 2,
+    ERROR = 3
+};
+
+const size_t LOG_BUFFER_RECORDS = 1024;   // Kapacita bufferu jednoho vlákna (záznamy)
+const int LOG_FLUSH_INTERVAL_MS = 20;     // Maximální zpoždění zápisu
+
+/**
+ * Převod názvu úrovně (debug|info|warn|error)
+ * @return false pro neznámý název
+ */
+inline bool parse_log_level(const std::string& name, LogLevel& level) {
+    if (name == "debug") level = LogLevel::DEBUG;
+    else if (name == "info") level = LogLevel::INFO;
+    else if (name == "warn") level = LogLevel::WARN;
+    else if (name == "error") level = LogLevel::ERROR;
+    else return false;
+    return true;
+}
+
+class AsyncLog {
+public:
+    static AsyncLog& instance() {
+        // Záměrně se nikdy neuvolní - odpojená vlákna mohou logovat až do konce procesu
+        static AsyncLog* log = new AsyncLog();
+        return *log;
+    }
+
+    void set_level(LogLevel level) {
+        level_.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    bool enabled(LogLevel level) const {
+        return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Spuštění flusheru (volat jednou při startu programu)
+     */
+    void start() {
+        started_.store(true, std::memory_order_release);
+        std::thread([this] { flusher_loop(); }).detach();
+    }
+
+    /**
+     * Zařazení záznamu do bufferu aktuálního vlákna (nikdy neblokuje)
+     */
+    void write(LogLevel level, std::string&& text) {
+        if (!started_.load(std::memory_order_acquire)) {
+            text += '\n';
+            write_all(level == LogLevel::ERROR ? STDERR_FILENO : STDOUT_FILENO, text);
+            return;
+        }
+
+        ThreadBuffer* buffer = local_buffer();
+        size_t tail = buffer->tail.load(std::memory_order_relaxed);
+        size_t used = tail - buffer->head.load(std::memory_order_acquire);
+        if (used == LOG_BUFFER_RECORDS) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Record& record = buffer->records[tail % LOG_BUFFER_RECORDS];
+        record.level = level;
+        record.text = std::move(text);
+        buffer->tail.store(tail + 1, std::memory_order_release);
+
+        // Buffer se plní rychleji, než je interval flusheru - probudit ho hned
+        if (used + 1 == LOG_BUFFER_RECORDS / 2) {
+            wakeup_.notify_one();
+        }
+    }
+
+    /**
+     * Počet zahozených záznamů od startu
+     */
+    uint64_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Record {
+        LogLevel level;
+        std::string text;
+    };
+
+    // Buffer jednoho vlákna; zapisuje vlastník (tail), vybírá flusher (head)
+    struct ThreadBuffer {
+        Record records[LOG_BUFFER_RECORDS];
+        std::atomic<size_t> head;
+        std::atomic<size_t> tail;
+        std::atomic<bool> retired;   // Vlákno skončilo, po vyprázdnění se buffer uvolní
+
+        ThreadBuffer() : head(0), tail(0), retired(false) {}
+    };
+
+    // Při ukončení vlákna předá jeho buffer flusheru k uvolnění
+    struct BufferOwner {
+        ThreadBuffer* buffer;
+
+        BufferOwner() : buffer(nullptr) {}
+        ~BufferOwner() {
+            if (buffer != nullptr) buffer->retired.store(true, std::memory_order_release);
+        }
+    };
+
+    AsyncLog() : level_(static_cast<int>(LogLevel::DEBUG)), started_(false), dropped_(0) {}
+
+    ThreadBuffer* local_buffer() {
+        static thread_local BufferOwner owner;
+        if (owner.buffer == nullptr) {
+            owner.buffer = new ThreadBuffer();
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffers_.push_back(owner.buffer);
+        }
+        return owner.buffer;
+    }
+
+    static void write_all(int fd, const std::string& data) {
+        size_t offset = 0;
+        while (offset < data.size()) {
+            ssize_t written = ::write(fd, data.data() + offset, data.size() - offset);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            offset += static_cast<size_t>(written);
+        }
+    }
+
+    void flusher_loop() {
+        std::string out;
+        std::string err;
+        uint64_t reported_drops = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+
+                for (size_t i = 0; i < buffers_.size();) {
+                    ThreadBuffer* buffer = buffers_[i];
+                    bool retired = buffer->retired.load(std::memory_order_acquire);
+                    drain(*buffer, out, err);
+                    if (retired) {
+                        buffers_[i] = buffers_.back();
+                        buffers_.pop_back();
+                        delete buffer;
+                    } else {
+                        ++i;
+                    }
+                }
+            }
+
+            uint64_t drops = dropped();
+            if (drops != reported_drops) {
+                err += "[log] zahozeno " + std::to_string(drops - reported_drops) + " záznamů (plný buffer)\n";
+                reported_drops = drops;
+            }
+
+            // Jeden zápis na dávku a výstup
+            if (!out.empty()) {
+                write_all(STDOUT_FILENO, out);
+                out.clear();
+            }
+            if (!err.empty()) {
+                write_all(STDERR_FILENO, err);
+                err.clear();
+            }
+        }
+    }
+
+    static void drain(ThreadBuffer& buffer, std::string& out, std::string& err) {
+        size_t head = buffer.head.load(std::memory_order_relaxed);
+        size_t tail = buffer.tail.load(std::memory_order_acquire);
+        for (; head != tail; ++head) {
+            Record& record = buffer.records[head % LOG_BUFFER_RECORDS];
+            std::string& target = record.level == LogLevel::ERROR ? err : out;
+            target += record.text;
+            target += '\n';
+            record.text.clear();
+        }
+        buffer.head.store(head, std::memory_order_release);
+    }
+
+    std::atomic<int> level_;
+    std::atomic<bool> started_;
+    std::atomic<uint64_t> dropped_;
+    std::mutex mutex_;                   // Seznam bufferů (registrace vlákna, flusher)
+    std::condition_variable wakeup_;
+    std::vector<ThreadBuffer*> buffers_;
+};
+
+/**
+ * Skládání jednoho řádku logu bez ostringstream
+ * Záznam se odešle v destruktoru.
+ */
+class LogLine {
+public:
+    explicit LogLine(LogLevel level) : level_(level) {
+        text_.reserve(128);
+    }
+
+    ~LogLine() {
+        AsyncLog::instance().write(level_, std::move(text_));
+    }
+
+    LogLine& append(const char* data, size_t size) {
+        text_.append(data, size);
+        return *this;
+    }
+
+    LogLine& operator<<(const char* text) {
+        text_ += text;
+        return *this;
+    }
+
+    LogLine& operator<<(const std::string& text) {
+        text_ += text;
+        return *this;
+    }
+
+    LogLine& operator<<(char c) {
+        text_ += c;
+        return *this;
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value, LogLine&>::type operator<<(T value) {
+        text_ += std::to_string(value);
+        return *this;
+    }
+
+    LogLine& operator<<(double value) {
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%g", value);
+        if (length > 0) text_.append(buffer, static_cast<size_t>(length));
+        return *this;
+    }
+
+private:
+    LogLine(const LogLine&);
+    LogLine& operator=(const LogLine&);
+
+    LogLevel level_;
+    std::string text_;
+};
+
+// Výraz za úrovní se vyhodnotí jen při zapnuté úrovni
+#define LOG_AT(level, expr) \
+    do { \
+        if (AsyncLog::instance().enabled(level)) { \
+            LogLine log_line_(level); \
+            log_line_ << expr; \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(expr) LOG_AT(LogLevel::DEBUG, expr)
+#define LOG_INFO(expr) LOG_AT(LogLevel::INFO, expr)
+#define LOG_WARN(expr) LOG_AT(LogLevel::WARN, expr)
+#define LOG_ERROR(expr) LOG_AT(LogLevel::ERROR, expr)
+
+#endif // ASYNC_LOG_H
@@ -0,0 +1,535 @@
+/**
+ * Zátěžový test a měření latence C++ chat serveru
+ *
+ * Otevře N spojení (SETUP: handshake stejně jako client.cpp), odesílá chat
+ * zprávy zadanou rychlostí a u každého doručení broadcastu měří latenci
+ * od odeslání po přijetí. Odesílatel i příjemci jsou v tomto procesu, čas
+ * odeslání nese zpráva sama (monotónní hodiny) - měří se tedy celá cesta
+ * klient -> server -> fronty -> klient.
+ *
+ * Výchozí rychlost je těsně pod rate limitem serveru (RATE_LIMIT_MESSAGES
+ * zpráv za sekundu na spojení), server tak žádnou zprávu neodmítne a měří
+ * se jen broadcast. Na PING odpovídá PONG. Výsledek jde na standardní
+ * výstup jako jeden JSON objekt, průběh a shrnutí na chybový výstup.
+ *
+ * Kompilace:
+ *   g++ -std=c++11 -O2 -pthread benchmark.cpp -o benchmark
+ *
+ * Spuštění:
+ *   ./benchmark --connections 50 --duration 10
+ *   ./benchmark --protocol v2 --threads 2 --label epoll > epoll.json
+ */
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "framing.h"
+#include "protocol.h"
+#include "latency_histogram.h"
+
+// Konfigurace
+const char* const DEFAULT_HOST = "127.0.0.1";
+const int DEFAULT_PORT = 8080;
+const int SERVER_RATE_LIMIT = 10;         // RATE_LIMIT_MESSAGES serveru (zpráv za sekundu)
+const double DEFAULT_RATE = 9.0;          // Zpráv za sekundu na odesílající spojení
+const double READY_TIMEOUT = 10.0;        // Max. čekání na uvítání všech spojení (sekundy)
+const int EPOLL_MAX_EVENTS = 128;
+const int MAX_WAIT_MS = 50;               // Nejdelší spánek smyčky (kontrola fází)
+const char* const PAYLOAD_TAG = "lat ";   // Začátek měřené zprávy: "lat <běh> <spojení> <čas ns> xxx"
+
+struct BenchConfig {
+    std::string host;
+    int port;
+    int connections;
+    int senders;         // Kolik spojení odesílá (ostatní jen přijímají)
+    double rate;
+    double duration;     // Měřené okno (sekundy)
+    double warmup;       // Odesílání před měřením (sekundy)
+    double drain;        // Čekání na doručení po konci odesílání (sekundy)
+    size_t payload;      // Velikost textu zprávy (bytů)
+    int protocol;        // PROTOCOL_TEXT nebo PROTOCOL_BINARY
+    int threads;
+    std::string label;   // Popisek běhu ve výsledku (např. režim serveru)
+};
+
+// Časy fází běhu (ns monotónních hodin), nastaví je hlavní vlákno
+struct BenchPhases {
+    std::atomic<int64_t> send_start;    // 0 = ještě se neodesílá
+    std::atomic<int64_t> measure_start;
+    std::atomic<int64_t> measure_end;   // Konec odesílání
+    std::atomic<int64_t> finish;        // Konec čekání na doručení
+    std::atomic<int> ready;             // Spojení, která dostala uvítání
+    std::atomic<int> failed;            // Spojení, která se nepodařilo navázat
+
+    BenchPhases() : send_start(0), measure_start(0), measure_end(0), finish(0), ready(0), failed(0) {}
+};
+
+// Výsledky jednoho pracovního vlákna
+struct WorkerStats {
+    LatencyHistogram latency;   // ns, jen zprávy odeslané v měřeném okně
+    uint64_t sent;              // Odeslané v měřeném okně
+    uint64_t delivered;         // Doručené zprávy z měřeného okna
+    uint64_t sent_total;
+    uint64_t errors;            // Chybové odpovědi serveru
+    uint64_t rate_limited;      // Z toho odmítnuté rate limitem
+    uint64_t pings;             // Zodpovězené PING
+    uint64_t disconnects;       // Spojení ukončená serverem
+
+    WorkerStats() : sent(0), delivered(0), sent_total(0), errors(0), rate_limited(0), pings(0), disconnects(0) {}
+};
+
+// Spojení jednoho pracovního vlákna
+struct BenchConnection {
+    int fd;
+    int index;
+    bool sender;
+    bool ready;
+    bool writable_wait;  // Čeká se na EPOLLOUT
+    int64_t next_send;
+    FrameDecoder decoder;
+    FrameBatch pending;
+
+    BenchConnection() : fd(-1), index(0), sender(false), ready(false), writable_wait(false), next_send(0),
+                        decoder(DEFAULT_MAX_MESSAGE_SIZE) {}
+};
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Připojení a úvodní zpráva (SETUP:jméno:port[:v2])
+ * @return fd neblokujícího socketu nebo -1
+ */
+int connect_client(const BenchConfig& config, int index) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    sockaddr_in server_addr{};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(static_cast<uint16_t>(config.port));
+    if (inet_pton(AF_INET, config.host.c_str(), &server_addr.sin_addr) <= 0 ||
+        connect(sock, (sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    std::string setup = "SETUP:bench" + std::to_string(index) + ":0";
+    if (config.protocol == PROTOCOL_BINARY) {
+        setup += std::string(":") + PROTOCOL_V2_TOKEN;
+    }
+    if (!send_message(sock, setup)) {
+        close(sock);
+        return -1;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+    return sock;
+}
+
+/**
+ * Odeslání čekajících rámců, kolik socket pojme
+ * @return false při chybě spojení
+ */
+bool flush_connection(BenchConnection& conn, int epoll_fd) {
+    while (!conn.pending.empty()) {
+        if (conn.pending.write_some(conn.fd, MSG_DONTWAIT) < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            break;
+        }
+    }
+    bool wait = !conn.pending.empty();
+    if (wait != conn.writable_wait) {
+        epoll_event ev{};
+        ev.events = wait ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        ev.data.ptr = &conn;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev);
+        conn.writable_wait = wait;
+    }
+    return true;
+}
+
+/**
+ * Měřená chat zpráva s časem odeslání
+ */
+Frame make_chat_frame(const BenchConfig& config, uint32_t run, int index, int64_t sent_at) {
+    char header[64];
+    int length = std::snprintf(header, sizeof(header), "%s%u %d %lld ", PAYLOAD_TAG, run, index,
+                               static_cast<long long>(sent_at));
+    size_t padding = config.payload > static_cast<size_t>(length) ? config.payload - length : 0;
+    FrameBuilder builder = config.protocol == PROTOCOL_BINARY
+        ? binary_frame(MessageType::CHAT, length + padding) : FrameBuilder(length + padding);
+    builder.append(header, static_cast<size_t>(length));
+    for (size_t i = 0; i < padding; ++i) {
+        builder.append_u8('x');
+    }
+    return builder.finish();
+}
+
+/**
+ * Nalezení času odeslání v doručené chat zprávě tohoto běhu
+ * @return false pro cizí nebo starou zprávu (např. z historie místnosti)
+ */
+bool parse_sent_at(const MessageView& text, uint32_t run, int64_t& sent_at) {
+    size_t tag_length = std::strlen(PAYLOAD_TAG);
+    const char* end = text.data + text.size;
+    for (const char* p = text.data; p + tag_length <= end; ++p) {
+        if (std::memcmp(p, PAYLOAD_TAG, tag_length) != 0) continue;
+        char buffer[64];
+        size_t length = std::min(static_cast<size_t>(end - p - tag_length), sizeof(buffer) - 1);
+        std::memcpy(buffer, p + tag_length, length);
+        buffer[length] = '\0';
+        unsigned int message_run;
+        int index;
+        long long timestamp;
+        if (std::sscanf(buffer, "%u %d %lld", &message_run, &index, &timestamp) == 3 && message_run == run) {
+            sent_at = timestamp;
+            return true;
+        }
+        return false;
+    }
+    return false;
+}
+
+/**
+ * Zpracování jedné přijaté zprávy (PING, chyba, chat, ostatní)
+ */
+void handle_message(const BenchConfig& config, BenchConnection& conn, const MessageView& message,
+                    uint32_t run, const BenchPhases& phases, WorkerStats& stats, int64_t now) {
+    if (!conn.ready) {
+        // První zpráva po SETUP je uvítání, nebo chyba (např. plný server)
+        if (message.starts_with("ERROR: ") || (message.size > 0 && message.data[0] == static_cast<char>(MessageType::ERROR))) {
+            ++stats.errors;
+        } else {
+            conn.ready = true;
+        }
+        return;
+    }
+    MessageView chat = {nullptr, 0};
+    if (config.protocol == PROTOCOL_BINARY && is_binary_message(message.data, message.size)) {
+        MessageType type = static_cast<MessageType>(message.data[0]);
+        if (type == MessageType::PING) {
+            FrameBuilder pong = binary_frame(MessageType::PONG);
+            conn.pending.push(pong.finish());
+            ++stats.pings;
+        } else if (type == MessageType::ERROR) {
+            ++stats.errors;
+            if (message.substr(1).starts_with("Příliš")) ++stats.rate_limited;
+        } else if (type == MessageType::CHAT) {
+            chat = message.substr(14);  // [typ][u32 odesílatel][u8 barva][u32 čas][u32 pořadí][text]
+        }
+    } else if (message.equals("PING")) {
+        conn.pending.push(make_frame("PONG"));
+        ++stats.pings;
+    } else if (message.starts_with("ERROR: ")) {
+        ++stats.errors;
+        if (message.substr(7).starts_with("Příliš")) ++stats.rate_limited;
+    } else if (message.starts_with("[COLOR:")) {
+        chat = message;
+    }
+
+    int64_t sent_at;
+    if (chat.size > 0 && parse_sent_at(chat, run, sent_at) &&
+        sent_at >= phases.measure_start.load() && sent_at < phases.measure_end.load()) {
+        stats.latency.record(static_cast<uint64_t>(now - sent_at));
+        ++stats.delivered;
+    }
+}
+
+/**
+ * Pracovní vlákno - vlastní epoll a spojení s indexy worker, worker + threads, ...
+ */
+void worker_loop(const BenchConfig& config, int worker, uint32_t run, BenchPhases& phases, WorkerStats& stats) {
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<BenchConnection> connections;
+    for (int index = worker; index < config.connections; index += config.threads) {
+        connections.push_back(BenchConnection());
+        connections.back().index = index;
+        connections.back().sender = index < config.senders;
+    }
+
+    for (BenchConnection& conn : connections) {
+        conn.fd = connect_client(config, conn.index);
+        if (conn.fd < 0) {
+            phases.failed.fetch_add(1);
+            continue;
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = &conn;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn.fd, &ev);
+    }
+
+    double interval_ns = 1e9 / config.rate;
+    std::mt19937 random(run + worker);
+    bool scheduled = false;
+    epoll_event events[EPOLL_MAX_EVENTS];
+    while (true) {
+        int64_t now = now_ns();
+        int64_t finish = phases.finish.load();
+        if (finish > 0 && now >= finish) {
+            break;
+        }
+
+        // Odesílání - první zpráva spojení náhodně v prvním intervalu (bez synchronních dávek)
+        int64_t send_start = phases.send_start.load();
+        int64_t measure_end = phases.measure_end.load();
+        int64_t next_deadline = now + MAX_WAIT_MS * 1000000LL;
+        if (send_start > 0 && now >= send_start && now < measure_end) {
+            if (!scheduled) {
+                std::uniform_real_distribution<double> offset(0.0, interval_ns);
+                for (BenchConnection& conn : connections) {
+                    conn.next_send = send_start + static_cast<int64_t>(offset(random));
+                }
+                scheduled = true;
+            }
+            for (BenchConnection& conn : connections) {
+                if (!conn.sender || conn.fd < 0) continue;
+                if (conn.next_send <= now) {
+                    conn.pending.push(make_chat_frame(config, run, conn.index, now));
+                    ++stats.sent_total;
+                    if (now >= phases.measure_start.load()) ++stats.sent;
+                    conn.next_send += static_cast<int64_t>(interval_ns);
+                    if (conn.next_send <= now) conn.next_send = now + static_cast<int64_t>(interval_ns);  // Zpoždění se nedohání
+                    if (!flush_connection(conn, epoll_fd)) {
+                        close(conn.fd);
+                        conn.fd = -1;
+                        ++stats.disconnects;
+                        continue;
+                    }
+                }
+                next_deadline = std::min(next_deadline, conn.next_send);
+            }
+        }
+
+        int timeout_ms = static_cast<int>((next_deadline - now + 999999) / 1000000);
+        int count = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, std::max(0, timeout_ms));
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            BenchConnection& conn = *static_cast<BenchConnection*>(events[i].data.ptr);
+            if (conn.fd < 0) continue;
+            bool alive = true;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                while (alive) {
+                    ssize_t received = conn.decoder.fill(conn.fd, MSG_DONTWAIT);
+                    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                        alive = false;
+                        break;
+                    }
+                    if (received < 0) break;
+                    now = now_ns();  // Čas příjmu až po recv() (zprávu mohlo poslat jiné vlákno)
+                    MessageView message;
+                    FrameDecoder::Status status;
+                    while ((status = conn.decoder.next(message)) == FrameDecoder::FRAME) {
+                        bool was_ready = conn.ready;
+                        handle_message(config, conn, message, run, phases, stats, now);
+                        if (!was_ready && conn.ready) phases.ready.fetch_add(1);
+                    }
+                    if (status == FrameDecoder::TOO_LARGE) alive = false;
+                }
+            }
+            if (alive) {
+                alive = flush_connection(conn, epoll_fd);
+            }
+            if (!alive) {
+                if (!conn.ready) phases.failed.fetch_add(1);
+                close(conn.fd);
+                conn.fd = -1;
+                ++stats.disconnects;
+            }
+        }
+    }
+
+    for (BenchConnection& conn : connections) {
+        if (conn.fd >= 0) close(conn.fd);
+    }
+    close(epoll_fd);
+}
+
+/**
+ * Výpis nápovědy k parametrům příkazové řádky
+ */
+void print_usage(const char* program) {
+    std::cerr << "Použití: " << program << " [--host IP] [--port N] [--connections N] [--senders N]"
+              << " [--rate MSG_PER_S] [--duration S] [--warmup S] [--drain S] [--size BYTES]"
+              << " [--protocol v1|v2] [--threads N] [--label TEXT]" << std::endl;
+    std::cerr << "Server přijme nejvýše 100 klientů; rychlost nad " << SERVER_RATE_LIMIT
+              << " zpráv/s na spojení narazí na rate limit." << std::endl;
+}
+
+/**
+ * Řetězec jako JSON (popisek běhu)
+ */
+std::string json_string(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        out += c;
+    }
+    return out + "\"";
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+    config.host = DEFAULT_HOST;
+    config.port = DEFAULT_PORT;
+    config.connections = 20;
+    config.senders = -1;
+    config.rate = DEFAULT_RATE;
+    config.duration = 10.0;
+    config.warmup = 1.0;
+    config.drain = 1.0;
+    config.payload = 32;
+    config.protocol = PROTOCOL_TEXT;
+    config.threads = 1;
+
+    // Zpracování parametrů příkazové řádky
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--host" && has_value) {
+            config.host = argv[++i];
+        } else if (arg == "--port" && has_value) {
+            config.port = std::atoi(argv[++i]);
+        } else if (arg == "--connections" && has_value) {
+            config.connections = std::atoi(argv[++i]);
+        } else if (arg == "--senders" && has_value) {
+            config.senders = std::atoi(argv[++i]);
+        } else if (arg == "--rate" && has_value) {
+            config.rate = std::atof(argv[++i]);
+        } else if (arg == "--duration" && has_value) {
+            config.duration = std::atof(argv[++i]);
+        } else if (arg == "--warmup" && has_value) {
+            config.warmup = std::atof(argv[++i]);
+        } else if (arg == "--drain" && has_value) {
+            config.drain = std::atof(argv[++i]);
+        } else if (arg == "--size" && has_value) {
+            config.payload = static_cast<size_t>(std::atoi(argv[++i]));
+        } else if (arg == "--threads" && has_value) {
+            config.threads = std::atoi(argv[++i]);
+        } else if (arg == "--label" && has_value) {
+            config.label = argv[++i];
+        } else if (arg == "--protocol" && has_value) {
+            std::string protocol = argv[++i];
+            if (protocol == "v1") {
+                config.protocol = PROTOCOL_TEXT;
+            } else if (protocol == PROTOCOL_V2_TOKEN) {
+                config.protocol = PROTOCOL_BINARY;
+            } else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.senders < 0 || config.senders > config.connections) config.senders = config.connections;
+    if (config.connections <= 0 || config.port <= 0 || config.rate <= 0 || config.duration <= 0 ||
+        config.warmup < 0 || config.drain < 0 || config.threads <= 0 || config.payload >= DEFAULT_MAX_MESSAGE_SIZE) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (config.threads > config.connections) config.threads = config.connections;
+    if (config.rate >= SERVER_RATE_LIMIT) {
+        std::cerr << "Varování: " << config.rate << " zpráv/s na spojení překračuje rate limit serveru ("
+                  << SERVER_RATE_LIMIT << "/s)" << std::endl;
+    }
+
+    // Identifikace běhu - zprávy z historie místnosti (minulé běhy) se neměří
+    uint32_t run = std::random_device()();
+    BenchPhases phases;
+    std::vector<WorkerStats> stats(config.threads);
+    std::vector<std::thread> workers;
+    for (int worker = 0; worker < config.threads; ++worker) {
+        workers.emplace_back(worker_loop, std::cref(config), worker, run, std::ref(phases), std::ref(stats[worker]));
+    }
+
+    // Čekání na uvítání všech spojení
+    std::cerr << "Připojování " << config.connections << " spojení k " << config.host << ":" << config.port << "..." << std::endl;
+    int64_t ready_deadline = now_ns() + static_cast<int64_t>(READY_TIMEOUT * 1e9);
+    while (phases.ready.load() + phases.failed.load() < config.connections && now_ns() < ready_deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    int ready = phases.ready.load();
+    if (ready < config.connections) {
+        std::cerr << "Připojeno jen " << ready << " z " << config.connections << " spojení" << std::endl;
+        phases.finish.store(now_ns());
+        for (auto& worker : workers) worker.join();
+        return 1;
+    }
+
+    // Fáze: zahřátí -> měření -> doručení zbytku
+    int64_t start = now_ns();
+    phases.measure_start.store(start + static_cast<int64_t>(config.warmup * 1e9));
+    phases.measure_end.store(phases.measure_start.load() + static_cast<int64_t>(config.duration * 1e9));
+    phases.finish.store(phases.measure_end.load() + static_cast<int64_t>(config.drain * 1e9));
+    phases.send_start.store(start);
+    std::cerr << "Odesílání: " << config.senders << " spojení po " << config.rate << " zpráv/s, měření "
+              << config.duration << " s" << std::endl;
+    for (auto& worker : workers) worker.join();
+
+    WorkerStats total;
+    for (const WorkerStats& part : stats) {
+        total.latency.merge(part.latency);
+        total.sent += part.sent;
+        total.delivered += part.delivered;
+        total.sent_total += part.sent_total;
+        total.errors += part.errors;
+        total.rate_limited += part.rate_limited;
+        total.pings += part.pings;
+        total.disconnects += part.disconnects;
+    }
+
+    // Každá zpráva jde všem spojením v místnosti včetně odesílatele
+    uint64_t expected = total.sent * static_cast<uint64_t>(config.connections);
+    double ratio = expected > 0 ? static_cast<double>(total.delivered) / expected : 0.0;
+    const LatencyHistogram& latency = total.latency;
+    char json[1024];
+    std::snprintf(json, sizeof(json),
+        "{\"label\":%s,\"protocol\":\"v%d\",\"connections\":%d,\"senders\":%d,\"threads\":%d,"
+        "\"rate_per_sender\":%.3f,\"duration_s\":%.3f,\"payload_bytes\":%zu,"
+        "\"sent\":%llu,\"delivered\":%llu,\"expected\":%llu,\"delivery_ratio\":%.6f,"
+        "\"messages_per_s\":%.1f,\"deliveries_per_s\":%.1f,"
+        "\"latency_us\":{\"min\":%.1f,\"mean\":%.1f,\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f},"
+        "\"errors\":%llu,\"rate_limited\":%llu,\"pings\":%llu,\"disconnects\":%llu}",
+        json_string(config.label).c_str(), config.protocol, config.connections, config.senders, config.threads,
+        config.rate, config.duration, config.payload,
+        static_cast<unsigned long long>(total.sent), static_cast<unsigned long long>(total.delivered),
+        static_cast<unsigned long long>(expected), ratio,
+        total.sent / config.duration, total.delivered / config.duration,
+        latency.min() / 1e3, latency.mean() / 1e3, latency.percentile(50) / 1e3, latency.percentile(90) / 1e3,
+        latency.percentile(99) / 1e3, latency.percentile(99.9) / 1e3, latency.max() / 1e3,
+        static_cast<unsigned long long>(total.errors), static_cast<unsigned long long>(total.rate_limited),
+        static_cast<unsigned long long>(total.pings), static_cast<unsigned long long>(total.disconnects));
+    std::cout << json << std::endl;
+
+    std::cerr << "Odesláno " << total.sent << " zpráv, doručeno " << total.delivered << " z " << expected
+              << ", p50 " << latency.percentile(50) / 1e3 << " us, p99 " << latency.percentile(99) / 1e3
+              << " us, p99.9 " << latency.percentile(99.9) / 1e3 << " us" << std::endl;
+    return total.disconnects > 0 ? 2 : 0;
+}
@@ -0,0 +1,246 @@
+/**
+ * Chatovací místnosti s vlastními seznamy odběratelů
+ *
+ * Každá místnost má vlastní zámek a seznam členů (fd -> záznam), broadcast
+ * chat zprávy tak prochází jen členy místnosti a nesahá na globální seznam
+ * klientů ani na clients_mutex. Různé místnosti spolu nesoupeří o zámek.
+ *
+ * Adresář místností se zamyká jen při vstupu a odchodu (/join, /leave,
+ * připojení a odpojení) - místnost se vytvoří prvním vstupem a zruší
+ * odchodem posledního člena (kromě výchozí místnosti). Členství se mění
+ * pod zámkem adresáře i místnosti, prázdná místnost proto nikdy nepřijde
+ * o člena, který do ní právě vstupuje.
+ *
+ * Místnost má i historii posledních zpráv (history_ring.h) pod stejným
+ * zámkem: zpráva se do historie zapíše ve stejném kroku jako snímek
+ * příjemců, nový člen tedy každou zprávu dostane buď přehráním historie,
+ * nebo živě - nikdy dvakrát ani vůbec.
+ *
+ * Chat zprávy místnosti se číslují (next_sequence()) - obnovená relace
+ * (session_store.h) si podle čísla poslední přijaté zprávy nechá přehrát
+ * jen zmeškané zprávy.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef CHAT_ROOMS_H
+#define CHAT_ROOMS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "history_ring.h"
+
+const char* const DEFAULT_ROOM = "lobby";
+const size_t MAX_ROOM_NAME = 20;
+
+/**
+ * Je název místnosti platný? (1-20 znaků bez mezer, ':' a '/', nezačíná '.')
+ * Název se používá i jako adresář žurnálu.
+ */
+inline bool valid_room_name(const std::string& name) {
+    if (name.empty() || name.size() > MAX_ROOM_NAME || name[0] == '.') return false;
+    for (size_t i = 0; i < name.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(name[i]);
+        if (c <= ' ' || c == ':' || c == '/') return false;
+    }
+    return true;
+}
+
+template <typename Member, typename Entry>
+class ChatRoom {
+public:
+    ChatRoom(const std::string& name, size_t history_capacity)
+        : name_(name), history_(history_capacity), sequence_(0) {}
+
+    const std::string& name() const {
+        return name_;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return members_.size();
+    }
+
+    /**
+     * Pořadové číslo další zprávy místnosti (od 1, bez zámku)
+     * Číslo se přidělí před sestavením rámců, zprávy souběžných odesílatelů
+     * se tak do historie mohou zapsat v jiném pořadí než podle čísla.
+     */
+    uint32_t next_sequence() {
+        return sequence_.fetch_add(1) + 1;
+    }
+
+    /**
+     * Průchod členy pod zámkem místnosti (jen krátké operace - např. snímek front)
+     */
+    template <typename Function>
+    void for_each(Function function) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const Member& member : members_) {
+            function(member);
+        }
+    }
+
+    /**
+     * Zápis zprávy do historie a průchod příjemci v jednom kroku pod zámkem
+     */
+    template <typename Function>
+    void publish(const Entry& entry, Function function) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        history_.push(entry);
+        for (const Member& member : members_) {
+            function(member);
+        }
+    }
+
+    /**
+     * Přístup ke členům a historii pod zámkem místnosti (/history)
+     */
+    template <typename Function>
+    void inspect(Function function) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        function(members_, history_);
+    }
+
+private:
+    template <typename, typename> friend class RoomDirectory;
+
+    // Volá jen RoomDirectory (pod zámkem adresáře); on_joined běží pod zámkem
+    // místnosti hned po přidání člena
+    template <typename Function>
+    void add(int fd, const Member& member, Function on_joined) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = index_.find(fd);
+        if (found != index_.end()) {
+            members_[found->second] = member;
+        } else {
+            index_[fd] = members_.size();
+            members_.push_back(member);
+        }
+        on_joined(members_, history_);
+    }
+
+    // Odebrání výměnou s posledním členem (O(1), pořadí se nezachovává)
+    size_t remove(int fd) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = index_.find(fd);
+        if (found != index_.end()) {
+            size_t index = found->second;
+            index_.erase(found);
+            if (index + 1 != members_.size()) {
+                members_[index] = std::move(members_.back());
+                index_[members_[index].socket] = index;
+            }
+            members_.pop_back();
+        }
+        return members_.size();
+    }
+
+    std::string name_;
+    mutable std::mutex mutex_;
+    std::vector<Member> members_;
+    std::unordered_map<int, size_t> index_;  // fd -> pozice ve vektoru
+    HistoryRing<Entry> history_;             // Poslední zprávy místnosti
+    std::atomic<uint32_t> sequence_;         // Poslední přidělené číslo zprávy
+};
+
+/**
+ * Adresář místností (název -> místnost)
+ * Member musí mít pole socket (fd člena).
+ */
+template <typename Member, typename Entry>
+class RoomDirectory {
+public:
+    typedef ChatRoom<Member, Entry> Room;
+    typedef std::shared_ptr<Room> RoomPtr;
+    typedef std::function<void(const std::string&, HistoryRing<Entry>&)> RestoreHistory;
+
+    RoomDirectory() : history_capacity_(0) {}
+
+    /**
+     * Kapacita historie nově vytvořených místností (nastavit před prvním vstupem)
+     */
+    void set_history_capacity(size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        history_capacity_ = capacity;
+    }
+
+    /**
+     * Naplnění historie nově vytvořené místnosti (např. ze žurnálu)
+     * Volá se pod zámkem adresáře, než místnost dostane prvního člena.
+     */
+    void set_restore_history(RestoreHistory restore) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        restore_history_ = restore;
+    }
+
+    /**
+     * Vstup do místnosti (vytvoří ji, pokud neexistuje)
+     * @param on_joined Volá se pod zámkem místnosti se členy a historií
+     *                  (uvítání a přehrání historie před živými zprávami)
+     */
+    template <typename Function>
+    RoomPtr join(const std::string& name, int fd, const Member& member, Function on_joined) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        RoomPtr& room = rooms_[name];
+        if (!room) {
+            room = std::make_shared<Room>(name, history_capacity_);
+            if (restore_history_) restore_history_(name, room->history_);
+        }
+        room->add(fd, member, on_joined);
+        return room;
+    }
+
+    /**
+     * Odchod z místnosti; prázdná místnost (kromě výchozí) zanikne
+     */
+    void leave(const RoomPtr& room, int fd) {
+        if (!room) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (room->remove(fd) == 0 && room->name() != DEFAULT_ROOM) {
+            auto found = rooms_.find(room->name());
+            if (found != rooms_.end() && found->second == room) {
+                rooms_.erase(found);
+            }
+        }
+    }
+
+    /**
+     * Existující místnost bez vstupu do ní (nullptr = neexistuje)
+     */
+    RoomPtr find(const std::string& name) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = rooms_.find(name);
+        return found != rooms_.end() ? found->second : RoomPtr();
+    }
+
+    /**
+     * Názvy a velikosti existujících místností
+     */
+    std::vector<std::pair<std::string, size_t>> list() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::pair<std::string, size_t>> result;
+        result.reserve(rooms_.size());
+        for (const auto& entry : rooms_) {
+            result.push_back(std::make_pair(entry.first, entry.second->size()));
+        }
+        return result;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, RoomPtr> rooms_;
+    size_t history_capacity_;
+    RestoreHistory restore_history_;
+};
+
+#endif // CHAT_ROOMS_H
@@ -1,20 +1,50 @@
 /**
  * Rozšířená socket klient implementace v C++
- * Používá length-prefixed protokol (kompatibilní s Python servery)
+ * Používá length-prefixed protokol (kompatibilní s Python servery),
+ * s C++ serverem vyjedná binární protokol v2 (protocol.h) a kompresi (compression.h)
+ *
+ * Čtecí vlákno zprávy průběžně zobrazuje a hned odpovídá na PING,
+ * vstup (terminál nebo skript) předává zprávy zapisovacímu vláknu
+ * přes frontu bez zámku (spsc_queue.h).
  * 
  * Kompilace:
- *   g++ -std=c++11 client.cpp -o client
+ *   g++ -std=c++11 -pthread client.cpp -o client -lz
+ *
+ * Spuštění:
+ *   ./client
+ *   ./client --host 10.0.0.5 --name alice
+ *   ./client --headless --name bot --rate 5 < zpravy.txt   (skriptované odesílání)
  */
 
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <cerrno>
 #include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
+#include "framing.h"
+#include "protocol.h"
+#include "compression.h"
+#include "spsc_queue.h"
+#include "socket_tuning.h"
+
 // ANSI escape kódy pro barvy
 namespace Colors {
     const char* RESET = "\033[0m";
@@ -36,233 +66,959 @@ namespace Colors {
 // Konfigurace
 const char* HOST = "127.0.0.1";
 const int PORT = 8080;
+const int DEFAULT_P2P_PORT = 8081;
+const size_t INPUT_QUEUE_CAPACITY = 1024;   // Zprávy čekající na odeslání (vstup)
+const size_t CONTROL_QUEUE_CAPACITY = 64;   // Odpovědi čtecího vlákna (PONG)
+const double WELCOME_TIMEOUT = 5.0;         // Max. čekání na první zprávu serveru (sekundy)
+const double QUIT_TIMEOUT = 2.0;            // Max. čekání na odpojení po /quit (sekundy)
+const double HEADLESS_LINGER = 1.0;         // Výchozí čekání na odpovědi po konci vstupu (sekundy)
+const int INPUT_POLL_MS = 200;              // Kontrola ukončení při čekání na vstup
+const size_t RENDER_FLUSH_BYTES = 65536;    // Výpis na terminál nejpozději po tolika bytech
+const double RECONNECT_INITIAL_DELAY = 0.2; // První čekání před novým připojením (sekundy)
+const double RECONNECT_MAX_DELAY = 10.0;    // Strop exponenciálního backoffu (sekundy)
+const int RECONNECT_ATTEMPTS = 10;          // Počet pokusů o nové připojení po výpadku
 
 /**
- * Odešle zprávu s prefixem délky (kompatibilní s Python servery)
+ * Zapisovací vlákno klienta
+ * Vstup (terminál / headless) a čtecí vlákno (PONG) mají každý vlastní
+ * SPSC frontu rámců - každá má tak právě jednoho producenta. Zapisovač
+ * vyprázdní obě fronty jedním gather zápisem a usne na eventfd; producent
+ * ho budí jen tehdy, když opravdu spí.
+ *
+ * Fronty přežijí výpadek spojení: run() skončí s koncem spojení a po
+ * novém připojení se spustí znovu nad novým socketem - zprávy napsané
+ * mezitím se odešlou až po obnovení relace.
  */
-bool send_message(int sock, const std::string& message) {
-    uint32_t message_length = htonl(static_cast<uint32_t>(message.length()));
-    
-    ssize_t sent = send(sock, &message_length, 4, 0);
-    if (sent != 4) {
-        std::cerr << "Chyba při odesílání délky zprávy" << std::endl;
-        return false;
+class ClientWriter {
+public:
+    ClientWriter()
+        : input_(INPUT_QUEUE_CAPACITY), control_(CONTROL_QUEUE_CAPACITY),
+          wakeup_(eventfd(0, EFD_CLOEXEC)), sleeping_(false), stopping_(false), interrupted_(false) {}
+
+    ~ClientWriter() {
+        if (wakeup_ >= 0) close(wakeup_);
     }
-    
-    if (message.length() > 0) {
-        sent = send(sock, message.c_str(), message.length(), 0);
-        if (sent != static_cast<ssize_t>(message.length())) {
-            std::cerr << "Chyba při odesílání zprávy" << std::endl;
-            return false;
+
+    /**
+     * Zpráva ze vstupu (jen vstupní vlákno); při plné frontě počká
+     * @return false po ukončení zapisovače
+     */
+    bool submit(const std::string& message) {
+        Frame frame = make_frame(message);
+        while (!input_.try_push(frame)) {
+            if (stopping_.load()) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
+        wake();
+        return !stopping_.load();
     }
-    
-    return true;
+
+    // Odpověď čtecího vlákna (jen čtecí vlákno) - PONG nečeká za vstupem
+    void submit_control(const std::string& message) {
+        if (control_.try_push(make_frame(message))) {
+            wake();
+        }
+    }
+
+    // Ukončení po odeslání všeho, co už je ve frontách
+    void stop() {
+        stopping_.store(true);
+        signal();
+    }
+
+    // Konec spojení - run() skončí bez vyprázdnění front
+    void interrupt() {
+        interrupted_.store(true);
+        signal();
+    }
+
+    // Před dalším run() po interrupt()
+    void reset() {
+        interrupted_.store(false);
+    }
+
+    /**
+     * Odesílání do jednoho spojení, dokud nepřijde stop(), interrupt() nebo chyba
+     * Po chybě zápisu socket zavře, aby čtecí vlákno dostalo EOF.
+     */
+    void run(int sock) {
+        FrameBatch batch;
+        Frame frame;
+        while (!interrupted_.load()) {
+            while (batch.size() < MAX_BATCH_IOV && (control_.try_pop(frame) || input_.try_pop(frame))) {
+                batch.push(std::move(frame));
+            }
+            if (!batch.empty()) {
+                if (!batch.send_all(sock)) {
+                    shutdown(sock, SHUT_RDWR);
+                    return;
+                }
+                continue;
+            }
+            if (stopping_.load()) {
+                return;
+            }
+            
+            // Uspání - po nastavení příznaku ještě jednou zkontrolovat fronty,
+            // jinak by se ztratila zpráva vložená mezi kontrolou a read()
+            sleeping_.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (control_.empty() && input_.empty() && !stopping_.load() && !interrupted_.load()) {
+                uint64_t value;
+                ssize_t received = read(wakeup_, &value, sizeof(value));
+                (void)received;
+            }
+            sleeping_.store(false);
+        }
+    }
+
+private:
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.exchange(false)) {
+            signal();
+        }
+    }
+
+    void signal() {
+        uint64_t one = 1;
+        ssize_t written = write(wakeup_, &one, sizeof(one));
+        (void)written;
+    }
+
+    SpscQueue<Frame> input_;
+    SpscQueue<Frame> control_;
+    int wakeup_;
+    std::atomic<bool> sleeping_;
+    std::atomic<bool> stopping_;
+    std::atomic<bool> interrupted_;
+};
+
+/**
+ * Stav relace sdílený spojovacím vláknem a vstupem
+ * Socket aktuálního spojení se mění jen pod zámkem (vstup ho při /quit
+ * zavírá přes shutdown_socket()).
+ */
+struct ClientSession {
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool welcomed = false;              // Přišla první zpráva serveru
+    int socket = -1;                    // Aktuální spojení (-1 = žádné)
+    std::atomic<bool> binary{false};    // Server odpovídá binárním protokolem v2
+    std::atomic<bool> connected{true};  // Spojovací vlákno ještě běží
+    std::atomic<bool> quitting{false};  // Odhlášení - po konci spojení se nepřipojovat znovu
+
+    void set_socket(int sock) {
+        std::lock_guard<std::mutex> lock(mutex);
+        socket = sock;
+    }
+
+    void shutdown_socket() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (socket >= 0) shutdown(socket, SHUT_RDWR);
+    }
+};
+
+/**
+ * Obnovení relace (SESSION od serveru) - token a nejvyšší přijaté pořadí
+ * zprávy aktuální místnosti; mění ho jen čtecí smyčka
+ */
+struct ResumeState {
+    std::string token;
+    uint32_t last_sequence = 0;
+};
+
+/**
+ * Parametry připojení (znovu použité při obnovení spojení)
+ */
+struct ClientConfig {
+    std::string host;
+    int port;
+    std::string username;
+    int p2p_port;
+    bool reconnect;
+    SocketProfile socket_profile;   // Volby socketu (--socket-profile), výchozí chat
+};
+
+/**
+ * Řádkový vstup nad fd s periodickou kontrolou, zda spojení ještě běží
+ * (std::getline by čekal na Enter i po odpojení serveru)
+ */
+class LineReader {
+public:
+    explicit LineReader(int fd) : fd_(fd), eof_(false) {}
+
+    /**
+     * @return false při konci vstupu nebo po ukončení spojení
+     */
+    bool next(std::string& line, const std::atomic<bool>& running) {
+        while (true) {
+            size_t newline = buffer_.find('\n');
+            if (newline != std::string::npos) {
+                line.assign(buffer_, 0, newline);
+                if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+                buffer_.erase(0, newline + 1);
+                return true;
+            }
+            if (eof_) {
+                if (buffer_.empty()) return false;
+                line.swap(buffer_);
+                buffer_.clear();
+                return true;
+            }
+            if (!running.load()) {
+                return false;
+            }
+            pollfd input{fd_, POLLIN, 0};
+            if (poll(&input, 1, INPUT_POLL_MS) <= 0) {
+                continue;
+            }
+            char chunk[4096];
+            ssize_t received = read(fd_, chunk, sizeof(chunk));
+            if (received <= 0) {
+                eof_ = true;
+            } else {
+                buffer_.append(chunk, static_cast<size_t>(received));
+            }
+        }
+    }
+
+private:
+    int fd_;
+    bool eof_;
+    std::string buffer_;
+};
+
+/**
+ * Buffer výstupu na terminál
+ * Zprávy se skládají do jednoho řetězce a na stdout jdou jedním write()
+ * za dávku - místo flush po každém řádku (std::endl). Kapacita se drží
+ * mezi dávkami, ustálený provoz tak nealokuje.
+ */
+class RenderBuffer {
+public:
+    RenderBuffer() {
+        buffer_.reserve(RENDER_FLUSH_BYTES);
+    }
+
+    RenderBuffer& operator<<(const char* text) {
+        buffer_ += text;
+        return *this;
+    }
+
+    RenderBuffer& operator<<(const std::string& text) {
+        buffer_ += text;
+        return *this;
+    }
+
+    RenderBuffer& operator<<(const MessageView& text) {
+        buffer_.append(text.data, text.size);
+        return *this;
+    }
+
+    RenderBuffer& operator<<(uint32_t value) {
+        buffer_ += std::to_string(value);
+        return *this;
+    }
+
+    void append(const char* data, size_t size) {
+        buffer_.append(data, size);
+    }
+
+    size_t size() const {
+        return buffer_.size();
+    }
+
+    // Zápis celé dávky (předtím vyprázdní std::cout, aby se nepřeházelo pořadí)
+    void flush() {
+        if (buffer_.empty()) return;
+        std::cout.flush();
+        const char* data = buffer_.data();
+        size_t remaining = buffer_.size();
+        while (remaining > 0) {
+            ssize_t written = write(STDOUT_FILENO, data, remaining);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+        buffer_.clear();
+    }
+
+private:
+    std::string buffer_;
+};
+
+// Uživatel známý z USER_JOIN (binární protokol)
+struct KnownUser {
+    std::string username;
+    int color;
+};
+
+/**
+ * Formátování času ze serveru (sekundy od epochy) jako HH:MM
+ */
+std::string format_time(uint32_t timestamp) {
+    std::time_t time = static_cast<std::time_t>(timestamp);
+    std::tm timeinfo;
+    localtime_r(&time, &timeinfo);
+    char text[8];
+    std::snprintf(text, sizeof(text), "%02d:%02d", timeinfo.tm_hour, timeinfo.tm_min);
+    return text;
+}
+
+std::string user_name(const std::map<uint32_t, KnownUser>& users, uint32_t id) {
+    std::map<uint32_t, KnownUser>::const_iterator it = users.find(id);
+    return it != users.end() ? it->second.username : "#" + std::to_string(id);
 }
 
 /**
- * Přijme zprávu s prefixem délky (kompatibilní s Python servery)
+ * Převod řádku od uživatele na binární zprávu v2
  */
-std::string receive_message(int sock) {
-    uint32_t message_length_net;
-    ssize_t received = recv(sock, &message_length_net, 4, MSG_WAITALL);
+std::string encode_binary_input(const std::string& message) {
+    std::string frame;
+    if (message == "/quit" || message == "quit" || message == "/exit" || message == "exit") {
+        frame.push_back(static_cast<char>(MessageType::QUIT));
+    } else if (message == "/list") {
+        frame.push_back(static_cast<char>(MessageType::LIST));
+    } else if (message == "/peers") {
+        frame.push_back(static_cast<char>(MessageType::PEERS));
+    } else if (message == "/help") {
+        frame.push_back(static_cast<char>(MessageType::HELP));
+    } else if (message == "/leave") {
+        frame.push_back(static_cast<char>(MessageType::LEAVE));
+    } else if (message == "/rooms") {
+        frame.push_back(static_cast<char>(MessageType::ROOMS));
+    } else if (message == "/rvtoken") {
+        frame.push_back(static_cast<char>(MessageType::RVTOKEN));
+    } else if (message == "/history" || message.find("/history ") == 0) {
+        frame.push_back(static_cast<char>(MessageType::HISTORY));
+        int count = message.size() > 9 ? std::atoi(message.c_str() + 9) : 0;
+        uint16_t network = htons(static_cast<uint16_t>(count > 0 && count < 65536 ? count : 0));
+        frame.append(reinterpret_cast<const char*>(&network), sizeof(network));
+    } else if (message.find("/join ") == 0) {
+        frame.push_back(static_cast<char>(MessageType::JOIN));
+        frame += message.substr(6);
+    } else if (message.find("/getpeer ") == 0) {
+        frame.push_back(static_cast<char>(MessageType::GETPEER));
+        frame += message.substr(9);
+    } else if (message.find("/pm ") == 0 && message.find(' ', 4) != std::string::npos) {
+        size_t space = message.find(' ', 4);
+        std::string target = message.substr(4, std::min<size_t>(space - 4, 255));
+        frame.push_back(static_cast<char>(MessageType::PM));
+        frame.push_back(static_cast<char>(target.size()));
+        frame += target;
+        frame += message.substr(space + 1);
+    } else {
+        frame.push_back(static_cast<char>(MessageType::CHAT));
+        frame += message;
+    }
+    return frame;
+}
+
+/**
+ * Návod k P2P spojení (PEER_INFO v1 i v2)
+ */
+void render_peer_info(RenderBuffer& out, const std::string& username, const std::string& ip, const std::string& port) {
+    out << "\n" << Colors::CYAN << "[INFO] P2P informace o " << username << ":" << Colors::RESET << "\n"
+        << "  IP: " << ip << "\n"
+        << "  Port: " << port << "\n"
+        << "  Pro připojení použijte P2P aplikaci:\n"
+        << "    cd P2P/C++\n"
+        << "    ./peer2peer\n"
+        << "    /connect " << ip << " " << port << "\n";
+}
+
+/**
+ * Zobrazení binární zprávy v2 (PING rovnou zodpoví)
+ */
+void render_binary_message(RenderBuffer& out, ClientWriter& writer, const std::string& response,
+                           std::map<uint32_t, KnownUser>& users, ResumeState& resume) {
+    BinaryReader reader(response.data() + 1, response.size() - 1);
+    MessageType type = static_cast<MessageType>(response[0]);
+    uint32_t id = 0;
+    uint32_t timestamp = 0;
+    uint8_t color = 0;
     
-    if (received != 4) {
-        if (received == 0) {
-            return ""; // Spojení ukončeno
+    switch (type) {
+        case MessageType::PING:
+            writer.submit_control(std::string(1, static_cast<char>(MessageType::PONG)));
+            break;
+        case MessageType::WELCOME:
+            if (reader.read_u32(id) && reader.read_u8(color)) {
+                out << "\n" << Colors::BRIGHT_BLUE << "[SYSTEM] " << reader.rest() << Colors::RESET << "\n";
+            }
+            break;
+        case MessageType::CHAT: {
+            uint32_t sequence = 0;
+            if (reader.read_u32(id) && reader.read_u8(color) && reader.read_u32(timestamp) && reader.read_u32(sequence)) {
+                resume.last_sequence = std::max(resume.last_sequence, sequence);
+                out << "\n\033[" << static_cast<int>(color) << "m[" << format_time(timestamp) << "] "
+                    << user_name(users, id) << ": " << reader.rest() << Colors::RESET << "\n";
+            }
+            break;
+        }
+        case MessageType::PM:
+            if (reader.read_u32(id) && reader.read_u32(timestamp)) {
+                out << "\n" << Colors::MAGENTA << "[PM od " << user_name(users, id) << "] " << reader.rest() << Colors::RESET << "\n";
+            }
+            break;
+        case MessageType::PEER_INFO: {
+            uint32_t ip = 0;
+            uint16_t port = 0;
+            if (reader.read_u32(id) && reader.read_u32(ip) && reader.read_u16(port)) {
+                in_addr address;
+                address.s_addr = htonl(ip);
+                std::string peer_ip = inet_ntoa(address);
+                render_peer_info(out, reader.rest().str(), peer_ip, std::to_string(port));
+            }
+            break;
         }
-        return "";
+        case MessageType::PEER_INFO6: {
+            MessageView ip;
+            uint16_t port = 0;
+            if (reader.read_u32(id) && reader.read_bytes(16, ip) && reader.read_u16(port)) {
+                char peer_ip[INET6_ADDRSTRLEN];
+                inet_ntop(AF_INET6, ip.data, peer_ip, sizeof(peer_ip));
+                render_peer_info(out, reader.rest().str(), peer_ip, std::to_string(port));
+            }
+            break;
+        }
+        case MessageType::ERROR:
+            out << "\n" << Colors::RED << "ERROR: " << reader.rest() << Colors::RESET << "\n";
+            break;
+        case MessageType::SYSTEM:
+            if (reader.read_u32(timestamp)) {
+                out << "\n" << Colors::BRIGHT_BLUE << "[SYSTEM] " << reader.rest() << Colors::RESET << "\n";
+            }
+            break;
+        case MessageType::USER_JOIN: {
+            uint8_t announce = 0;
+            uint8_t length = 0;
+            MessageView name;
+            reader.read_u8(announce);
+            while (reader.read_u32(id) && reader.read_u8(color) && reader.read_u8(length) && reader.read_bytes(length, name)) {
+                users[id] = KnownUser{name.str(), color};
+                if (announce != USER_JOIN_ROSTER) {
+                    const char* text = announce == USER_JOIN_ROOM ? " vstoupil do místnosti" : " se připojil k chatu";
+                    out << "\n" << Colors::BRIGHT_BLUE << "[SYSTEM] " << name << text << Colors::RESET << "\n";
+                }
+            }
+            break;
+        }
+        case MessageType::USER_LEAVE:
+            if (reader.read_u32(id)) {
+                uint8_t reason = USER_LEAVE_DISCONNECTED;
+                reader.read_u8(reason);
+                const char* text = reason == USER_LEAVE_ROOM ? " odešel do jiné místnosti" : " opustil chat";
+                out << "\n" << Colors::BRIGHT_BLUE << "[SYSTEM] " << user_name(users, id) << text << Colors::RESET << "\n";
+                users.erase(id);
+            }
+            break;
+        case MessageType::ROOM: {
+            // Nový seznam členů přijde hned za touto zprávou
+            uint32_t members = 0;
+            if (reader.read_u32(members)) {
+                users.clear();
+                resume.last_sequence = 0;  // Pořadí platí jen v rámci místnosti
+                out << "\n" << Colors::BRIGHT_BLUE << "[SYSTEM] Místnost " << reader.rest() << " (" << members << " uživatelů)" << Colors::RESET << "\n";
+            }
+            break;
+        }
+        case MessageType::SESSION: {
+            // Token pro obnovení relace a pořadí poslední zprávy místnosti
+            uint32_t sequence = 0;
+            if (reader.read_u32(sequence)) {
+                resume.last_sequence = std::max(resume.last_sequence, sequence);
+                resume.token = reader.rest().str();
+            }
+            break;
+        }
+        default:
+            break;
     }
-    
-    uint32_t message_length = ntohl(message_length_net);
-    
-    if (message_length > 40960) {
-        std::cerr << "Chyba: Příliš dlouhá zpráva" << std::endl;
-        return "";
+}
+
+/**
+ * Druh textové zprávy (protokol v1) podle prefixu a obsahu
+ */
+enum class TextKind {
+    PEER_INFO,    // "PEER_INFO:jméno:ip:port:"
+    PRIVATE,      // "[PM od ..."
+    SYSTEM,       // "Server: ..."
+    PEER_LIST,    // "P2P informace: ..."
+    COLORED,      // "[COLOR:XX][HH:MM] Uživatel: zpráva"
+    CHAT,         // Obsahuje ':' a ani "ERROR", ani "INFO"
+    ERROR,        // Začíná "ERROR"
+    INFO,         // Začíná "INFO"
+    OTHER
+};
+
+inline bool has_prefix(const std::string& text, const char* prefix, size_t length) {
+    return text.size() >= length && std::memcmp(text.data(), prefix, length) == 0;
+}
+
+/**
+ * Zařazení zprávy jedním průchodem
+ * Prefixy se rozliší podle prvního bytu, zbytek (dvojtečka, "ERROR" a "INFO"
+ * kdekoli ve zprávě) zjistí jediné projití řetězce místo řady find().
+ */
+TextKind classify_text(const std::string& response) {
+    if (response.empty()) {
+        return TextKind::OTHER;
+    }
+    switch (response[0]) {
+        case 'P':
+            if (has_prefix(response, "PEER_INFO:", 10)) return TextKind::PEER_INFO;
+            if (has_prefix(response, "P2P informace:", 14)) return TextKind::PEER_LIST;
+            break;
+        case '[':
+            if (has_prefix(response, "[PM od", 6)) return TextKind::PRIVATE;
+            if (has_prefix(response, "[COLOR:", 7)) return TextKind::COLORED;
+            break;
+        case 'S':
+            if (has_prefix(response, "Server:", 7)) return TextKind::SYSTEM;
+            break;
+        default:
+            break;
     }
     
-    std::string message(message_length, '\0');
-    if (message_length > 0) {
-        received = recv(sock, &message[0], message_length, MSG_WAITALL);
-        if (received != static_cast<ssize_t>(message_length)) {
-            return "";
+    bool colon = false;
+    bool marker = false;  // "ERROR" nebo "INFO" kdekoli ve zprávě
+    const char* data = response.data();
+    size_t size = response.size();
+    for (size_t i = 0; i < size && !marker; ++i) {
+        char c = data[i];
+        if (c == ':') {
+            colon = true;
+        } else if (c == 'E') {
+            marker = size - i >= 5 && std::memcmp(data + i, "ERROR", 5) == 0;
+        } else if (c == 'I') {
+            marker = size - i >= 4 && std::memcmp(data + i, "INFO", 4) == 0;
         }
     }
-    
-    return message;
+    if (colon && !marker) return TextKind::CHAT;
+    if (has_prefix(response, "ERROR", 5)) return TextKind::ERROR;
+    if (has_prefix(response, "INFO", 4)) return TextKind::INFO;
+    return TextKind::OTHER;
 }
 
 /**
- * Hlavní funkce klienta
+ * Zobrazení textové zprávy (protokol v1)
+ */
+void render_text_message(RenderBuffer& out, const std::string& response) {
+    // Rozlišení mezi systémovými zprávami a chat zprávami s barvami
+    switch (classify_text(response)) {
+        case TextKind::PEER_INFO: {
+            // P2P informace (cyan)
+            // Jméno končí první dvojtečkou, port je za poslední (IPv6 adresa obsahuje ':')
+            size_t pos1 = response.find(':', 10);
+            size_t pos2 = response.rfind(':');
+            if (pos1 != std::string::npos && pos2 > pos1) {
+                std::string peer_username = response.substr(10, pos1 - 10);
+                std::string peer_ip = response.substr(pos1 + 1, pos2 - pos1 - 1);
+                std::string peer_port = response.substr(pos2 + 1);
+                render_peer_info(out, peer_username, peer_ip, peer_port);
+            }
+            break;
+        }
+        case TextKind::PRIVATE:
+            // Soukromá zpráva přes server (magenta)
+            out << "\n" << Colors::MAGENTA << response << Colors::RESET << "\n";
+            break;
+        case TextKind::SYSTEM:
+            // Systémové zprávy (modře)
+            out << "\n" << Colors::BRIGHT_BLUE << "[SYSTEM] " << response << Colors::RESET << "\n";
+            break;
+        case TextKind::PEER_LIST:
+            // Seznam P2P informací (cyan)
+            out << "\n" << Colors::CYAN << response << Colors::RESET << "\n";
+            break;
+        case TextKind::COLORED: {
+            // Chat zpráva s barvou uživatele - barva z [COLOR:XX], prefix se nezobrazí
+            size_t color_end = response.find(']', 7);
+            if (color_end != std::string::npos) {
+                out << "\n\033[";
+                out.append(response.data() + 7, color_end - 7);
+                out << "m";
+                out.append(response.data() + color_end + 1, response.size() - color_end - 1);
+                out << Colors::RESET << "\n";
+            } else {
+                out << "\n" << response << "\n";
+            }
+            break;
+        }
+        case TextKind::CHAT:
+            // Chat zpráva od uživatele (zeleně) - fallback
+            out << "\n" << Colors::BRIGHT_GREEN << response << Colors::RESET << "\n";
+            break;
+        case TextKind::ERROR:
+            // Chyby (červeně)
+            out << "\n" << Colors::RED << response << Colors::RESET << "\n";
+            break;
+        case TextKind::INFO:
+            // Info zprávy (žlutě)
+            out << "\n" << Colors::BRIGHT_YELLOW << response << Colors::RESET << "\n";
+            break;
+        case TextKind::OTHER:
+            // Jiné zprávy (bíle)
+            out << "\n" << Colors::WHITE << "[Server] " << response << Colors::RESET << "\n";
+            break;
+    }
+}
+
+/**
+ * Zbývají v socketu nepřečtená data (další zpráva dávky)?
  */
-int main() {
-    // Vytvoření socketu
+bool socket_has_pending(int sock) {
+    int pending = 0;
+    return ioctl(sock, FIONREAD, &pending) == 0 && pending > 0;
+}
+
+/**
+ * Čtecí smyčka jednoho spojení - průběžně přijímá a zobrazuje zprávy, na PING odpoví hned
+ * Výstup se vypíše, až v socketu nic nezbývá (nebo buffer dosáhne
+ * RENDER_FLUSH_BYTES) - replay historie je pak pár zápisů místo tisíců.
+ * @return true pokud spojení něco přijalo (relace byla navázaná)
+ */
+bool reader_loop(int sock, ClientWriter& writer, ClientSession& session, ResumeState& resume) {
+    FrameDecompressor decompressor;  // Proud deflate od serveru (":deflate"), na spojení
+    std::map<uint32_t, KnownUser> users;
+    RenderBuffer out;
+    bool received = false;
+    while (true) {
+        std::string response = receive_message(sock, decompressor);
+        if (response.empty()) {
+            break;
+        }
+        received = true;
+        
+        // Binární protokol v2 (první byte je typ zprávy)
+        bool binary = is_binary_message(response.data(), response.size());
+        if (!session.welcomed) {
+            std::lock_guard<std::mutex> lock(session.mutex);
+            session.binary.store(binary);
+            session.welcomed = true;
+            session.changed.notify_all();
+        }
+        
+        if (binary) {
+            render_binary_message(out, writer, response, users, resume);
+        } else if (response == "PING") {
+            // Zpracování heartbeat ping
+            writer.submit_control("PONG");
+        } else {
+            render_text_message(out, response);
+        }
+        if (out.size() >= RENDER_FLUSH_BYTES || !socket_has_pending(sock)) {
+            out.flush();
+        }
+    }
+    out.flush();
+    return received;
+}
+
+/**
+ * Čekání na změnu stavu spojení (uvítání, odpojení) s timeoutem
+ */
+template <typename Predicate>
+bool wait_session(ClientSession& session, double timeout, Predicate predicate) {
+    std::unique_lock<std::mutex> lock(session.mutex);
+    return session.changed.wait_for(lock, std::chrono::duration<double>(timeout), predicate);
+}
+
+bool is_quit_command(const std::string& message) {
+    return message == "quit" || message == "/quit" || message == "exit" || message == "/exit";
+}
+
+void print_usage(const char* program) {
+    std::cerr << "Použití: " << program << " [--host HOST] [--port PORT] [--name JMÉNO] [--p2p-port PORT]"
+              << " [--headless] [--rate ZPRÁV_ZA_S] [--linger SEKUNDY] [--no-reconnect]"
+              << " [--socket-profile chat|bulk|fanout]" << std::endl;
+}
+
+/**
+ * Připojení k serveru
+ * @return socket, nebo -1 při chybě (errno z connect())
+ */
+int connect_to_server(const ClientConfig& config) {
+    sockaddr_in server_addr{};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(config.port);
+    if (inet_pton(AF_INET, config.host.c_str(), &server_addr.sin_addr) <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
     int sock = socket(AF_INET, SOCK_STREAM, 0);
-    
     if (sock < 0) {
-        std::cerr << "Chyba při vytváření socketu" << std::endl;
-        return 1;
+        return -1;
+    }
+    // Před connect() - velikost bufferů ovlivní okno nabízené serveru
+    apply_socket_tuning(sock, socket_profile(config.socket_profile));
+    if (connect(sock, (sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        int error = errno;
+        close(sock);
+        errno = error;
+        return -1;
+    }
+    return sock;
+}
+
+/**
+ * Úvodní zpráva (":v2" = nabídka binárního protokolu; server, který ho nezná,
+ * odpovídá dál textově a klient to pozná podle prvního bytu). Po výpadku
+ * nese token a pořadí poslední přijaté zprávy pro obnovení relace.
+ */
+std::string setup_message(const ClientConfig& config, const ResumeState& resume) {
+    std::string setup = "SETUP:" + config.username + ":" + std::to_string(config.p2p_port) + ":" +
+                        PROTOCOL_V2_TOKEN + ":" + COMPRESSION_TOKEN + ":" + RESUME_TOKEN;
+    if (!resume.token.empty()) {
+        setup += "=" + resume.token + ":" + RESUME_SEQ_TOKEN + "=" + std::to_string(resume.last_sequence);
+    }
+    return setup;
+}
+
+/**
+ * Spojovací vlákno - čte ze spojení a po výpadku se připojí znovu
+ * Zapisovač běží nad každým spojením zvlášť, jeho fronty zůstávají.
+ * Nové připojení čeká s exponenciálním backoffem, prodleva je náhodná
+ * v [delay / 2, delay] - klienti odpojení najednou (restart serveru,
+ * přepnutí balanceru) se tak nepřipojují ve stejný okamžik. Backoff se
+ * vynuluje až spojením, které něco přijalo.
+ */
+void connection_loop(const ClientConfig& config, int sock, ClientWriter& writer, ClientSession& session) {
+    ResumeState resume;
+    bool ever_established = false;
+    int attempt = 0;
+    double delay = RECONNECT_INITIAL_DELAY;
+    std::mt19937 random(std::random_device{}());
+    while (true) {
+        if (sock >= 0) {
+            session.set_socket(sock);
+            std::thread writer_thread(&ClientWriter::run, &writer, sock);
+            bool established = reader_loop(sock, writer, session, resume);
+            writer.interrupt();
+            writer_thread.join();
+            writer.reset();
+            session.set_socket(-1);
+            close(sock);
+            sock = -1;
+            if (established) {
+                ever_established = true;
+                attempt = 0;
+                delay = RECONNECT_INITIAL_DELAY;
+            }
+            
+            // Bez obnovení po /quit, s --no-reconnect nebo když první spojení nic nepřijalo
+            if (session.quitting.load() || !config.reconnect || !ever_established) {
+                if (!session.quitting.load()) {
+                    std::cerr << "Server ukončil spojení" << std::endl;
+                }
+                break;
+            }
+        }
+        
+        if (++attempt > RECONNECT_ATTEMPTS) {
+            std::cerr << Colors::RED << "Nelze obnovit spojení se serverem" << Colors::RESET << std::endl;
+            break;
+        }
+        double wait = std::uniform_real_distribution<double>(delay / 2, delay)(random);
+        delay = std::min(delay * 2, RECONNECT_MAX_DELAY);
+        std::cerr << Colors::BRIGHT_YELLOW << "Spojení ztraceno - nový pokus za " << static_cast<int>(wait * 1000)
+                  << " ms (" << attempt << "/" << RECONNECT_ATTEMPTS << ")" << Colors::RESET << std::endl;
+        if (wait_session(session, wait, [&session] { return session.quitting.load(); })) {
+            break;
+        }
+        sock = connect_to_server(config);
+        if (sock >= 0 && !send_message(sock, setup_message(config, resume))) {
+            close(sock);
+            sock = -1;
+        }
+        if (sock >= 0) {
+            std::cerr << Colors::BRIGHT_GREEN << "✓ Znovu připojeno k " << config.host << ":" << config.port
+                      << (resume.token.empty() ? "" : " (obnovení relace)") << Colors::RESET << std::endl;
+        }
     }
+    std::lock_guard<std::mutex> lock(session.mutex);
+    session.connected.store(false);
+    session.changed.notify_all();
+}
+
+/**
+ * Hlavní funkce klienta
+ */
+int main(int argc, char* argv[]) {
+    ClientConfig config;
+    config.host = HOST;
+    config.port = PORT;
+    config.p2p_port = DEFAULT_P2P_PORT;
+    config.reconnect = true;
+    config.socket_profile = SocketProfile::CHAT;
+    bool username_given = false;
+    bool p2p_port_given = false;
+    bool headless = false;     // Zprávy ze stdin bez výzev (skripty, zátěžové testy)
+    double rate = 0.0;         // Max. zpráv za sekundu v headless režimu (0 = bez omezení)
+    double linger = HEADLESS_LINGER;
     
-    // Konfigurace adresy serveru
-    sockaddr_in server_addr{};
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(PORT);
+    // Parametry příkazové řádky
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        try {
+            if (arg == "--host" && i + 1 < argc) {
+                config.host = argv[++i];
+            } else if (arg == "--port" && i + 1 < argc) {
+                config.port = std::stoi(argv[++i]);
+            } else if (arg == "--name" && i + 1 < argc) {
+                config.username = argv[++i];
+                username_given = true;
+            } else if (arg == "--p2p-port" && i + 1 < argc) {
+                config.p2p_port = std::stoi(argv[++i]);
+                p2p_port_given = true;
+            } else if (arg == "--headless") {
+                headless = true;
+            } else if (arg == "--rate" && i + 1 < argc) {
+                rate = std::stod(argv[++i]);
+            } else if (arg == "--linger" && i + 1 < argc) {
+                linger = std::stod(argv[++i]);
+            } else if (arg == "--no-reconnect") {
+                config.reconnect = false;
+            } else if (arg == "--socket-profile" && i + 1 < argc) {
+                if (!parse_socket_profile(argv[++i], config.socket_profile)) {
+                    print_usage(argv[0]);
+                    return 1;
+                }
+            } else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } catch (...) {
+            std::cerr << "Neplatná hodnota parametru " << arg << std::endl;
+            return 1;
+        }
+    }
     
-    if (inet_pton(AF_INET, HOST, &server_addr.sin_addr) <= 0) {
+    // Konfigurace adresy serveru
+    in_addr address;
+    if (inet_pton(AF_INET, config.host.c_str(), &address) <= 0) {
         std::cerr << "Chyba při převodu IP adresy" << std::endl;
-        close(sock);
         return 1;
     }
     
     // Připojení k serveru
-    std::cout << "Připojování k serveru na " << HOST << ":" << PORT << "..." << std::endl;
-    if (connect(sock, (sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+    std::cout << "Připojování k serveru na " << config.host << ":" << config.port << "..." << std::endl;
+    int sock = connect_to_server(config);
+    if (sock < 0) {
         std::cerr << "Chyba při připojování k serveru. Ujistěte se, že server běží." << std::endl;
-        close(sock);
         return 1;
     }
     
-    std::cout << "✓ Připojeno k serveru na " << HOST << ":" << PORT << std::endl;
+    std::cout << "✓ Připojeno k serveru na " << config.host << ":" << config.port << std::endl;
+    std::cout << "Socket profil: " << socket_profile_name(config.socket_profile) << " ("
+              << format_socket_tuning(read_socket_tuning(sock)) << ")" << std::endl;
     
-    // Přijetí uvítací zprávy
-    std::string welcome = receive_message(sock);
-    if (!welcome.empty()) {
-        std::cout << welcome << std::endl;
+    // Server nejdřív čeká na SETUP, uvítání přijde až po něm (čtecí smyčka)
+    LineReader input(STDIN_FILENO);
+    std::atomic<bool> input_open{true};
+    if (!username_given && !headless) {
+        std::cout << "Zadejte vaše jméno (nebo Enter pro výchozí): " << std::flush;
+        input.next(config.username, input_open);
     }
-    
-    // Volitelné: Odeslání uživatelského jména a P2P portu
-    std::string username;
-    std::cout << "Zadejte vaše jméno (nebo Enter pro výchozí): ";
-    std::getline(std::cin, username);
-    if (username.empty()) {
-        username = "Guest";
+    if (config.username.empty()) {
+        config.username = "Guest";
     }
     
-    std::string p2p_port_str;
-    std::cout << "Zadejte P2P port pro soukromé zprávy (nebo Enter pro výchozí 8081): ";
-    std::getline(std::cin, p2p_port_str);
-    int p2p_port = 8081;
-    if (!p2p_port_str.empty()) {
-        try {
-            p2p_port = std::stoi(p2p_port_str);
-        } catch (...) {
-            p2p_port = 8081;
-            std::cout << "Neplatný port, použiji výchozí " << p2p_port << std::endl;
+    if (!p2p_port_given && !headless) {
+        std::string p2p_port_str;
+        std::cout << "Zadejte P2P port pro soukromé zprávy (nebo Enter pro výchozí " << DEFAULT_P2P_PORT << "): " << std::flush;
+        input.next(p2p_port_str, input_open);
+        if (!p2p_port_str.empty()) {
+            try {
+                config.p2p_port = std::stoi(p2p_port_str);
+            } catch (...) {
+                config.p2p_port = DEFAULT_P2P_PORT;
+                std::cout << "Neplatný port, použiji výchozí " << config.p2p_port << std::endl;
+            }
         }
     }
     
-    // Odeslání informací serveru
-    send_message(sock, "SETUP:" + username + ":" + std::to_string(p2p_port));
+    // Odeslání informací serveru (s nabídkou obnovení relace po výpadku)
+    if (!send_message(sock, setup_message(config, ResumeState()))) {
+        std::cerr << "Chyba při odesílání zprávy" << std::endl;
+        close(sock);
+        return 1;
+    }
+    
+    ClientWriter writer;
+    ClientSession session;
+    std::thread connection_thread(connection_loop, std::cref(config), sock, std::ref(writer), std::ref(session));
     
-    std::cout << "\n=== Chat připojen ===" << std::endl;
-    std::cout << "Napište zprávu a stiskněte Enter pro odeslání všem uživatelům" << std::endl;
-    std::cout << "Použijte '/help' pro nápovědu, '/quit' pro odpojení\n" << std::endl;
+    // Kódování vstupu se volí podle první odpovědi serveru
+    wait_session(session, WELCOME_TIMEOUT, [&session] { return session.welcomed || !session.connected.load(); });
+    
+    if (!headless) {
+        std::cout << "\n=== Chat připojen ===" << std::endl;
+        std::cout << "Napište zprávu a stiskněte Enter pro odeslání všem uživatelům" << std::endl;
+        std::cout << "Použijte '/help' pro nápovědu, '/quit' pro odpojení\n" << std::endl;
+    }
     
-    // Hlavní smyčka pro komunikaci
+    // Vstupní smyčka - jen kóduje a předává zprávy, příjem běží souběžně
+    // (během výpadku spojení se zprávy hromadí ve frontě zapisovače)
     std::string message;
-    while (true) {
-        std::cout << "> ";
-        std::getline(std::cin, message);
-        
+    bool quit = false;
+    std::chrono::steady_clock::time_point next_send = std::chrono::steady_clock::now();
+    while (session.connected.load()) {
+        if (!input.next(message, session.connected)) {
+            break;
+        }
         if (message.empty()) {
             continue;
         }
         
-        if (message == "quit" || message == "/quit" || message == "exit" || message == "/exit") {
-            send_message(sock, "/quit");
-            break;
-        } else if (message.find("/getpeer ") == 0 || message.find("/pm ") == 0 || message == "/peers") {
-            // P2P příkazy
-            send_message(sock, message);
-        } else {
-            // Odeslání zprávy serveru
-            if (!send_message(sock, message)) {
-                std::cerr << "Chyba při odesílání zprávy" << std::endl;
-                break;
-            }
+        if (rate > 0.0) {
+            std::this_thread::sleep_until(next_send);
+            next_send = std::max(next_send, std::chrono::steady_clock::now()) +
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / rate));
         }
         
-        // V chat módu zprávy přicházejí asynchronně
-        // Pro jednoduchost čekáme na odpověď, ale v produkci by bylo lepší použít thread
-        std::string response = receive_message(sock);
-        
-        if (response.empty()) {
-            std::cerr << "Server ukončil spojení" << std::endl;
-            break;
+        quit = is_quit_command(message);
+        if (quit) {
+            // Před odesláním - konec spojení po /quit už není výpadek
+            session.quitting.store(true);
         }
-        
-        // Zpracování heartbeat ping
-        if (response == "PING") {
-            // Odpověď na ping
-            send_message(sock, "PONG");
-            continue;
+        std::string payload = session.binary.load() ? encode_binary_input(message) : (quit ? std::string("/quit") : message);
+        if (!writer.submit(payload)) {
+            std::cerr << "Chyba při odesílání zprávy" << std::endl;
+            break;
         }
-        
-        // Rozlišení mezi systémovými zprávami a chat zprávami s barvami
-        if (response.find("PEER_INFO:") == 0) {
-            // P2P informace (cyan)
-            size_t pos1 = response.find(":", 10);
-            size_t pos2 = response.find(":", pos1 + 1);
-            size_t pos3 = response.find(":", pos2 + 1);
-            if (pos1 != std::string::npos && pos2 != std::string::npos && pos3 != std::string::npos) {
-                std::string peer_username = response.substr(10, pos1 - 10);
-                std::string peer_ip = response.substr(pos1 + 1, pos2 - pos1 - 1);
-                std::string peer_port = response.substr(pos2 + 1, pos3 - pos2 - 1);
-                std::cout << "\n" << Colors::CYAN << "[INFO] P2P informace o " << peer_username << ":" << Colors::RESET << std::endl;
-                std::cout << "  IP: " << peer_ip << std::endl;
-                std::cout << "  Port: " << peer_port << std::endl;
-                std::cout << "  Pro připojení použijte P2P aplikaci:" << std::endl;
-                std::cout << "    cd P2P/C++" << std::endl;
-                std::cout << "    ./peer2peer" << std::endl;
-                std::cout << "    /connect " << peer_ip << " " << peer_port << std::endl;
-            }
-        } else if (response.find("[PM od") == 0) {
-            // Soukromá zpráva přes server (magenta)
-            std::cout << "\n" << Colors::MAGENTA << response << Colors::RESET << std::endl;
-        } else if (response.find("Server:") == 0) {
-            // Systémové zprávy (modře)
-            std::cout << "\n" << Colors::BRIGHT_BLUE << "[SYSTEM] " << response << Colors::RESET << std::endl;
-        } else if (response.find("P2P informace:") == 0) {
-            // Seznam P2P informací (cyan)
-            std::cout << "\n" << Colors::CYAN << response << Colors::RESET << std::endl;
-        } else if (response.find("[COLOR:") == 0 && response.find(":") != std::string::npos) {
-            // Chat zpráva s barvou uživatele
-            // Formát: "[COLOR:XX][HH:MM] Uživatel: zpráva"
-            size_t color_start = response.find("[COLOR:") + 7;
-            size_t color_end = response.find("]", color_start);
-            if (color_end != std::string::npos) {
-                std::string color_code = response.substr(color_start, color_end - color_start);
-                // Odstranění [COLOR:XX] prefixu
-                std::string message_without_color = response.substr(color_end + 1);
-                // Použití barvy uživatele
-                std::cout << "\n\033[" << color_code << "m" << message_without_color << Colors::RESET << std::endl;
-            } else {
-                std::cout << "\n" << response << std::endl;
-            }
-        } else if (response.find("[") == 0 && response.find(":") != std::string::npos && 
-                   response.find("ERROR") == std::string::npos && 
-                   response.find("INFO") == std::string::npos) {
-            // Chat zpráva od uživatele s časovým razítkem (zeleně) - fallback
-            std::cout << "\n" << Colors::BRIGHT_GREEN << response << Colors::RESET << std::endl;
-        } else if (response.find(":") != std::string::npos && 
-                   response.find("ERROR") == std::string::npos && 
-                   response.find("INFO") == std::string::npos) {
-            // Chat zpráva od uživatele bez časového razítka (zeleně) - fallback
-            std::cout << "\n" << Colors::BRIGHT_GREEN << response << Colors::RESET << std::endl;
-        } else if (response.find("ERROR") == 0) {
-            // Chyby (červeně)
-            std::cout << "\n" << Colors::RED << response << Colors::RESET << std::endl;
-        } else if (response.find("INFO") == 0) {
-            // Info zprávy (žlutě)
-            std::cout << "\n" << Colors::BRIGHT_YELLOW << response << Colors::RESET << std::endl;
-        } else {
-            // Jiné zprávy (bíle)
-            std::cout << "\n" << Colors::WHITE << "[Server] " << response << Colors::RESET << std::endl;
+        if (quit) {
+            break;
         }
     }
     
-    close(sock);
+    // Headless: po konci vstupu ještě chvíli přijímat odpovědi, pak se odhlásit
+    if (headless && !quit && session.connected.load()) {
+        wait_session(session, linger, [&session] { return !session.connected.load(); });
+        session.quitting.store(true);
+        writer.submit(session.binary.load() ? encode_binary_input("/quit") : std::string("/quit"));
+        quit = true;
+    }
+    
+    // Po /quit server spojení zavře sám, jinak (nebo po timeoutu) ho zavřeme my
+    session.quitting.store(true);
+    if (quit) {
+        wait_session(session, QUIT_TIMEOUT, [&session] { return !session.connected.load(); });
+    }
+    writer.stop();
+    session.shutdown_socket();
+    {
+        // Probuzení případného čekání na další pokus o připojení
+        std::lock_guard<std::mutex> lock(session.mutex);
+        session.changed.notify_all();
+    }
+    connection_thread.join();
+    
     std::cout << "Odpojeno od serveru" << std::endl;
     return 0;
 }
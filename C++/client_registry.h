@@ -0,0 +1,196 @@
+/**
+ * Indexovaný registr připojených klientů
+ *
+ * Klienti leží v tabulce slotů; vyhledání podle fd i podle jména je O(1)
+ * přes hashovací mapy, odebrání je O(1) (slot se vrátí do free listu).
+ * Sloty jsou navíc propojené v pořadí připojení, takže průchod (/list,
+ * broadcast) zachovává stejné pořadí jako původní vektor.
+ *
+ * Handle (index + generace) zůstává platný i po odebrání jiných klientů;
+ * po odebrání jeho klienta už nic nenajde, ani když se slot znovu použije.
+ *
+ * Registr sám nezamyká - volající drží clients_mutex.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef CLIENT_REGISTRY_H
+#define CLIENT_REGISTRY_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Stabilní odkaz na záznam v registru
+struct ClientHandle {
+    uint32_t index;
+    uint32_t generation;
+
+    bool valid() const {
+        return generation != 0;
+    }
+};
+
+const ClientHandle INVALID_CLIENT_HANDLE = {0, 0};
+
+template <typename T>
+class ClientRegistry {
+public:
+    ClientRegistry() : head_(NIL), tail_(NIL), free_head_(NIL), size_(0), next_order_(0) {}
+
+    size_t size() const {
+        return size_;
+    }
+
+    /**
+     * Přidání záznamu pod fd a jménem (jména se mohou opakovat)
+     */
+    ClientHandle insert(int fd, const std::string& name, T value) {
+        uint32_t index;
+        if (free_head_ != NIL) {
+            index = free_head_;
+            free_head_ = slots_[index].next;
+        } else {
+            index = static_cast<uint32_t>(slots_.size());
+            slots_.push_back(Slot());
+        }
+
+        Slot& slot = slots_[index];
+        slot.value = std::move(value);
+        slot.fd = fd;
+        slot.name = name;
+        slot.used = true;
+        slot.order = next_order_++;
+        ++slot.generation;
+        if (slot.generation == 0) slot.generation = 1;  // 0 je vyhrazeno pro neplatný handle
+
+        // Připojení na konec seznamu v pořadí připojení
+        slot.prev = tail_;
+        slot.next = NIL;
+        if (tail_ != NIL) slots_[tail_].next = index; else head_ = index;
+        tail_ = index;
+
+        by_fd_[fd] = index;
+        by_name_.insert(std::make_pair(name, index));
+        ++size_;
+
+        ClientHandle handle = {index, slot.generation};
+        return handle;
+    }
+
+    T* get(ClientHandle handle) {
+        if (handle.index >= slots_.size()) return nullptr;
+        Slot& slot = slots_[handle.index];
+        return (slot.used && slot.generation == handle.generation) ? &slot.value : nullptr;
+    }
+
+    T* find_fd(int fd) {
+        typename std::unordered_map<int, uint32_t>::iterator it = by_fd_.find(fd);
+        return it != by_fd_.end() ? &slots_[it->second].value : nullptr;
+    }
+
+    /**
+     * Vyhledání podle jména (při duplicitě vrací nejdříve připojeného)
+     */
+    T* find_name(const std::string& name) {
+        return find_name(name.data(), name.size());
+    }
+
+    /**
+     * Vyhledání podle jména z pohledu do zprávy
+     * Klíč se skládá v bufferu registru (kapacita zůstává) - bez alokace.
+     */
+    T* find_name(const char* name, size_t length) {
+        lookup_.assign(name, length);
+        typedef typename std::unordered_multimap<std::string, uint32_t>::iterator Iterator;
+        std::pair<Iterator, Iterator> range = by_name_.equal_range(lookup_);
+        T* best = nullptr;
+        uint64_t best_order = UINT64_MAX;
+        for (Iterator it = range.first; it != range.second; ++it) {
+            if (slots_[it->second].order < best_order) {
+                best_order = slots_[it->second].order;
+                best = &slots_[it->second].value;
+            }
+        }
+        return best;
+    }
+
+    bool erase(ClientHandle handle) {
+        if (get(handle) == nullptr) return false;
+        erase_index(handle.index);
+        return true;
+    }
+
+    bool erase_fd(int fd) {
+        typename std::unordered_map<int, uint32_t>::iterator it = by_fd_.find(fd);
+        if (it == by_fd_.end()) return false;
+        erase_index(it->second);
+        return true;
+    }
+
+    /**
+     * Průchod všemi záznamy v pořadí připojení
+     * Callback nesmí registr měnit.
+     */
+    template <typename F>
+    void for_each(F callback) {
+        for (uint32_t index = head_; index != NIL; index = slots_[index].next) {
+            callback(slots_[index].value);
+        }
+    }
+
+private:
+    static const uint32_t NIL = UINT32_MAX;
+
+    struct Slot {
+        T value;
+        int fd;
+        std::string name;
+        uint32_t generation;
+        uint32_t prev;
+        uint32_t next;      // Další v pořadí připojení, u volného slotu další volný
+        uint64_t order;     // Pořadové číslo připojení (pro duplicitní jména)
+        bool used;
+
+        Slot() : value(), fd(-1), generation(0), prev(NIL), next(NIL), order(0), used(false) {}
+    };
+
+    void erase_index(uint32_t index) {
+        Slot& slot = slots_[index];
+
+        // Odebrání z indexů
+        by_fd_.erase(slot.fd);
+        typedef typename std::unordered_multimap<std::string, uint32_t>::iterator Iterator;
+        std::pair<Iterator, Iterator> range = by_name_.equal_range(slot.name);
+        for (Iterator it = range.first; it != range.second; ++it) {
+            if (it->second == index) {
+                by_name_.erase(it);
+                break;
+            }
+        }
+
+        // Vyjmutí ze seznamu v pořadí připojení
+        if (slot.prev != NIL) slots_[slot.prev].next = slot.next; else head_ = slot.next;
+        if (slot.next != NIL) slots_[slot.next].prev = slot.prev; else tail_ = slot.prev;
+
+        slot.value = T();
+        slot.used = false;
+        slot.next = free_head_;
+        free_head_ = index;
+        --size_;
+    }
+
+    std::vector<Slot> slots_;
+    std::unordered_map<int, uint32_t> by_fd_;
+    std::unordered_multimap<std::string, uint32_t> by_name_;
+    uint32_t head_;
+    uint32_t tail_;
+    uint32_t free_head_;
+    size_t size_;
+    uint64_t next_order_;
+    std::string lookup_;  // Klíč pro find_name() z pohledu
+};
+
+#endif // CLIENT_REGISTRY_H
@@ -0,0 +1,135 @@
+/**
+ * Hrubé hodiny pro horké cesty serveru
+ *
+ * Samostatné vlákno jednou za tick uloží monotónní čas, systémový čas
+ * a předformátovaný místní čas HH:MM do atomických proměnných. Čtenáři
+ * (chat zprávy, rate limit, heartbeat) tak nevolají localtime() ani
+ * neformátují přes ostringstream a nikdy nečekají na zámek.
+ *
+ * Dokud hodiny neběží (start() nebyl zavolán), čtení spočítá přesný čas.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef COARSE_CLOCK_H
+#define COARSE_CLOCK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <thread>
+
+/**
+ * Přesný monotónní čas v sekundách (pouze pro rozdíly, ne pro zobrazení)
+ */
+inline double monotonic_seconds() {
+    auto since_start = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(since_start).count();
+}
+
+class CoarseClock {
+public:
+    static CoarseClock& instance() {
+        static CoarseClock clock;
+        return clock;
+    }
+
+    /**
+     * Spuštění obnovovacího vlákna (volat jednou při startu programu)
+     */
+    void start(double tick_seconds) {
+        refresh();
+        started_.store(true, std::memory_order_release);
+        std::thread([this, tick_seconds] {
+            auto tick = std::chrono::duration<double>(tick_seconds);
+            while (true) {
+                std::this_thread::sleep_for(tick);
+                refresh();
+            }
+        }).detach();
+    }
+
+    /**
+     * Monotónní čas s přesností na jeden tick
+     */
+    double monotonic() const {
+        if (!started_.load(std::memory_order_acquire)) {
+            return monotonic_seconds();
+        }
+        return monotonic_us_.load(std::memory_order_relaxed) / 1000000.0;
+    }
+
+    /**
+     * Systémový čas v sekundách od epochy (binární protokol)
+     */
+    uint32_t wall_seconds() const {
+        if (!started_.load(std::memory_order_acquire)) {
+            return static_cast<uint32_t>(std::time(nullptr));
+        }
+        return static_cast<uint32_t>(wall_.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * Místní čas ve formátu HH:MM
+     */
+    std::string hhmm() const {
+        if (!started_.load(std::memory_order_acquire)) {
+            return format_hhmm(std::time(nullptr));
+        }
+        uint64_t packed = hhmm_packed_.load(std::memory_order_relaxed);
+        char text[HHMM_SIZE];
+        for (size_t i = 0; i < HHMM_SIZE; ++i) {
+            text[i] = static_cast<char>(packed >> (8 * i));
+        }
+        return std::string(text, HHMM_SIZE);
+    }
+
+private:
+    static const size_t HHMM_SIZE = 5;
+
+    CoarseClock() : monotonic_us_(0), hhmm_packed_(0), wall_(0), last_wall_(0), started_(false) {}
+
+    static std::string format_hhmm(std::time_t wall) {
+        std::tm timeinfo;
+        localtime_r(&wall, &timeinfo);
+        char text[HHMM_SIZE + 1];
+        text[0] = static_cast<char>('0' + timeinfo.tm_hour / 10);
+        text[1] = static_cast<char>('0' + timeinfo.tm_hour % 10);
+        text[2] = ':';
+        text[3] = static_cast<char>('0' + timeinfo.tm_min / 10);
+        text[4] = static_cast<char>('0' + timeinfo.tm_min % 10);
+        return std::string(text, HHMM_SIZE);
+    }
+
+    // Volá jen obnovovací vlákno (a start() před jeho spuštěním)
+    void refresh() {
+        monotonic_us_.store(static_cast<int64_t>(monotonic_seconds() * 1000000.0), std::memory_order_relaxed);
+
+        // Místní čas se přepočítá jen při změně sekundy
+        std::time_t wall = std::time(nullptr);
+        if (wall != last_wall_) {
+            last_wall_ = wall;
+            wall_.store(static_cast<int64_t>(wall), std::memory_order_relaxed);
+            std::string text = format_hhmm(wall);
+            uint64_t packed = 0;
+            for (size_t i = 0; i < HHMM_SIZE; ++i) {
+                packed |= static_cast<uint64_t>(static_cast<unsigned char>(text[i])) << (8 * i);
+            }
+            hhmm_packed_.store(packed, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<int64_t> monotonic_us_;
+    std::atomic<uint64_t> hhmm_packed_;
+    std::atomic<int64_t> wall_;
+    std::time_t last_wall_;
+    std::atomic<bool> started_;
+};
+
+inline double coarse_monotonic_seconds() {
+    return CoarseClock::instance().monotonic();
+}
+
+#endif // COARSE_CLOCK_H
@@ -0,0 +1,199 @@
+/**
+ * Volitelná komprese rámců (deflate, zlib)
+ *
+ * Vyjednává se v úvodní zprávě volbou ":deflate" (SETUP:jméno:port[:v2]:deflate)
+ * a týká se směru server -> klient. Komprimovaný rámec má v hlavičce nastavený
+ * nejvyšší bit délky (délky zpráv jsou mnohem menší než 2^31), zbytek hlavičky
+ * je délka komprimovaných dat. Zprávy kratší než práh jdou beze změny.
+ *
+ * Spojení má jeden proud deflate po celou dobu života (Z_SYNC_FLUSH po každém
+ * rámci), slovník tak tvoří všechna dříve odeslaná data - i krátké opakující
+ * se chat zprávy se komprimují dobře. Na začátku proudu je předvolený slovník
+ * s běžnými texty serveru. Proto se komprimuje až v zapisovači spojení (po
+ * vyzvednutí z fronty): rámce zahozené frontou nesmí chybět v proudu.
+ *
+ * Kompilace s -lz. Kompatibilní s: C++11
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <zlib.h>
+#include <arpa/inet.h>
+
+#include "framing.h"
+
+const char* const COMPRESSION_TOKEN = "deflate";
+const size_t COMPRESSION_THRESHOLD = 32;  // Výchozí práh - kratší zprávy jdou nekomprimované
+const int COMPRESSION_LEVEL = 9;          // Spojení jsou omezená šířkou pásma, ne CPU
+const int COMPRESSION_WINDOW_BITS = -15;  // Raw deflate, 32KB okno (hlavičku zlib nepotřebujeme)
+
+/**
+ * Předvolený slovník - nejčastější texty serveru (nejčastější na konci)
+ */
+const char COMPRESSION_DICTIONARY[] =
+    "=== Chat Server - Nápověda ===\nVšechny vaše zprávy se automaticky posílají všem uživatelům ve vaší místnosti.\n\n"
+    "Dostupné příkazy:\n/quit - Odpojení ze serveru\n/list - Seznam připojených uživatelů\n"
+    "/join <místnost> - Přechod do místnosti\n/leave - Návrat do hlavní místnosti\n/rooms - Seznam místností\n/history [N] - Posledních N zpráv místnosti\n"
+    "/pm <uživatel> <zpráva> - Soukromá zpráva přes server\n/getpeer <uživatel> - Získání P2P informací\n"
+    "/peers - Seznam všech s P2P informacemi\n/help - Zobrazení této nápovědy\n\n"
+    "Pro odeslání zprávy jednoduše napište text a stiskněte Enter."
+    "ERROR: Neznámý příkaz. Použijte /help"
+    "PEERS:P2P_INFO:Připojení uživatelé (): Vítejte v chatu, ! Vaše barva: \033[0m"
+    " odešel do místnosti vstoupil do místnosti Jste v místnosti lobby se připojil k chatu opustil chat[PM od ] [SYSTEM] Server: \033[91m\033[92m\033[93m\033[94m\033[95m\033[96m";
+
+/**
+ * Kompresor odchozích rámců jednoho spojení
+ * enable() volá obsluha při handshake, compress_batch() jen zapisovač
+ * spojení (proud deflate má jediného vlastníka).
+ */
+class FrameCompressor {
+public:
+    explicit FrameCompressor(size_t threshold = COMPRESSION_THRESHOLD)
+        : threshold_(threshold), enabled_(false), initialized_(false) {}
+
+    ~FrameCompressor() {
+        if (initialized_) deflateEnd(&stream_);
+    }
+
+    void enable() {
+        enabled_.store(true, std::memory_order_release);
+    }
+
+    bool enabled() const {
+        return enabled_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Komprese rámců dávky od indexu first (právě vyzvednutých z fronty)
+     */
+    void compress_batch(FrameBatch& batch, size_t first) {
+        if (!enabled()) return;
+        batch.transform_from(first, [this](const Frame& frame) { return compress(frame); });
+    }
+
+    /**
+     * Komprimovaná kopie rámce, nebo původní rámec pod prahem
+     */
+    Frame compress(const Frame& frame) {
+        size_t payload_size = frame->size() - FRAME_HEADER_SIZE;
+        if (payload_size < threshold_ || !ensure_stream()) {
+            return frame;
+        }
+
+        // Výstupní buffer z poolu rámců (vrátí se tam i komprimovaný rámec)
+        size_t bound = FRAME_HEADER_SIZE + deflateBound(&stream_, payload_size) + 16;
+        std::string* buffer = FramePool::instance().acquire(bound);
+        std::string& out = *buffer;
+        out.assign(bound, '\0');
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(frame->data() + FRAME_HEADER_SIZE));
+        stream_.avail_in = static_cast<uInt>(payload_size);
+        size_t produced = FRAME_HEADER_SIZE;
+        do {
+            if (produced == out.size()) out.resize(out.size() * 2);
+            stream_.next_out = reinterpret_cast<Bytef*>(&out[produced]);
+            stream_.avail_out = static_cast<uInt>(out.size() - produced);
+            deflate(&stream_, Z_SYNC_FLUSH);
+            produced = out.size() - stream_.avail_out;
+        } while (stream_.avail_out == 0);
+        out.resize(produced);
+
+        uint32_t header = htonl(static_cast<uint32_t>(produced - FRAME_HEADER_SIZE) | FRAME_COMPRESSED_FLAG);
+        std::memcpy(&out[0], &header, FRAME_HEADER_SIZE);
+        return FramePool::instance().share(buffer);
+    }
+
+private:
+    FrameCompressor(const FrameCompressor&);
+    FrameCompressor& operator=(const FrameCompressor&);
+
+    bool ensure_stream() {
+        if (initialized_) return true;
+        std::memset(&stream_, 0, sizeof(stream_));
+        if (deflateInit2(&stream_, COMPRESSION_LEVEL, Z_DEFLATED, COMPRESSION_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+        deflateSetDictionary(&stream_, reinterpret_cast<const Bytef*>(COMPRESSION_DICTIONARY), sizeof(COMPRESSION_DICTIONARY) - 1);
+        initialized_ = true;
+        return true;
+    }
+
+    size_t threshold_;
+    std::atomic<bool> enabled_;
+    bool initialized_;
+    z_stream stream_;
+};
+
+/**
+ * Dekompresor příchozích rámců (protějšek FrameCompressor na straně klienta)
+ */
+class FrameDecompressor {
+public:
+    FrameDecompressor() : initialized_(false) {}
+
+    ~FrameDecompressor() {
+        if (initialized_) inflateEnd(&stream_);
+    }
+
+    /**
+     * Rozbalení jednoho komprimovaného rámce
+     * @return false při poškozených datech nebo zprávě delší než max_message_size
+     */
+    bool decompress(const std::string& compressed, std::string& message,
+                    uint32_t max_message_size = DEFAULT_MAX_MESSAGE_SIZE) {
+        if (!ensure_stream()) return false;
+        message.assign(max_message_size + 1, '\0');
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+        stream_.avail_in = static_cast<uInt>(compressed.size());
+        stream_.next_out = reinterpret_cast<Bytef*>(&message[0]);
+        stream_.avail_out = static_cast<uInt>(message.size());
+        int result = inflate(&stream_, Z_SYNC_FLUSH);
+        if ((result != Z_OK && result != Z_BUF_ERROR) || stream_.avail_in != 0 || stream_.avail_out == 0) {
+            return false;
+        }
+        message.resize(message.size() - stream_.avail_out);
+        return true;
+    }
+
+private:
+    FrameDecompressor(const FrameDecompressor&);
+    FrameDecompressor& operator=(const FrameDecompressor&);
+
+    bool ensure_stream() {
+        if (initialized_) return true;
+        std::memset(&stream_, 0, sizeof(stream_));
+        if (inflateInit2(&stream_, COMPRESSION_WINDOW_BITS) != Z_OK) {
+            return false;
+        }
+        inflateSetDictionary(&stream_, reinterpret_cast<const Bytef*>(COMPRESSION_DICTIONARY), sizeof(COMPRESSION_DICTIONARY) - 1);
+        initialized_ = true;
+        return true;
+    }
+
+    bool initialized_;
+    z_stream stream_;
+};
+
+/**
+ * Přijetí zprávy, která může být komprimovaná (klient s vyjednanou kompresí)
+ * @return prázdný řetězec při ukončení spojení, chybě nebo poškozených datech
+ */
+inline std::string receive_message(int sock, FrameDecompressor& decompressor,
+                                   uint32_t max_message_size = DEFAULT_MAX_MESSAGE_SIZE) {
+    bool compressed = false;
+    std::string message = receive_frame(sock, compressed, max_message_size);
+    if (!compressed) {
+        return message;
+    }
+    std::string plain;
+    if (!decompressor.decompress(message, plain, max_message_size)) {
+        return "";
+    }
+    return plain;
+}
+
+#endif // COMPRESSION_H
@@ -0,0 +1,89 @@
+/**
+ * Konfigurační soubor jako parametry příkazové řádky
+ *
+ * Každý řádek je jeden parametr bez úvodních "--", hodnota za '=':
+ *   # komentář
+ *   port = 8080
+ *   max-clients = 500
+ *   peer = 10.0.0.2:9190        (opakovatelné parametry na více řádků)
+ *   no-compression              (přepínač bez hodnoty)
+ *
+ * Soubor se převede na parametry ("--port", "8080", ...) a zpracuje stejným
+ * kódem jako příkazová řádka - parametry z ní jsou za parametry souboru,
+ * takže ho přepíší. Neznámý klíč ohlásí zpracování parametrů.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef CONFIG_FILE_H
+#define CONFIG_FILE_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+inline std::string trim_config(const std::string& text) {
+    size_t start = text.find_first_not_of(" \t\r");
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(start, end - start + 1);
+}
+
+/**
+ * Načtení souboru jako parametrů
+ * @param error Popis chyby (soubor nelze otevřít, řádek bez klíče)
+ * @return false při chybě
+ */
+inline bool load_config_file(const std::string& path, std::vector<std::string>& args, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "nelze otevřít " + path;
+        return false;
+    }
+    std::string line;
+    int number = 0;
+    while (std::getline(file, line)) {
+        ++number;
+        std::string text = trim_config(line.substr(0, line.find('#')));
+        if (text.empty()) {
+            continue;
+        }
+        size_t equals = text.find('=');
+        std::string key = trim_config(text.substr(0, equals));
+        if (key.empty()) {
+            error = path + ":" + std::to_string(number) + ": chybí název parametru";
+            return false;
+        }
+        args.push_back("--" + key);
+        if (equals != std::string::npos) {
+            args.push_back(trim_config(text.substr(equals + 1)));
+        }
+    }
+    return true;
+}
+
+/**
+ * Parametry programu s rozvinutým --config SOUBOR
+ * Program dál parsuje jen vrácený seznam (argv[0], soubor, příkazová řádka).
+ * @return false při chybě souboru (popis v error)
+ */
+inline bool expand_config_args(int argc, char* argv[], std::vector<std::string>& args, std::string& error) {
+    args.assign(1, argv[0]);
+    std::vector<std::string> command_line;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--config" && i + 1 < argc) {
+            if (!load_config_file(argv[++i], args, error)) {
+                return false;
+            }
+        } else {
+            command_line.push_back(arg);
+        }
+    }
+    args.insert(args.end(), command_line.begin(), command_line.end());
+    return true;
+}
+
+#endif // CONFIG_FILE_H
@@ -0,0 +1,94 @@
+/**
+ * Stav spojení pro rate limiting a heartbeat
+ *
+ * Každé spojení má vlastní token bucket a čas poslední aktivity, takže
+ * zpracování zprávy nesahá na globální seznam klientů ani na jeho zámek.
+ * Token bucket mění jen vlastník spojení (vlákno klienta nebo reaktor),
+ * časy aktivity jsou atomické - čtou je i časovače spojení.
+ *
+ * Časy jsou z monotónních hrubých hodin (coarse_clock.h), posun systémového
+ * času tedy neovlivní ani limit, ani detekci neaktivních klientů.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef CONNECTION_STATE_H
+#define CONNECTION_STATE_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "coarse_clock.h"
+
+/**
+ * Token bucket - průměrně rate zpráv za sekundu, nárazově až capacity
+ * Není thread-safe, používá ho jen vlastník spojení.
+ */
+class TokenBucket {
+public:
+    TokenBucket(double capacity, double rate_per_second)
+        : capacity_(capacity), rate_(rate_per_second), tokens_(capacity), last_refill_(coarse_monotonic_seconds()) {}
+
+    /**
+     * Odebrání jednoho tokenu
+     * @return false pokud je bucket prázdný (limit překročen)
+     */
+    bool try_consume(double now) {
+        if (now > last_refill_) {
+            tokens_ += (now - last_refill_) * rate_;
+            if (tokens_ > capacity_) tokens_ = capacity_;
+            last_refill_ = now;
+        }
+        if (tokens_ < 1.0) {
+            return false;
+        }
+        tokens_ -= 1.0;
+        return true;
+    }
+
+private:
+    double capacity_;
+    double rate_;
+    double tokens_;
+    double last_refill_;
+};
+
+/**
+ * Čas poslední aktivity klienta (zapisuje vlastník, čtou časovače)
+ */
+class Liveness {
+public:
+    explicit Liveness(double now) : last_activity_ms_(to_ms(now)) {}
+
+    void touch(double now) {
+        last_activity_ms_.store(to_ms(now), std::memory_order_relaxed);
+    }
+
+    double idle_for(double now) const {
+        return now - last_activity_ms_.load(std::memory_order_relaxed) / 1000.0;
+    }
+
+    // Byla od času since nějaká aktivita? (ve stejném rozlišení jako touch)
+    bool active_since(double since) const {
+        return last_activity_ms_.load(std::memory_order_relaxed) >= to_ms(since);
+    }
+
+private:
+    static int64_t to_ms(double seconds) {
+        return static_cast<int64_t>(seconds * 1000.0);
+    }
+
+    std::atomic<int64_t> last_activity_ms_;
+};
+
+// Stav sdílený mezi obsluhou spojení a záznamem v seznamu klientů
+struct ConnectionState {
+    TokenBucket rate_limit;
+    Liveness liveness;      // Jakákoli zpráva včetně PONG (heartbeat)
+    Liveness last_message;  // Chat zpráva nebo příkaz (idle timeout)
+
+    ConnectionState(double burst, double rate_per_second, double now)
+        : rate_limit(burst, rate_per_second), liveness(now), last_message(now) {}
+};
+
+#endif // CONNECTION_STATE_H
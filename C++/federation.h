@@ -0,0 +1,395 @@
+/**
+ * Federace serverů - trvalá spojení mezi uzly clusteru
+ *
+ * Každý uzel má vlastní klienty (--max-clients platí na uzel) a ke každému
+ * dalšímu uzlu jedno odchozí spojení (NodeLink). Uzel posílá jen události
+ * svých klientů - chat zprávu místnosti jednou za uzel (ne za každého
+ * vzdáleného klienta), /pm jen uzlu příjemce a změny adresáře uživatelů
+ * (připojení, přechod do místnosti, odpojení). Přijaté zprávy se dál
+ * nepřeposílají, konfigurace je tedy úplná síť: každý uzel uvede všechny
+ * ostatní přes --peer.
+ *
+ * Rámování je stejné jako u klientů (4 byty délky), obsah začíná bytem typu
+ * (NodeMessage), pole jsou big-endian:
+ *   HELLO      [u8 verze][u8 id uzlu][sdílené heslo] (první zpráva v obou směrech)
+ *   USER       [u32 id][u8 barva][u16 P2P port][u8 délka][adresa][u8 délka][jméno][místnost]
+ *   USER_LEFT  [u32 id]
+ *   CHAT       [u8 délka][místnost][u32 odesílatel][u8 barva][u32 čas][u8 délka][jméno][text]
+ *   PM         [u32 odesílatel][u8 barva][u8 délka][jméno][u8 délka][příjemce][text]
+ *
+ * Chat a /pm nesou jméno odesílatele, příjemce tedy nezávisí na pořadí
+ * vůči změnám adresáře. Po navázání spojení dostane protější uzel HELLO
+ * a úplný seznam místních uživatelů dřív než jakoukoli další událost;
+ * po přerušení zapomene všechny uživatele, které se dozvěděl přes toto
+ * spojení (RemoteDirectory::remove_link), a odchozí strana se s rostoucí
+ * prodlevou připojuje znovu. Události z doby výpadku se neposílají.
+ *
+ * Port uzlů přijme jen spojení, jehož HELLO nese heslo clusteru
+ * (--node-secret) - bez něj by kdokoli, kdo se k portu připojí, mohl
+ * vkládat uživatele a zprávy. Heslo jde po síti nešifrované, port uzlů
+ * proto patří na privátní rozhraní (--node-bind).
+ *
+ * Zapisovač spojení odesílá frontu (outbound_queue.h) gather zápisy po
+ * MAX_BATCH_IOV rámcích - události mnoha klientů tak jdou jedním send().
+ *
+ * Kompatibilní s: C++11, Linux
+ */
+
+#ifndef FEDERATION_H
+#define FEDERATION_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "async_log.h"
+#include "framing.h"
+#include "outbound_queue.h"
+#include "socket_tuning.h"
+
+const uint8_t NODE_PROTOCOL_VERSION = 3;
+const size_t NODE_SECRET_MAX_LENGTH = 128;
+const size_t NODE_LINK_QUEUE_CAPACITY = 65536;      // Rámců čekajících na odeslání jednomu uzlu
+const uint32_t NODE_HELLO_SIZE_LIMIT = 256;         // Odchozí strana čte jen HELLO
+const double NODE_RECONNECT_INITIAL_DELAY = 0.5;    // Prodleva před opakovaným připojením (sekundy)
+const double NODE_RECONNECT_MAX_DELAY = 10.0;
+// Spojení mezi uzly nesou dávky rámců - velké buffery, TCP_NODELAY a keepalive
+const SocketProfile NODE_LINK_SOCKET_PROFILE = SocketProfile::BULK;
+
+enum class NodeMessage : uint8_t {
+    HELLO = 0x01,
+    USER = 0x02,
+    USER_LEFT = 0x03,
+    CHAT = 0x04,
+    PM = 0x05
+};
+
+/**
+ * Začátek zprávy mezi uzly daného typu
+ */
+inline FrameBuilder node_frame(NodeMessage type, size_t payload_hint = 0) {
+    FrameBuilder builder(1 + payload_hint);
+    builder.append_u8(static_cast<uint8_t>(type));
+    return builder;
+}
+
+inline Frame make_node_hello(uint8_t node_id, const std::string& secret) {
+    return node_frame(NodeMessage::HELLO, 2 + secret.size())
+        .append_u8(NODE_PROTOCOL_VERSION)
+        .append_u8(node_id)
+        .append(secret)
+        .finish();
+}
+
+/**
+ * Porovnání hesla z HELLO v konstantním čase (nezávisle na shodném prefixu)
+ */
+inline bool node_secret_matches(const MessageView& offered, const std::string& secret) {
+    if (offered.size != secret.size()) {
+        return false;
+    }
+    unsigned char difference = 0;
+    for (size_t i = 0; i < secret.size(); ++i) {
+        difference |= static_cast<unsigned char>(offered.data[i] ^ secret[i]);
+    }
+    return difference == 0;
+}
+
+/**
+ * Rozdělení "host:port" (IPv6 adresa v hranatých závorkách)
+ * @return false pokud chybí host nebo platný port
+ */
+inline bool parse_node_address(const std::string& address, std::string& host, int& port) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 >= address.size()) {
+        return false;
+    }
+    host = address.substr(0, colon);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    char* end = nullptr;
+    long value = std::strtol(address.c_str() + colon + 1, &end, 10);
+    if (*end != '\0' || value <= 0 || value > 65535) {
+        return false;
+    }
+    port = static_cast<int>(value);
+    return true;
+}
+
+/**
+ * Uživatelé ostatních uzlů (id -> záznam, vyhledání i podle jména)
+ * Každý záznam si pamatuje spojení, přes které přišel - po jeho přerušení
+ * se odeberou jen záznamy tohoto spojení, ne novější z dalšího spojení
+ * stejného uzlu. Všechny metody zamykají vlastní zámek; callback for_each()
+ * běží pod ním a nesmí zamykat nic, co se drží při volání adresáře.
+ */
+template <typename Record>
+class RemoteDirectory {
+public:
+    /**
+     * Vložení nebo změna uživatele
+     * @return true pokud byl uživatel už známý (previous = původní záznam)
+     */
+    bool upsert(uint32_t id, const std::string& name, uint64_t link, const Record& record, Record& previous) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = entries_.find(id);
+        if (found != entries_.end()) {
+            previous = found->second.record;
+            if (found->second.name != name) {
+                erase_name_locked(found->second.name, id);
+                by_name_.insert(std::make_pair(name, id));
+                found->second.name = name;
+            }
+            found->second.record = record;
+            found->second.link = link;
+            return true;
+        }
+        Entry entry = {record, name, link};
+        entries_.insert(std::make_pair(id, entry));
+        by_name_.insert(std::make_pair(name, id));
+        return false;
+    }
+
+    bool remove(uint32_t id, Record& removed) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = entries_.find(id);
+        if (found == entries_.end()) {
+            return false;
+        }
+        removed = found->second.record;
+        erase_name_locked(found->second.name, id);
+        entries_.erase(found);
+        return true;
+    }
+
+    /**
+     * Odebrání všech uživatelů, kteří přišli daným spojením
+     */
+    void remove_link(uint64_t link, std::vector<Record>& removed) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (it->second.link == link) {
+                removed.push_back(it->second.record);
+                erase_name_locked(it->second.name, it->first);
+                it = entries_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    bool find_name(const char* name, size_t length, Record& out) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = by_name_.find(std::string(name, length));
+        if (found == by_name_.end()) {
+            return false;
+        }
+        out = entries_.find(found->second)->second.record;
+        return true;
+    }
+
+    template <typename Function>
+    void for_each(Function function) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : entries_) {
+            function(entry.second.record);
+        }
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+private:
+    struct Entry {
+        Record record;
+        std::string name;
+        uint64_t link;
+    };
+
+    void erase_name_locked(const std::string& name, uint32_t id) {
+        auto range = by_name_.equal_range(name);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == id) {
+                by_name_.erase(it);
+                return;
+            }
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint32_t, Entry> entries_;
+    std::unordered_multimap<std::string, uint32_t> by_name_;
+};
+
+/**
+ * Odchozí spojení k jednomu uzlu
+ * Vlastní vlákno se připojuje (při neúspěchu znovu s rostoucí prodlevou),
+ * po připojení předá novou frontu callbacku on_connected a pak ji odesílá.
+ * Druhé vlákno spojení čte HELLO protější strany a pozná zavření spojení.
+ * Odesílatelé volají forward() - bez připojené fronty se rámec zahodí.
+ */
+class NodeLink {
+public:
+    /**
+     * Naplnění fronty nového spojení (HELLO, úplný stav uzlu)
+     * Callback frontu zveřejní přes attach() ve stejném kroku, v jakém
+     * pořizuje snímek stavu, aby žádná událost nepředběhla snímek.
+     */
+    typedef std::function<void(NodeLink&, const std::shared_ptr<OutboundQueue>&)> Connected;
+
+    NodeLink(const std::string& host, int port)
+        : host_(host), port_(port), address_(host + ":" + std::to_string(port)),
+          remote_node_(0) {}
+
+    void start(Connected on_connected) {
+        on_connected_ = std::move(on_connected);
+        std::thread(&NodeLink::run, this).detach();
+    }
+
+    void attach(const std::shared_ptr<OutboundQueue>& queue) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_ = queue;
+    }
+
+    /**
+     * Zařazení rámce k odeslání (nikdy nečeká)
+     * @return CLOSED pokud spojení není navázané
+     */
+    OutboundQueue::PushResult forward(const Frame& frame) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_ ? queue_->push(frame, false) : OutboundQueue::CLOSED;
+    }
+
+    bool connected() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_ != nullptr;
+    }
+
+    // Id protějšího uzlu z jeho HELLO (0 = zatím neznámé)
+    uint8_t remote_node() const {
+        return remote_node_.load(std::memory_order_acquire);
+    }
+
+    const std::string& address() const {
+        return address_;
+    }
+
+private:
+    NodeLink(const NodeLink&);
+    NodeLink& operator=(const NodeLink&);
+
+    int connect_once() const {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &result) != 0) {
+            return -1;
+        }
+        int fd = -1;
+        for (addrinfo* ai = result; ai != nullptr && fd < 0; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd >= 0) {
+                // Buffery před connect() - jádro podle nich volí okno
+                apply_socket_tuning(fd, socket_profile(NODE_LINK_SOCKET_PROFILE));
+            }
+            if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(result);
+        return fd;
+    }
+
+    void run() {
+        double delay = NODE_RECONNECT_INITIAL_DELAY;
+        bool reported = false;
+        while (true) {
+            int fd = connect_once();
+            if (fd < 0) {
+                if (!reported) LOG_WARN("Uzel " << address_ << " je nedostupný, připojení se opakuje");
+                reported = true;
+                std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+                delay = std::min(delay * 2, NODE_RECONNECT_MAX_DELAY);
+                continue;
+            }
+            reported = false;
+            delay = NODE_RECONNECT_INITIAL_DELAY;
+            LOG_INFO("Spojení s uzlem " << address_ << " navázáno");
+
+            std::shared_ptr<OutboundQueue> queue =
+                std::make_shared<OutboundQueue>(NODE_LINK_QUEUE_CAPACITY, OverflowPolicy::DROP_OLDEST, 0.0);
+            on_connected_(*this, queue);
+            std::thread watcher(&NodeLink::watch, this, fd, queue);
+            FrameBatch batch;
+            while (queue->pop(batch, MAX_BATCH_IOV)) {
+                if (!batch.send_all(fd)) {
+                    break;
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (queue_ == queue) queue_.reset();
+            }
+            queue->abort();
+            shutdown(fd, SHUT_RDWR);
+            watcher.join();
+            close(fd);
+            remote_node_.store(0, std::memory_order_release);
+            LOG_WARN("Spojení s uzlem " << address_ << " přerušeno");
+            std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+        }
+    }
+
+    // Čtení HELLO; zavření spojení protější stranou ukončí i zapisovač
+    void watch(int fd, std::shared_ptr<OutboundQueue> queue) {
+        FrameDecoder decoder(NODE_HELLO_SIZE_LIMIT);
+        MessageView message;
+        while (true) {
+            FrameDecoder::Status status = decoder.next(message);
+            if (status == FrameDecoder::TOO_LARGE) {
+                break;
+            }
+            if (status == FrameDecoder::NEED_MORE) {
+                ssize_t received = decoder.fill(fd, 0);
+                if (received < 0 && errno == EINTR) continue;
+                if (received <= 0) break;
+                continue;
+            }
+            if (message.size >= 3 && static_cast<uint8_t>(message.data[0]) == static_cast<uint8_t>(NodeMessage::HELLO)) {
+                remote_node_.store(static_cast<uint8_t>(message.data[2]), std::memory_order_release);
+            }
+        }
+        queue->abort();
+    }
+
+    std::string host_;
+    int port_;
+    std::string address_;
+    Connected on_connected_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<OutboundQueue> queue_;  // Fronta navázaného spojení (nullptr = odpojeno)
+    std::atomic<uint8_t> remote_node_;
+};
+
+#endif // FEDERATION_H
@@ -0,0 +1,100 @@
+/**
+ * Krátký řetězec s pevnou kapacitou uložený přímo v objektu
+ *
+ * Pro pole s malou horní mezí (jméno uživatele, kód barvy, název místnosti):
+ * kopie záznamu klienta nebo položky historie je jen memcpy, bez alokace
+ * na haldě. Delší vstup se při přiřazení zkrátí na kapacitu (stejně jako
+ * dřívější substr(0, 20) u jména).
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+template <size_t Capacity>
+class FixedString {
+    static_assert(Capacity < 256, "délka se ukládá do jednoho bytu");
+
+public:
+    FixedString() : size_(0) {
+        data_[0] = '\0';
+    }
+
+    FixedString(const char* data, size_t size) {
+        assign(data, size);
+    }
+
+    explicit FixedString(const std::string& text) {
+        assign(text.data(), text.size());
+    }
+
+    FixedString& assign(const char* data, size_t size) {
+        if (size > Capacity) size = Capacity;
+        std::memcpy(data_, data, size);
+        data_[size] = '\0';
+        size_ = static_cast<uint8_t>(size);
+        return *this;
+    }
+
+    FixedString& operator=(const std::string& text) {
+        return assign(text.data(), text.size());
+    }
+
+    FixedString& operator=(const char* text) {
+        return assign(text, std::strlen(text));
+    }
+
+    static size_t capacity() {
+        return Capacity;
+    }
+
+    const char* data() const {
+        return data_;
+    }
+
+    const char* c_str() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    std::string str() const {
+        return std::string(data_, size_);
+    }
+
+    bool equals(const char* data, size_t size) const {
+        return size == size_ && std::memcmp(data_, data, size) == 0;
+    }
+
+    bool operator==(const std::string& text) const {
+        return equals(text.data(), text.size());
+    }
+
+    bool operator!=(const std::string& text) const {
+        return !equals(text.data(), text.size());
+    }
+
+private:
+    char data_[Capacity + 1];
+    uint8_t size_;
+};
+
+template <size_t Capacity>
+inline std::ostream& operator<<(std::ostream& os, const FixedString<Capacity>& text) {
+    return os.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+#endif // FIXED_STRING_H
@@ -0,0 +1,208 @@
+/**
+ * Pool bufferů pro rámce zpráv
+ *
+ * Rámec (Frame) žije krátce - vznikne při broadcastu, projde frontami
+ * příjemců a zanikne po posledním odeslání nebo vypadnutí z historie.
+ * Místo alokace a uvolnění na každou zprávu se buffery recyklují:
+ *
+ *   - buffery (std::string se zachovanou kapacitou) jsou rozdělené do tříd
+ *     podle velikosti, FrameBuilder si vezme buffer nejbližší větší třídy
+ *   - poslední reference rámce buffer místo smazání vrátí do jeho třídy
+ *   - řídicí blok shared_ptr se bere z free listu bloků pevné velikosti
+ *
+ * V ustáleném stavu tak zpráva nealokuje nic. Rámec se uvolňuje v jiném
+ * vlákně, než vznikl (zapisovač, reaktor), proto jsou free listy sdílené
+ * pod zámkem třídy. Prázdných bufferů třída drží nejvýše FRAME_POOL_CLASS_BYTES,
+ * přebytek a větší buffery se uvolní normálně.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+// Zarámovaná zpráva sdílená mezi příjemci (hlavička + obsah)
+typedef std::shared_ptr<const std::string> Frame;
+
+const size_t FRAME_POOL_CLASSES[] = {128, 512, 2048, 8192, 65536};  // Kapacity tříd (B)
+const size_t FRAME_POOL_CLASS_COUNT = sizeof(FRAME_POOL_CLASSES) / sizeof(FRAME_POOL_CLASSES[0]);
+const size_t FRAME_POOL_CLASS_BYTES = 8 * 1024 * 1024;  // Max. volné paměti v jedné třídě
+const size_t FRAME_POOL_BLOCK_SIZE = 64;                // Řídicí blok shared_ptr (s rezervou)
+
+class FramePool {
+public:
+    /**
+     * Sdílený pool procesu
+     * Nikdy se neruší - rámce může uvolňovat i odpojené vlákno při ukončení.
+     */
+    static FramePool& instance() {
+        static FramePool* pool = new FramePool();
+        return *pool;
+    }
+
+    /**
+     * Prázdný buffer s kapacitou alespoň capacity
+     */
+    std::string* acquire(size_t capacity) {
+        size_t index = class_for_request(capacity);
+        if (index < FRAME_POOL_CLASS_COUNT) {
+            SizeClass& size_class = classes_[index];
+            std::lock_guard<std::mutex> lock(size_class.mutex);
+            if (!size_class.free.empty()) {
+                std::string* buffer = size_class.free.back();
+                size_class.free.pop_back();
+                reused_.fetch_add(1, std::memory_order_relaxed);
+                return buffer;
+            }
+            capacity = FRAME_POOL_CLASSES[index];
+        }
+        allocated_.fetch_add(1, std::memory_order_relaxed);
+        std::string* buffer = new std::string();
+        buffer->reserve(capacity);
+        return buffer;
+    }
+
+    /**
+     * Vrácení bufferu (třída podle skutečné kapacity - buffer mohl narůst)
+     */
+    void release(std::string* buffer) {
+        size_t index = class_for_buffer(buffer->capacity());
+        if (index < FRAME_POOL_CLASS_COUNT) {
+            SizeClass& size_class = classes_[index];
+            buffer->clear();
+            std::lock_guard<std::mutex> lock(size_class.mutex);
+            if (size_class.free.size() < FRAME_POOL_CLASS_BYTES / FRAME_POOL_CLASSES[index]) {
+                size_class.free.push_back(buffer);
+                return;
+            }
+        }
+        delete buffer;
+    }
+
+    /**
+     * Hotový buffer jako sdílený rámec (po poslední referenci se vrátí do poolu)
+     */
+    Frame share(std::string* buffer);
+
+    // Řídicí bloky shared_ptr (pevná velikost, jeden free list)
+    void* allocate_block(size_t size) {
+        if (size <= FRAME_POOL_BLOCK_SIZE) {
+            std::lock_guard<std::mutex> lock(blocks_mutex_);
+            if (free_blocks_ != nullptr) {
+                FreeBlock* block = free_blocks_;
+                free_blocks_ = block->next;
+                return block;
+            }
+            return ::operator new(FRAME_POOL_BLOCK_SIZE);
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate_block(void* pointer, size_t size) {
+        if (size <= FRAME_POOL_BLOCK_SIZE) {
+            FreeBlock* block = static_cast<FreeBlock*>(pointer);
+            std::lock_guard<std::mutex> lock(blocks_mutex_);
+            block->next = free_blocks_;
+            free_blocks_ = block;
+            return;
+        }
+        ::operator delete(pointer);
+    }
+
+    // Počet nově alokovaných a recyklovaných bufferů (kontrola ustáleného stavu)
+    uint64_t allocated() const {
+        return allocated_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t reused() const {
+        return reused_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct SizeClass {
+        std::mutex mutex;
+        std::vector<std::string*> free;
+    };
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    FramePool() : free_blocks_(nullptr), allocated_(0), reused_(0) {}
+    FramePool(const FramePool&);
+    FramePool& operator=(const FramePool&);
+
+    // Nejmenší třída, do které se požadavek vejde (COUNT = mimo pool)
+    static size_t class_for_request(size_t capacity) {
+        size_t index = 0;
+        while (index < FRAME_POOL_CLASS_COUNT && FRAME_POOL_CLASSES[index] < capacity) ++index;
+        return index;
+    }
+
+    // Největší třída, jejíž kapacitu buffer pokryje (COUNT = mimo pool)
+    static size_t class_for_buffer(size_t capacity) {
+        if (capacity > 2 * FRAME_POOL_CLASSES[FRAME_POOL_CLASS_COUNT - 1]) return FRAME_POOL_CLASS_COUNT;
+        size_t index = FRAME_POOL_CLASS_COUNT;
+        while (index > 0 && FRAME_POOL_CLASSES[index - 1] > capacity) --index;
+        return index > 0 ? index - 1 : FRAME_POOL_CLASS_COUNT;
+    }
+
+    SizeClass classes_[FRAME_POOL_CLASS_COUNT];
+    std::mutex blocks_mutex_;
+    FreeBlock* free_blocks_;
+    std::atomic<uint64_t> allocated_;
+    std::atomic<uint64_t> reused_;
+};
+
+/**
+ * Alokátor řídicích bloků rámců (free list poolu)
+ */
+template <typename T>
+struct FrameBlockAllocator {
+    typedef T value_type;
+
+    FrameBlockAllocator() {}
+
+    template <typename U>
+    FrameBlockAllocator(const FrameBlockAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(FramePool::instance().allocate_block(count * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, size_t count) {
+        FramePool::instance().deallocate_block(pointer, count * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+inline bool operator==(const FrameBlockAllocator<T>&, const FrameBlockAllocator<U>&) {
+    return true;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const FrameBlockAllocator<T>&, const FrameBlockAllocator<U>&) {
+    return false;
+}
+
+// Deleter rámce - buffer se vrací do poolu
+struct FrameRecycler {
+    void operator()(const std::string* buffer) const {
+        FramePool::instance().release(const_cast<std::string*>(buffer));
+    }
+};
+
+inline Frame FramePool::share(std::string* buffer) {
+    return Frame(buffer, FrameRecycler(), FrameBlockAllocator<std::string>());
+}
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,477 @@
+/**
+ * Rámování zpráv length-prefixed protokolu
+ * Formát: [4 byty délka (big-endian)][zpráva]
+ * Nejvyšší bit délky značí komprimovanou zprávu (jen po vyjednání, compression.h).
+ *
+ * Společná vrstva pro server, klienta i P2P peera (C++/server.cpp,
+ * C++/client.cpp, P2P/C++/peer2peer.cpp). Hlavička a obsah se odesílají
+ * jedním gather zápisem (sendmsg), částečný zápis se dopíše.
+ *
+ * Frame je neměnný, referencemi počítaný buffer s již zarámovanou zprávou.
+ * Broadcast zprávu zarámuje jednou a všichni příjemci sdílí stejný buffer -
+ * na příjemce nepřipadá žádná další kopie ani alokace. Buffery i řídicí
+ * bloky rámců se recyklují (frame_pool.h).
+ *
+ * Kompatibilní s: C++11, Python implementace
+ */
+
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+
+#include "fixed_string.h"
+#include "frame_pool.h"
+
+const size_t FRAME_HEADER_SIZE = 4;
+const uint32_t DEFAULT_MAX_MESSAGE_SIZE = 40960;  // 40KB (stejně jako Python)
+const size_t MAX_BATCH_IOV = 64;                  // Max. počet rámců v jednom zápisu
+const size_t DECODER_READ_CHUNK = 16384;          // Minimální volné místo pro jedno recv()
+const uint32_t FRAME_COMPRESSED_FLAG = 0x80000000u;  // Příznak komprese v hlavičce
+
+/**
+ * Pohled na obsah přijaté zprávy bez kopírování
+ * Platí jen do dalšího FrameDecoder::fill() - kdo potřebuje víc, zavolá str().
+ */
+struct MessageView {
+    const char* data;
+    size_t size;
+
+    bool empty() const {
+        return size == 0;
+    }
+
+    bool equals(const char* text) const {
+        size_t length = std::strlen(text);
+        return size == length && std::memcmp(data, text, length) == 0;
+    }
+
+    bool starts_with(const char* prefix) const {
+        size_t length = std::strlen(prefix);
+        return size >= length && std::memcmp(data, prefix, length) == 0;
+    }
+
+    // Část zprávy od pos (nejvýše length bytů), stále bez kopie
+    MessageView substr(size_t pos, size_t length = std::string::npos) const {
+        if (pos > size) pos = size;
+        MessageView view = {data + pos, std::min(length, size - pos)};
+        return view;
+    }
+
+    std::string str() const {
+        return std::string(data, size);
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const MessageView& message) {
+    return os.write(message.data, static_cast<std::streamsize>(message.size));
+}
+
+/**
+ * Postupné skládání obsahu zprávy přímo do bufferu rámce
+ * Nahrazuje řetězení std::string - buffer pro celou zprávu se vezme z poolu
+ * rámců podle payload_hint (delší zpráva buffer jednou zvětší).
+ */
+class FrameBuilder {
+public:
+    explicit FrameBuilder(size_t payload_hint = 0)
+        : buffer_(FramePool::instance().acquire(FRAME_HEADER_SIZE + payload_hint)) {
+        buffer_->append(FRAME_HEADER_SIZE, '\0');
+    }
+
+    FrameBuilder(FrameBuilder&& other) : buffer_(other.buffer_) {
+        other.buffer_ = nullptr;
+    }
+
+    // Nedokončený buffer se vrací do poolu
+    ~FrameBuilder() {
+        if (buffer_ != nullptr) FramePool::instance().release(buffer_);
+    }
+
+    FrameBuilder& append(const char* data, size_t length) {
+        buffer_->append(data, length);
+        return *this;
+    }
+
+    FrameBuilder& append(const char* text) {
+        return append(text, std::strlen(text));
+    }
+
+    FrameBuilder& append(const std::string& text) {
+        return append(text.data(), text.size());
+    }
+
+    FrameBuilder& append(const MessageView& text) {
+        return append(text.data, text.size);
+    }
+
+    template <size_t Capacity>
+    FrameBuilder& append(const FixedString<Capacity>& text) {
+        return append(text.data(), text.size());
+    }
+
+    // Binární pole (big-endian, stejně jako hlavička)
+    FrameBuilder& append_u8(uint8_t value) {
+        buffer_->push_back(static_cast<char>(value));
+        return *this;
+    }
+
+    FrameBuilder& append_u16(uint16_t value) {
+        uint16_t network = htons(value);
+        return append(reinterpret_cast<const char*>(&network), sizeof(network));
+    }
+
+    FrameBuilder& append_u32(uint32_t value) {
+        uint32_t network = htonl(value);
+        return append(reinterpret_cast<const char*>(&network), sizeof(network));
+    }
+
+    /**
+     * Doplnění hlavičky a předání bufferu jako sdíleného rámce
+     */
+    Frame finish() {
+        uint32_t message_length = htonl(static_cast<uint32_t>(buffer_->size() - FRAME_HEADER_SIZE));
+        std::memcpy(&(*buffer_)[0], &message_length, FRAME_HEADER_SIZE);
+        std::string* buffer = buffer_;
+        buffer_ = nullptr;
+        return FramePool::instance().share(buffer);
+    }
+
+private:
+    FrameBuilder(const FrameBuilder&);
+    FrameBuilder& operator=(const FrameBuilder&);
+
+    std::string* buffer_;
+};
+
+/**
+ * Zarámování hotové zprávy
+ */
+inline Frame make_frame(const std::string& message) {
+    return FrameBuilder(message.size()).append(message).finish();
+}
+
+/**
+ * Odeslání celého iovec pole, včetně dopsání po částečném zápisu
+ * Pole se při tom upravuje (posouvají se začátky již odeslaných částí).
+ */
+inline bool send_iov_all(int sock, iovec* iov, size_t count) {
+    while (count > 0) {
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        
+        // Přeskočení kompletně odeslaných částí, zkrácení první neodeslané
+        size_t remaining = static_cast<size_t>(sent);
+        while (count > 0 && remaining >= iov->iov_len) {
+            remaining -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + remaining;
+            iov->iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+/**
+ * Odešle zprávu s prefixem délky (kompatibilní s Python)
+ * Hlavička i obsah jdou jedním syscallem - bez malých paketů kvůli Nagle.
+ */
+inline bool send_message(int sock, const std::string& message) {
+    uint32_t message_length = htonl(static_cast<uint32_t>(message.length()));
+    iovec iov[2];
+    iov[0].iov_base = &message_length;
+    iov[0].iov_len = FRAME_HEADER_SIZE;
+    iov[1].iov_base = const_cast<char*>(message.data());
+    iov[1].iov_len = message.length();
+    return send_iov_all(sock, iov, message.empty() ? 1 : 2);
+}
+
+/**
+ * Přijme jeden rámec včetně příznaku komprese
+ * @param compressed Nastaví se podle příznaku v hlavičce (obsah se nerozbaluje)
+ * @return prázdný řetězec při ukončení spojení, chybě nebo příliš dlouhé zprávě
+ */
+inline std::string receive_frame(int sock, bool& compressed, uint32_t max_message_size = DEFAULT_MAX_MESSAGE_SIZE) {
+    // Přijetí délky zprávy (4 byty)
+    uint32_t message_length_net;
+    if (recv(sock, &message_length_net, FRAME_HEADER_SIZE, MSG_WAITALL) != static_cast<ssize_t>(FRAME_HEADER_SIZE)) {
+        return ""; // Spojení ukončeno nebo chyba
+    }
+    
+    // Převod z network byte order na host byte order a validace délky
+    uint32_t message_length = ntohl(message_length_net);
+    compressed = (message_length & FRAME_COMPRESSED_FLAG) != 0;
+    message_length &= ~FRAME_COMPRESSED_FLAG;
+    if (message_length > max_message_size) {
+        return "";
+    }
+    
+    // Přijetí samotné zprávy
+    std::string message(message_length, '\0');
+    if (message_length > 0) {
+        if (recv(sock, &message[0], message_length, MSG_WAITALL) != static_cast<ssize_t>(message_length)) {
+            return "";
+        }
+    }
+    
+    return message;
+}
+
+/**
+ * Přijme zprávu s prefixem délky (kompatibilní s Python)
+ * Komprimovaný rámec (bez vyjednané komprese) se bere jako chyba.
+ * @return prázdný řetězec při ukončení spojení, chybě nebo příliš dlouhé zprávě
+ */
+inline std::string receive_message(int sock, uint32_t max_message_size = DEFAULT_MAX_MESSAGE_SIZE) {
+    bool compressed = false;
+    std::string message = receive_frame(sock, compressed, max_message_size);
+    return compressed ? std::string() : message;
+}
+
+/**
+ * Dekodér příchozích rámců nad bufferem spojení
+ * Jedno recv() načte vše, co má jádro k dispozici, a next() z toho postupně
+ * vrací kompletní zprávy jako pohledy do bufferu - bez alokace na zprávu.
+ * Buffer se alokuje jednou a roste nejvýše na hlavičku + max_message_size.
+ */
+class FrameDecoder {
+public:
+    enum Status {
+        FRAME,      // Vrácena kompletní zpráva
+        NEED_MORE,  // V bufferu není celá zpráva, je třeba fill()
+        TOO_LARGE   // Ohlášená délka přesahuje limit - spojení je třeba ukončit
+    };
+
+    explicit FrameDecoder(uint32_t max_message_size = DEFAULT_MAX_MESSAGE_SIZE)
+        : buffer_(DECODER_READ_CHUNK), start_(0), end_(0), max_message_size_(max_message_size) {}
+
+    /**
+     * Další kompletní zpráva z bufferu
+     */
+    Status next(MessageView& out) {
+        size_t available = end_ - start_;
+        if (available < FRAME_HEADER_SIZE) {
+            return NEED_MORE;
+        }
+        uint32_t message_length_net;
+        std::memcpy(&message_length_net, &buffer_[start_], FRAME_HEADER_SIZE);
+        uint32_t message_length = ntohl(message_length_net);
+        if (message_length > max_message_size_) {
+            return TOO_LARGE;
+        }
+        if (available - FRAME_HEADER_SIZE < message_length) {
+            return NEED_MORE;
+        }
+        out.data = &buffer_[start_ + FRAME_HEADER_SIZE];
+        out.size = message_length;
+        start_ += FRAME_HEADER_SIZE + message_length;
+        return FRAME;
+    }
+
+    /**
+     * Jedno recv() do volného místa bufferu (zneplatní dříve vrácené pohledy)
+     * @return výsledek recv(): počet bytů, 0 při ukončení spojení, -1 při chybě
+     */
+    ssize_t fill(int sock, int flags) {
+        make_room();
+        ssize_t received = recv(sock, &buffer_[end_], buffer_.size() - end_, flags);
+        if (received > 0) {
+            end_ += static_cast<size_t>(received);
+        }
+        return received;
+    }
+
+    /**
+     * Připojení dat přijatých jinou cestou (např. io_uring buffer) - jako fill()
+     */
+    void append(const char* data, size_t size) {
+        while (size > 0) {
+            make_room();
+            size_t chunk = std::min(size, buffer_.size() - end_);
+            std::memcpy(&buffer_[end_], data, chunk);
+            end_ += chunk;
+            data += chunk;
+            size -= chunk;
+        }
+    }
+
+private:
+    // Zajištění místa pro další čtení: celá rozpracovaná zpráva se musí vejít
+    // do bufferu a za daty má zbýt alespoň jeden blok čtení. Nezpracovaný zbytek
+    // se přesouvá na začátek jen tehdy, když místo na konci nestačí.
+    void make_room() {
+        size_t pending = end_ - start_;
+        if (pending == 0) {
+            start_ = end_ = 0;
+        }
+        
+        size_t frame_size = 0;
+        if (pending >= FRAME_HEADER_SIZE) {
+            uint32_t message_length_net;
+            std::memcpy(&message_length_net, &buffer_[start_], FRAME_HEADER_SIZE);
+            uint32_t message_length = ntohl(message_length_net);
+            if (message_length <= max_message_size_) {
+                frame_size = FRAME_HEADER_SIZE + message_length;
+            }
+        }
+        
+        bool tail_ok = buffer_.size() - end_ >= DECODER_READ_CHUNK && start_ + frame_size <= buffer_.size();
+        if (tail_ok) {
+            return;
+        }
+        if (start_ > 0) {
+            std::memmove(&buffer_[0], &buffer_[start_], pending);
+            start_ = 0;
+            end_ = pending;
+        }
+        size_t needed = std::max(pending + DECODER_READ_CHUNK, frame_size);
+        if (buffer_.size() < needed) {
+            buffer_.resize(needed);
+        }
+    }
+
+    std::vector<char> buffer_;
+    size_t start_;  // Začátek nezpracovaných dat
+    size_t end_;    // Konec přijatých dat
+    uint32_t max_message_size_;
+};
+
+/**
+ * Dávka rámců odesílaná jedním gather zápisem
+ * Pamatuje si, kolik z první neodeslané zprávy už odešlo, takže zvládá
+ * blokující i neblokující sockety.
+ */
+class FrameBatch {
+public:
+    FrameBatch() : next_(0), offset_(0) {}
+
+    void push(Frame frame) {
+        frames_.push_back(std::move(frame));
+    }
+
+    bool empty() const {
+        return next_ >= frames_.size();
+    }
+
+    // Počet rámců v dávce včetně již odeslaných (index pro transform_from)
+    size_t size() const {
+        return frames_.size();
+    }
+
+    // Počet dosud neodeslaných bytů
+    size_t pending_bytes() const {
+        size_t bytes = 0;
+        for (size_t i = next_; i < frames_.size(); ++i) {
+            bytes += frames_[i]->size();
+        }
+        return bytes - (empty() ? 0 : offset_);
+    }
+
+    /**
+     * Nahrazení dosud neodesílaných rámců od indexu first (např. kompresí)
+     */
+    template <typename Transform>
+    void transform_from(size_t first, Transform transform) {
+        if (first < next_ || (first == next_ && offset_ > 0)) {
+            first = next_ + (offset_ > 0 ? 1 : 0);
+        }
+        for (size_t i = first; i < frames_.size(); ++i) {
+            frames_[i] = transform(frames_[i]);
+        }
+    }
+
+    /**
+     * Jeden zápis (sendmsg) tolika rámců, kolik se vejde do MAX_BATCH_IOV
+     * @param flags Doplňující flagy (např. MSG_DONTWAIT)
+     * @return počet odeslaných bytů nebo -1 (errno nastaveno)
+     */
+    ssize_t write_some(int sock, int flags) {
+        iovec iov[MAX_BATCH_IOV];
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = prepare_iov(iov);
+        ssize_t sent = sendmsg(sock, &msg, MSG_NOSIGNAL | flags);
+        if (sent > 0) {
+            consume(static_cast<size_t>(sent));
+        }
+        return sent;
+    }
+
+    /**
+     * Vektor neodeslaných dat pro asynchronní zápis (nejvýše MAX_BATCH_IOV položek)
+     * Rámce musí zůstat v dávce, dokud zápis neskončí - pak complete().
+     * @return počet vyplněných položek
+     */
+    size_t prepare_iov(iovec* iov) const {
+        size_t count = 0;
+        for (size_t i = next_; i < frames_.size() && count < MAX_BATCH_IOV; ++i, ++count) {
+            size_t skip = (i == next_) ? offset_ : 0;
+            iov[count].iov_base = const_cast<char*>(frames_[i]->data() + skip);
+            iov[count].iov_len = frames_[i]->size() - skip;
+        }
+        return count;
+    }
+
+    // Dokončení asynchronního zápisu sent bytů
+    void complete(size_t sent) {
+        consume(sent);
+    }
+
+    /**
+     * Blokující odeslání celé dávky
+     */
+    bool send_all(int sock) {
+        while (!empty()) {
+            if (write_some(sock, 0) < 0 && errno != EINTR) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    // Posun za odeslané byty; po odeslání všeho se buffer vyprázdní (kapacita zůstává)
+    void consume(size_t sent) {
+        while (sent > 0 && next_ < frames_.size()) {
+            size_t left = frames_[next_]->size() - offset_;
+            if (sent < left) {
+                offset_ += sent;
+                return;
+            }
+            sent -= left;
+            frames_[next_].reset();
+            ++next_;
+            offset_ = 0;
+        }
+        if (next_ >= frames_.size()) {
+            frames_.clear();
+            next_ = 0;
+            offset_ = 0;
+        }
+    }
+
+    std::vector<Frame> frames_;
+    size_t next_;
+    size_t offset_;
+};
+
+#endif // FRAMING_H
@@ -0,0 +1,65 @@
+/**
+ * Historie posledních zpráv s pevnou kapacitou
+ *
+ * Kruhový buffer alokovaný při vytvoření, nová zpráva přepíše nejstarší.
+ * Záznamy drží již zarámované zprávy (sdílené Frame), přehrání historie
+ * je tedy jen zařazení stejných bufferů do fronty - bez formátování
+ * a bez alokace na zprávu.
+ *
+ * Kruh sám nezamyká - chrání ho zámek místnosti, které patří.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef HISTORY_RING_H
+#define HISTORY_RING_H
+
+#include <cstddef>
+#include <vector>
+
+template <typename T>
+class HistoryRing {
+public:
+    explicit HistoryRing(size_t capacity) : entries_(capacity), next_(0), size_(0) {}
+
+    size_t capacity() const {
+        return entries_.size();
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    /**
+     * Přidání záznamu (přepíše nejstarší, pokud je kruh plný)
+     * Slot se přiřazením znovu použije - jeho buffery zůstávají alokované.
+     */
+    void push(const T& entry) {
+        if (entries_.empty()) return;
+        entries_[next_] = entry;
+        next_ = (next_ + 1) % entries_.size();
+        if (size_ < entries_.size()) ++size_;
+    }
+
+    /**
+     * Průchod posledními count záznamy od nejstaršího
+     * @return počet prošlých záznamů
+     */
+    template <typename Function>
+    size_t for_each_last(size_t count, Function function) const {
+        if (count > size_) count = size_;
+        size_t index = (next_ + entries_.size() - count) % (entries_.empty() ? 1 : entries_.size());
+        for (size_t i = 0; i < count; ++i) {
+            function(entries_[index]);
+            index = (index + 1) % entries_.size();
+        }
+        return count;
+    }
+
+private:
+    std::vector<T> entries_;
+    size_t next_;  // Slot pro další záznam
+    size_t size_;
+};
+
+#endif // HISTORY_RING_H
@@ -0,0 +1,182 @@
+/**
+ * Histogram latencí s logaritmicko-lineárními koši (po vzoru HdrHistogram)
+ *
+ * Hodnoty se dělí podle řádu (mocniny 2) a každý řád na HISTOGRAM_SUB_BUCKETS / 2
+ * lineárních košů, relativní chyba percentilu je tak nejvýše 1/64 (~1.6 %)
+ * v celém rozsahu (nanosekundy až dny). Záznam je O(1) bez alokace
+ * (pevné pole košů), histogramy stejného typu se dají sčítat (merge).
+ *
+ * LatencyHistogram zapisuje i čte jedno vlákno. SharedHistogram zapisuje
+ * jedno vlákno (bez zamčených instrukcí) a číst ho smí kdokoli za běhu.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+const int HISTOGRAM_SUB_BUCKET_BITS = 7;
+const uint64_t HISTOGRAM_SUB_BUCKETS = 1ull << HISTOGRAM_SUB_BUCKET_BITS;
+const int HISTOGRAM_MAGNITUDES = 48;  // Rozsah do 2^(48 + 7) (v ns přes rok)
+const size_t HISTOGRAM_BUCKETS = HISTOGRAM_MAGNITUDES * (HISTOGRAM_SUB_BUCKETS / 2) + HISTOGRAM_SUB_BUCKETS;
+
+class LatencyHistogram {
+public:
+    LatencyHistogram()
+        : counts_(HISTOGRAM_BUCKETS, 0),
+          count_(0), sum_(0), min_(UINT64_MAX), max_(0) {}
+
+    void record(uint64_t value) {
+        ++counts_[bucket_index(value)];
+        ++count_;
+        sum_ += value;
+        if (value < min_) min_ = value;
+        if (value > max_) max_ = value;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        if (other.min_ < min_) min_ = other.min_;
+        if (other.max_ > max_) max_ = other.max_;
+    }
+
+    // Přičtení koše a souhrnu (snímek SharedHistogram)
+    void add_bucket(size_t index, uint64_t count) {
+        counts_[index] += count;
+    }
+
+    void add_summary(uint64_t count, uint64_t sum, uint64_t min, uint64_t max) {
+        count_ += count;
+        sum_ += sum;
+        if (count > 0 && min < min_) min_ = min;
+        if (max > max_) max_ = max;
+    }
+
+    void reset() {
+        counts_.assign(counts_.size(), 0);
+        count_ = 0;
+        sum_ = 0;
+        min_ = UINT64_MAX;
+        max_ = 0;
+    }
+
+    uint64_t count() const {
+        return count_;
+    }
+
+    uint64_t min() const {
+        return count_ > 0 ? min_ : 0;
+    }
+
+    uint64_t max() const {
+        return max_;
+    }
+
+    double mean() const {
+        return count_ > 0 ? static_cast<double>(sum_) / count_ : 0.0;
+    }
+
+    /**
+     * Hodnota percentilu (0-100) - horní mez koše, nejvýše max()
+     */
+    uint64_t percentile(double percent) const {
+        if (count_ == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(percent / 100.0 * count_ + 0.5);
+        if (rank < 1) rank = 1;
+        if (rank > count_) rank = count_;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                uint64_t upper = bucket_upper(i);
+                return upper < max_ ? upper : max_;
+            }
+        }
+        return max_;
+    }
+
+    // Hodnoty < SUB_BUCKETS mají koš každá, řád shift >= 1 pokrývá
+    // [2^(shift + 6), 2^(shift + 7)) polovinou košů po 2^shift
+    static size_t bucket_index(uint64_t value) {
+        if (value < HISTOGRAM_SUB_BUCKETS) return static_cast<size_t>(value);
+        int shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BUCKET_BITS + 1;
+        if (shift > HISTOGRAM_MAGNITUDES) return HISTOGRAM_BUCKETS - 1;
+        uint64_t sub = value >> shift;  // [SUB_BUCKETS / 2, SUB_BUCKETS)
+        return static_cast<size_t>(shift * (HISTOGRAM_SUB_BUCKETS / 2) + sub);
+    }
+
+    static uint64_t bucket_upper(size_t index) {
+        if (index < HISTOGRAM_SUB_BUCKETS) return index;
+        uint64_t half = HISTOGRAM_SUB_BUCKETS / 2;
+        uint64_t shift = index / half - 1;
+        uint64_t sub = index % half + half;
+        return ((sub + 1) << shift) - 1;
+    }
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+/**
+ * Histogram měřený za běhu serveru
+ * Zapisuje jediné vlákno (relaxed load + store, žádné sdílené zamčené
+ * instrukce), snímek snapshot_into() smí kdykoli pořídit jiné vlákno.
+ */
+class SharedHistogram {
+public:
+    SharedHistogram()
+        : counts_(new std::atomic<uint64_t>[HISTOGRAM_BUCKETS]()), count_(0), sum_(0), min_(UINT64_MAX), max_(0) {}
+
+    void record(uint64_t value) {
+        bump(counts_[LatencyHistogram::bucket_index(value)], 1);
+        bump(count_, 1);
+        bump(sum_, value);
+        if (value < min_.load(std::memory_order_relaxed)) min_.store(value, std::memory_order_relaxed);
+        if (value > max_.load(std::memory_order_relaxed)) max_.store(value, std::memory_order_relaxed);
+    }
+
+    void snapshot_into(LatencyHistogram& out) const {
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+            uint64_t count = counts_[i].load(std::memory_order_relaxed);
+            if (count > 0) out.add_bucket(i, count);
+        }
+        out.add_summary(count_.load(std::memory_order_relaxed), sum_.load(std::memory_order_relaxed),
+                        min_.load(std::memory_order_relaxed), max_.load(std::memory_order_relaxed));
+    }
+
+    // Jen pokud do histogramu nikdo nezapisuje (např. vlákno skončilo)
+    void reset() {
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) counts_[i].store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        min_.store(UINT64_MAX, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static void bump(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> min_;
+    std::atomic<uint64_t> max_;
+};
+
+#endif // LATENCY_HISTOGRAM_H
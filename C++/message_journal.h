@@ -0,0 +1,421 @@
+/**
+ * Žurnál zpráv - append-only log v souborech mapovaných do paměti
+ *
+ * Každá místnost má vlastní adresář se segmenty pevné velikosti
+ * (<adresář>/<místnost>/00000001.seg, ...). Segment obsahuje zarámované
+ * zprávy přesně ve formátu, který posílá send_message() ([4 byty délka]
+ * [zpráva], textový protokol v1), za posledním záznamem jsou nuly. Plný
+ * segment se zkrátí na skutečnou délku a pokračuje se dalším, nejstarší
+ * segmenty nad limit se mažou.
+ *
+ * append() zprávu jen zařadí (krátký zámek, při plné frontě ji zahodí) -
+ * zápis nikdy nezdrží broadcast. Vlákno žurnálu zapisuje celé dávky najednou
+ * (group commit) memcpy do mapovaného segmentu a podle politiky volá msync.
+ * Obsah záznamu se zapisuje před hlavičkou, nedokončený záznam má tedy
+ * nulovou délku a čtení na něm skončí. Délka záznamu se při čtení omezuje
+ * jen hranicí segmentu - ne limitem délky zprávy, který se mezi restarty
+ * může změnit (a záznam je o prefix barvy, času a jména delší než zpráva).
+ * Rámec delší než celý segment se nezapíše (započítá se jako zahozený).
+ *
+ * Obnova po startu (restore) sekvenčně projde mapované segmenty místnosti
+ * od konce a vrátí posledních N rámců.
+ *
+ * Při předání socketů novému procesu (socket_handover.h) starý proces zápis
+ * pozastaví (suspend) dřív, než nový žurnál otevře - do segmentu tak nikdy
+ * nezapisují dva procesy.
+ *
+ * Kompatibilní s: C++11, Linux
+ */
+
+#ifndef MESSAGE_JOURNAL_H
+#define MESSAGE_JOURNAL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "async_log.h"
+#include "framing.h"
+
+const size_t JOURNAL_SEGMENT_SIZE = 8 * 1024 * 1024;  // Velikost segmentu (bytů)
+const size_t JOURNAL_KEEP_SEGMENTS = 4;               // Počet segmentů místnosti na disku
+const size_t JOURNAL_QUEUE_LIMIT = 65536;             // Max. zpráv čekajících na zápis
+const int JOURNAL_COMMIT_INTERVAL_MS = 5;             // Max. zpoždění dávky
+const int JOURNAL_SYNC_INTERVAL_MS = 1000;            // Interval msync při politice INTERVAL
+const size_t JOURNAL_MAX_ROOM_NAME = 32;              // Delší název místnosti se nežurnáluje
+
+// Kdy se zapsaná data synchronizují na disk
+enum class JournalSync {
+    NONE,      // Jen jádro (přežije pád procesu, ne pád systému)
+    INTERVAL,  // Nejvýše jednou za JOURNAL_SYNC_INTERVAL_MS
+    BATCH      // Po každé dávce (group commit)
+};
+
+/**
+ * Převod názvu politiky (none|interval|batch)
+ * @return false pro neznámý název
+ */
+inline bool parse_journal_sync(const std::string& name, JournalSync& sync) {
+    if (name == "none") sync = JournalSync::NONE;
+    else if (name == "interval") sync = JournalSync::INTERVAL;
+    else if (name == "batch") sync = JournalSync::BATCH;
+    else return false;
+    return true;
+}
+
+class MessageJournal {
+public:
+    MessageJournal()
+        : sync_(JournalSync::INTERVAL), enabled_(false), writing_(false), dropped_(0), written_(0) {}
+
+    bool enabled() const {
+        return enabled_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Otevření žurnálu v adresáři (vytvoří ho) a spuštění vlákna zápisu
+     * @return false pokud adresář nelze vytvořit
+     */
+    bool open(const std::string& directory, JournalSync sync) {
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+        directory_ = directory;
+        sync_ = sync;
+        enabled_.store(true, std::memory_order_release);
+        std::thread([this] { writer_loop(); }).detach();
+        return true;
+    }
+
+    /**
+     * Zařazení zarámované zprávy do žurnálu místnosti (nikdy neblokuje)
+     */
+    void append(const std::string& room, const Frame& frame) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!enabled_.load(std::memory_order_relaxed)) {
+            return;  // Pozastavený žurnál (zpráva přišla těsně před suspend)
+        }
+        if (pending_.size() >= JOURNAL_QUEUE_LIMIT || room.size() > JOURNAL_MAX_ROOM_NAME) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Pending entry = {RoomName(room), frame};
+        pending_.push_back(std::move(entry));
+        if (pending_.size() == 1) {
+            wakeup_.notify_one();
+        }
+    }
+
+    /**
+     * Pozastavení zápisu - vrátí se až po zapsání všech zařazených zpráv
+     * Další zprávy se do obnovení (resume) do žurnálu nedostanou.
+     */
+    void suspend() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (directory_.empty()) {
+            return;
+        }
+        enabled_.store(false, std::memory_order_release);
+        idle_.wait(lock, [this] { return pending_.empty() && !writing_; });
+    }
+
+    void resume() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!directory_.empty()) {
+            enabled_.store(true, std::memory_order_release);
+        }
+    }
+
+    /**
+     * Posledních count rámců místnosti (od nejstaršího), čtených z mapovaných segmentů
+     * Volá se při vytvoření místnosti; zprávy čekající ve frontě nezahrnuje.
+     */
+    std::vector<Frame> restore(const std::string& room, size_t count) const {
+        std::deque<Frame> frames;
+        if (count == 0 || !enabled()) {
+            return std::vector<Frame>();
+        }
+        std::vector<uint64_t> segments = list_segments(room_directory(room));
+        for (size_t i = segments.size(); i > 0 && frames.size() < count; --i) {
+            std::deque<Frame> segment_frames;
+            scan_segment(segment_path(room, segments[i - 1]), [&segment_frames, count](const char* data, size_t size) {
+                segment_frames.push_back(std::make_shared<const std::string>(data, size));
+                if (segment_frames.size() > count) segment_frames.pop_front();
+            });
+            // Starší segment jde před dosud nalezené
+            while (!segment_frames.empty() && frames.size() < count) {
+                frames.push_front(segment_frames.back());
+                segment_frames.pop_back();
+            }
+        }
+        return std::vector<Frame>(frames.begin(), frames.end());
+    }
+
+    uint64_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t written() const {
+        return written_.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Název místnosti přímo v záznamu fronty - zařazení nealokuje
+    typedef FixedString<JOURNAL_MAX_ROOM_NAME> RoomName;
+
+    struct Pending {
+        RoomName room;
+        Frame frame;
+    };
+
+    // Aktuální (zapisovaný) segment místnosti - používá jen vlákno zápisu
+    struct Segment {
+        int fd;
+        char* map;
+        size_t offset;       // Konec zapsaných dat
+        size_t synced;       // Do kam jsou data synchronizovaná
+        uint64_t index;
+        bool failed;         // Chyba I/O - místnost se dál nezapisuje
+
+        Segment() : fd(-1), map(nullptr), offset(0), synced(0), index(0), failed(false) {}
+    };
+
+    std::string room_directory(const std::string& room) const {
+        return directory_ + "/" + room;
+    }
+
+    std::string segment_path(const std::string& room, uint64_t index) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%08llu.seg", static_cast<unsigned long long>(index));
+        return room_directory(room) + name;
+    }
+
+    // Čísla segmentů v adresáři místnosti vzestupně
+    static std::vector<uint64_t> list_segments(const std::string& directory) {
+        std::vector<uint64_t> segments;
+        DIR* dir = opendir(directory.c_str());
+        if (dir == nullptr) {
+            return segments;
+        }
+        while (dirent* entry = readdir(dir)) {
+            unsigned long long index = 0;
+            char suffix[8] = {0};
+            if (std::sscanf(entry->d_name, "%llu.%4s", &index, suffix) == 2 && std::strcmp(suffix, "seg") == 0) {
+                segments.push_back(index);
+            }
+        }
+        closedir(dir);
+        std::sort(segments.begin(), segments.end());
+        return segments;
+    }
+
+    /**
+     * Sekvenční průchod platnými záznamy segmentu (mapovaného jen pro čtení)
+     * @return délka platných dat (kde začne další zápis)
+     */
+    template <typename Function>
+    size_t scan_segment(const std::string& path, Function function) const {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return 0;
+        }
+        struct stat info;
+        size_t valid = 0;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            size_t size = static_cast<size_t>(info.st_size);
+            void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (map != MAP_FAILED) {
+                madvise(map, size, MADV_SEQUENTIAL);
+                const char* data = static_cast<const char*>(map);
+                while (valid + FRAME_HEADER_SIZE <= size) {
+                    uint32_t length_net;
+                    std::memcpy(&length_net, data + valid, FRAME_HEADER_SIZE);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    uint32_t length = ntohl(length_net);
+                    if (length == 0 || length > size - valid - FRAME_HEADER_SIZE) {
+                        break;  // Konec dat (nuly) nebo nedokončený záznam
+                    }
+                    function(data + valid, FRAME_HEADER_SIZE + length);
+                    valid += FRAME_HEADER_SIZE + length;
+                }
+                munmap(map, size);
+            }
+        }
+        close(fd);
+        return valid;
+    }
+
+    void writer_loop() {
+        std::vector<Pending> batch;
+        std::string room;  // Klíč segmentu (kapacita zůstává mezi zprávami)
+        auto last_sync = std::chrono::steady_clock::now();
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait(lock, [this] { return !pending_.empty(); });
+                // Krátké čekání, ať se dávka naplní (group commit)
+                lock.unlock();
+                std::this_thread::sleep_for(std::chrono::milliseconds(JOURNAL_COMMIT_INTERVAL_MS));
+                lock.lock();
+                batch.swap(pending_);
+                writing_ = true;
+            }
+
+            for (const Pending& entry : batch) {
+                room.assign(entry.room.data(), entry.room.size());
+                write_record(room, *entry.frame);
+            }
+            batch.clear();
+
+            auto now = std::chrono::steady_clock::now();
+            if (sync_ == JournalSync::BATCH ||
+                (sync_ == JournalSync::INTERVAL && now - last_sync >= std::chrono::milliseconds(JOURNAL_SYNC_INTERVAL_MS))) {
+                for (auto& entry : segments_) {
+                    sync_segment(entry.second);
+                }
+                last_sync = now;
+            }
+            
+            std::lock_guard<std::mutex> lock(mutex_);
+            writing_ = false;
+            idle_.notify_all();
+        }
+    }
+
+    void write_record(const std::string& room, const std::string& frame) {
+        Segment& segment = segments_[room];
+        if (segment.failed) {
+            return;
+        }
+        if (frame.size() > JOURNAL_SEGMENT_SIZE) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            LOG_WARN("Žurnál: zpráva " << frame.size() << " B je delší než segment, nezapíše se");
+            return;
+        }
+        if (segment.map == nullptr || segment.offset + frame.size() > JOURNAL_SEGMENT_SIZE) {
+            if (!open_next_segment(room, segment, frame.size())) {
+                segment.failed = true;
+                LOG_ERROR("Žurnál: zápis do místnosti " << room << " selhal: " << std::strerror(errno));
+                return;
+            }
+        }
+        // Obsah před hlavičkou - rozepsaný záznam má délku 0
+        std::memcpy(segment.map + segment.offset + FRAME_HEADER_SIZE, frame.data() + FRAME_HEADER_SIZE,
+                    frame.size() - FRAME_HEADER_SIZE);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(segment.map + segment.offset, frame.data(), FRAME_HEADER_SIZE);
+        segment.offset += frame.size();
+        written_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void sync_segment(Segment& segment) {
+        if (segment.map == nullptr || segment.synced == segment.offset) {
+            return;
+        }
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t start = segment.synced / page * page;
+        msync(segment.map + start, segment.offset - start, MS_SYNC);
+        segment.synced = segment.offset;
+    }
+
+    // Uzavření segmentu se zkrácením souboru na zapsaná data
+    void close_segment(Segment& segment) {
+        if (segment.map == nullptr) {
+            return;
+        }
+        sync_segment(segment);
+        munmap(segment.map, JOURNAL_SEGMENT_SIZE);
+        if (ftruncate(segment.fd, static_cast<off_t>(segment.offset)) != 0) {
+            LOG_ERROR("Žurnál: segment nelze zkrátit: " << std::strerror(errno));
+        }
+        close(segment.fd);
+        segment.map = nullptr;
+        segment.fd = -1;
+    }
+
+    /**
+     * Otevření segmentu pro zápis: po startu poslední existující (pokračuje
+     * se za jeho daty, pokud se do něj vejde record_size), jinak nový s dalším číslem
+     */
+    bool open_next_segment(const std::string& room, Segment& segment, size_t record_size) {
+        bool rotating = segment.map != nullptr;
+        close_segment(segment);
+
+        std::string directory = room_directory(room);
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+        std::vector<uint64_t> existing = list_segments(directory);
+        size_t offset = 0;
+        uint64_t index = existing.empty() ? 1 : existing.back();
+        if (!existing.empty()) {
+            offset = scan_segment(segment_path(room, index), [](const char*, size_t) {});
+            if (rotating || offset + record_size > JOURNAL_SEGMENT_SIZE) {
+                ++index;
+                offset = 0;
+            }
+        }
+
+        std::string path = segment_path(room, index);
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        // Soubor se zvětší na celý segment (řídký), za daty jsou nuly
+        if (ftruncate(fd, static_cast<off_t>(JOURNAL_SEGMENT_SIZE)) != 0) {
+            close(fd);
+            return false;
+        }
+        void* map = mmap(nullptr, JOURNAL_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        segment.fd = fd;
+        segment.map = static_cast<char*>(map);
+        segment.offset = offset;
+        segment.synced = offset;
+        segment.index = index;
+
+        // Odstranění nejstarších segmentů nad limit
+        existing.push_back(index);
+        std::sort(existing.begin(), existing.end());
+        existing.erase(std::unique(existing.begin(), existing.end()), existing.end());
+        for (size_t i = 0; i + JOURNAL_KEEP_SEGMENTS < existing.size(); ++i) {
+            unlink(segment_path(room, existing[i]).c_str());
+        }
+        return true;
+    }
+
+    std::string directory_;
+    JournalSync sync_;
+    std::atomic<bool> enabled_;
+    bool writing_;                      // Vlákno zapisuje dávku (pod mutex_)
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> written_;
+    std::mutex mutex_;                  // Fronta čekajících zpráv
+    std::condition_variable wakeup_;
+    std::condition_variable idle_;      // Konec zápisu dávky (suspend)
+    std::vector<Pending> pending_;
+    std::unordered_map<std::string, Segment> segments_;  // Jen vlákno zápisu
+};
+
+#endif // MESSAGE_JOURNAL_H
@@ -0,0 +1,105 @@
+/**
+ * Slab alokátor objektů jednoho typu
+ *
+ * Paměť se bere po slabech (slab_size objektů najednou) a uvolněné sloty
+ * se vrací do free listu - vytvoření a zrušení objektu je jen přesun
+ * ukazatele a konstruktor/destruktor, bez volání malloc/free.
+ *
+ * Pool nezamyká: patří jednomu vlastníkovi (např. epoll reaktoru, který
+ * spojení vytváří i ruší). Slaby se uvolní až se zrušením poolu, a to jen
+ * pokud v nich nezůstaly živé objekty.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+const size_t OBJECT_POOL_SLAB = 64;  // Výchozí počet objektů ve slabu
+
+template <typename T>
+class ObjectPool {
+public:
+    explicit ObjectPool(size_t slab_size = OBJECT_POOL_SLAB)
+        : slab_size_(slab_size > 0 ? slab_size : 1), free_(nullptr), live_(0) {}
+
+    ~ObjectPool() {
+        if (live_ != 0) return;  // Na živé objekty mohou ještě ukazovat jiná vlákna
+        for (Slot* slab : slabs_) {
+            delete[] slab;
+        }
+    }
+
+    /**
+     * Vytvoření objektu ve volném slotu (případně v novém slabu)
+     */
+    template <typename... Args>
+    T* create(Args&&... args) {
+        if (free_ == nullptr) {
+            grow();
+        }
+        Slot* slot = free_;
+        free_ = slot->next;
+        T* object;
+        try {
+            object = new (&slot->storage) T(std::forward<Args>(args)...);
+        } catch (...) {
+            slot->next = free_;
+            free_ = slot;
+            throw;
+        }
+        ++live_;
+        return object;
+    }
+
+    /**
+     * Zrušení objektu a vrácení slotu do free listu
+     */
+    void destroy(T* object) {
+        if (object == nullptr) return;
+        object->~T();
+        Slot* slot = reinterpret_cast<Slot*>(object);
+        slot->next = free_;
+        free_ = slot;
+        --live_;
+    }
+
+    size_t live() const {
+        return live_;
+    }
+
+    size_t capacity() const {
+        return slabs_.size() * slab_size_;
+    }
+
+private:
+    union Slot {
+        Slot* next;  // Volný slot: další volný
+        typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+    };
+
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator=(const ObjectPool&);
+
+    void grow() {
+        Slot* slab = new Slot[slab_size_];
+        slabs_.push_back(slab);
+        for (size_t i = slab_size_; i > 0; --i) {
+            slab[i - 1].next = free_;
+            free_ = &slab[i - 1];
+        }
+    }
+
+    std::vector<Slot*> slabs_;
+    size_t slab_size_;
+    Slot* free_;
+    size_t live_;
+};
+
+#endif // OBJECT_POOL_H
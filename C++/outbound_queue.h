@@ -0,0 +1,230 @@
+/**
+ * Omezená fronta odchozích zpráv jednoho klienta
+ *
+ * Broadcast a ostatní odesílatelé zprávy pouze zařadí (krátký zámek fronty),
+ * fronta drží jen reference na sdílené rámce (Frame), nikoli jejich kopie;
+ * samotné send() provádí zapisovač spojení - vlákno v threaded režimu nebo
+ * reaktor v epoll režimu. Pomalý klient tak zdržuje jen své vlastní spojení.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "framing.h"
+
+// Chování při plné frontě
+enum class OverflowPolicy {
+    DROP_OLDEST,   // Zahodí nejstarší zprávu ve frontě
+    DROP_CLIENT,   // Odesílatel dostane FULL a klient se odpojí
+    BACKPRESSURE   // Odesílatel počká na místo (nejdéle backpressure_timeout)
+};
+
+/**
+ * Kruhový buffer rámců s pevnou kapacitou
+ */
+class OutboundQueue {
+public:
+    enum PushResult {
+        QUEUED,          // Zpráva zařazena
+        DROPPED_OLDEST,  // Zpráva zařazena, nejstarší zahozena
+        FULL,            // Zpráva nezařazena - klienta je třeba odpojit
+        CLOSED           // Fronta je uzavřena
+    };
+
+    enum PopResult {
+        POPPED,   // Do dávky přidán alespoň jeden rámec
+        EMPTY,    // Fronta je prázdná (zapisovač se odhlásil z notifikací)
+        FINISHED  // Fronta je uzavřena a vyprázdněna
+    };
+
+    /**
+     * Callback volaný pod zámkem fronty při změně připravenosti
+     * true = ve frontě jsou data, false = zapisovač frontu vyprázdnil
+     */
+    typedef std::function<void(bool)> ReadyCallback;
+
+    OutboundQueue(size_t capacity, OverflowPolicy policy, double backpressure_timeout)
+        : ring_(capacity > 0 ? capacity : 1), head_(0), count_(0),
+          policy_(policy), backpressure_timeout_(backpressure_timeout), closed_(false),
+          ready_signaled_(false) {}
+
+    void set_ready_callback(ReadyCallback callback) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_callback_ = std::move(callback);
+    }
+
+    /**
+     * Zařazení zprávy
+     * @param may_wait Smí odesílatel při BACKPRESSURE čekat? (ne pod globálním
+     *                 zámkem a ne ve vlákně, které tuto frontu samo vyprazdňuje)
+     */
+    PushResult push(Frame frame, bool may_wait) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (closed_) {
+            return CLOSED;
+        }
+
+        PushResult result = QUEUED;
+        if (count_ == ring_.size()) {
+            if (policy_ == OverflowPolicy::DROP_OLDEST) {
+                head_ = (head_ + 1) % ring_.size();
+                --count_;
+                result = DROPPED_OLDEST;
+            } else if (policy_ == OverflowPolicy::BACKPRESSURE && may_wait) {
+                auto timeout = std::chrono::duration<double>(backpressure_timeout_);
+                if (!not_full_.wait_for(lock, timeout, [this] { return closed_ || count_ < ring_.size(); })) {
+                    return FULL;
+                }
+                if (closed_) {
+                    return CLOSED;
+                }
+            } else {
+                return FULL;
+            }
+        }
+
+        append(std::move(frame));
+        signal_ready(true);
+        return result;
+    }
+
+    /**
+     * Zařazení několika rámců pod jedním zámkem (např. přehrání historie)
+     * Nikdy nečeká; při BACKPRESSURE se plná fronta chová jako DROP_CLIENT.
+     * @return QUEUED/DROPPED_OLDEST po zařazení všech, jinak FULL nebo CLOSED
+     */
+    PushResult push_all(const std::vector<Frame>& frames) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) {
+            return CLOSED;
+        }
+
+        PushResult result = QUEUED;
+        for (const Frame& frame : frames) {
+            if (count_ == ring_.size()) {
+                if (policy_ != OverflowPolicy::DROP_OLDEST) {
+                    result = FULL;
+                    break;
+                }
+                head_ = (head_ + 1) % ring_.size();
+                --count_;
+                result = DROPPED_OLDEST;
+            }
+            append(frame);
+        }
+        if (count_ > 0) {
+            signal_ready(true);
+        }
+        return result;
+    }
+
+    /**
+     * Blokující vyzvednutí až max_frames rámců do dávky (zapisovací vlákno)
+     * @return false pokud je fronta uzavřena a prázdná
+     */
+    bool pop(FrameBatch& batch, size_t max_frames) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return closed_ || count_ > 0; });
+        if (count_ == 0) {
+            return false;
+        }
+        take_front(batch, max_frames);
+        return true;
+    }
+
+    /**
+     * Neblokující vyzvednutí až max_frames rámců do dávky (reaktor)
+     * Při EMPTY se atomicky s kontrolou prázdnosti zavolá callback(false),
+     * takže souběžné push() zapisovače vždy znovu probudí.
+     */
+    PopResult try_pop(FrameBatch& batch, size_t max_frames) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ > 0) {
+            take_front(batch, max_frames);
+            return POPPED;
+        }
+        if (closed_) {
+            return FINISHED;
+        }
+        signal_ready(false);
+        return EMPTY;
+    }
+
+    /**
+     * Uzavření fronty - další zprávy se nepřijímají, zbytek se ještě odešle
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+        signal_ready(true);
+    }
+
+    /**
+     * Okamžité ukončení - zahodí čekající zprávy a odpojí callback
+     * Po návratu už callback nikdy nebude zavolán.
+     */
+    void abort() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        for (size_t i = 0; i < count_; ++i) {
+            ring_[(head_ + i) % ring_.size()].reset();
+        }
+        count_ = 0;
+        ready_callback_ = nullptr;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+private:
+    // Callback se volá jen při skutečné změně stavu (bez zbytečných syscallů)
+    void signal_ready(bool ready) {
+        if (ready_callback_ && ready_signaled_ != ready) {
+            ready_signaled_ = ready;
+            ready_callback_(ready);
+        }
+    }
+
+    void append(Frame frame) {
+        ring_[(head_ + count_) % ring_.size()] = std::move(frame);
+        ++count_;
+        if (count_ == 1) {
+            not_empty_.notify_one();
+        }
+    }
+
+    void take_front(FrameBatch& batch, size_t max_frames) {
+        for (size_t taken = 0; count_ > 0 && taken < max_frames; ++taken) {
+            batch.push(std::move(ring_[head_]));
+            ring_[head_].reset();
+            head_ = (head_ + 1) % ring_.size();
+            --count_;
+        }
+        not_full_.notify_all();
+    }
+
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::vector<Frame> ring_;
+    size_t head_;
+    size_t count_;
+    OverflowPolicy policy_;
+    double backpressure_timeout_;
+    bool closed_;
+    bool ready_signaled_;
+    ReadyCallback ready_callback_;
+};
+
+#endif // OUTBOUND_QUEUE_H
@@ -0,0 +1,175 @@
+/**
+ * Binární protokol v2
+ *
+ * Vyjednává se v úvodní zprávě: SETUP:username:p2p_port:v2
+ * Klient bez ":v2" (např. Python) dál používá textový protokol v1.
+ *
+ * Rámování zůstává stejné (4 byty délky), obsah rámce začíná jedním bytem
+ * typu a následují pevná binární pole (big-endian) a případně text. Textové
+ * zprávy v1 začínají vždy tisknutelným znakem, typy v2 jsou menší než 0x20 -
+ * klient tak pozná formát zprávy podle prvního bytu.
+ *
+ * Server -> klient:
+ *   WELCOME     [u32 id][u8 barva][text]         (první zpráva po SETUP)
+ *   CHAT        [u32 odesílatel][u8 barva][u32 čas][u32 pořadí][text]
+ *   PM          [u32 odesílatel][u32 čas][text]
+ *   PING
+ *   PEER_INFO   [u32 id][u32 IPv4][u16 port][jméno]
+ *   PEER_INFO6  [u32 id][16 B IPv6][u16 port][jméno]  (klient připojený přes IPv6)
+ *   ERROR       [text]
+ *   SYSTEM      [u32 čas][text]
+ *   USER_JOIN   [u8 oznámit] + záznamy [u32 id][u8 barva][u8 délka][jméno]
+ *   USER_LEAVE  [u32 id][u8 důvod]
+ *   ROOM        [u32 počet členů][název]         (vstup do místnosti)
+ *   SESSION     [u32 pořadí][token]              (jen po nabídce ":resume")
+ *
+ * Klient -> server:
+ *   CHAT        [text]
+ *   PM          [u8 délka jména][jméno][text]
+ *   PONG
+ *   LIST, PEERS, HELP, QUIT
+ *   GETPEER     [jméno]
+ *   JOIN        [název místnosti]
+ *   LEAVE, ROOMS
+ *   HISTORY     [u16 počet]                      (0 nebo chybí = výchozí počet)
+ *   RVTOKEN                                      (token pro UDP rendezvous, odpověď SYSTEM)
+ *
+ * Místo jména odesílatele nese chat zpráva jeho id; jména zná klient ze
+ * seznamu členů místnosti USER_JOIN (oznámit = 0), který dostane po ROOM,
+ * a z oznámení o dalších příchozích (1 = připojil se k chatu, 2 = vstoupil
+ * do místnosti). Důvod USER_LEAVE: 0 = odpojil se, 1 = odešel do jiné
+ * místnosti. Čas je v sekundách od epochy, formátuje ho až klient. Barva
+ * je číslo ANSI kódu (31-96).
+ *
+ * Obnovení relace: klient v SETUP nabídne ":resume" a po vstupu do každé
+ * místnosti dostane SESSION s tokenem a pořadím poslední zprávy místnosti
+ * (chat zprávy místnosti jsou číslované). Po výpadku se připojí znovu
+ * s ":resume=<token>:seq=<pořadí>", kde pořadí je nejvyšší přijaté - server
+ * vrátí relaci (id, barvu, místnost) a přehraje jen novější zprávy.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <arpa/inet.h>
+
+#include "framing.h"
+
+const int PROTOCOL_TEXT = 1;     // Textový protokol v1 (Python klienti)
+const int PROTOCOL_BINARY = 2;   // Binární protokol v2
+const char* const PROTOCOL_V2_TOKEN = "v2";
+const char* const RESUME_TOKEN = "resume";    // ":resume" nebo ":resume=<token>"
+const char* const RESUME_SEQ_TOKEN = "seq";   // ":seq=<pořadí>"
+
+enum class MessageType : uint8_t {
+    WELCOME = 0x01,
+    CHAT = 0x02,
+    PM = 0x03,
+    PING = 0x04,
+    PONG = 0x05,
+    PEER_INFO = 0x06,
+    ERROR = 0x07,
+    SYSTEM = 0x08,
+    USER_JOIN = 0x09,
+    USER_LEAVE = 0x0A,
+    ROOM = 0x0B,
+    SESSION = 0x0C,
+    PEER_INFO6 = 0x0D,
+    LIST = 0x10,
+    PEERS = 0x11,
+    HELP = 0x12,
+    QUIT = 0x13,
+    GETPEER = 0x14,
+    JOIN = 0x15,
+    LEAVE = 0x16,
+    ROOMS = 0x17,
+    HISTORY = 0x18,
+    RVTOKEN = 0x19
+};
+
+// Hodnoty oznámit v USER_JOIN a důvodu v USER_LEAVE
+const uint8_t USER_JOIN_ROSTER = 0;
+const uint8_t USER_JOIN_CONNECTED = 1;
+const uint8_t USER_JOIN_ROOM = 2;
+const uint8_t USER_LEAVE_DISCONNECTED = 0;
+const uint8_t USER_LEAVE_ROOM = 1;
+
+const size_t MESSAGE_TYPE_LIMIT = 0x20;  // Typy v2 jsou menší, text v1 začíná tisknutelným znakem
+
+/**
+ * Je zpráva v binárním formátu v2?
+ */
+inline bool is_binary_message(const char* data, size_t size) {
+    return size > 0 && static_cast<uint8_t>(data[0]) < MESSAGE_TYPE_LIMIT;
+}
+
+/**
+ * Začátek binární zprávy daného typu
+ */
+inline FrameBuilder binary_frame(MessageType type, size_t payload_hint = 0) {
+    FrameBuilder builder(1 + payload_hint);
+    builder.append_u8(static_cast<uint8_t>(type));
+    return builder;
+}
+
+/**
+ * Čtení pevných polí binární zprávy s kontrolou délky
+ */
+class BinaryReader {
+public:
+    BinaryReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+    bool read_u8(uint8_t& value) {
+        if (size_ < 1) return false;
+        value = static_cast<uint8_t>(data_[0]);
+        skip(1);
+        return true;
+    }
+
+    bool read_u16(uint16_t& value) {
+        if (size_ < sizeof(value)) return false;
+        std::memcpy(&value, data_, sizeof(value));
+        value = ntohs(value);
+        skip(sizeof(value));
+        return true;
+    }
+
+    bool read_u32(uint32_t& value) {
+        if (size_ < sizeof(value)) return false;
+        std::memcpy(&value, data_, sizeof(value));
+        value = ntohl(value);
+        skip(sizeof(value));
+        return true;
+    }
+
+    bool read_bytes(size_t length, MessageView& view) {
+        if (size_ < length) return false;
+        view.data = data_;
+        view.size = length;
+        skip(length);
+        return true;
+    }
+
+    // Zbytek zprávy (typicky text na konci)
+    MessageView rest() {
+        MessageView view = {data_, size_};
+        skip(size_);
+        return view;
+    }
+
+private:
+    void skip(size_t length) {
+        data_ += length;
+        size_ -= length;
+    }
+
+    const char* data_;
+    size_t size_;
+};
+
+#endif // PROTOCOL_H
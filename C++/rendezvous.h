@@ -0,0 +1,239 @@
+/**
+ * Adresy peerů (IPv4 i IPv6) a UDP rendezvous pro přímá P2P spojení
+ *
+ * Server zjistí skutečnou adresu klienta z accept() a posílá ji v /getpeer
+ * a /peers místo 127.0.0.1. Peer za NATem ale na svou adresu další peery
+ * přímo nepustí - proto volitelný rendezvous: peer se serveru ohlásí UDP
+ * datagramem ze svého P2P portu a server si zapamatuje veřejný endpoint,
+ * jak ho vidí (po překladu NATem). Na dotaz pošle tazateli endpoint
+ * hledaného peera a hledanému endpoint tazatele; oba pak posílají PUNCH
+ * datagramy proti sobě, čímž si v NATech otevřou cestu (hole punching).
+ *
+ * Jméno v REGISTER musí být doloženo tokenem, který uživatel dostane
+ * příkazem /rvtoken přes přihlášené chat spojení (RendezvousTokens) - jinak
+ * by kdokoli mohl přepsat endpoint libovolného jména. LOOKUP se přijme jen
+ * z registrovaného endpointu tazatele, INTRODUCE tedy jde jen peerovi
+ * s platným tokenem a nese ověřený endpoint (server nic nepošle na adresu,
+ * kterou si odesílatel datagramu jen vymyslel).
+ *
+ * Zprávy jsou textové, jedna na datagram (bez rámování):
+ *   peer -> server   REGISTER:<jméno>:<token>    (opakovaně - udržuje mapování NATu)
+ *   server -> peer   ENDPOINT:<ip>:<port>        (veřejný endpoint odesílatele)
+ *                    DENIED:<jméno>              (neplatný nebo prošlý token)
+ *   peer -> server   LOOKUP:<hledaný>:<vlastní jméno>
+ *   server -> peer   PEER:<jméno>:<ip>:<port>    (tazateli)
+ *                    INTRODUCE:<jméno>:<ip>:<port> (hledanému - endpoint tazatele)
+ *                    UNKNOWN:<jméno>
+ *   peer <-> peer    PUNCH:<jméno>, PUNCH_ACK:<jméno>, MSG:<jméno>:<text>
+ *
+ * IPv6 adresa obsahuje ':' - jméno končí první dvojtečkou (jména ':' nesmí
+ * obsahovat), token je za poslední dvojtečkou REGISTER, port je za
+ * poslední. IPv4 adresy z dual-stack socketu (::ffff:a.b.c.d) se vypisují
+ * jako IPv4.
+ *
+ * Kompatibilní s: C++11, POSIX
+ */
+
+#ifndef RENDEZVOUS_H
+#define RENDEZVOUS_H
+
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+const double RENDEZVOUS_TTL = 60.0;              // Platnost ohlášeného endpointu na serveru (sekundy)
+const double RENDEZVOUS_KEEPALIVE = 20.0;        // Interval REGISTER (NAT mapování UDP drží řádově desítky sekund)
+const size_t RENDEZVOUS_DATAGRAM_SIZE = 1400;    // Nejdelší datagram (bez fragmentace na běžné MTU)
+const double PUNCH_INTERVAL = 0.2;               // Interval PUNCH datagramů (sekundy)
+const double PUNCH_TIMEOUT = 5.0;                // Jak dlouho se cesta k peeru zkouší otevřít
+const double RENDEZVOUS_TOKEN_TTL = 600.0;       // Platnost nepoužitého tokenu z /rvtoken (sekundy)
+
+const char* const RENDEZVOUS_REGISTER = "REGISTER:";
+const char* const RENDEZVOUS_ENDPOINT = "ENDPOINT:";
+const char* const RENDEZVOUS_DENIED = "DENIED:";
+const char* const RENDEZVOUS_LOOKUP = "LOOKUP:";
+const char* const RENDEZVOUS_PEER = "PEER:";
+const char* const RENDEZVOUS_INTRODUCE = "INTRODUCE:";
+const char* const RENDEZVOUS_UNKNOWN = "UNKNOWN:";
+const char* const PUNCH_REQUEST = "PUNCH:";
+const char* const PUNCH_ACK = "PUNCH_ACK:";
+const char* const PUNCH_MESSAGE = "MSG:";
+
+/**
+ * Textová IP adresa (IPv4 namapovaná do IPv6 jako IPv4)
+ */
+inline std::string address_text(const sockaddr_storage& addr) {
+    char text[INET6_ADDRSTRLEN] = "";
+    if (addr.ss_family == AF_INET6) {
+        const in6_addr& ip = reinterpret_cast<const sockaddr_in6&>(addr).sin6_addr;
+        if (IN6_IS_ADDR_V4MAPPED(&ip)) {
+            inet_ntop(AF_INET, ip.s6_addr + 12, text, sizeof(text));
+        } else {
+            inet_ntop(AF_INET6, &ip, text, sizeof(text));
+        }
+    } else if (addr.ss_family == AF_INET) {
+        inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in&>(addr).sin_addr, text, sizeof(text));
+    }
+    return text;
+}
+
+inline int address_port(const sockaddr_storage& addr) {
+    if (addr.ss_family == AF_INET6) return ntohs(reinterpret_cast<const sockaddr_in6&>(addr).sin6_port);
+    if (addr.ss_family == AF_INET) return ntohs(reinterpret_cast<const sockaddr_in&>(addr).sin_port);
+    return 0;
+}
+
+// Stejná IP (IPv4 i jako ::ffff:a.b.c.d) a port
+inline bool same_endpoint(const sockaddr_storage& a, const sockaddr_storage& b) {
+    return address_text(a) == address_text(b) && address_port(a) == address_port(b);
+}
+
+/**
+ * "ip:port", IPv6 v hranatých závorkách ("[::1]:8081") - pro výpisy
+ */
+inline std::string endpoint_text(const std::string& ip, int port) {
+    bool v6 = ip.find(':') != std::string::npos;
+    return (v6 ? "[" + ip + "]" : ip) + ":" + std::to_string(port);
+}
+
+/**
+ * Adresa pro socket dané rodiny (AF_INET6 socket je dual-stack, IPv4 se
+ * na něm adresuje jako ::ffff:a.b.c.d)
+ * @return false pokud ip není platná adresa pro tuto rodinu
+ */
+inline bool socket_address(const std::string& ip, int port, int family, sockaddr_storage& out, socklen_t& length) {
+    std::memset(&out, 0, sizeof(out));
+    in_addr v4;
+    bool is_v4 = inet_pton(AF_INET, ip.c_str(), &v4) == 1;
+    if (family == AF_INET) {
+        if (!is_v4) return false;
+        sockaddr_in& addr = reinterpret_cast<sockaddr_in&>(out);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr = v4;
+        length = sizeof(addr);
+        return true;
+    }
+    sockaddr_in6& addr = reinterpret_cast<sockaddr_in6&>(out);
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(static_cast<uint16_t>(port));
+    if (is_v4) {
+        addr.sin6_addr.s6_addr[10] = 0xFF;
+        addr.sin6_addr.s6_addr[11] = 0xFF;
+        std::memcpy(addr.sin6_addr.s6_addr + 12, &v4, sizeof(v4));
+    } else if (inet_pton(AF_INET6, ip.c_str(), &addr.sin6_addr) != 1) {
+        return false;
+    }
+    length = sizeof(addr);
+    return true;
+}
+
+/**
+ * Rozdělení "<jméno>:<ip>:<port>" (zbytek zprávy za prefixem)
+ */
+inline bool parse_named_endpoint(const std::string& text, std::string& name, std::string& ip, int& port) {
+    size_t first = text.find(':');
+    size_t last = text.rfind(':');
+    if (first == std::string::npos || last == first || last + 1 >= text.size()) {
+        return false;
+    }
+    name = text.substr(0, first);
+    ip = text.substr(first + 1, last - first - 1);
+    port = std::atoi(text.c_str() + last + 1);
+    return !name.empty() && !ip.empty() && port > 0 && port <= 65535;
+}
+
+/**
+ * UDP socket na portu - dual-stack IPv6, bez podpory IPv6 jen IPv4
+ * @return fd nebo -1
+ */
+inline int open_udp_socket(int port, int& family) {
+    family = AF_INET6;
+    int fd = socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0) {
+        int off = 0;
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+        sockaddr_in6 addr{};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_port = htons(static_cast<uint16_t>(port));
+        addr.sin6_addr = in6addr_any;
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+            return fd;
+        }
+        close(fd);
+    }
+    family = AF_INET;
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Registrační tokeny rendezvous (jméno -> token), strana serveru
+ * Token vydaný pro jméno přihlášeného uživatele platí RENDEZVOUS_TOKEN_TTL
+ * do první registrace; pak ho drží opakované REGISTER (každá prodlouží
+ * platnost o RENDEZVOUS_TTL) a po jejich výpadku zanikne. Nový token pro
+ * stejné jméno ten předchozí zneplatní. Metody zamykají vlastní zámek -
+ * vydává vlákno obsluhy chatu, ověřuje vlákno rendezvous.
+ */
+class RendezvousTokens {
+public:
+    void issue(const std::string& name, const std::string& token, double now) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = tokens_.begin(); it != tokens_.end();) {
+            it = it->second.expires <= now ? tokens_.erase(it) : std::next(it);
+        }
+        Entry& entry = tokens_[name];
+        entry.token = token;
+        entry.expires = now + RENDEZVOUS_TOKEN_TTL;
+    }
+
+    /**
+     * Ověření tokenu z REGISTER (porovnání v konstantním čase)
+     * @return true pokud token patří jménu a platí (platnost se prodlouží)
+     */
+    bool accept(const std::string& name, const std::string& token, double now) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = tokens_.find(name);
+        if (found == tokens_.end() || found->second.expires <= now || found->second.token.size() != token.size()) {
+            return false;
+        }
+        unsigned char difference = 0;
+        for (size_t i = 0; i < token.size(); ++i) {
+            difference |= static_cast<unsigned char>(found->second.token[i] ^ token[i]);
+        }
+        if (difference != 0) {
+            return false;
+        }
+        found->second.expires = now + RENDEZVOUS_TTL;
+        return true;
+    }
+
+private:
+    struct Entry {
+        std::string token;
+        double expires;
+    };
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> tokens_;
+};
+
+#endif // RENDEZVOUS_H
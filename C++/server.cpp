@@ -1,38 +1,193 @@
 /**
  * Rozšířená socket server implementace v C++
- * Používá thread-per-client architekturu s length-prefixed protokolem
+ * Používá thread-per-client architekturu s length-prefixed protokolem,
+ * volitelně event-driven režim s epoll reaktorem na každém jádře
  * 
  * Kompatibilní s: Python klienty
  * 
  * Kompilace:
- *   g++ -std=c++11 -pthread server.cpp -o server
+ *   g++ -std=c++11 -pthread server.cpp -o server -lz
+ * 
+ * Spuštění:
+ *   ./server                          (thread-per-client)
+ *   ./server --accept-threads 4       (4 accept shardy na SO_REUSEPORT)
+ *   ./server --mode epoll [--reactors N]
+ *   ./server --mode uring [--reactors N] (io_uring, Linux 6.0+)
+ *   ./server --idle-timeout 3600      (odpojení nečinných klientů)
+ *   ./server --log-level info         (bez řádků pro každou zprávu)
+ *   ./server --compress-threshold 256 (komprese jen delších zpráv)
+ *   ./server --journal journal        (uchování zpráv přes restart)
+ *   ./server --admin-port 9100        (metriky na http://127.0.0.1:9100/metrics)
+ *   ./server --resume-window 60       (obnovení relace do 60 s po výpadku)
+ *   ./server --port 8082 --node-id 2 --node-port 9002 --node-secret S --peer 10.0.0.1:9001
+ *                                     (uzel clusteru, federation.h)
+ *   ./server --rendezvous-port 8079   (UDP rendezvous pro P2P, rendezvous.h)
+ *   ./server --config server.conf     (parametry ze souboru, config_file.h)
+ *   ./server --handover-socket /run/chat.sock
+ *                                     (restart bez výpadku, socket_handover.h)
  */
 
 #include <iostream>
 #include <thread>
 #include <vector>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <cstdint>
-#include <ctime>
-#include <iomanip>
-#include <sstream>
-#include <chrono>
 #include <string>
+#include <memory>
+#include <unordered_set>
+#include <cerrno>
+#include <cstdlib>
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <poll.h>
+#include <csignal>
 #include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "async_log.h"
+#include "config_file.h"
+#include "framing.h"
+#include "protocol.h"
+#include "compression.h"
+#include "outbound_queue.h"
+#include "client_registry.h"
+#include "chat_rooms.h"
+#include "session_store.h"
+#include "federation.h"
+#include "rendezvous.h"
+#include "socket_tuning.h"
+#include "socket_handover.h"
+#include "message_journal.h"
+#include "object_pool.h"
+#include "server_metrics.h"
+#include "coarse_clock.h"
+#include "uring.h"
+#include "connection_state.h"
+#include "timer_wheel.h"
 
 // Konfigurace
-const int PORT = 8080;
+const int DEFAULT_PORT = 8080;
 const int MAX_CLIENTS = 100;
-const size_t BUFFER_SIZE = 4096;
+const int LISTEN_BACKLOG = 1024;  // Výchozí fronta nepřijatých spojení (jádro omezí na somaxconn)
+const size_t BUFFER_SIZE = 4096;          // Přijímací buffer io_uring reaktoru
 const uint32_t MAX_MESSAGE_SIZE = 40960; // 40KB
 const double HEARTBEAT_INTERVAL = 300.0;  // Interval pro heartbeat (sekundy)
 const double HEARTBEAT_TIMEOUT = 100.0;   // Timeout pro heartbeat odpověď (sekundy)
+const double HANDSHAKE_TIMEOUT = 30.0;    // Max. doba na SETUP:/USERNAME: zprávu (sekundy)
+const double TIMER_TICK = 0.1;            // Rozlišení časovacího kola (sekundy)
+const double COARSE_CLOCK_TICK = 0.01;    // Obnova hrubých hodin (sekundy)
 const int RATE_LIMIT_MESSAGES = 10;      // Maximální počet zpráv
 const double RATE_LIMIT_WINDOW = 1.0;    // Časové okno v sekundách
+const int EPOLL_MAX_EVENTS = 128;        // Počet událostí zpracovaných jedním epoll_wait
+const size_t OUTBOUND_QUEUE_CAPACITY = 256;  // Výchozí kapacita odchozí fronty klienta (zprávy)
+const double BACKPRESSURE_TIMEOUT = 5.0;     // Max. čekání odesílatele na místo ve frontě (sekundy)
+const size_t HISTORY_CAPACITY = 100;         // Výchozí délka historie místnosti (zprávy)
+const size_t HISTORY_JOIN_REPLAY = 20;       // Počet zpráv přehraných po vstupu do místnosti
+const double RESUME_WINDOW = 30.0;           // Výchozí platnost odpojené relace (sekundy)
+const size_t DETACHED_SESSION_LIMIT = 1000;  // Max. počet odpojených relací čekajících na obnovení
+const size_t MAX_USERNAME_LENGTH = 20;       // Delší jméno se zkrátí
+const size_t MAX_COLOR_CODE = 2;             // ANSI kód barvy ("31" - "96")
+const int NODE_ID_SHIFT = 24;                // Id klienta = (id uzlu << 24) | pořadí na uzlu
+const uint32_t NODE_MESSAGE_OVERHEAD = 64;   // Hlavička chat zprávy mezi uzly nad max_message_size
+const size_t RENDEZVOUS_ENTRY_LIMIT = 4096;  // Max. ohlášených P2P endpointů (UDP rendezvous)
+const int ADMIN_RECEIVE_TIMEOUT = 2;         // Max. čekání na HTTP požadavek admin portu (sekundy)
+const size_t ADMIN_REQUEST_SIZE = 4096;      // Delší HTTP požadavek se zamítne
+const unsigned URING_ENTRIES = 1024;         // Velikost SQ kruhu reaktoru (CQ je dvojnásobná)
+const unsigned URING_RECV_BUFFERS = 512;     // Poskytnuté přijímací buffery reaktoru (mocnina 2)
+const double DRAIN_TIMEOUT = 30.0;           // Výchozí doba vyprázdnění spojení při ukončení (sekundy)
+const double DRAIN_TICK = 0.1;               // Interval postupného odpojování klientů (sekundy)
+const int HANDOVER_ACK_TIMEOUT_MS = 30000;   // Max. čekání na start nového procesu při předání
+
+// Pevná pole v záznamech klientů - kopie záznamu nealokuje
+typedef FixedString<MAX_USERNAME_LENGTH> Username;
+typedef FixedString<MAX_COLOR_CODE> ColorCode;
+typedef FixedString<MAX_ROOM_NAME> RoomName;
+typedef FixedString<INET6_ADDRSTRLEN> PeerAddress;
+
+// Režim obsluhy klientů (volí se při spuštění)
+enum class ServerMode {
+    THREADED,  // Jedno vlákno na klienta (výchozí)
+    EPOLL,     // Neblokující sockety, jeden epoll reaktor na jádro
+    URING      // io_uring reaktor na jádro (multishot accept/recv, dávkové odeslání)
+};
+
+ServerMode server_mode = ServerMode::THREADED;
+int server_port = DEFAULT_PORT;
+size_t outbound_queue_capacity = OUTBOUND_QUEUE_CAPACITY;
+OverflowPolicy outbound_policy = OverflowPolicy::DROP_OLDEST;
+double idle_timeout = 0.0;  // Odpojení po nečinnosti (sekundy, 0 = vypnuto)
+size_t history_capacity = HISTORY_CAPACITY;
+std::string journal_directory;  // Prázdné = žurnál vypnutý
+JournalSync journal_sync = JournalSync::INTERVAL;
+bool compression_allowed = true;  // Přijímat nabídku komprese od klientů
+size_t compression_threshold = COMPRESSION_THRESHOLD;
+int admin_port = 0;  // HTTP port s metrikami na 127.0.0.1 (0 = vypnuto)
+int listen_backlog = LISTEN_BACKLOG;
+bool pin_threads = true;  // Accept shardy a reaktory na vlastních jádrech
+uint8_t node_id = 0;      // Id uzlu clusteru (0 = samostatný server)
+int node_port = 0;        // Port pro spojení od ostatních uzlů (0 = nepřijímat)
+std::string node_bind;    // Adresa portu uzlů (prázdná = všechna rozhraní)
+std::string node_secret;  // Heslo clusteru v HELLO (--node-secret)
+int rendezvous_port = 0;  // UDP port rendezvous pro P2P hole punching (0 = vypnuto)
+SocketProfile client_socket_profile = SocketProfile::FANOUT;  // Volby socketů klientů (--socket-profile)
+SocketTuning client_socket_tuning = socket_profile(SocketProfile::FANOUT);
+SocketTuning effective_socket_tuning;  // Hodnoty po úpravách jádra (výpis a /metrics)
+
+// Limity nastavitelné parametry nebo konfiguračním souborem (výchozí viz výše)
+int max_clients = MAX_CLIENTS;
+uint32_t max_message_size = MAX_MESSAGE_SIZE;
+size_t buffer_size = BUFFER_SIZE;
+double heartbeat_interval = HEARTBEAT_INTERVAL;
+double heartbeat_timeout = HEARTBEAT_TIMEOUT;
+int rate_limit_messages = RATE_LIMIT_MESSAGES;
+double rate_limit_window = RATE_LIMIT_WINDOW;
+double drain_timeout = DRAIN_TIMEOUT;
+std::string handover_path;  // Unixový socket pro předání socketů (prázdné = bez předání)
+
+// Ukončování: po false přestanou všechna vlákna přijímat nová spojení a
+// reaktory skončí, jakmile se odpojí jejich klienti. shutdown_event (eventfd)
+// je od té chvíle trvale čitelný - probouzí poll() a epoll_wait() čekající na accept.
+std::atomic<bool> server_running(true);
+int shutdown_event = -1;
+
+// Naslouchací sockety tohoto procesu (pro předání) a sockety převzaté od
+// předchozího procesu, dokud si je nevezme vytvoření listeneru
+std::vector<HandoverSocket> owned_sockets;
+std::vector<HandoverSocket> inherited_sockets;
+int handover_connection = -1;  // Spojení s předchozím procesem do potvrzení převzetí
+
+// Počet přijatých spojení (včetně rozpracovaného handshake) - kontrola kapacity
+// hned po accept(), dřív než vznikne vlákno, session nebo buffery
+std::atomic<int> admitted_connections(0);
+double start_time = 0.0;  // Čas spuštění serveru (monotonic_seconds)
+
+// Výpis zprávy (pohledu do přijímacího bufferu) do logu bez kopie
+LogLine& operator<<(LogLine& line, const MessageView& message) {
+    return line.append(message.data, message.size);
+}
+
+template <size_t Capacity>
+LogLine& operator<<(LogLine& line, const FixedString<Capacity>& text) {
+    return line.append(text.data(), text.size());
+}
+
+// Smí aktuální vlákno čekat na místo v cizí frontě? (reaktor nesmí - vyprazdňuje je sám)
+thread_local bool queue_wait_allowed = true;
+
+// Okamžik posledního recv() vlákna (ns) - počátek latence receive -> broadcast
+thread_local uint64_t receive_time_ns = 0;
 
 // Paleta barev pro uživatele (ANSI escape kódy - pouze čísla)
 const std::vector<std::string> USER_COLORS = {
@@ -53,86 +208,238 @@ const std::vector<std::string> USER_COLORS = {
 // Struktura pro uložení informací o klientovi
 struct ClientInfo {
     int socket;
-    std::string username;
+    uint32_t id;   // Id odesílatele v binárním protokolu
+    int protocol;  // PROTOCOL_TEXT nebo PROTOCOL_BINARY
+    uint8_t color; // Barva jako číslo (binární protokol)
+    Username username;
     int p2p_port;  // Port pro P2P připojení
-    double last_heartbeat;  // Čas posledního úspěšného heartbeat
-    double last_message_time;  // Čas poslední zprávy pro rate limiting
-    int message_count;  // Počet zpráv v aktuálním okně
-    std::string color_code;  // ANSI escape kód pro barvu uživatele
+    ColorCode color_code;  // ANSI escape kód pro barvu uživatele
+    std::shared_ptr<OutboundQueue> outbound;  // Odchozí fronta (vyprazdňuje ji zapisovač)
+    RoomName room;         // Místnost pro adresář ostatních uzlů (jen v registru klientů)
+    PeerAddress address;   // Adresa klienta z accept() (P2P informace)
 };
 
-// Sdílený seznam klientů
-std::vector<ClientInfo> clients;
-std::mutex clients_mutex; // Mutex pro synchronizaci přístupu k seznamu klientů
-
 /**
- * Odešle zprávu s prefixem délky (kompatibilní s Python)
- * Formát: [4 byty délka (big-endian)][zpráva]
+ * Zpráva zarámovaná v obou formátech - příjemce dostane tu ve svém protokolu
  */
-bool send_message(int sock, const std::string& message) {
-    // Převod délky zprávy na big-endian (network byte order)
-    uint32_t message_length = htonl(static_cast<uint32_t>(message.length()));
-    
-    // Odeslání délky zprávy (4 byty)
-    ssize_t sent = send(sock, &message_length, 4, 0);
-    if (sent != 4) {
-        return false;
-    }
-    
-    // Odeslání samotné zprávy
-    if (message.length() > 0) {
-        sent = send(sock, message.c_str(), message.length(), 0);
-        if (sent != static_cast<ssize_t>(message.length())) {
-            return false;
-        }
+struct ProtocolFrames {
+    Frame text;    // Textový protokol v1
+    Frame binary;  // Binární protokol v2
+
+    const Frame& get(int protocol) const {
+        return protocol == PROTOCOL_BINARY ? binary : text;
     }
+};
+
+// Záznam historie místnosti - zarámovaná zpráva a odesílatel (pro seznam
+// jmen binárních klientů, kteří autora už nemusí znát)
+struct HistoryEntry {
+    ProtocolFrames frames;
+    uint32_t sender_id;
+    uint8_t color;
+    Username username;
+    uint32_t sequence;  // Pořadí v místnosti (0 = obnoveno ze žurnálu)
+};
+
+typedef RoomDirectory<ClientInfo, HistoryEntry> Rooms;
+typedef Rooms::RoomPtr RoomPtr;
+
+/**
+ * Časovací kolo obsluhy spojení
+ * V threaded režimu jedno sdílené kolo pod zámkem, které posouvá vlastní
+ * vlákno; v epoll režimu má každý reaktor své kolo a zámek nepoužívá.
+ */
+struct TimerService {
+    TimerWheel wheel;
+    bool shared;                      // Kolo používá více vláken (threaded režim)
+    std::mutex mutex;
+    std::condition_variable wakeup;   // Probuzení vlákna kola po naplánování
+
+    explicit TimerService(bool shared_wheel)
+        : wheel(TIMER_TICK, monotonic_seconds()), shared(shared_wheel) {}
+};
+
+// Časovače jednoho spojení (všechny v kole obsluhy spojení)
+struct SessionTimers {
+    TimerService* service;
+    TimerWheel::Timer handshake;  // Vypršení handshake
+    TimerWheel::Timer heartbeat;  // Odeslání PING / čekání na odpověď
+    TimerWheel::Timer idle;       // Idle timeout (jen při --idle-timeout)
+    double ping_sent_at;          // Kdy odešel nezodpovězený PING (0 = žádný)
+    double ping_after;            // Nečinnost před PING (náhodně 0.5 - 1 interval, na spojení)
+};
+
+// Stav jednoho klienta z pohledu obsluhy (vlákna nebo reaktoru)
+struct Session {
+    int socket;
+    uint32_t client_id;  // Přiděleno při registraci
+    int protocol;        // Vyjednáno v SETUP: (výchozí textový v1)
+    uint8_t color;
+    Username username;
+    int p2p_port;
+    PeerAddress address;     // Skutečná adresa klienta (IPv4 nebo IPv6)
+    std::shared_ptr<OutboundQueue> outbound;
+    std::shared_ptr<FrameCompressor> compressor;  // Používá jen zapisovač spojení
+    std::shared_ptr<ConnectionState> state;
+    ColorCode color_code;    // Přidělená barva (platná po registraci)
+    ClientHandle handle;     // Záznam v registru klientů (po registraci)
+    RoomPtr room;            // Aktuální místnost (mění jen obsluha spojení)
+    SessionTimers timers;
+    bool resumable;          // Klient nabídl ":resume" (jen binární protokol)
+    std::string resume_token;  // Token z ":resume=...", po registraci token relace
+    uint32_t resume_after;   // Poslední přijatá zpráva místnosti (":seq=...")
+    bool quitting;           // Odhlášení přes /quit - relace se neuchová
+};
+
+// Relace odpojeného klienta čekající na obnovení (session_store.h)
+struct DetachedSession {
+    uint32_t client_id;
+    uint8_t color;
+    ColorCode color_code;
+    Username username;
+    int p2p_port;
+    std::string room;
+};
+
+// Uživatel jiného uzlu clusteru (adresář z federation.h)
+struct RemoteUser {
+    uint32_t id;
+    uint8_t color;
+    Username username;
+    int p2p_port;
+    PeerAddress address;
+    RoomName room;
+};
+
+struct Connection;
+struct UringReactor;
+
+/**
+ * I/O engine reaktoru (epoll, io_uring)
+ * Stavový automat spojení (handshake, zprávy, CLOSING) je společný,
+ * engine jen dodává data do dekodéru a odesílá rámce z fronty.
+ */
+struct ConnectionEngine {
+    const char* name;
+    bool (*flush)(Connection* conn);  // Odeslání (nebo zahájení odeslání) čekajících rámců
+};
+
+/**
+ * Stav spojení v reaktorovém režimu (epoll, io_uring)
+ * Spojení vlastní reaktor, který ho přijal; ostatní vlákna pouze přidávají
+ * zprávy do jeho odchozí fronty přes deliver_message(). Reaktor spojení
+ * vytváří i ruší ve vlastním slab poolu (object_pool.h).
+ */
+struct Connection {
+    enum State {
+        HANDSHAKE,  // Čeká se na SETUP:/USERNAME: zprávu
+        ACTIVE,     // Klient je v seznamu klientů
+        CLOSING     // Po odeslání zbývajících dat se spojení zavře
+    };
+
+    int fd;
+    int epoll_fd;            // epoll instance vlastnícího reaktoru
+    State state;
+    FrameDecoder decoder{max_message_size};  // Přijatá, dosud nezpracovaná data
+    FrameBatch pending;      // Rámce vyzvednuté z fronty, zatím neodeslané celé
+    Session session;
+    ObjectPool<Connection>* pool;  // Pool reaktoru, ve kterém spojení leží
+    const ConnectionEngine* engine;
     
-    return true;
+    // Rozpracované operace io_uring (spojení se uvolní až po jejich dokončení)
+    UringReactor* uring;
+    int operations;          // Počet operací v jádře
+    bool receiving;          // Běží multishot recv
+    bool sending;            // Běží sendmsg dávky pending
+    bool closed;             // Spojení je uzavřené, čeká se na dokončení operací
+    msghdr send_msg;
+    iovec send_iov[MAX_BATCH_IOV];
+};
+
+// Sdílený registr klientů (indexovaný podle fd i jména)
+ClientRegistry<ClientInfo> clients;
+std::mutex clients_mutex; // Mutex pro synchronizaci přístupu k seznamu klientů
+
+// Zámek seznamu klientů s měřením čekání a držení (metriky)
+class ClientsLock {
+public:
+    ClientsLock() : lock_(clients_mutex, Histogram::CLIENTS_LOCK_WAIT, Histogram::CLIENTS_LOCK_HOLD) {}
+
+private:
+    MeteredLock lock_;
+};
+
+// Místnosti s vlastními seznamy členů (chat zprávy nezamykají clients_mutex)
+Rooms rooms;
+
+// Žurnál chat zpráv místností (--journal)
+MessageJournal journal;
+
+// Id klientů pro binární protokol (0 = nepřiděleno)
+std::atomic<uint32_t> next_client_id(1);
+
+// Odpojené relace podle resume tokenu (--resume-window)
+SessionStore<DetachedSession> detached_sessions(RESUME_WINDOW, DETACHED_SESSION_LIMIT);
+
+// Tokeny pro REGISTER u UDP rendezvous (/rvtoken)
+RendezvousTokens rendezvous_tokens;
+
+// Odchozí spojení k ostatním uzlům (--peer, seznam se po startu nemění)
+std::vector<std::unique_ptr<NodeLink>> node_links;
+
+// Uživatelé ostatních uzlů a pořadí příchozích spojení od uzlů
+RemoteDirectory<RemoteUser> remote_users;
+std::atomic<uint64_t> next_node_link(1);
+
+/**
+ * Binární systémová zpráva (čas 0 = bez časového razítka)
+ */
+Frame make_system_frame(uint32_t time, const std::string& text) {
+    return binary_frame(MessageType::SYSTEM, 4 + text.size()).append_u32(time).append(text).finish();
+}
+
+Frame make_error_frame(const std::string& text) {
+    return binary_frame(MessageType::ERROR, text.size()).append(text).finish();
 }
 
+// Neměnné odpovědi zarámované jednou při startu
+const std::string QUIT_TEXT = "Odpojování...";
+const std::string UNKNOWN_COMMAND_TEXT = "Neznámý příkaz. Použijte /help";
+const std::string HELP_TEXT = "=== Chat Server - Nápověda ===\nVšechny vaše zprávy se automaticky posílají všem uživatelům ve vaší místnosti.\n\nDostupné příkazy:\n/quit - Odpojení ze serveru\n/list - Seznam připojených uživatelů\n/join <místnost> - Přechod do místnosti\n/leave - Návrat do hlavní místnosti\n/rooms - Seznam místností\n/history [N] - Posledních N zpráv místnosti\n/pm <uživatel> <zpráva> - Soukromá zpráva přes server\n/getpeer <uživatel> - Získání P2P informací\n/peers - Seznam všech s P2P informacemi\n/rvtoken - Token pro registraci P2P peera u rendezvous\n/help - Zobrazení této nápovědy\n\nPro odeslání zprávy jednoduše napište text a stiskněte Enter.";
+
+const ProtocolFrames PING_FRAMES = {make_frame("PING"), binary_frame(MessageType::PING).finish()};
+const ProtocolFrames QUIT_FRAMES = {make_frame(QUIT_TEXT), make_system_frame(0, QUIT_TEXT)};
+const ProtocolFrames UNKNOWN_COMMAND_FRAMES = {make_frame("ERROR: " + UNKNOWN_COMMAND_TEXT), make_error_frame(UNKNOWN_COMMAND_TEXT)};
+const ProtocolFrames HELP_FRAMES = {make_frame(HELP_TEXT), make_system_frame(0, HELP_TEXT)};
+const Frame SERVER_FULL_FRAME = make_frame("ERROR: Server je plný");  // Protokol ještě není známý
+
 /**
- * Přijme zprávu s prefixem délky (kompatibilní s Python)
+ * Přijetí spojení do kapacity serveru (atomický čítač, bez zámku)
+ * Nad kapacitou dostane klient jen chybovou zprávu a spojení se hned zavře.
+ * @return false pokud bylo spojení odmítnuto (fd je zavřený)
  */
-std::string receive_message(int sock) {
-    // Přijetí délky zprávy (4 byty)
-    uint32_t message_length_net;
-    ssize_t received = recv(sock, &message_length_net, 4, MSG_WAITALL);
-    
-    if (received != 4) {
-        return ""; // Spojení ukončeno nebo chyba
-    }
-    
-    // Převod z network byte order na host byte order
-    uint32_t message_length = ntohl(message_length_net);
-    
-    // Validace délky
-    if (message_length > MAX_MESSAGE_SIZE) {
-        std::cerr << "Chyba: Příliš dlouhá zpráva: " << message_length << " bytů" << std::endl;
-        return "";
-    }
-    
-    // Přijetí samotné zprávy
-    std::string message(message_length, '\0');
-    if (message_length > 0) {
-        received = recv(sock, &message[0], message_length, MSG_WAITALL);
-        if (received != static_cast<ssize_t>(message_length)) {
-            return "";
-        }
+bool admit_connection(int fd) {
+    if (admitted_connections.fetch_add(1, std::memory_order_relaxed) >= max_clients) {
+        admitted_connections.fetch_sub(1, std::memory_order_relaxed);
+        ServerMetrics::instance().add(Counter::CONNECTIONS_REJECTED);
+        ssize_t sent = send(fd, SERVER_FULL_FRAME->data(), SERVER_FULL_FRAME->size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        (void)sent;
+        close(fd);
+        return false;
     }
-    
-    return message;
+    return true;
+}
+
+// Uvolnění místa po zavření přijatého spojení
+void release_connection() {
+    admitted_connections.fetch_sub(1, std::memory_order_relaxed);
 }
 
 /**
  * Získání aktuálního času ve formátu HH:MM
  */
 std::string get_current_time() {
-    std::time_t now = std::time(nullptr);
-    std::tm* timeinfo = std::localtime(&now);
-    std::ostringstream oss;
-    oss << std::setfill('0') << std::setw(2) << timeinfo->tm_hour << ":"
-        << std::setw(2) << timeinfo->tm_min;
-    return oss.str();
+    return CoarseClock::instance().hhmm();
 }
 
 /**
@@ -143,395 +450,3257 @@ std::string get_user_color(int client_index) {
 }
 
 /**
- * Získání aktuálního času jako double (sekundy od epochy)
+ * Kontrola rate limitingu pro klienta (token bucket spojení, bez zámku)
+ * Průměrně rate_limit_messages zpráv za rate_limit_window, nárazově stejný počet.
  */
-double get_current_timestamp() {
-    auto now = std::chrono::system_clock::now();
-    auto duration = now.time_since_epoch();
-    return std::chrono::duration<double>(duration).count();
+bool check_rate_limit(ConnectionState& state, double now) {
+    return state.rate_limit.try_consume(now);
 }
 
 /**
- * Kontrola rate limitingu pro klienta
+ * Aktualizace času posledního heartbeat pro klienta (atomický zápis, bez zámku)
  */
-bool check_rate_limit(int client_fd) {
-    double current_time = get_current_timestamp();
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    
-    for (auto& client : clients) {
-        if (client.socket == client_fd) {
-            // Kontrola, zda uplynulo dost času pro reset okna
-            if (current_time - client.last_message_time >= RATE_LIMIT_WINDOW) {
-                // Reset okna
-                client.last_message_time = current_time;
-                client.message_count = 1;
-                return true;
-            } else if (client.message_count < RATE_LIMIT_MESSAGES) {
-                // Zvýšení počtu zpráv
-                client.message_count++;
-                return true;
-            } else {
-                // Rate limit překročen
-                return false;
-            }
-        }
+void update_heartbeat(ConnectionState& state, double now) {
+    state.liveness.touch(now);
+}
+
+/**
+ * Vytvoření odchozí fronty podle nastavení serveru
+ */
+std::shared_ptr<OutboundQueue> make_outbound_queue() {
+    return std::make_shared<OutboundQueue>(outbound_queue_capacity, outbound_policy, BACKPRESSURE_TIMEOUT);
+}
+
+/**
+ * Inicializace stavu nově přijatého spojení (výchozí jméno a P2P port)
+ */
+void init_session(Session& session, int client_fd, const sockaddr_storage* peer = nullptr) {
+    // Multishot accept io_uring adresu nevrací - zjistí se z getpeername()
+    sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    if (peer == nullptr && getpeername(client_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len) == 0) {
+        peer = &addr;
     }
-    return true;
+    session.address = peer != nullptr ? address_text(*peer) : std::string();
+    if (apply_socket_tuning(client_fd, client_socket_tuning) > 0) {
+        ServerMetrics::instance().add(Counter::SOCKET_OPTIONS_REJECTED);
+    }
+    session.socket = client_fd;
+    session.client_id = 0;
+    session.protocol = PROTOCOL_TEXT;
+    session.color = 37;
+    session.username = "User";
+    session.p2p_port = 8081;
+    session.outbound = make_outbound_queue();
+    session.compressor = std::make_shared<FrameCompressor>(compression_threshold);
+    session.state = std::make_shared<ConnectionState>(
+        rate_limit_messages, rate_limit_messages / rate_limit_window, monotonic_seconds());
+    session.handle = INVALID_CLIENT_HANDLE;
+    session.timers.service = nullptr;
+    session.timers.ping_sent_at = 0;
+    session.timers.ping_after = heartbeat_interval;
+    session.resumable = false;
+    session.resume_after = 0;
+    session.quitting = false;
+    ServerMetrics::instance().add(Counter::CONNECTIONS_ACCEPTED);
 }
 
 /**
- * Aktualizace času posledního heartbeat pro klienta
+ * Ukončení spojení klienta z jiného vlákna, než které ho obsluhuje
+ * Socket se pouze zavře pro čtení i zápis - obsluha (vlákno nebo reaktor)
+ * dostane EOF a spojení uklidí sama (fd se nesmí uvolnit pod jejíma rukama).
+ * Volat pod clients_mutex, dokud je klient v seznamu.
  */
-void update_heartbeat(int client_fd) {
-    double current_time = get_current_timestamp();
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    
-    for (auto& client : clients) {
-        if (client.socket == client_fd) {
-            client.last_heartbeat = current_time;
-            break;
-        }
+void disconnect_client(const ClientInfo& client) {
+    shutdown(client.socket, SHUT_RDWR);
+}
+
+/**
+ * Doručení zprávy registrovanému klientovi (volá se pod clients_mutex)
+ * Pod globálním zámkem se na místo ve frontě nikdy nečeká.
+ */
+bool deliver_message(const ClientInfo& client, const Frame& frame) {
+    OutboundQueue::PushResult result = client.outbound->push(frame, false);
+    if (result == OutboundQueue::FULL) {
+        LOG_WARN("Odchozí fronta klienta " << client.username << " je plná - odpojování");
+        disconnect_client(client);
     }
+    return result != OutboundQueue::FULL && result != OutboundQueue::CLOSED;
 }
 
 /**
- * Heartbeat monitor - kontroluje připojení klientů
+ * Doručení odpovědi klientovi, kterého obsluhuje aktuální vlákno
  */
-void heartbeat_monitor() {
-    while (true) {
-        sleep(static_cast<unsigned int>(HEARTBEAT_INTERVAL));
-        double current_time = get_current_timestamp();
-        std::vector<int> disconnected;
-        
-        {
-            std::lock_guard<std::mutex> lock(clients_mutex);
-            for (const auto& client : clients) {
-                // Kontrola, zda klient neodpovídá příliš dlouho
-                if (current_time - client.last_heartbeat > HEARTBEAT_TIMEOUT * 2) {
-                    std::cout << "Klient " << client.username << " neodpovídá na heartbeat - odpojování" << std::endl;
-                    disconnected.push_back(client.socket);
-                } else {
-                    // Odeslání ping zprávy
-                    if (!send_message(client.socket, "PING")) {
-                        disconnected.push_back(client.socket);
-                    }
-                }
-            }
-        }
-        
-        // Odstranění odpojených klientů
-        if (!disconnected.empty()) {
-            std::lock_guard<std::mutex> lock(clients_mutex);
-            clients.erase(
-                std::remove_if(clients.begin(), clients.end(),
-                    [&disconnected](const ClientInfo& c) {
-                        return std::find(disconnected.begin(), disconnected.end(), c.socket) != disconnected.end();
-                    }),
-                clients.end()
-            );
-            
-            for (int fd : disconnected) {
-                close(fd);
-            }
-        }
+bool deliver_message(const Session& session, const Frame& frame) {
+    OutboundQueue::PushResult result = session.outbound->push(frame, queue_wait_allowed);
+    if (result == OutboundQueue::FULL) {
+        LOG_WARN("Odchozí fronta klienta " << session.username << " je plná - odpojování");
+        shutdown(session.socket, SHUT_RDWR);
+    }
+    return result != OutboundQueue::FULL && result != OutboundQueue::CLOSED;
+}
+
+bool deliver_message(const ClientInfo& client, const std::string& message) {
+    return deliver_message(client, make_frame(message));
+}
+
+bool deliver_message(const Session& session, const std::string& message) {
+    return deliver_message(session, make_frame(message));
+}
+
+bool deliver_message(const ClientInfo& client, const ProtocolFrames& frames) {
+    return deliver_message(client, frames.get(client.protocol));
+}
+
+bool deliver_message(const Session& session, const ProtocolFrames& frames) {
+    return deliver_message(session, frames.get(session.protocol));
+}
+
+/**
+ * Chybová odpověď ("ERROR: ..." v textovém protokolu)
+ */
+bool send_error(const Session& session, const std::string& text) {
+    if (session.protocol == PROTOCOL_BINARY) {
+        return deliver_message(session, make_error_frame(text));
+    }
+    return deliver_message(session, "ERROR: " + text);
+}
+
+/**
+ * Informační odpověď ("INFO: ..." v textovém protokolu)
+ */
+bool send_info(const Session& session, const std::string& text) {
+    if (session.protocol == PROTOCOL_BINARY) {
+        return deliver_message(session, make_system_frame(CoarseClock::instance().wall_seconds(), text));
+    }
+    return deliver_message(session, "INFO: " + text);
+}
+
+/**
+ * Systémová odpověď (v textovém protokolu beze změny)
+ */
+bool send_system(const Session& session, const std::string& text) {
+    if (session.protocol == PROTOCOL_BINARY) {
+        return deliver_message(session, make_system_frame(CoarseClock::instance().wall_seconds(), text));
     }
+    return deliver_message(session, text);
+}
+
+/**
+ * Zámek kola obsluhy spojení (v epoll režimu prázdný)
+ */
+std::unique_lock<std::mutex> lock_timers(TimerService& service) {
+    std::unique_lock<std::mutex> lock(service.mutex, std::defer_lock);
+    if (service.shared) lock.lock();
+    return lock;
+}
+
+/**
+ * Vypršení handshake - klient do HANDSHAKE_TIMEOUT neposlal úvodní zprávu
+ * Časovače spojení běží v kole jeho obsluhy; socket se jen zavře pro čtení
+ * i zápis a úklid provede obsluha (stejně jako u disconnect_client).
+ */
+void on_handshake_timeout(Session& session) {
+    LOG_INFO("Klient " << session.socket << " neposlal úvodní zprávu do " << HANDSHAKE_TIMEOUT << "s - odpojování");
+    ServerMetrics::instance().add(Counter::HANDSHAKE_TIMEOUTS);
+    shutdown(session.socket, SHUT_RDWR);
 }
 
 /**
- * Broadcast zprávy všem klientům
+ * Heartbeat časovač spojení
+ * Aktivita klienta časovač nepřeplánovává (zpráva jen atomicky zapíše čas),
+ * při vypršení se podle času poslední aktivity buď posune, nebo se pošle PING
+ * a časovač počká heartbeat_timeout na odpověď. Práh nečinnosti ping_after
+ * je pro každé spojení jiný, takže se fáze spojení připojených najednou
+ * nesjednotí ani přeplánováním podle poslední aktivity, ani po odpovědi na PING.
  */
-void broadcast_message(const std::string& message, int exclude_socket = -1) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
-    std::vector<int> disconnected;
+void on_heartbeat_timer(Session& session) {
+    SessionTimers& timers = session.timers;
+    double now = coarse_monotonic_seconds();  // Stejné hodiny, jaké zapisuje touch()
+    double idle = session.state->liveness.idle_for(now);
     
-    for (auto& client : clients) {
-        if (client.socket == exclude_socket) {
-            continue;
+    if (timers.ping_sent_at > 0) {
+        if (!session.state->liveness.active_since(timers.ping_sent_at)) {
+            LOG_INFO("Klient " << session.username << " neodpovídá na heartbeat - odpojování");
+            ServerMetrics::instance().add(Counter::HEARTBEAT_TIMEOUTS);
+            shutdown(session.socket, SHUT_RDWR);
+            return;
         }
-        
-        if (!send_message(client.socket, message)) {
-            disconnected.push_back(client.socket);
+        timers.ping_sent_at = 0;  // Od odeslání PING klient něco poslal
+    }
+    
+    if (idle >= timers.ping_after) {
+        if (!deliver_message(session, PING_FRAMES)) {
+            return;
         }
+        timers.ping_sent_at = now;
+        timers.service->wheel.schedule(timers.heartbeat, now, heartbeat_timeout);
+    } else {
+        timers.service->wheel.schedule(timers.heartbeat, now, timers.ping_after - idle);
+    }
+}
+
+/**
+ * Idle timeout - klient dlouho neposlal žádnou zprávu ani příkaz
+ */
+void on_idle_timer(Session& session) {
+    double now = coarse_monotonic_seconds();
+    double idle = session.state->last_message.idle_for(now);
+    if (idle >= idle_timeout) {
+        LOG_INFO("Klient " << session.username << " je nečinný " << static_cast<int>(idle) << "s - odpojování");
+        ServerMetrics::instance().add(Counter::IDLE_TIMEOUTS);
+        shutdown(session.socket, SHUT_RDWR);
+        return;
     }
+    session.timers.service->wheel.schedule(session.timers.idle, now, idle_timeout - idle);
+}
+
+/**
+ * Zapojení časovačů nového spojení do kola jeho obsluhy (běží handshake timeout)
+ */
+void start_session_timers(Session& session, TimerService& service) {
+    Session* target = &session;
+    session.timers.service = &service;
+    session.timers.handshake.set_callback([target] { on_handshake_timeout(*target); });
+    session.timers.heartbeat.set_callback([target] { on_heartbeat_timer(*target); });
+    session.timers.idle.set_callback([target] { on_idle_timer(*target); });
     
-    // Odstranění odpojených klientů
-    clients.erase(
-        std::remove_if(clients.begin(), clients.end(),
-            [&disconnected](const ClientInfo& c) {
-                return std::find(disconnected.begin(), disconnected.end(), c.socket) != disconnected.end();
-            }),
-        clients.end()
-    );
+    std::unique_lock<std::mutex> lock = lock_timers(service);
+    service.wheel.schedule(session.timers.handshake, monotonic_seconds(), HANDSHAKE_TIMEOUT);
+    if (service.shared) service.wakeup.notify_one();
 }
 
 /**
- * Funkce pro obsluhu jednoho klienta
- * @param client_fd Deskriptor socketu klienta
+ * Po registraci klienta: zrušení handshake timeoutu, start heartbeat a idle časovačů
+ * Práh nečinnosti pro PING se volí náhodně v druhé polovině intervalu a platí
+ * po celou dobu spojení, aby se klienti připojení najednou (např. po restartu
+ * serveru) nepingovali současně - ani poprvé, ani v dalších kolech.
  */
-void handle_client(int client_fd) {
-    std::string username = "User";
-    int p2p_port = 8081;  // Výchozí P2P port
+void on_session_registered(Session& session) {
+    SessionTimers& timers = session.timers;
+    TimerService& service = *timers.service;
+    double now = monotonic_seconds();
+    timers.ping_after = heartbeat_interval * (0.5 + 0.5 * (std::rand() / (RAND_MAX + 1.0)));
     
-    try {
-        // Přijetí uživatelského jména a P2P portu (volitelné)
-        std::string welcome_msg = receive_message(client_fd);
-        if (!welcome_msg.empty()) {
-            if (welcome_msg.find("SETUP:") == 0) {
-                // Formát: SETUP:username:p2p_port
-                size_t pos1 = welcome_msg.find(":", 6);
-                size_t pos2 = welcome_msg.find(":", pos1 + 1);
-                if (pos1 != std::string::npos) {
-                    username = welcome_msg.substr(6, pos1 - 6);
-                    if (username.length() > 20) username = username.substr(0, 20);
-                }
-                if (pos2 != std::string::npos) {
-                    try {
-                        p2p_port = std::stoi(welcome_msg.substr(pos2 + 1));
-                    } catch (...) {
-                        p2p_port = 8081;
-                    }
-                }
-                std::cout << "Klient nastavil jméno: " << username << ", P2P port: " << p2p_port << std::endl;
-            } else if (welcome_msg.find("USERNAME:") == 0) {
-                username = welcome_msg.substr(9);
-                if (username.length() > 20) username = username.substr(0, 20);
-                std::cout << "Klient nastavil jméno: " << username << std::endl;
-            }
-        }
-        
-        // Přidání klienta do seznamu (thread-safe)
-        {
-            std::lock_guard<std::mutex> lock(clients_mutex);
-            if (clients.size() >= MAX_CLIENTS) {
-                send_message(client_fd, "ERROR: Server je plný");
-                close(client_fd);
-                return;
-            }
-            double current_time = get_current_timestamp();
-            std::string user_color = get_user_color(clients.size());
-            clients.push_back({client_fd, username, p2p_port, current_time, current_time, 0, user_color});
-            std::cout << "Klient připojen: " << username << ". Celkem klientů: " << clients.size() << ", barva: " << user_color << std::endl;
-        }
-        
-        // Získání počtu připojených uživatelů
-        int user_count;
-        {
-            std::lock_guard<std::mutex> lock(clients_mutex);
-            user_count = clients.size();
+    std::unique_lock<std::mutex> lock = lock_timers(service);
+    service.wheel.cancel(timers.handshake);
+    service.wheel.schedule(timers.heartbeat, now, timers.ping_after);
+    if (idle_timeout > 0) {
+        service.wheel.schedule(timers.idle, now, idle_timeout);
+    }
+    if (service.shared) service.wakeup.notify_one();
+}
+
+/**
+ * Zrušení všech časovačů spojení (před zavřením socketu)
+ */
+void stop_session_timers(Session& session) {
+    if (session.timers.service == nullptr) {
+        return;
+    }
+    TimerService& service = *session.timers.service;
+    std::unique_lock<std::mutex> lock = lock_timers(service);
+    service.wheel.cancel(session.timers.handshake);
+    service.wheel.cancel(session.timers.heartbeat);
+    service.wheel.cancel(session.timers.idle);
+}
+
+// Sdílené kolo pro threaded režim
+TimerService threaded_timers(true);
+
+/**
+ * Vlákno časovacího kola threaded režimu
+ * Spí do nejbližšího vypršení (nebo do naplánování nového časovače),
+ * callbacky spojení běží pod zámkem kola.
+ */
+void timer_thread() {
+    queue_wait_allowed = false;
+    std::unique_lock<std::mutex> lock(threaded_timers.mutex);
+    while (true) {
+        threaded_timers.wheel.advance(monotonic_seconds());
+        int timeout_ms = threaded_timers.wheel.next_timeout_ms(monotonic_seconds());
+        if (timeout_ms < 0) {
+            threaded_timers.wakeup.wait(lock);
+        } else {
+            threaded_timers.wakeup.wait_for(lock, std::chrono::milliseconds(timeout_ms));
         }
-        
-        // Odeslání uvítací zprávy s počtem uživatelů
-        std::string user_text = (user_count > 1) ? "uživatelé" : "uživatel";
-        send_message(client_fd, "Vítejte v chatu, " + username + "! [" + std::to_string(user_count) + " " + user_text + " online] Napište zprávu a stiskněte Enter. Použijte /help pro nápovědu.");
-        
-        // Broadcast o novém připojení
-        std::string current_time = get_current_time();
-        broadcast_message("[" + current_time + "] Server: " + username + " se připojil k chatu", client_fd);
-        
-        // Hlavní smyčka pro komunikaci s klientem
-        while (true) {
-            std::string message = receive_message(client_fd);
-            
-            if (message.empty()) {
-                // Klient se odpojil
-                break;
-            }
-            
-            // Zpracování PONG odpovědi na heartbeat
-            if (message == "PONG") {
-                update_heartbeat(client_fd);
-                continue;
-            }
-            
-            // Kontrola rate limitingu (kromě systémových příkazů)
-            if (message.length() == 0 || message[0] != '/') {
-                if (!check_rate_limit(client_fd)) {
-                    send_message(client_fd, "ERROR: Příliš mnoho zpráv! Maximálně " + std::to_string(RATE_LIMIT_MESSAGES) + " zpráv za " + std::to_string(RATE_LIMIT_WINDOW) + " sekund.");
-                    std::cout << "Rate limit překročen pro " << username << " (" << client_fd << ")" << std::endl;
-                    continue;
-                }
-            }
-            
-            // Aktualizace heartbeat při jakékoli aktivitě
-            update_heartbeat(client_fd);
-            
-            std::cout << "Přijato od " << username << " (" << client_fd << "): " << message << std::endl;
-            
-            // Speciální příkazy
-            if (message.length() > 0 && message[0] == '/') {
-                if (message == "/quit") {
-                    send_message(client_fd, "Odpojování...");
-                    break;
-                } else if (message == "/list") {
-                    std::lock_guard<std::mutex> lock(clients_mutex);
-                    std::string user_list = "Připojení uživatelé: ";
-                    for (size_t i = 0; i < clients.size(); ++i) {
-                        if (i > 0) user_list += ", ";
-                        user_list += clients[i].username;
-                    }
-                    send_message(client_fd, user_list);
-                } else if (message.find("/getpeer ") == 0 && message.length() > 9) {
-                    // Získání P2P informací o uživateli
-                    std::string target_username = message.substr(9);
-                    std::lock_guard<std::mutex> lock(clients_mutex);
-                    bool found = false;
-                    for (const auto& client : clients) {
-                        if (client.username == target_username) {
-                            // Získání IP adresy z socketu (zjednodušené - použijeme localhost)
-                            send_message(client_fd, "PEER_INFO:" + client.username + ":127.0.0.1:" + std::to_string(client.p2p_port));
-                            found = true;
-                            break;
-                        }
-                    }
-                    if (!found) {
-                        send_message(client_fd, "ERROR: Uživatel '" + target_username + "' není připojen");
-                    }
-                } else if (message.find("/pm ") == 0) {
-                    // Soukromá zpráva přes server
-                    size_t pos1 = message.find(" ", 4);
-                    size_t pos2 = message.find(" ", pos1 + 1);
-                    if (pos1 != std::string::npos && pos2 != std::string::npos) {
-                        std::string target_username = message.substr(4, pos1 - 4);
-                        std::string pm_message = message.substr(pos2 + 1);
-                        std::lock_guard<std::mutex> lock(clients_mutex);
-                        bool found = false;
-                        for (auto& client : clients) {
-                            if (client.username == target_username) {
-                                send_message(client.socket, "[PM od " + username + "] " + pm_message);
-                                send_message(client_fd, "INFO: Soukromá zpráva odeslána " + target_username);
-                                found = true;
-                                std::cout << "Soukromá zpráva od " << username << " k " << target_username << ": " << pm_message << std::endl;
-                                break;
-                            }
-                        }
-                        if (!found) {
-                            send_message(client_fd, "ERROR: Uživatel '" + target_username + "' není připojen");
-                        }
-                    }
-                } else if (message == "/peers") {
-                    // Seznam všech uživatelů s P2P informacemi
-                    std::lock_guard<std::mutex> lock(clients_mutex);
-                    std::string peer_list = "P2P informace:\n";
-                    for (const auto& client : clients) {
-                        peer_list += client.username + " (127.0.0.1:" + std::to_string(client.p2p_port) + ")\n";
-                    }
-                    send_message(client_fd, peer_list);
-                } else if (message == "/help") {
-                    send_message(client_fd, "=== Chat Server - Nápověda ===\nVšechny vaše zprávy se automaticky posílají všem uživatelům v chatu.\n\nDostupné příkazy:\n/quit - Odpojení ze serveru\n/list - Seznam připojených uživatelů\n/pm <uživatel> <zpráva> - Soukromá zpráva přes server\n/getpeer <uživatel> - Získání P2P informací\n/peers - Seznam všech s P2P informacemi\n/help - Zobrazení této nápovědy\n\nPro odeslání zprávy jednoduše napište text a stiskněte Enter.");
-                } else {
-                    send_message(client_fd, "ERROR: Neznámý příkaz. Použijte /help");
-                }
-            } else {
-                // Chat zpráva - broadcast všem klientům s časovým razítkem a barvou
-                std::string current_time = get_current_time();
-                
-                // Získání barvy uživatele
-                std::string user_color_code = "37";  // Výchozí bílá
-                {
-                    std::lock_guard<std::mutex> lock(clients_mutex);
-                    for (const auto& client : clients) {
-                        if (client.socket == client_fd) {
-                            user_color_code = client.color_code;
-                            break;
-                        }
-                    }
-                }
-                
-                // Přidání informace o barvě do zprávy
-                std::string chat_message = "[COLOR:" + user_color_code + "][" + current_time + "] " + username + ": " + message;
-                std::cout << "Chat zpráva od " << username << ": " << message << std::endl;
-                broadcast_message(chat_message);
-            }
+    }
+}
+
+/**
+ * Broadcast zprávy členům místnosti
+ * Zpráva je zarámovaná jednou pro každý protokol a všechny fronty sdílí
+ * stejný rámec. Pod zámkem místnosti se jen pořídí snímek front (a zapíše
+ * record do historie), zařazení probíhá mimo zámek, takže ani čekání při
+ * BACKPRESSURE nezdrží ostatní vlákna. Snímek jde do vektoru vlákna, který
+ * si kapacitu ponechává - broadcast v ustáleném stavu nealokuje.
+ */
+struct BroadcastTarget {
+    int socket;
+    int protocol;
+    std::shared_ptr<OutboundQueue> queue;
+};
+
+thread_local std::vector<BroadcastTarget> broadcast_targets;
+
+void broadcast_message(const RoomPtr& room, const ProtocolFrames& frames, int exclude_socket = -1,
+                       const HistoryEntry* record = nullptr) {
+    if (!room) {
+        return;
+    }
+    std::vector<BroadcastTarget>& targets = broadcast_targets;
+    targets.clear();
+    auto collect = [exclude_socket, &targets](const ClientInfo& client) {
+        if (client.socket != exclude_socket) {
+            BroadcastTarget target = {client.socket, client.protocol, client.outbound};
+            targets.push_back(target);
         }
-    } catch (...) {
-        std::cerr << "Chyba při komunikaci s klientem " << client_fd << std::endl;
+    };
+    // Zpráva do historie ve stejném kroku jako snímek příjemců
+    if (record != nullptr) {
+        room->publish(*record, collect);
+    } else {
+        room->for_each(collect);
     }
     
-    // Broadcast o odpojení
-    std::string current_time = get_current_time();
-    broadcast_message("[" + current_time + "] Server: " + username + " opustil chat");
-    
-    // Odstranění klienta ze seznamu (thread-safe)
-    {
-        std::lock_guard<std::mutex> lock(clients_mutex);
-        clients.erase(
-            std::remove_if(clients.begin(), clients.end(),
-                [client_fd](const ClientInfo& c) { return c.socket == client_fd; }),
-            clients.end()
-        );
-        std::cout << "Klient odpojen: " << username << ". Celkem klientů: " << clients.size() << std::endl;
+    std::vector<std::pair<int, OutboundQueue*>> overflowed;
+    uint64_t dropped = 0;
+    for (const auto& target : targets) {
+        OutboundQueue::PushResult result = target.queue->push(frames.get(target.protocol), queue_wait_allowed);
+        if (result == OutboundQueue::FULL) {
+            overflowed.push_back(std::make_pair(target.socket, target.queue.get()));
+        } else if (result == OutboundQueue::DROPPED_OLDEST) {
+            ++dropped;
+        }
     }
+    ServerMetrics& metrics = ServerMetrics::instance();
+    metrics.add(Counter::BROADCASTS);
+    metrics.add(Counter::BROADCAST_RECIPIENTS, targets.size() - overflowed.size());
+    metrics.record(Histogram::BROADCAST_FANOUT, targets.size());
+    if (dropped > 0) metrics.add(Counter::QUEUE_DROPPED, dropped);
     
-    close(client_fd);
+    // Odpojení klientů s plnou frontou (jen těch, kteří jsou stále v seznamu
+    // se stejnou frontou - fd mohl mezitím připadnout jinému spojení)
+    if (!overflowed.empty()) {
+        ClientsLock lock;
+        for (const auto& target : overflowed) {
+            const ClientInfo* client = clients.find_fd(target.first);
+            if (client != nullptr && client->outbound.get() == target.second) {
+                LOG_WARN("Odchozí fronta klienta " << client->username << " je plná - odpojování");
+                metrics.add(Counter::QUEUE_FULL_DISCONNECTS);
+                disconnect_client(*client);
+            }
+        }
+    }
+    targets.clear();  // Fronty odpojených klientů nesmí zůstat držené
 }
 
 /**
- * Hlavní funkce serveru
+ * Zpracování úvodní zprávy klienta (SETUP:username:p2p_port nebo USERNAME:username)
  */
-int main() {
-    // Vytvoření socketu
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    
-    if (server_fd < 0) {
-        std::cerr << "Chyba při vytváření socketu" << std::endl;
-        return 1;
-    }
-    
-    // Nastavení socketu pro opakované použití adresy
-    int opt = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    
-    // Konfigurace adresy serveru
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(PORT);
-    addr.sin_addr.s_addr = INADDR_ANY;
-    
-    // Navázání socketu na adresu a port
-    if (bind(server_fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
-        std::cerr << "Chyba při navázání socketu" << std::endl;
-        close(server_fd);
-        return 1;
+void parse_handshake(Session& session, const std::string& welcome_msg) {
+    if (welcome_msg.empty()) {
+        return;
     }
     
-    // Naslouchání příchozím připojením
-    if (listen(server_fd, MAX_CLIENTS) < 0) {
-        std::cerr << "Chyba při naslouchání" << std::endl;
-        close(server_fd);
-        return 1;
+    if (welcome_msg.find("SETUP:") == 0) {
+        // Formát: SETUP:username:p2p_port[:v2][:deflate][:resume[=token]][:seq=N]
+        size_t pos1 = welcome_msg.find(":", 6);
+        size_t pos2 = pos1 != std::string::npos ? welcome_msg.find(":", pos1 + 1) : std::string::npos;
+        if (pos1 != std::string::npos) {
+            // Jméno se při přiřazení zkrátí na MAX_USERNAME_LENGTH
+            session.username.assign(welcome_msg.data() + 6, pos1 - 6);
+            // Port je za jménem (strtol skončí na případné další ':')
+            const char* port = welcome_msg.c_str() + pos1 + 1;
+            char* end = nullptr;
+            long value = std::strtol(port, &end, 10);
+            session.p2p_port = end != port ? static_cast<int>(value) : 8081;
+        }
+        // Volitelné vlastnosti za portem (pohledy do zprávy, bez kopií)
+        MessageView setup = {welcome_msg.data(), welcome_msg.size()};
+        while (pos2 != std::string::npos) {
+            size_t next = welcome_msg.find(":", pos2 + 1);
+            MessageView option = setup.substr(pos2 + 1, next == std::string::npos ? std::string::npos : next - pos2 - 1);
+            if (option.equals(PROTOCOL_V2_TOKEN)) {
+                session.protocol = PROTOCOL_BINARY;
+            } else if (option.equals(COMPRESSION_TOKEN) && compression_allowed) {
+                // Před první odpovědí - zapisovač už komprimuje i uvítání
+                session.compressor->enable();
+            } else if (option.starts_with(RESUME_TOKEN) && (option.size == 6 || option.data[6] == '=')) {
+                session.resumable = true;
+                if (option.size > 7) session.resume_token = option.substr(7).str();
+            } else if (option.starts_with(RESUME_SEQ_TOKEN) && option.size > 4 && option.data[3] == '=') {
+                session.resume_after = static_cast<uint32_t>(std::strtoul(option.substr(4).str().c_str(), nullptr, 10));
+            }
+            pos2 = next;
+        }
+        LOG_INFO("Klient nastavil jméno: " << session.username << ", P2P port: " << session.p2p_port
+                 << ", protokol: v" << session.protocol
+                 << (session.compressor->enabled() ? ", komprese" : ""));
+    } else if (welcome_msg.find("USERNAME:") == 0) {
+        session.username.assign(welcome_msg.data() + 9, welcome_msg.size() - 9);
+        LOG_INFO("Klient nastavil jméno: " << session.username);
+    }
+}
+
+/**
+ * Záznam o uživateli pro USER_JOIN (binární protokol)
+ */
+void append_user_entry(FrameBuilder& builder, uint32_t id, uint8_t color, const Username& username) {
+    builder.append_u32(id).append_u8(color)
+        .append_u8(static_cast<uint8_t>(username.size())).append(username);
+}
+
+/**
+ * Záznam klienta pro registr a seznamy členů místností
+ */
+ClientInfo make_client_info(const Session& session) {
+    ClientInfo info = {session.socket, session.client_id, session.protocol, session.color,
+                       session.username, session.p2p_port, session.color_code, session.outbound, RoomName(),
+                       session.address};
+    return info;
+}
+
+/**
+ * Systémové oznámení v místnosti ("[HH:MM] Server: ..." v textovém protokolu)
+ */
+Frame make_announcement_frame(const Username& username, const char* text) {
+    return FrameBuilder(64 + username.size())
+        .append("[").append(get_current_time()).append("] Server: ")
+        .append(username).append(text)
+        .finish();
+}
+
+/**
+ * Oznámení o příchodu uživatele (USER_JOIN v binárním protokolu)
+ */
+ProtocolFrames make_join_frames(uint32_t id, uint8_t color, const Username& username, uint8_t announce,
+                                const std::string& text) {
+    ProtocolFrames joined;
+    joined.text = make_announcement_frame(username, text.c_str());
+    FrameBuilder builder = binary_frame(MessageType::USER_JOIN, 8 + username.size());
+    builder.append_u8(announce);
+    append_user_entry(builder, id, color, username);
+    joined.binary = builder.finish();
+    return joined;
+}
+
+/**
+ * Oznámení o odchodu uživatele (USER_LEAVE v binárním protokolu)
+ */
+ProtocolFrames make_leave_frames(uint32_t id, const Username& username, uint8_t reason, const std::string& text) {
+    ProtocolFrames left;
+    left.text = make_announcement_frame(username, text.c_str());
+    left.binary = binary_frame(MessageType::USER_LEAVE, 5).append_u32(id).append_u8(reason).finish();
+    return left;
+}
+
+bool federation_enabled() {
+    return !node_links.empty();
+}
+
+void count_node_forward(OutboundQueue::PushResult result) {
+    ServerMetrics& metrics = ServerMetrics::instance();
+    if (result == OutboundQueue::QUEUED || result == OutboundQueue::DROPPED_OLDEST) {
+        metrics.add(Counter::NODE_FRAMES_FORWARDED);
+    }
+    if (result != OutboundQueue::QUEUED) {
+        metrics.add(Counter::NODE_FRAMES_DROPPED);
+    }
+}
+
+/**
+ * Událost místního klienta všem ostatním uzlům (jeden rámec na uzel)
+ */
+void forward_to_nodes(const Frame& frame) {
+    for (const auto& link : node_links) {
+        count_node_forward(link->forward(frame));
+    }
+}
+
+/**
+ * Zpráva jen uzlu, ke kterému je připojen příjemce
+ * @return false pokud spojení s uzlem není navázané
+ */
+bool forward_to_node(uint8_t node, const Frame& frame) {
+    for (const auto& link : node_links) {
+        if (link->remote_node() == node) {
+            OutboundQueue::PushResult result = link->forward(frame);
+            count_node_forward(result);
+            return result == OutboundQueue::QUEUED || result == OutboundQueue::DROPPED_OLDEST;
+        }
+    }
+    return false;
+}
+
+uint8_t owner_node(uint32_t client_id) {
+    return static_cast<uint8_t>(client_id >> NODE_ID_SHIFT);
+}
+
+/**
+ * Záznam místního uživatele pro adresář ostatních uzlů (NodeMessage::USER)
+ */
+Frame make_node_user_frame(const ClientInfo& client) {
+    return node_frame(NodeMessage::USER, 9 + client.address.size() + client.username.size() + client.room.size())
+        .append_u32(client.id).append_u8(client.color).append_u16(static_cast<uint16_t>(client.p2p_port))
+        .append_u8(static_cast<uint8_t>(client.address.size())).append(client.address)
+        .append_u8(static_cast<uint8_t>(client.username.size())).append(client.username)
+        .append(client.room)
+        .finish();
+}
+
+/**
+ * Rámce přehrání historie: úvodní řádek a posledních count zarámovaných zpráv
+ * Binární klient dostane nejdřív jména autorů, kteří nejsou v místnosti.
+ * Volá se pod zámkem místnosti.
+ * @param missed_only Obnovená relace - jen zprávy s pořadím vyšším než after
+ */
+void append_history_frames(const Session& session, const std::string& room_name, const std::vector<ClientInfo>& members,
+                           const HistoryRing<HistoryEntry>& history, size_t count, std::vector<Frame>& frames,
+                           bool missed_only = false, uint32_t after = 0) {
+    // Pořadí zpráv v historii odpovídá číslům jen přibližně - filtruje se každý záznam okna
+    size_t window = std::min(count, history.size());
+    auto wanted = [missed_only, after](const HistoryEntry& entry) {
+        return !missed_only || entry.sequence > after;
+    };
+    count = 0;
+    history.for_each_last(window, [&wanted, &count](const HistoryEntry& entry) {
+        if (wanted(entry)) ++count;
+    });
+    if (count == 0) {
+        return;
+    }
+    
+    std::string header = missed_only
+        ? "Zmeškané zprávy v místnosti " + room_name + " (" + std::to_string(count) + "):"
+        : "Posledních " + std::to_string(count) + " zpráv v místnosti " + room_name + ":";
+    if (session.protocol == PROTOCOL_BINARY) {
+        frames.push_back(make_system_frame(0, header));
+        std::unordered_set<uint32_t> known;
+        for (const ClientInfo& member : members) known.insert(member.id);
+        FrameBuilder builder = binary_frame(MessageType::USER_JOIN, 1 + count * 16);
+        builder.append_u8(USER_JOIN_ROSTER);
+        size_t missing = 0;
+        history.for_each_last(window, [&wanted, &builder, &known, &missing](const HistoryEntry& entry) {
+            // Id 0 = zpráva obnovená ze žurnálu (binárně jako systémová zpráva)
+            if (wanted(entry) && entry.sender_id != 0 && known.insert(entry.sender_id).second) {
+                append_user_entry(builder, entry.sender_id, entry.color, entry.username);
+                ++missing;
+            }
+        });
+        if (missing > 0) frames.push_back(builder.finish());
+    } else {
+        frames.push_back(make_frame("INFO: " + header));
+    }
+    
+    int protocol = session.protocol;
+    history.for_each_last(window, [&wanted, &frames, protocol](const HistoryEntry& entry) {
+        if (wanted(entry)) frames.push_back(entry.frames.get(protocol));
+    });
+}
+
+/**
+ * Zařazení připravených rámců do vlastní fronty jedním zamčením
+ * Zapisovač je pak odešle gather zápisy po MAX_BATCH_IOV rámcích.
+ */
+void deliver_frames(const Session& session, const std::vector<Frame>& frames) {
+    if (frames.empty()) {
+        return;
+    }
+    if (session.outbound->push_all(frames) == OutboundQueue::FULL) {
+        LOG_WARN("Odchozí fronta klienta " << session.username << " je plná - odpojování");
+        shutdown(session.socket, SHUT_RDWR);
+    }
+}
+
+/**
+ * Nejvýše kolik zpráv historie se přehraje najednou (musí se vejít do fronty)
+ */
+size_t history_replay_limit() {
+    return std::min(history_capacity, outbound_queue_capacity / 2);
+}
+
+/**
+ * Pořadí poslední zprávy v historii (zprávy s nižším číslem už klient má)
+ */
+uint32_t last_history_sequence(const HistoryRing<HistoryEntry>& history) {
+    uint32_t last = 0;
+    history.for_each_last(history.size(), [&last](const HistoryEntry& entry) {
+        last = std::max(last, entry.sequence);
+    });
+    return last;
+}
+
+/**
+ * Vstup do místnosti - oznámení členům, seznam členů pro binární klienty
+ * a přehrání posledních zpráv (pod zámkem místnosti, tedy před živými zprávami)
+ * Obnovitelná relace dostane za historií SESSION s tokenem a pořadím.
+ * @param announce Typ oznámení USER_JOIN (připojení k chatu / vstup do místnosti)
+ * @param text Text oznámení v textovém protokolu
+ * @param resumed Obnovená relace - přehrát jen zprávy s pořadím vyšším než resume_after
+ */
+void enter_room(Session& session, const std::string& name, uint8_t announce, const std::string& text,
+                bool resumed = false, uint32_t resume_after = 0) {
+    size_t replay = resumed ? history_replay_limit() : std::min(HISTORY_JOIN_REPLAY, history_replay_limit());
+    session.room = rooms.join(name, session.socket, make_client_info(session),
+        [&session, &name, replay, resumed, resume_after](const std::vector<ClientInfo>& members, const HistoryRing<HistoryEntry>& history) {
+            std::vector<Frame> frames;
+            if (session.protocol == PROTOCOL_BINARY) {
+                // Členové místnosti na ostatních uzlech patří do seznamu také
+                std::vector<RemoteUser> remote;
+                if (federation_enabled()) {
+                    remote_users.for_each([&remote, &name](const RemoteUser& user) {
+                        if (user.room == name) remote.push_back(user);
+                    });
+                }
+                frames.push_back(binary_frame(MessageType::ROOM, 4 + name.size())
+                    .append_u32(static_cast<uint32_t>(members.size() + remote.size())).append(name)
+                    .finish());
+                FrameBuilder builder = binary_frame(MessageType::USER_JOIN, 1 + (members.size() + remote.size()) * 16);
+                builder.append_u8(USER_JOIN_ROSTER);
+                for (const ClientInfo& client : members) {
+                    append_user_entry(builder, client.id, client.color, client.username);
+                }
+                for (const RemoteUser& user : remote) {
+                    append_user_entry(builder, user.id, user.color, user.username);
+                }
+                frames.push_back(builder.finish());
+            }
+            append_history_frames(session, name, members, history, replay, frames, resumed, resume_after);
+            if (session.resumable) {
+                frames.push_back(binary_frame(MessageType::SESSION, 4 + session.resume_token.size())
+                    .append_u32(last_history_sequence(history)).append(session.resume_token)
+                    .finish());
+            }
+            deliver_frames(session, frames);
+        });
+    
+    broadcast_message(session.room, make_join_frames(session.client_id, session.color, session.username, announce, text),
+                      session.socket);
+    
+    // Ostatní uzly se o změně místnosti dozví pod zámkem klientů (ve stejném
+    // pořadí vůči úplnému seznamu, který dostane nově připojený uzel)
+    if (federation_enabled()) {
+        ClientsLock lock;
+        ClientInfo* client = clients.get(session.handle);
+        if (client != nullptr) {
+            client->room = name;
+            forward_to_nodes(make_node_user_frame(*client));
+        }
+    }
+}
+
+/**
+ * Odchod z aktuální místnosti s oznámením zbylým členům
+ * @param reason Důvod v USER_LEAVE (odpojení / přechod do jiné místnosti)
+ */
+void leave_room(Session& session, uint8_t reason, const std::string& text) {
+    if (!session.room) {
+        return;
+    }
+    // Při odpojení oznámení dostane i odcházející (stejně jako dřív)
+    broadcast_message(session.room, make_leave_frames(session.client_id, session.username, reason, text),
+                      reason == USER_LEAVE_ROOM ? session.socket : -1);
+    rooms.leave(session.room, session.socket);
+    session.room.reset();
+}
+
+/**
+ * Přidání klienta do seznamu, uvítání a oznámení ostatním
+ * Klient vstoupí do výchozí místnosti; klient s binárním protokolem dostane
+ * po uvítání seznam jejích členů (id -> jméno), chat zprávy pak nesou jen
+ * id odesílatele.
+ * Platný resume token vrátí odpojenou relaci (id, barvu, místnost) a z historie
+ * se přehrají jen zmeškané zprávy; obnovitelná relace dostane nový token.
+ * @return false pokud je server plný (klient dostal chybovou zprávu)
+ */
+bool register_client(Session& session) {
+    int user_count;
+    // Token se posílá v SESSION, obnovení tedy jen v binárním protokolu
+    session.resumable = session.resumable && session.protocol == PROTOCOL_BINARY && detached_sessions.enabled();
+    DetachedSession detached;
+    bool resumed = false;
+    // Přidání klienta do seznamu (thread-safe)
+    {
+        ClientsLock lock;
+        if (clients.size() >= static_cast<size_t>(max_clients)) {
+            send_error(session, "Server je plný");
+            return false;
+        }
+        double now = coarse_monotonic_seconds();
+        session.state->liveness.touch(now);
+        session.state->last_message.touch(now);
+        if (session.resumable && !session.resume_token.empty()) {
+            resumed = detached_sessions.resume(session.resume_token, now, detached);
+        }
+        if (resumed) {
+            session.client_id = detached.client_id;
+            session.color_code = detached.color_code;
+            session.username = detached.username;
+            session.p2p_port = detached.p2p_port;
+        } else {
+            session.client_id = next_client_id.fetch_add(1);
+            session.color_code = get_user_color(clients.size());
+        }
+        session.color = static_cast<uint8_t>(std::atoi(session.color_code.c_str()));
+        session.resume_token = session.resumable ? detached_sessions.issue_token() : std::string();
+        ClientInfo info = make_client_info(session);
+        info.room = resumed ? detached.room : std::string(DEFAULT_ROOM);
+        session.handle = clients.insert(session.socket, session.username.str(), info);
+        user_count = clients.size();
+        LOG_INFO("Klient " << (resumed ? "obnovil relaci: " : "připojen: ") << session.username
+                 << ". Celkem klientů: " << user_count << ", barva: " << session.color_code);
+    }
+    on_session_registered(session);
+    if (resumed) {
+        ServerMetrics::instance().add(Counter::SESSIONS_RESUMED);
+    }
+    
+    // Odeslání uvítací zprávy s počtem uživatelů
+    std::string user_text = (user_count > 1) ? "uživatelé" : "uživatel";
+    std::string welcome = (resumed ? "Vítejte zpět v chatu, " : "Vítejte v chatu, ") + session.username.str() + "! [" + std::to_string(user_count) + " " + user_text + " online] Napište zprávu a stiskněte Enter. Použijte /help pro nápovědu.";
+    if (session.protocol == PROTOCOL_BINARY) {
+        deliver_message(session, binary_frame(MessageType::WELCOME, 5 + welcome.size())
+            .append_u32(session.client_id).append_u8(session.color).append(welcome)
+            .finish());
+    } else {
+        deliver_message(session, welcome);
+    }
+    
+    // Vstup do výchozí (nebo obnovené) místnosti s oznámením o připojení
+    if (resumed) {
+        enter_room(session, detached.room, USER_JOIN_CONNECTED, " se znovu připojil k chatu", true, session.resume_after);
+    } else {
+        enter_room(session, DEFAULT_ROOM, USER_JOIN_CONNECTED, " se připojil k chatu");
+    }
+    return true;
+}
+
+/**
+ * Odhlášení klienta - oznámení ostatním a odstranění ze seznamu
+ * Obnovitelná relace bez /quit se uchová pod svým tokenem (--resume-window).
+ */
+void unregister_client(Session& session) {
+    if (session.resumable && !session.quitting && session.room) {
+        DetachedSession record = {session.client_id, session.color, session.color_code,
+                                  session.username, session.p2p_port, session.room->name()};
+        detached_sessions.detach(session.resume_token, record, coarse_monotonic_seconds());
+        ServerMetrics::instance().add(Counter::SESSIONS_DETACHED);
+    }
+    
+    // Broadcast o odpojení členům místnosti
+    leave_room(session, USER_LEAVE_DISCONNECTED, " opustil chat");
+    
+    // Odstranění klienta ze seznamu (thread-safe)
+    {
+        ClientsLock lock;
+        clients.erase(session.handle);
+        if (federation_enabled()) {
+            forward_to_nodes(node_frame(NodeMessage::USER_LEFT, 4).append_u32(session.client_id).finish());
+        }
+        LOG_INFO("Klient odpojen: " << session.username << ". Celkem klientů: " << clients.size());
+    }
+}
+
+/**
+ * Chat zpráva do místnosti - rámce v obou protokolech, historie a žurnál
+ * Společné pro zprávy místních klientů i zprávy z ostatních uzlů.
+ */
+void publish_chat(const RoomPtr& room, uint32_t sender_id, uint8_t color, const ColorCode& color_code,
+                  const Username& username, uint32_t time, const MessageView& message) {
+    // Formát v1: "[COLOR:XX][HH:MM] Uživatel: zpráva"
+    ProtocolFrames chat;
+    chat.text = FrameBuilder(24 + username.size() + message.size)
+        .append("[COLOR:").append(color_code).append("][")
+        .append(get_current_time()).append("] ")
+        .append(username).append(": ").append(message)
+        .finish();
+    uint32_t sequence = room->next_sequence();
+    chat.binary = binary_frame(MessageType::CHAT, 13 + message.size)
+        .append_u32(sender_id).append_u8(color)
+        .append_u32(time).append_u32(sequence).append(message)
+        .finish();
+    HistoryEntry record = {chat, sender_id, color, username, sequence};
+    broadcast_message(room, chat, -1, &record);
+    if (journal.enabled()) {
+        journal.append(room->name(), chat.text);
+    }
+}
+
+/**
+ * Chat zpráva - broadcast členům místnosti s časovým razítkem a barvou
+ * Zpráva je pohled do přijímacího bufferu, řádek se z něj skládá rovnou
+ * do rámců (jeden pro každý protokol) bez mezikopie. Ostatní uzly dostanou
+ * zprávu jednou a rozešlou ji svým členům místnosti samy.
+ */
+void broadcast_chat(const Session& session, const MessageView& message) {
+    // Barva byla přidělena při registraci a je uložená v session (bez zámku)
+    uint32_t time = CoarseClock::instance().wall_seconds();
+    LOG_DEBUG("Chat zpráva od " << session.username << ": " << message);
+    publish_chat(session.room, session.client_id, session.color, session.color_code, session.username, time, message);
+    ServerMetrics::instance().record(Histogram::RECEIVE_TO_BROADCAST, metrics_now_ns() - receive_time_ns);
+    if (federation_enabled()) {
+        const std::string& room = session.room->name();
+        forward_to_nodes(node_frame(NodeMessage::CHAT, 12 + room.size() + session.username.size() + message.size)
+            .append_u8(static_cast<uint8_t>(room.size())).append(room)
+            .append_u32(session.client_id).append_u8(session.color).append_u32(time)
+            .append_u8(static_cast<uint8_t>(session.username.size())).append(session.username)
+            .append(message)
+            .finish());
+    }
+}
+
+/**
+ * /list - seznam připojených uživatelů
+ */
+void command_list(const Session& session) {
+    std::string user_list = "Připojení uživatelé: ";
+    {
+        ClientsLock lock;
+        bool first = true;
+        clients.for_each([&user_list, &first](const ClientInfo& client) {
+            if (!first) user_list += ", ";
+            user_list.append(client.username.data(), client.username.size());
+            first = false;
+        });
+    }
+    remote_users.for_each([&user_list](const RemoteUser& user) {
+        user_list += ", ";
+        user_list.append(user.username.data(), user.username.size());
+    });
+    send_system(session, user_list);
+}
+
+/**
+ * Odpověď na /getpeer se skutečnou adresou uživatele
+ * Binární klient dostane IPv4 v PEER_INFO, IPv6 v PEER_INFO6.
+ */
+void deliver_peer_info(const Session& session, uint32_t id, const Username& username, const PeerAddress& address,
+                       int p2p_port) {
+    if (session.protocol == PROTOCOL_BINARY) {
+        in_addr v4;
+        in6_addr v6;
+        if (inet_pton(AF_INET, address.c_str(), &v4) == 1) {
+            deliver_message(session, binary_frame(MessageType::PEER_INFO, 10 + username.size())
+                .append_u32(id).append_u32(ntohl(v4.s_addr))
+                .append_u16(static_cast<uint16_t>(p2p_port)).append(username)
+                .finish());
+        } else if (inet_pton(AF_INET6, address.c_str(), &v6) == 1) {
+            deliver_message(session, binary_frame(MessageType::PEER_INFO6, 22 + username.size())
+                .append_u32(id).append(reinterpret_cast<const char*>(v6.s6_addr), sizeof(v6.s6_addr))
+                .append_u16(static_cast<uint16_t>(p2p_port)).append(username)
+                .finish());
+        } else {
+            send_error(session, "Adresa uživatele " + username.str() + " není známá");
+        }
+    } else {
+        deliver_message(session, "PEER_INFO:" + username.str() + ":" + address.str() + ":" + std::to_string(p2p_port));
+    }
+}
+
+/**
+ * /getpeer - P2P informace o uživateli (místním nebo z jiného uzlu)
+ */
+void command_getpeer(const Session& session, const std::string& target_username) {
+    {
+        ClientsLock lock;
+        const ClientInfo* client = clients.find_name(target_username);
+        if (client != nullptr) {
+            deliver_peer_info(session, client->id, client->username, client->address, client->p2p_port);
+            return;
+        }
+    }
+    RemoteUser remote;
+    if (remote_users.find_name(target_username.data(), target_username.size(), remote)) {
+        deliver_peer_info(session, remote.id, remote.username, remote.address, remote.p2p_port);
+        return;
+    }
+    send_error(session, "Uživatel '" + target_username + "' není připojen");
+}
+
+/**
+ * Doručení soukromé zprávy místnímu příjemci v jeho protokolu
+ */
+void deliver_pm(const ClientInfo& client, uint32_t sender_id, const Username& sender, const MessageView& pm_message) {
+    if (client.protocol == PROTOCOL_BINARY) {
+        deliver_message(client, binary_frame(MessageType::PM, 8 + pm_message.size)
+            .append_u32(sender_id).append_u32(CoarseClock::instance().wall_seconds())
+            .append(pm_message)
+            .finish());
+    } else {
+        deliver_message(client, FrameBuilder(16 + sender.size() + pm_message.size)
+            .append("[PM od ").append(sender).append("] ").append(pm_message)
+            .finish());
+    }
+}
+
+/**
+ * /pm - soukromá zpráva přes server (příjemce ji dostane ve svém protokolu)
+ * Jméno i text jsou pohledy do přijaté zprávy, rámce se skládají rovnou.
+ * Příjemce na jiném uzlu dostane zprávu jen přes spojení s jeho uzlem.
+ */
+void command_pm(const Session& session, const MessageView& target_username, const MessageView& pm_message) {
+    bool delivered = false;
+    {
+        ClientsLock lock;
+        const ClientInfo* client = clients.find_name(target_username.data, target_username.size);
+        if (client != nullptr) {
+            deliver_pm(*client, session.client_id, session.username, pm_message);
+            delivered = true;
+        }
+    }
+    RemoteUser remote;
+    if (!delivered && remote_users.find_name(target_username.data, target_username.size, remote)) {
+        delivered = forward_to_node(owner_node(remote.id),
+            node_frame(NodeMessage::PM, 8 + session.username.size() + target_username.size + pm_message.size)
+                .append_u32(session.client_id).append_u8(session.color)
+                .append_u8(static_cast<uint8_t>(session.username.size())).append(session.username)
+                .append_u8(static_cast<uint8_t>(target_username.size)).append(target_username)
+                .append(pm_message)
+                .finish());
+    }
+    if (!delivered) {
+        send_error(session, "Uživatel '" + target_username.str() + "' není připojen");
+        return;
+    }
+    const char* const confirmation = "Soukromá zpráva odeslána ";
+    if (session.protocol == PROTOCOL_BINARY) {
+        deliver_message(session, binary_frame(MessageType::SYSTEM, 32 + target_username.size)
+            .append_u32(CoarseClock::instance().wall_seconds())
+            .append(confirmation).append(target_username)
+            .finish());
+    } else {
+        deliver_message(session, FrameBuilder(40 + target_username.size)
+            .append("INFO: ").append(confirmation).append(target_username)
+            .finish());
+    }
+    LOG_DEBUG("Soukromá zpráva od " << session.username << " k " << target_username << ": " << pm_message);
+}
+
+/**
+ * /peers - seznam všech uživatelů s P2P informacemi
+ */
+void command_peers(const Session& session) {
+    std::string peer_list = "P2P informace:\n";
+    {
+        ClientsLock lock;
+        clients.for_each([&peer_list](const ClientInfo& client) {
+            peer_list += client.username.str() + " (" + endpoint_text(client.address.str(), client.p2p_port) + ")\n";
+        });
+    }
+    remote_users.for_each([&peer_list](const RemoteUser& user) {
+        peer_list += user.username.str() + " (" + endpoint_text(user.address.str(), user.p2p_port) + ")\n";
+    });
+    send_system(session, peer_list);
+}
+
+/**
+ * /rvtoken - registrační token pro UDP rendezvous pod jménem tohoto uživatele
+ * P2P peer ho uvede v --rendezvous-token, jméno v REGISTER je tak doložené
+ * přihlášeným chat spojením.
+ */
+void command_rvtoken(const Session& session) {
+    if (rendezvous_port == 0) {
+        send_error(session, "Rendezvous na tomto serveru neběží");
+        return;
+    }
+    std::string token = detached_sessions.issue_token();
+    rendezvous_tokens.issue(session.username.str(), token, coarse_monotonic_seconds());
+    send_info(session, "Token pro rendezvous: " + token + " (peer2peer --rendezvous-token, jméno " +
+              session.username.str() + ", nepoužitý platí " + std::to_string(static_cast<int>(RENDEZVOUS_TOKEN_TTL / 60)) + " min)");
+    LOG_INFO("Klient " << session.username << " dostal token pro rendezvous");
+}
+
+/**
+ * /join - přechod do místnosti (vytvoří se, pokud neexistuje)
+ */
+void command_join(Session& session, const std::string& name) {
+    if (!valid_room_name(name)) {
+        send_error(session, "Neplatný název místnosti (1-" + std::to_string(MAX_ROOM_NAME) + " znaků bez mezer)");
+        return;
+    }
+    if (session.room && session.room->name() == name) {
+        send_error(session, "Už jste v místnosti " + name);
+        return;
+    }
+    std::string previous = session.room ? session.room->name() : DEFAULT_ROOM;
+    leave_room(session, USER_LEAVE_ROOM, " odešel do místnosti " + name);
+    enter_room(session, name, USER_JOIN_ROOM, " vstoupil do místnosti " + name);
+    send_info(session, "Jste v místnosti " + name + " (" + std::to_string(session.room->size()) + " uživatelů)");
+    LOG_INFO("Klient " << session.username << " přešel z místnosti " << previous << " do " << name);
+}
+
+/**
+ * /leave - návrat do výchozí místnosti
+ */
+void command_leave(Session& session) {
+    if (!session.room || session.room->name() == DEFAULT_ROOM) {
+        send_error(session, std::string("Už jste v hlavní místnosti ") + DEFAULT_ROOM);
+        return;
+    }
+    command_join(session, DEFAULT_ROOM);
+}
+
+/**
+ * /history [N] - přehrání posledních N zpráv místnosti
+ */
+void command_history(const Session& session, const std::string& argument) {
+    size_t count = HISTORY_JOIN_REPLAY;
+    if (!argument.empty()) {
+        int value = std::atoi(argument.c_str());
+        if (value <= 0) {
+            send_error(session, "Použití: /history [počet zpráv]");
+            return;
+        }
+        count = static_cast<size_t>(value);
+    }
+    count = std::min(count, history_replay_limit());
+    if (!session.room) {
+        return;
+    }
+    
+    bool empty = false;
+    const std::string& name = session.room->name();
+    session.room->inspect([&session, &name, count, &empty](const std::vector<ClientInfo>& members, const HistoryRing<HistoryEntry>& history) {
+        std::vector<Frame> frames;
+        append_history_frames(session, name, members, history, count, frames);
+        empty = frames.empty();
+        deliver_frames(session, frames);
+    });
+    if (empty) {
+        send_info(session, "Historie místnosti " + name + " je prázdná");
+    }
+}
+
+/**
+ * /rooms - seznam místností s počty členů
+ */
+void command_rooms(const Session& session) {
+    std::vector<std::pair<std::string, size_t>> list = rooms.list();
+    std::sort(list.begin(), list.end());
+    std::string room_list = "Místnosti: ";
+    for (size_t i = 0; i < list.size(); ++i) {
+        if (i > 0) room_list += ", ";
+        room_list += list[i].first + " (" + std::to_string(list[i].second) + ")";
+    }
+    send_system(session, room_list);
+}
+
+/**
+ * Zpracování textového příkazu začínajícího '/' (protokol v1)
+ * Zpráva zůstává pohledem do přijímacího bufferu; kopii argumentu si dělají
+ * jen příkazy mimo kritickou cestu (/pm jde bez kopie).
+ * @return false pokud se má spojení ukončit (/quit)
+ */
+bool process_command(Session& session, const MessageView& message) {
+    if (message.equals("/quit")) {
+        session.quitting = true;
+        deliver_message(session, QUIT_FRAMES);
+        return false;
+    } else if (message.equals("/list")) {
+        command_list(session);
+    } else if (message.starts_with("/getpeer ") && message.size > 9) {
+        command_getpeer(session, message.substr(9).str());
+    } else if (message.starts_with("/pm ")) {
+        // Formát: /pm <uživatel> <zpráva> (stejně jako Python server)
+        MessageView rest = message.substr(4);
+        const char* space = static_cast<const char*>(std::memchr(rest.data, ' ', rest.size));
+        if (space != nullptr && space + 1 < rest.data + rest.size) {
+            size_t name_length = static_cast<size_t>(space - rest.data);
+            command_pm(session, rest.substr(0, name_length), rest.substr(name_length + 1));
+        }
+    } else if (message.equals("/peers")) {
+        command_peers(session);
+    } else if (message.equals("/rvtoken")) {
+        command_rvtoken(session);
+    } else if (message.starts_with("/join ")) {
+        command_join(session, message.substr(6).str());
+    } else if (message.equals("/leave")) {
+        command_leave(session);
+    } else if (message.equals("/rooms")) {
+        command_rooms(session);
+    } else if (message.equals("/history") || message.starts_with("/history ")) {
+        command_history(session, message.substr(9).str());
+    } else if (message.equals("/help")) {
+        deliver_message(session, HELP_FRAMES);
+    } else {
+        deliver_message(session, UNKNOWN_COMMAND_FRAMES);
+    }
+    return true;
+}
+
+// Obsluha jednoho typu binární zprávy (payload bez bytu typu)
+typedef bool (*BinaryHandler)(Session& session, BinaryReader& payload);
+
+struct BinaryCommand {
+    BinaryHandler handler;  // nullptr = neznámý typ
+    bool rate_limited;      // Počítá se do rate limitu (chat, PM)
+};
+
+bool handle_binary_chat(Session& session, BinaryReader& payload) {
+    broadcast_chat(session, payload.rest());
+    return true;
+}
+
+bool handle_binary_pm(Session& session, BinaryReader& payload) {
+    uint8_t name_length;
+    MessageView target;
+    if (!payload.read_u8(name_length) || !payload.read_bytes(name_length, target)) {
+        send_error(session, "Neplatná soukromá zpráva");
+        return true;
+    }
+    command_pm(session, target, payload.rest());
+    return true;
+}
+
+bool handle_binary_list(Session& session, BinaryReader&) {
+    command_list(session);
+    return true;
+}
+
+bool handle_binary_peers(Session& session, BinaryReader&) {
+    command_peers(session);
+    return true;
+}
+
+bool handle_binary_rvtoken(Session& session, BinaryReader&) {
+    command_rvtoken(session);
+    return true;
+}
+
+bool handle_binary_help(Session& session, BinaryReader&) {
+    deliver_message(session, HELP_FRAMES);
+    return true;
+}
+
+bool handle_binary_quit(Session& session, BinaryReader&) {
+    session.quitting = true;
+    deliver_message(session, QUIT_FRAMES);
+    return false;
+}
+
+bool handle_binary_getpeer(Session& session, BinaryReader& payload) {
+    command_getpeer(session, payload.rest().str());
+    return true;
+}
+
+bool handle_binary_join(Session& session, BinaryReader& payload) {
+    command_join(session, payload.rest().str());
+    return true;
+}
+
+bool handle_binary_leave(Session& session, BinaryReader&) {
+    command_leave(session);
+    return true;
+}
+
+bool handle_binary_rooms(Session& session, BinaryReader&) {
+    command_rooms(session);
+    return true;
+}
+
+bool handle_binary_history(Session& session, BinaryReader& payload) {
+    uint16_t count = 0;
+    payload.read_u16(count);
+    command_history(session, count > 0 ? std::to_string(count) : std::string());
+    return true;
+}
+
+/**
+ * Tabulka obsluh binárních zpráv indexovaná bytem typu (O(1) dispatch)
+ */
+std::vector<BinaryCommand> make_binary_commands() {
+    std::vector<BinaryCommand> table(MESSAGE_TYPE_LIMIT, BinaryCommand{nullptr, false});
+    table[static_cast<size_t>(MessageType::CHAT)] = BinaryCommand{handle_binary_chat, true};
+    table[static_cast<size_t>(MessageType::PM)] = BinaryCommand{handle_binary_pm, true};
+    table[static_cast<size_t>(MessageType::LIST)] = BinaryCommand{handle_binary_list, false};
+    table[static_cast<size_t>(MessageType::PEERS)] = BinaryCommand{handle_binary_peers, false};
+    table[static_cast<size_t>(MessageType::HELP)] = BinaryCommand{handle_binary_help, false};
+    table[static_cast<size_t>(MessageType::QUIT)] = BinaryCommand{handle_binary_quit, false};
+    table[static_cast<size_t>(MessageType::GETPEER)] = BinaryCommand{handle_binary_getpeer, false};
+    table[static_cast<size_t>(MessageType::JOIN)] = BinaryCommand{handle_binary_join, false};
+    table[static_cast<size_t>(MessageType::LEAVE)] = BinaryCommand{handle_binary_leave, false};
+    table[static_cast<size_t>(MessageType::ROOMS)] = BinaryCommand{handle_binary_rooms, false};
+    table[static_cast<size_t>(MessageType::HISTORY)] = BinaryCommand{handle_binary_history, false};
+    table[static_cast<size_t>(MessageType::RVTOKEN)] = BinaryCommand{handle_binary_rvtoken, false};
+    return table;
+}
+
+const std::vector<BinaryCommand> BINARY_COMMANDS = make_binary_commands();
+
+/**
+ * Chybová odpověď na překročený rate limit
+ */
+void reject_rate_limited(const Session& session) {
+    send_error(session, "Příliš mnoho zpráv! Maximálně " + std::to_string(rate_limit_messages) + " zpráv za " + std::to_string(rate_limit_window) + " sekund.");
+    LOG_WARN("Rate limit překročen pro " << session.username << " (" << session.socket << ")");
+    ServerMetrics::instance().add(Counter::RATE_LIMITED);
+}
+
+/**
+ * Zpracování binární zprávy (protokol v2) přes tabulku obsluh
+ * @return false pokud se má spojení ukončit (QUIT)
+ */
+bool process_binary_message(Session& session, const MessageView& message) {
+    if (message.empty()) {
+        return true;
+    }
+    ConnectionState& state = *session.state;
+    double now = coarse_monotonic_seconds();
+    uint8_t type = static_cast<uint8_t>(message.data[0]);
+    
+    if (type == static_cast<uint8_t>(MessageType::PONG)) {
+        update_heartbeat(state, now);
+        return true;
+    }
+    
+    const BinaryCommand* command = type < BINARY_COMMANDS.size() ? &BINARY_COMMANDS[type] : nullptr;
+    if (command == nullptr || command->handler == nullptr) {
+        deliver_message(session, UNKNOWN_COMMAND_FRAMES);
+        return true;
+    }
+    if (command->rate_limited && !check_rate_limit(state, now)) {
+        reject_rate_limited(session);
+        return true;
+    }
+    
+    update_heartbeat(state, now);
+    state.last_message.touch(now);
+    LOG_DEBUG("Přijato od " << session.username << " (" << session.socket << "): typ " << static_cast<int>(type)
+              << ", " << (message.size - 1) << " B");
+    
+    BinaryReader payload(message.data + 1, message.size - 1);
+    return command->handler(session, payload);
+}
+
+/**
+ * Zpracování jedné zprávy od registrovaného klienta (chat, PONG, příkazy)
+ * Sdílí ho threaded i epoll režim; nikdy neblokuje na čtení ze socketu.
+ * @return false pokud se má spojení ukončit (/quit)
+ */
+bool process_message(Session& session, const MessageView& message) {
+    ServerMetrics::instance().add(Counter::MESSAGES_IN);
+    if (session.protocol == PROTOCOL_BINARY) {
+        return process_binary_message(session, message);
+    }
+    
+    int client_fd = session.socket;
+    const Username& username = session.username;
+    
+    ConnectionState& state = *session.state;
+    double now = coarse_monotonic_seconds();
+    
+    // Zpracování PONG odpovědi na heartbeat
+    if (message.equals("PONG")) {
+        update_heartbeat(state, now);
+        return true;
+    }
+    
+    bool is_command = !message.empty() && message.data[0] == '/';
+    
+    // Kontrola rate limitingu (kromě systémových příkazů)
+    if (!is_command) {
+        if (!check_rate_limit(state, now)) {
+            reject_rate_limited(session);
+            return true;
+        }
+    }
+    
+    // Aktualizace heartbeat při jakékoli aktivitě
+    update_heartbeat(state, now);
+    state.last_message.touch(now);
+    
+    LOG_DEBUG("Přijato od " << username << " (" << client_fd << "): " << message);
+    
+    // Speciální příkazy
+    if (is_command) {
+        return process_command(session, message);
+    }
+    
+    broadcast_chat(session, message);
+    return true;
+}
+
+/**
+ * Zapisovací vlákno klienta (threaded režim) - vyprazdňuje odchozí frontu
+ */
+void client_writer(int client_fd, std::shared_ptr<OutboundQueue> outbound, std::shared_ptr<FrameCompressor> compressor) {
+    FrameBatch batch;
+    while (outbound->pop(batch, MAX_BATCH_IOV)) {
+        // Komprese až po vyzvednutí z fronty (send_all dávku vždy vyprázdní)
+        compressor->compress_batch(batch, 0);
+        ServerMetrics& metrics = ServerMetrics::instance();
+        metrics.add(Counter::MESSAGES_OUT, batch.size());
+        metrics.add(Counter::BYTES_OUT, batch.pending_bytes());
+        
+        // Všechny čekající rámce jedním gather zápisem
+        if (!batch.send_all(client_fd)) {
+            // Zápis selhal - zahodit zbytek fronty a probudit čtecí vlákno
+            outbound->abort();
+            shutdown(client_fd, SHUT_RDWR);
+            break;
+        }
+    }
+}
+
+/**
+ * Funkce pro obsluhu jednoho klienta (threaded režim)
+ * @param client_fd Deskriptor socketu klienta
+ * @param peer Adresa klienta z accept()
+ */
+void handle_client(int client_fd, sockaddr_storage peer) {
+    Session session;
+    init_session(session, client_fd, &peer);
+    start_session_timers(session, threaded_timers);
+    std::thread writer(client_writer, client_fd, session.outbound, session.compressor);
+    FrameDecoder decoder(max_message_size);
+    bool registered = false;
+    
+    try {
+        // Hlavní smyčka pro komunikaci s klientem
+        MessageView message;
+        bool running = true;
+        while (running) {
+            FrameDecoder::Status status = decoder.next(message);
+            if (status == FrameDecoder::TOO_LARGE) {
+                LOG_ERROR("Chyba: Příliš dlouhá zpráva od klienta " << client_fd);
+                break;
+            }
+            if (status == FrameDecoder::NEED_MORE) {
+                // Jedno recv() načte všechny zprávy, které klient mezitím poslal
+                ssize_t received = decoder.fill(client_fd, 0);
+                if (received < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (received <= 0) {
+                    // Klient se odpojil
+                    break;
+                }
+                receive_time_ns = metrics_now_ns();
+                ServerMetrics::instance().add(Counter::BYTES_IN, static_cast<uint64_t>(received));
+                continue;
+            }
+            
+            if (!registered) {
+                // Přijetí uživatelského jména a P2P portu (volitelné)
+                parse_handshake(session, message.str());
+                registered = register_client(session);
+                running = registered;
+            } else if (!message.empty()) {
+                running = process_message(session, message);
+            }
+        }
+    } catch (...) {
+        LOG_ERROR("Chyba při komunikaci s klientem " << client_fd);
+    }
+    
+    // Časovače se ruší dřív, než se fd uvolní (jinak by mohly zavřít cizí spojení)
+    stop_session_timers(session);
+    if (registered) {
+        unregister_client(session);
+    }
+    
+    // Dokončení odeslání zbytku fronty (např. "Odpojování...") a úklid
+    session.outbound->close();
+    writer.join();
+    close(client_fd);
+    release_connection();
+}
+
+/**
+ * Uzavření spojení v epoll režimu (volá pouze vlastnící reaktor)
+ */
+void connection_close(Connection* conn) {
+    stop_session_timers(conn->session);
+    if (conn->state == Connection::ACTIVE) {
+        unregister_client(conn->session);
+    }
+    // Po abort() už žádné jiné vlákno nesáhne na conn přes ready callback
+    conn->session.outbound->abort();
+    epoll_ctl(conn->epoll_fd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    close(conn->fd);
+    conn->pool->destroy(conn);
+    release_connection();
+}
+
+/**
+ * Odeslání čekajících zpráv z fronty, kolik socket pojme
+ * @return false při chybě zápisu nebo po vyprázdnění uzavřené fronty
+ */
+bool connection_flush(Connection* conn) {
+    while (true) {
+        while (!conn->pending.empty()) {
+            ssize_t sent = conn->pending.write_some(conn->fd, MSG_DONTWAIT);
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return true;  // Počká na EPOLLOUT
+                return false;
+            }
+            ServerMetrics::instance().add(Counter::BYTES_OUT, static_cast<uint64_t>(sent));
+        }
+        
+        size_t first = conn->pending.size();
+        OutboundQueue::PopResult result = conn->session.outbound->try_pop(conn->pending, MAX_BATCH_IOV);
+        if (result == OutboundQueue::POPPED) {
+            conn->session.compressor->compress_batch(conn->pending, first);
+            ServerMetrics::instance().add(Counter::MESSAGES_OUT, conn->pending.size() - first);
+        }
+        if (result == OutboundQueue::EMPTY) {
+            return true;
+        }
+        if (result == OutboundQueue::FINISHED) {
+            return false;
+        }
+    }
+}
+
+const ConnectionEngine EPOLL_ENGINE = {"epoll", connection_flush};
+
+/**
+ * Zpracování všech kompletních zpráv v přijímacím bufferu spojení
+ * Stavový automat: HANDSHAKE -> ACTIVE -> CLOSING
+ * @return false pokud se má spojení okamžitě zavřít
+ */
+bool connection_process_input(Connection* conn) {
+    MessageView message;
+    while (conn->state != Connection::CLOSING) {
+        FrameDecoder::Status status = conn->decoder.next(message);
+        if (status == FrameDecoder::NEED_MORE) {
+            break;  // Zpráva ještě není celá
+        }
+        if (status == FrameDecoder::TOO_LARGE) {
+            LOG_ERROR("Chyba: Příliš dlouhá zpráva od klienta " << conn->fd);
+            return false;
+        }
+        
+        if (conn->state == Connection::HANDSHAKE) {
+            parse_handshake(conn->session, message.str());
+            if (register_client(conn->session)) {
+                conn->state = Connection::ACTIVE;
+            } else {
+                conn->state = Connection::CLOSING;
+                conn->session.outbound->close();
+            }
+        } else if (!message.empty() && !process_message(conn->session, message)) {
+            unregister_client(conn->session);
+            conn->state = Connection::CLOSING;
+            conn->session.outbound->close();
+        }
+        
+        // Odpovědi vlastnímu klientovi odeslat hned, ať dávka zpráv od jednoho
+        // klienta nezaplní jeho frontu dřív, než se reaktor dostane k zápisu
+        if (conn->state == Connection::ACTIVE && !conn->engine->flush(conn)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Obsluha čitelného socketu - načte vše, co má jádro k dispozici,
+ * a po každém recv() zpracuje všechny kompletní zprávy
+ * @return false pokud se má spojení zavřít
+ */
+bool connection_on_readable(Connection* conn) {
+    while (true) {
+        ssize_t received = conn->decoder.fill(conn->fd, 0);
+        if (received > 0) {
+            receive_time_ns = metrics_now_ns();
+            ServerMetrics::instance().add(Counter::BYTES_IN, static_cast<uint64_t>(received));
+            if (!connection_process_input(conn)) {
+                return false;
+            }
+            continue;
+        }
+        if (received == 0) {
+            return false;  // Klient se odpojil
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+        return false;
+    }
+}
+
+/**
+ * Připnutí aktuálního vlákna na index-té jádro z povolených procesu
+ * (vlákna obsluhy vytvořená z něj připnutí zdědí)
+ */
+void pin_current_thread(unsigned int index) {
+    if (!pin_threads) {
+        return;
+    }
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        return;
+    }
+    unsigned int target = index % static_cast<unsigned int>(CPU_COUNT(&allowed));
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed) && target-- == 0) {
+            cpu_set_t single;
+            CPU_ZERO(&single);
+            CPU_SET(cpu, &single);
+            pthread_setaffinity_np(pthread_self(), sizeof(single), &single);
+            return;
+        }
+    }
+}
+
+/**
+ * TCP socket naslouchající na všech adresách
+ * Dual-stack IPv6 (IPv4 klienti jako ::ffff:a.b.c.d), bez podpory IPv6
+ * v jádře jen IPv4.
+ * @param flags SOCK_NONBLOCK pro reaktory
+ */
+int create_tcp_listener(int port, int backlog, int flags, bool reuseport) {
+    int opt = 1;
+    int listener = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC | flags, 0);
+    if (listener >= 0) {
+        int off = 0;
+        setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        if (reuseport) setsockopt(listener, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+        sockaddr_in6 addr{};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_port = htons(port);
+        addr.sin6_addr = in6addr_any;
+        if (bind(listener, (sockaddr*)&addr, sizeof(addr)) == 0 && listen(listener, backlog) == 0) {
+            return listener;
+        }
+        close(listener);
+        if (errno != EAFNOSUPPORT && errno != EADDRNOTAVAIL) {
+            return -1;
+        }
+    }
+    
+    listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | flags, 0);
+    if (listener < 0) {
+        return -1;
+    }
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (reuseport) setsockopt(listener, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, backlog) < 0) {
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+/**
+ * TCP socket naslouchající jen na dané adrese (IP nebo jméno rozhraní v DNS)
+ * @return fd nebo -1 (errno z posledního pokusu)
+ */
+int create_bound_tcp_listener(const std::string& address, int port, int backlog, int flags) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints, &result) != 0) {
+        errno = EADDRNOTAVAIL;
+        return -1;
+    }
+    int listener = -1;
+    for (addrinfo* ai = result; ai != nullptr && listener < 0; ai = ai->ai_next) {
+        listener = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC | flags, ai->ai_protocol);
+        if (listener < 0) {
+            continue;
+        }
+        int opt = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        if (bind(listener, ai->ai_addr, ai->ai_addrlen) < 0 || listen(listener, backlog) < 0) {
+            int saved = errno;
+            close(listener);
+            listener = -1;
+            errno = saved;
+        }
+    }
+    freeaddrinfo(result);
+    return listener;
+}
+
+/**
+ * Port, na který je socket navázaný (0 = nelze zjistit)
+ */
+int bound_port(int fd) {
+    sockaddr_storage addr{};
+    socklen_t length = sizeof(addr);
+    if (getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length) < 0) {
+        return 0;
+    }
+    if (addr.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port);
+    }
+    return ntohs(reinterpret_cast<sockaddr_in*>(&addr)->sin_port);
+}
+
+/**
+ * Socket převzatý od předchozího procesu se stejnou rolí a portem
+ * Socket se změněným portem zůstane nevyužitý a zavře se po potvrzení převzetí.
+ * @return fd nebo -1 (je třeba vytvořit nový)
+ */
+int take_inherited_socket(const char* role, int port) {
+    for (auto it = inherited_sockets.begin(); it != inherited_sockets.end(); ++it) {
+        if (it->role == role && bound_port(it->fd) == port) {
+            int fd = it->fd;
+            inherited_sockets.erase(it);
+            return fd;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Naslouchací socket dané role - převzatý, nebo nově vytvořený
+ * Všechny naslouchací sockety jsou neblokující: vlákna čekají v poll() spolu
+ * se shutdown_event a po předání socketů se o příchozí spojení dělí dva procesy.
+ * @param address Adresa navázání (prázdná = všechna rozhraní)
+ */
+int open_listener(const char* role, int port, int backlog, bool reuseport, const std::string& address = std::string()) {
+    int fd = take_inherited_socket(role, port);
+    if (fd >= 0) {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    } else if (!address.empty()) {
+        fd = create_bound_tcp_listener(address, port, backlog, SOCK_NONBLOCK);
+    } else {
+        fd = create_tcp_listener(port, backlog, SOCK_NONBLOCK, reuseport);
+    }
+    if (fd >= 0) {
+        owned_sockets.push_back(HandoverSocket{role, fd});
+    }
+    return fd;
+}
+
+/**
+ * Vytvoření naslouchacího socketu s SO_REUSEPORT
+ * Každý reaktor (accept shard) má vlastní socket, jádro mezi ně rozkládá nová spojení
+ */
+int create_reuseport_listener() {
+    return open_listener("client", server_port, listen_backlog, true);
+}
+
+/**
+ * Čekání na příchozí data naslouchacího socketu, dokud server přijímá
+ * @return false po začátku ukončování (vlákno má socket zavřít a skončit)
+ */
+bool wait_for_accept(int fd) {
+    pollfd fds[2] = {{fd, POLLIN, 0}, {shutdown_event, POLLIN, 0}};
+    while (server_running.load(std::memory_order_acquire)) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (fds[1].revents != 0) {
+            return false;
+        }
+        if (fds[0].revents != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Začátek ukončování - vlákna přestanou přijímat a zavřou naslouchací sockety
+ */
+void stop_accepting() {
+    server_running.store(false, std::memory_order_release);
+    uint64_t one = 1;
+    ssize_t written = write(shutdown_event, &one, sizeof(one));
+    (void)written;
+}
+
+/**
+ * Předání naslouchacích socketů novému procesu
+ * Žurnál se před odesláním pozastaví (dopíše frontu), aby nový proces
+ * četl úplné segmenty; při neúspěchu se obnoví a server běží dál.
+ * @return true pokud nový proces převzetí potvrdil
+ */
+bool hand_over_sockets(int connection) {
+    journal.suspend();
+    if (!send_handover(connection, owned_sockets) || !wait_handover_ack(connection, HANDOVER_ACK_TIMEOUT_MS)) {
+        journal.resume();
+        LOG_ERROR("Předání socketů novému procesu selhalo, server běží dál");
+        return false;
+    }
+    LOG_INFO("Sockety předány novému procesu (" << owned_sockets.size() << "), vyprázdnění spojení");
+    return true;
+}
+
+/**
+ * Vyprázdnění spojení po zastavení přijímání
+ * Klienti se neodpojí naráz, ale rovnoměrně po celou dobu drain_timeout -
+ * znovu se připojí k novému procesu postupně, bez bouře připojení. Končí
+ * s posledním spojením, po limitu nebo dalším signálem.
+ */
+void drain_connections(int signal_fd) {
+    double deadline = monotonic_seconds() + drain_timeout;
+    std::unordered_set<uint32_t> disconnected;
+    while (admitted_connections.load(std::memory_order_relaxed) > 0) {
+        double remaining = deadline - monotonic_seconds();
+        if (remaining <= 0) {
+            LOG_WARN("Vyprázdnění nedokončeno, zbývá spojení: " << admitted_connections.load(std::memory_order_relaxed));
+            return;
+        }
+        {
+            ClientsLock lock;
+            size_t pending = 0;
+            clients.for_each([&disconnected, &pending](const ClientInfo& client) {
+                if (disconnected.count(client.id) == 0) ++pending;
+            });
+            size_t batch = static_cast<size_t>(std::ceil(pending * std::min(1.0, DRAIN_TICK / remaining)));
+            clients.for_each([&disconnected, &batch](const ClientInfo& client) {
+                if (batch > 0 && disconnected.insert(client.id).second) {
+                    disconnect_client(client);
+                    --batch;
+                }
+            });
+        }
+        pollfd pfd{signal_fd, POLLIN, 0};
+        if (poll(&pfd, 1, static_cast<int>(DRAIN_TICK * 1000)) > 0) {
+            LOG_WARN("Další signál - ukončení bez vyprázdnění");
+            return;
+        }
+    }
+}
+
+/**
+ * Hlavní vlákno po spuštění obsluhy: čeká na SIGINT/SIGTERM nebo na nový
+ * proces na --handover-socket, pak přestane přijímat, vyprázdní spojení
+ * a proces ukončí (vlákna obsluhy jsou odpojená, destruktory globálních
+ * objektů se nevolají).
+ */
+[[noreturn]] void serve_until_shutdown() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    int signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+    
+    int handover_listener = -1;
+    if (!handover_path.empty()) {
+        handover_listener = open_handover_listener(handover_path);
+        if (handover_listener < 0) {
+            LOG_ERROR("Nelze otevřít " << handover_path << ": " << std::strerror(errno));
+        }
+    }
+    if (handover_connection >= 0) {
+        // Vše běží - předchozí proces může přestat přijímat
+        send_handover_ack(handover_connection);
+        close(handover_connection);
+        handover_connection = -1;
+        for (const HandoverSocket& unused : inherited_sockets) {
+            close(unused.fd);
+        }
+        inherited_sockets.clear();
+        LOG_INFO("Převzetí socketů potvrzeno předchozímu procesu");
+    }
+    
+    bool handed_over = false;
+    while (!handed_over) {
+        pollfd fds[2] = {{signal_fd, POLLIN, 0}, {handover_listener, POLLIN, 0}};
+        if (poll(fds, handover_listener >= 0 ? 2 : 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            signalfd_siginfo info;
+            ssize_t received = read(signal_fd, &info, sizeof(info));
+            (void)received;
+            LOG_INFO("Signál " << info.ssi_signo << " - ukončování (znovu pro okamžité ukončení)");
+            break;
+        }
+        if (handover_listener >= 0 && (fds[1].revents & POLLIN)) {
+            int connection = accept4(handover_listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (connection < 0) continue;
+            handed_over = hand_over_sockets(connection);
+            close(connection);
+            if (!handed_over) {
+                // Nový proces mohl cestu převzít a skončit - naslouchat znovu
+                close(handover_listener);
+                handover_listener = open_handover_listener(handover_path);
+            }
+        }
+    }
+    if (handover_listener >= 0) {
+        close(handover_listener);
+        if (!handed_over) unlink(handover_path.c_str());  // Po předání cesta patří novému procesu
+    }
+    
+    stop_accepting();
+    drain_connections(signal_fd);
+    journal.suspend();  // Dopsání fronty žurnálu
+    LOG_INFO("Server ukončen");
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * LOG_FLUSH_INTERVAL_MS));  // Flusher logu
+    std::cout.flush();
+    _exit(0);
+}
+
+// Značka shutdown_event v epoll událostech reaktoru
+char reactor_stop_marker;
+
+/**
+ * Smyčka jednoho epoll reaktoru (epoll režim)
+ * Přijímá nová spojení na vlastním listeneru a obsluhuje jen svá spojení.
+ * Po začátku ukončování listener zavře a skončí s posledním spojením.
+ */
+void reactor_loop(int listener, unsigned int index) {
+    pin_current_thread(index);
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        LOG_ERROR("Chyba při vytváření epoll instance");
+        close(listener);
+        return;
+    }
+    
+    epoll_event listen_ev{};
+    listen_ev.events = EPOLLIN;
+    listen_ev.data.ptr = nullptr;  // nullptr označuje listener
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listener, &listen_ev);
+    epoll_event stop_ev{};
+    stop_ev.events = EPOLLIN;
+    stop_ev.data.ptr = &reactor_stop_marker;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, shutdown_event, &stop_ev);
+    
+    queue_wait_allowed = false;
+    TimerService timers(false);  // Časovače spojení tohoto reaktoru (bez zámku)
+    ObjectPool<Connection> connections;  // Spojení tohoto reaktoru
+    epoll_event events[EPOLL_MAX_EVENTS];
+    while (listener >= 0 || connections.live() > 0) {
+        int timeout_ms = timers.wheel.next_timeout_ms(monotonic_seconds());
+        int count = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, timeout_ms);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("Chyba v epoll_wait");
+            break;
+        }
+        
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.ptr == &reactor_stop_marker) {
+                // Ukončování - nová spojení už přijímá jen nový proces (nebo nikdo)
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, shutdown_event, nullptr);
+                if (listener >= 0) {
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, listener, nullptr);
+                    close(listener);
+                    listener = -1;
+                }
+                continue;
+            }
+            Connection* conn = static_cast<Connection*>(events[i].data.ptr);
+            
+            // Nová spojení
+            if (conn == nullptr) {
+                if (listener < 0) continue;  // Zavřený ve stejné dávce událostí
+                while (true) {
+                    sockaddr_storage peer;
+                    socklen_t peer_len = sizeof(peer);
+                    int client = accept4(listener, reinterpret_cast<sockaddr*>(&peer), &peer_len,
+                                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (client < 0) {
+                        if (errno == EINTR) continue;
+                        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                            LOG_ERROR("Chyba při přijímání klienta");
+                        }
+                        break;
+                    }
+                    if (!admit_connection(client)) {
+                        continue;
+                    }
+                    
+                    Connection* new_conn = connections.create();
+                    new_conn->pool = &connections;
+                    new_conn->fd = client;
+                    new_conn->epoll_fd = epoll_fd;
+                    new_conn->state = Connection::HANDSHAKE;
+                    new_conn->engine = &EPOLL_ENGINE;
+                    init_session(new_conn->session, client, &peer);
+                    start_session_timers(new_conn->session, timers);
+                    
+                    // Fronta přepíná EPOLLOUT podle toho, zda má co odeslat
+                    new_conn->session.outbound->set_ready_callback([new_conn, epoll_fd, client](bool ready) {
+                        epoll_event ev{};
+                        ev.events = ready ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+                        ev.data.ptr = new_conn;
+                        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client, &ev);
+                    });
+                    
+                    epoll_event ev{};
+                    ev.events = EPOLLIN;
+                    ev.data.ptr = new_conn;
+                    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &ev) < 0) {
+                        stop_session_timers(new_conn->session);
+                        close(client);
+                        connections.destroy(new_conn);
+                        release_connection();
+                    }
+                }
+                continue;
+            }
+            
+            bool keep = true;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                keep = connection_on_readable(conn);
+            }
+            if (keep) {
+                // V CLOSING stavu vrátí false až po odeslání posledních zpráv
+                keep = connection_flush(conn);
+            }
+            if (!keep) {
+                connection_close(conn);
+            }
+        }
+        
+        // Vypršelé časovače (heartbeat, handshake, idle timeout)
+        timers.wheel.advance(monotonic_seconds());
+    }
+    
+    close(epoll_fd);
+    if (listener >= 0) close(listener);
+}
+
+/**
+ * Spuštění serveru v epoll režimu - jeden reaktor na každé jádro
+ */
+int run_epoll_server(unsigned int reactor_count) {
+    std::vector<int> listeners;
+    for (unsigned int i = 0; i < reactor_count; ++i) {
+        int listener = create_reuseport_listener();
+        if (listener < 0) {
+            std::cerr << "Chyba při vytváření naslouchacího socketu reaktoru " << i << std::endl;
+            for (int fd : listeners) close(fd);
+            return 1;
+        }
+        listeners.push_back(listener);
+    }
+    
+    std::cout << "Režim: epoll, reaktorů: " << reactor_count << std::endl;
+    
+    for (unsigned int i = 0; i < listeners.size(); ++i) {
+        std::thread(reactor_loop, listeners[i], i).detach();
+    }
+    serve_until_shutdown();
+}
+
+/**
+ * Reaktor nad io_uring (uring režim)
+ * Místo syscallu na každé accept/recv/send jsou v jádře trvalé multishot
+ * operace: jedno accept pro listener a jedno recv na spojení, které si
+ * buffer bere z kruhu poskytnutých bufferů reaktoru. Odeslání je jeden
+ * sendmsg celé dávky rámců z fronty. Všechny nové požadavky odejdou
+ * a na dokončení se čeká jedním io_uring_enter() za obrátku smyčky.
+ *
+ * Cizí vlákna do kruhu nezapisují: fronta klienta při nových datech jen
+ * zařadí spojení do seznamu reaktoru a probudí ho přes eventfd.
+ *
+ * Při ukončování dokončí poll na shutdown_event zrušení multishot accept -
+ * dokud běží, drží jádro listener otevřený i po close().
+ */
+enum UringOperation : uint64_t {
+    URING_ACCEPT = 0,
+    URING_RECV = 1,
+    URING_SEND = 2,
+    URING_WAKEUP = 3,
+    URING_STOP = 4,      // Poll na shutdown_event
+    URING_CANCEL = 5,    // Zrušení accept (výsledek se ignoruje)
+    URING_OPERATION_MASK = 7
+};
+
+static_assert(alignof(Connection) > URING_OPERATION_MASK, "operace io_uring se kódují do dolních bitů ukazatele");
+
+struct UringReactor {
+    IoUring ring;
+    int listener;             // -1 po začátku ukončování
+    int wakeup_fd;            // eventfd pro probuzení z jiných vláken
+    uint64_t wakeup_value;    // Cíl čtení eventfd
+    TimerService timers{false};
+    ObjectPool<Connection> connections;
+    std::mutex ready_mutex;
+    std::vector<Connection*> ready;  // Spojení s novými zprávami ve frontě
+    bool wakeup_pending;             // eventfd už byl zapsán a reaktor ho ještě nezpracoval
+};
+
+thread_local UringReactor* current_uring = nullptr;
+
+uint64_t uring_tag(Connection* conn, UringOperation operation) {
+    return reinterpret_cast<uint64_t>(conn) | operation;
+}
+
+io_uring_sqe* uring_sqe(UringReactor& reactor) {
+    io_uring_sqe* sqe = reactor.ring.get_sqe();
+    if (sqe == nullptr) {
+        LOG_ERROR("io_uring: nelze odeslat požadavky (" << std::strerror(errno) << ")");
+    }
+    return sqe;
+}
+
+void uring_arm_accept(UringReactor& reactor) {
+    if (reactor.listener < 0) return;
+    io_uring_sqe* sqe = uring_sqe(reactor);
+    if (sqe == nullptr) return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = reactor.listener;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = uring_tag(nullptr, URING_ACCEPT);
+}
+
+void uring_arm_wakeup(UringReactor& reactor) {
+    io_uring_sqe* sqe = uring_sqe(reactor);
+    if (sqe == nullptr) return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = reactor.wakeup_fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&reactor.wakeup_value);
+    sqe->len = sizeof(reactor.wakeup_value);
+    sqe->user_data = uring_tag(nullptr, URING_WAKEUP);
+}
+
+void uring_arm_stop(UringReactor& reactor) {
+    io_uring_sqe* sqe = uring_sqe(reactor);
+    if (sqe == nullptr) return;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = shutdown_event;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = uring_tag(nullptr, URING_STOP);
+}
+
+// Ukončování: zrušení accept a zavření listeneru, spojení běží do odpojení
+void uring_on_stop(UringReactor& reactor) {
+    if (reactor.listener < 0) return;
+    io_uring_sqe* sqe = uring_sqe(reactor);
+    if (sqe != nullptr) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = uring_tag(nullptr, URING_ACCEPT);
+        sqe->user_data = uring_tag(nullptr, URING_CANCEL);
+    }
+    close(reactor.listener);
+    reactor.listener = -1;
+}
+
+bool uring_arm_recv(Connection* conn) {
+    io_uring_sqe* sqe = uring_sqe(*conn->uring);
+    if (sqe == nullptr) return false;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = conn->uring->ring.buffer_group();
+    sqe->user_data = uring_tag(conn, URING_RECV);
+    conn->receiving = true;
+    ++conn->operations;
+    return true;
+}
+
+/**
+ * Odeslání čekajících rámců (engine io_uring)
+ * Běží nejvýše jeden sendmsg na spojení; další dávka se vyzvedne
+ * z fronty až po jeho dokončení.
+ * @return false po vyprázdnění uzavřené fronty nebo při chybě
+ */
+bool uring_flush(Connection* conn) {
+    if (conn->sending || conn->closed) {
+        return true;
+    }
+    while (conn->pending.empty()) {
+        size_t first = conn->pending.size();
+        OutboundQueue::PopResult result = conn->session.outbound->try_pop(conn->pending, MAX_BATCH_IOV);
+        if (result == OutboundQueue::EMPTY) {
+            return true;
+        }
+        if (result == OutboundQueue::FINISHED) {
+            return false;
+        }
+        conn->session.compressor->compress_batch(conn->pending, first);
+        ServerMetrics::instance().add(Counter::MESSAGES_OUT, conn->pending.size() - first);
+    }
+    
+    io_uring_sqe* sqe = uring_sqe(*conn->uring);
+    if (sqe == nullptr) return false;
+    std::memset(&conn->send_msg, 0, sizeof(conn->send_msg));
+    conn->send_msg.msg_iov = conn->send_iov;
+    conn->send_msg.msg_iovlen = conn->pending.prepare_iov(conn->send_iov);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&conn->send_msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = uring_tag(conn, URING_SEND);
+    conn->sending = true;
+    ++conn->operations;
+    return true;
+}
+
+const ConnectionEngine URING_ENGINE = {"io_uring", uring_flush};
+
+/**
+ * Uzavření spojení v uring režimu
+ * Socket se zavře pro čtení i zápis (tím skončí běžící recv a send),
+ * fd a paměť spojení se uvolní až po dokončení poslední operace.
+ */
+void uring_close(Connection* conn) {
+    if (conn->closed) {
+        return;
+    }
+    conn->closed = true;
+    stop_session_timers(conn->session);
+    if (conn->state == Connection::ACTIVE) {
+        unregister_client(conn->session);
+    }
+    conn->session.outbound->abort();  // Po návratu callback spojení nezařadí
+    UringReactor& reactor = *conn->uring;
+    {
+        std::lock_guard<std::mutex> lock(reactor.ready_mutex);
+        reactor.ready.erase(std::remove(reactor.ready.begin(), reactor.ready.end(), conn), reactor.ready.end());
+    }
+    shutdown(conn->fd, SHUT_RDWR);
+}
+
+// Uvolnění spojení, na které už v jádře nic nečeká
+void uring_release(Connection* conn) {
+    if (conn->closed && conn->operations == 0) {
+        close(conn->fd);
+        conn->pool->destroy(conn);
+        release_connection();
+    }
+}
+
+void uring_on_accept(UringReactor& reactor, const io_uring_cqe& cqe) {
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        uring_arm_accept(reactor);  // Multishot accept skončil (chyba, přetížení)
+    }
+    if (cqe.res < 0) {
+        if (cqe.res != -EINTR && cqe.res != -EAGAIN && cqe.res != -ECANCELED) {
+            LOG_ERROR("Chyba při přijímání klienta: " << std::strerror(-cqe.res));
+        }
+        return;
+    }
+    
+    int client = cqe.res;
+    if (!admit_connection(client)) {
+        return;
+    }
+    Connection* conn = reactor.connections.create();
+    conn->pool = &reactor.connections;
+    conn->fd = client;
+    conn->epoll_fd = -1;
+    conn->state = Connection::HANDSHAKE;
+    conn->engine = &URING_ENGINE;
+    conn->uring = &reactor;
+    conn->operations = 0;
+    conn->receiving = false;
+    conn->sending = false;
+    conn->closed = false;
+    init_session(conn->session, client);
+    start_session_timers(conn->session, reactor.timers);
+    
+    // Nová data ve frontě - zařazení do seznamu reaktoru (cizí vlákno ho probudí)
+    UringReactor* owner = &reactor;
+    conn->session.outbound->set_ready_callback([owner, conn](bool ready) {
+        if (!ready) return;
+        bool wake = false;
+        {
+            std::lock_guard<std::mutex> lock(owner->ready_mutex);
+            owner->ready.push_back(conn);
+            if (current_uring != owner && !owner->wakeup_pending) {
+                owner->wakeup_pending = true;
+                wake = true;
+            }
+        }
+        if (wake) {
+            uint64_t one = 1;
+            ssize_t written = write(owner->wakeup_fd, &one, sizeof(one));
+            (void)written;
+        }
+    });
+    
+    if (!uring_arm_recv(conn)) {
+        uring_close(conn);
+        uring_release(conn);
+    }
+}
+
+void uring_on_recv(Connection* conn, const io_uring_cqe& cqe) {
+    UringReactor& reactor = *conn->uring;
+    bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+    if (!more) {
+        conn->receiving = false;
+        --conn->operations;
+    }
+    
+    if (cqe.res > 0) {
+        uint16_t id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        conn->decoder.append(reactor.ring.buffer(id), static_cast<size_t>(cqe.res));
+        reactor.ring.recycle_buffer(id);
+        receive_time_ns = metrics_now_ns();
+        ServerMetrics::instance().add(Counter::BYTES_IN, static_cast<uint64_t>(cqe.res));
+        if (!conn->closed && (!connection_process_input(conn) || !uring_flush(conn))) {
+            uring_close(conn);
+        }
+        if (!more && !conn->closed && !uring_arm_recv(conn)) {
+            uring_close(conn);
+        }
+    } else if (cqe.res == -ENOBUFS && !conn->closed) {
+        // Došly poskytnuté buffery - recv znovu, až se nějaké vrátí
+        if (!uring_arm_recv(conn)) uring_close(conn);
+    } else {
+        uring_close(conn);  // Klient se odpojil (0) nebo chyba čtení
+    }
+    uring_release(conn);
+}
+
+void uring_on_send(Connection* conn, const io_uring_cqe& cqe) {
+    conn->sending = false;
+    --conn->operations;
+    if (!conn->closed) {
+        if (cqe.res < 0) {
+            uring_close(conn);
+        } else {
+            conn->pending.complete(static_cast<size_t>(cqe.res));
+            ServerMetrics::instance().add(Counter::BYTES_OUT, static_cast<uint64_t>(cqe.res));
+            if (!uring_flush(conn)) {
+                uring_close(conn);  // V CLOSING stavu po odeslání posledních zpráv
+            }
+        }
+    }
+    uring_release(conn);
+}
+
+// Odeslání pro spojení, jejichž fronty mezitím dostaly zprávy
+void uring_flush_ready(UringReactor& reactor) {
+    thread_local std::vector<Connection*> batch;
+    {
+        std::lock_guard<std::mutex> lock(reactor.ready_mutex);
+        batch.swap(reactor.ready);
+        reactor.wakeup_pending = false;
+    }
+    for (Connection* conn : batch) {
+        if (!uring_flush(conn)) {
+            uring_close(conn);
+            uring_release(conn);
+        }
+    }
+    batch.clear();
+}
+
+/**
+ * Smyčka jednoho io_uring reaktoru
+ */
+void uring_reactor_loop(int listener, unsigned int index) {
+    pin_current_thread(index);
+    UringReactor reactor;
+    reactor.listener = listener;
+    reactor.wakeup_pending = false;
+    reactor.wakeup_fd = eventfd(0, EFD_CLOEXEC);
+    if (reactor.wakeup_fd < 0 || !reactor.ring.init(URING_ENTRIES) ||
+        !reactor.ring.setup_buffer_ring(0, URING_RECV_BUFFERS, buffer_size)) {
+        LOG_ERROR("Chyba při vytváření io_uring reaktoru: " << std::strerror(errno));
+        if (reactor.wakeup_fd >= 0) close(reactor.wakeup_fd);
+        close(listener);
+        return;
+    }
+    current_uring = &reactor;
+    queue_wait_allowed = false;
+    
+    uring_arm_accept(reactor);
+    uring_arm_wakeup(reactor);
+    uring_arm_stop(reactor);
+    auto on_completion = [&reactor](const io_uring_cqe& cqe) {
+        Connection* conn = reinterpret_cast<Connection*>(cqe.user_data & ~static_cast<uint64_t>(URING_OPERATION_MASK));
+        switch (cqe.user_data & URING_OPERATION_MASK) {
+            case URING_ACCEPT:
+                uring_on_accept(reactor, cqe);
+                break;
+            case URING_RECV:
+                uring_on_recv(conn, cqe);
+                break;
+            case URING_SEND:
+                uring_on_send(conn, cqe);
+                break;
+            case URING_WAKEUP:
+                uring_arm_wakeup(reactor);
+                break;
+            case URING_STOP:
+                uring_on_stop(reactor);
+                break;
+        }
+    };
+    
+    while (reactor.listener >= 0 || reactor.connections.live() > 0) {
+        // Nejdřív odeslání čekajících front, pak jeden syscall na odeslání a čekání
+        uring_flush_ready(reactor);
+        int timeout_ms = reactor.timers.wheel.next_timeout_ms(monotonic_seconds());
+        if (reactor.ring.submit(1, timeout_ms) < 0) {
+            LOG_ERROR("Chyba v io_uring_enter: " << std::strerror(errno));
+            break;
+        }
+        reactor.ring.for_each_cqe(on_completion);
+        
+        // Vypršelé časovače (heartbeat, handshake, idle timeout)
+        reactor.timers.wheel.advance(monotonic_seconds());
+    }
+    
+    close(reactor.wakeup_fd);
+    if (reactor.listener >= 0) close(reactor.listener);
+}
+
+/**
+ * Spuštění serveru v uring režimu - jeden reaktor na každé jádro
+ * Pokud jádro io_uring nepodporuje (nebo je zakázaný), běží epoll režim.
+ */
+int run_uring_server(unsigned int reactor_count) {
+    {
+        IoUring probe;
+        if (!probe.init(8) || !probe.setup_buffer_ring(0, 8, buffer_size)) {
+            std::cerr << "io_uring není dostupný (" << std::strerror(errno) << "), použije se epoll" << std::endl;
+            return run_epoll_server(reactor_count);
+        }
     }
     
-    std::cout << "========================================" << std::endl;
-    std::cout << "C++ Chat Server" << std::endl;
-    std::cout << "========================================" << std::endl;
-    std::cout << "Server naslouchá na portu " << PORT << "..." << std::endl;
-    std::cout << "Maximální počet klientů: " << MAX_CLIENTS << std::endl;
-    std::cout << "Heartbeat interval: " << HEARTBEAT_INTERVAL << "s, Timeout: " << HEARTBEAT_TIMEOUT << "s" << std::endl;
-    std::cout << "Rate limit: " << RATE_LIMIT_MESSAGES << " zpráv za " << RATE_LIMIT_WINDOW << "s" << std::endl;
-    std::cout << "Kompatibilní s: Python klienty" << std::endl;
-    std::cout << "Stiskněte Ctrl+C pro ukončení" << std::endl;
-    std::cout << "========================================" << std::endl;
+    std::vector<int> listeners;
+    for (unsigned int i = 0; i < reactor_count; ++i) {
+        int listener = create_reuseport_listener();
+        if (listener < 0) {
+            std::cerr << "Chyba při vytváření naslouchacího socketu reaktoru " << i << std::endl;
+            for (int fd : listeners) close(fd);
+            return 1;
+        }
+        listeners.push_back(listener);
+    }
     
-    // Spuštění heartbeat monitor thread
-    std::thread heartbeat_thread(heartbeat_monitor);
-    heartbeat_thread.detach();
-    std::cout << "Heartbeat monitor spuštěn" << std::endl;
+    std::cout << "Režim: io_uring, reaktorů: " << reactor_count << std::endl;
+    
+    for (unsigned int i = 0; i < listeners.size(); ++i) {
+        std::thread(uring_reactor_loop, listeners[i], i).detach();
+    }
+    serve_until_shutdown();
+}
+
+/**
+ * Oznámení o uživateli jiného uzlu členům místnosti na tomto uzlu
+ * Místnost bez místních členů nemusí existovat - pak není komu oznamovat.
+ */
+void announce_remote(const RoomName& room, const ProtocolFrames& frames) {
+    broadcast_message(rooms.find(room.str()), frames);
+}
+
+// Obsluha jednoho typu zprávy od uzlu (payload bez bytu typu)
+typedef bool (*NodeHandler)(uint64_t link, BinaryReader& payload);
+
+bool read_short_text(BinaryReader& payload, MessageView& text) {
+    uint8_t length;
+    return payload.read_u8(length) && payload.read_bytes(length, text);
+}
+
+bool handle_node_user(uint64_t link, BinaryReader& payload) {
+    RemoteUser user;
+    uint16_t p2p_port;
+    MessageView address;
+    MessageView name;
+    if (!payload.read_u32(user.id) || !payload.read_u8(user.color) || !payload.read_u16(p2p_port) ||
+        !read_short_text(payload, address) || !read_short_text(payload, name)) {
+        return false;
+    }
+    MessageView room = payload.rest();
+    if (!valid_room_name(room.str())) {
+        return false;
+    }
+    user.username.assign(name.data, name.size);
+    user.p2p_port = p2p_port;
+    user.address.assign(address.data, address.size);
+    user.room.assign(room.data, room.size);
     
-    // Hlavní smyčka - přijímání nových klientů
+    RemoteUser previous;
+    if (!remote_users.upsert(user.id, user.username.str(), link, user, previous)) {
+        LOG_INFO("Uživatel " << user.username << " připojen na uzlu " << static_cast<int>(owner_node(user.id)));
+        announce_remote(user.room, make_join_frames(user.id, user.color, user.username, USER_JOIN_CONNECTED,
+                                                    " se připojil k chatu"));
+    } else if (previous.room.str() != user.room.str()) {
+        announce_remote(previous.room, make_leave_frames(user.id, user.username, USER_LEAVE_ROOM,
+                                                         " odešel do místnosti " + user.room.str()));
+        announce_remote(user.room, make_join_frames(user.id, user.color, user.username, USER_JOIN_ROOM,
+                                                    " vstoupil do místnosti " + user.room.str()));
+    }
+    return true;
+}
+
+bool handle_node_user_left(uint64_t, BinaryReader& payload) {
+    uint32_t id;
+    if (!payload.read_u32(id)) {
+        return false;
+    }
+    RemoteUser user;
+    if (remote_users.remove(id, user)) {
+        LOG_INFO("Uživatel " << user.username << " odpojen z uzlu " << static_cast<int>(owner_node(id)));
+        announce_remote(user.room, make_leave_frames(id, user.username, USER_LEAVE_DISCONNECTED, " opustil chat"));
+    }
+    return true;
+}
+
+bool handle_node_chat(uint64_t, BinaryReader& payload) {
+    MessageView room_name;
+    MessageView name;
+    uint32_t sender;
+    uint8_t color;
+    uint32_t time;
+    if (!read_short_text(payload, room_name) || !payload.read_u32(sender) || !payload.read_u8(color) ||
+        !payload.read_u32(time) || !read_short_text(payload, name)) {
+        return false;
+    }
+    RoomPtr room = rooms.find(room_name.str());
+    if (!room) {
+        return true;  // Místnost tu nemá žádné členy
+    }
+    ColorCode color_code(std::to_string(color));
+    publish_chat(room, sender, color, color_code, Username(name.data, name.size), time, payload.rest());
+    return true;
+}
+
+bool handle_node_pm(uint64_t, BinaryReader& payload) {
+    uint32_t sender;
+    uint8_t color;
+    MessageView name;
+    MessageView target;
+    if (!payload.read_u32(sender) || !payload.read_u8(color) || !read_short_text(payload, name) ||
+        !read_short_text(payload, target)) {
+        return false;
+    }
+    MessageView pm_message = payload.rest();
+    ClientsLock lock;
+    const ClientInfo* client = clients.find_name(target.data, target.size);
+    if (client == nullptr) {
+        LOG_DEBUG("Soukromá zpráva z uzlu " << static_cast<int>(owner_node(sender)) << " pro odpojeného " << target);
+        return true;
+    }
+    deliver_pm(*client, sender, Username(name.data, name.size), pm_message);
+    return true;
+}
+
+/**
+ * Tabulka obsluh zpráv od uzlů indexovaná bytem typu (HELLO je zvlášť)
+ */
+std::vector<NodeHandler> make_node_handlers() {
+    std::vector<NodeHandler> table(static_cast<size_t>(NodeMessage::PM) + 1, nullptr);
+    table[static_cast<size_t>(NodeMessage::USER)] = handle_node_user;
+    table[static_cast<size_t>(NodeMessage::USER_LEFT)] = handle_node_user_left;
+    table[static_cast<size_t>(NodeMessage::CHAT)] = handle_node_chat;
+    table[static_cast<size_t>(NodeMessage::PM)] = handle_node_pm;
+    return table;
+}
+
+const std::vector<NodeHandler> NODE_HANDLERS = make_node_handlers();
+
+/**
+ * Obsluha příchozího spojení od jiného uzlu (vlastní vlákno)
+ * První zpráva musí být HELLO s heslem clusteru, uzel dostane HELLO zpět (podle něj odchozí
+ * strana pozná, kam patří /pm). Po přerušení se zapomenou jeho uživatelé.
+ */
+void handle_node_link(int fd) {
+    uint64_t link = next_node_link.fetch_add(1);
+    FrameDecoder decoder(max_message_size + NODE_MESSAGE_OVERHEAD);
+    ServerMetrics& metrics = ServerMetrics::instance();
+    int remote = 0;  // Id uzlu z HELLO
+    MessageView message;
     while (true) {
-        // Přijetí nového klienta
-        int client = accept(server_fd, nullptr, nullptr);
+        FrameDecoder::Status status = decoder.next(message);
+        if (status == FrameDecoder::TOO_LARGE) {
+            LOG_ERROR("Příliš dlouhá zpráva od uzlu " << remote);
+            break;
+        }
+        if (status == FrameDecoder::NEED_MORE) {
+            ssize_t received = decoder.fill(fd, 0);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) break;
+            continue;
+        }
+        if (message.empty()) {
+            continue;
+        }
+        uint8_t type = static_cast<uint8_t>(message.data[0]);
+        BinaryReader payload(message.data + 1, message.size - 1);
+        if (remote == 0) {
+            uint8_t version;
+            uint8_t id;
+            if (type != static_cast<uint8_t>(NodeMessage::HELLO) || !payload.read_u8(version) || !payload.read_u8(id) ||
+                version != NODE_PROTOCOL_VERSION || id == 0 || id == node_id ||
+                !node_secret_matches(payload.rest(), node_secret)) {
+                LOG_WARN("Odmítnuto spojení uzlu s neplatným HELLO (verze, id nebo heslo)");
+                break;
+            }
+            remote = id;
+            FrameBatch reply;
+            reply.push(make_node_hello(node_id, node_secret));
+            if (!reply.send_all(fd)) break;
+            LOG_INFO("Uzel " << remote << " připojen");
+            continue;
+        }
+        metrics.add(Counter::NODE_FRAMES_RECEIVED);
+        NodeHandler handler = type < NODE_HANDLERS.size() ? NODE_HANDLERS[type] : nullptr;
+        if (handler == nullptr || !handler(link, payload)) {
+            LOG_WARN("Neplatná zpráva typu " << static_cast<int>(type) << " od uzlu " << remote);
+            break;
+        }
+    }
+    
+    std::vector<RemoteUser> removed;
+    remote_users.remove_link(link, removed);
+    for (const RemoteUser& user : removed) {
+        announce_remote(user.room, make_leave_frames(user.id, user.username, USER_LEAVE_DISCONNECTED, " opustil chat"));
+    }
+    if (remote != 0) {
+        LOG_WARN("Spojení od uzlu " << remote << " ukončeno, odebráno uživatelů: " << removed.size());
+    }
+    close(fd);
+}
+
+void node_listener_thread(int listener) {
+    while (wait_for_accept(listener)) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EINTR && errno != EAGAIN) LOG_ERROR("Chyba při přijímání spojení od uzlu");
+            continue;
+        }
+        apply_socket_tuning(fd, socket_profile(NODE_LINK_SOCKET_PROFILE));
+        try {
+            std::thread(handle_node_link, fd).detach();
+        } catch (const std::system_error&) {
+            LOG_ERROR("Nelze vytvořit vlákno pro spojení od uzlu");
+            close(fd);
+        }
+    }
+    close(listener);
+}
+
+/**
+ * Nové odchozí spojení k uzlu: HELLO a úplný seznam místních uživatelů
+ * Fronta se zveřejní pod zámkem klientů - registrace, odhlášení i změny
+ * místností se posílají pod ním, takže žádná nepředběhne snímek.
+ */
+void on_node_link_connected(NodeLink& link, const std::shared_ptr<OutboundQueue>& queue) {
+    std::vector<Frame> frames;
+    frames.push_back(make_node_hello(node_id, node_secret));
+    ClientsLock lock;
+    clients.for_each([&frames](const ClientInfo& client) {
+        frames.push_back(make_node_user_frame(client));
+    });
+    queue->push_all(frames);
+    link.attach(queue);
+}
+
+/**
+ * Spuštění federace - port pro příchozí spojení uzlů a odchozí spojení (--peer)
+ */
+bool start_federation() {
+    if (node_port > 0) {
+        int listener = open_listener("node", node_port, 16, false, node_bind);
+        if (listener < 0) {
+            return false;
+        }
+        std::thread(node_listener_thread, listener).detach();
+    }
+    for (const auto& link : node_links) {
+        link->start(on_node_link_connected);
+    }
+    return true;
+}
+
+// Ohlášený veřejný UDP endpoint peera
+struct RendezvousEntry {
+    sockaddr_storage addr;
+    socklen_t length;
+    double expires;
+};
+
+void send_datagram(int fd, const std::string& text, const sockaddr_storage& addr, socklen_t length) {
+    sendto(fd, text.data(), text.size(), MSG_NOSIGNAL, reinterpret_cast<const sockaddr*>(&addr), length);
+}
+
+/**
+ * UDP rendezvous pro P2P hole punching (rendezvous.h)
+ * Jediné vlákno, tabulka endpointů proto nepotřebuje zámek. Endpoint je
+ * adresa, ze které datagram přišel - po překladu NATem, jak ji uvidí i peer.
+ * Registrace vyžaduje token z /rvtoken, LOOKUP se přijme jen z endpointu
+ * registrovaného tazatele (jinak se datagram zahodí bez odpovědi).
+ */
+void rendezvous_thread(int fd) {
+    std::unordered_map<std::string, RendezvousEntry> endpoints;
+    double next_cleanup = 0;
+    char buffer[RENDEZVOUS_DATAGRAM_SIZE];
+    while (wait_for_accept(fd)) {
+        RendezvousEntry from;
+        from.length = sizeof(from.addr);
+        ssize_t received = recvfrom(fd, buffer, sizeof(buffer), MSG_DONTWAIT,
+                                    reinterpret_cast<sockaddr*>(&from.addr), &from.length);
+        if (received < 0) {
+            if (errno != EINTR && errno != EAGAIN) LOG_ERROR("Chyba při příjmu rendezvous datagramu");
+            continue;
+        }
+        ServerMetrics::instance().add(Counter::RENDEZVOUS_REQUESTS);
+        double now = coarse_monotonic_seconds();
+        if (now >= next_cleanup) {
+            for (auto it = endpoints.begin(); it != endpoints.end();) {
+                it = it->second.expires <= now ? endpoints.erase(it) : std::next(it);
+            }
+            next_cleanup = now + RENDEZVOUS_TTL;
+        }
         
+        std::string message(buffer, static_cast<size_t>(received));
+        std::string from_endpoint = address_text(from.addr) + ":" + std::to_string(address_port(from.addr));
+        if (message.compare(0, 9, RENDEZVOUS_REGISTER) == 0 && message.size() > 9) {
+            // REGISTER:<jméno>:<token>
+            size_t colon = message.rfind(':');
+            std::string name = colon != std::string::npos && colon > 9 ? message.substr(9, colon - 9) : std::string();
+            if (name.empty() || !rendezvous_tokens.accept(name, message.substr(colon + 1), now)) {
+                // Odpověď je kratší než žádost - nezesiluje podvržený zdroj
+                send_datagram(fd, RENDEZVOUS_DENIED + Username(name).str(), from.addr, from.length);
+                continue;
+            }
+            if (endpoints.size() >= RENDEZVOUS_ENTRY_LIMIT && endpoints.find(name) == endpoints.end()) {
+                continue;
+            }
+            from.expires = now + RENDEZVOUS_TTL;
+            endpoints[name] = from;
+            send_datagram(fd, RENDEZVOUS_ENDPOINT + from_endpoint, from.addr, from.length);
+        } else if (message.compare(0, 7, RENDEZVOUS_LOOKUP) == 0) {
+            // LOOKUP:<hledaný>:<tazatel> - oba dostanou endpoint toho druhého
+            size_t colon = message.find(':', 7);
+            std::string target = message.substr(7, colon == std::string::npos ? std::string::npos : colon - 7);
+            std::string requester = colon == std::string::npos ? std::string() : message.substr(colon + 1);
+            auto known = endpoints.find(requester);
+            if (known == endpoints.end() || known->second.expires <= now || !same_endpoint(known->second.addr, from.addr)) {
+                continue;
+            }
+            auto found = endpoints.find(target);
+            if (found == endpoints.end() || found->second.expires <= now) {
+                send_datagram(fd, RENDEZVOUS_UNKNOWN + target, from.addr, from.length);
+                continue;
+            }
+            const RendezvousEntry& entry = found->second;
+            send_datagram(fd, RENDEZVOUS_PEER + target + ":" + address_text(entry.addr) + ":" +
+                          std::to_string(address_port(entry.addr)), from.addr, from.length);
+            send_datagram(fd, RENDEZVOUS_INTRODUCE + Username(requester).str() + ":" + from_endpoint,
+                          entry.addr, entry.length);
+            LOG_DEBUG("Rendezvous: " << requester << " (" << from_endpoint << ") hledá " << target);
+        }
+    }
+    close(fd);
+}
+
+bool start_rendezvous(int port) {
+    // Převzatý socket ponechá i frontu datagramů; tabulku endpointů si peery obnoví registrací
+    int fd = take_inherited_socket("rendezvous", port);
+    if (fd < 0) {
+        int family;
+        fd = open_udp_socket(port, family);
+        if (fd < 0) {
+            return false;
+        }
+    }
+    owned_sockets.push_back(HandoverSocket{"rendezvous", fd});
+    std::thread(rendezvous_thread, fd).detach();
+    return true;
+}
+
+/**
+ * Okamžité hodnoty stavu serveru pro /metrics
+ */
+std::vector<std::pair<MetricInfo, double>> admin_gauges() {
+    size_t client_count;
+    {
+        ClientsLock lock;
+        client_count = clients.size();
+    }
+    FramePool& pool = FramePool::instance();
+    std::vector<std::pair<MetricInfo, double>> gauges;
+    gauges.push_back({{"chat_clients", "Registered clients", 1}, static_cast<double>(client_count)});
+    gauges.push_back({{"chat_connections", "Admitted connections including pending handshakes", 1},
+                      static_cast<double>(admitted_connections.load(std::memory_order_relaxed))});
+    gauges.push_back({{"chat_rooms", "Existing rooms", 1}, static_cast<double>(rooms.list().size())});
+    gauges.push_back({{"chat_detached_sessions", "Dropped sessions waiting for resumption", 1},
+                      static_cast<double>(detached_sessions.size())});
+    size_t connected_links = 0;
+    for (const auto& link : node_links) {
+        if (link->connected()) ++connected_links;
+    }
+    gauges.push_back({{"chat_remote_users", "Users connected to other cluster nodes", 1},
+                      static_cast<double>(remote_users.size())});
+    gauges.push_back({{"chat_node_links_connected", "Established links to other cluster nodes", 1},
+                      static_cast<double>(connected_links)});
+    const SocketTuning& tuning = effective_socket_tuning;
+    gauges.push_back({{"chat_socket_nodelay", "TCP_NODELAY on client sockets (1 = on)", 1}, tuning.nodelay ? 1.0 : 0.0});
+    gauges.push_back({{"chat_socket_send_buffer_bytes", "SO_SNDBUF of client sockets as set by the kernel", 1},
+                      static_cast<double>(tuning.send_buffer)});
+    gauges.push_back({{"chat_socket_receive_buffer_bytes", "SO_RCVBUF of client sockets as set by the kernel", 1},
+                      static_cast<double>(tuning.receive_buffer)});
+    gauges.push_back({{"chat_socket_keepalive_idle_seconds", "TCP keepalive idle time of client sockets (0 = off)", 1},
+                      tuning.keepalive ? static_cast<double>(tuning.keepalive_idle) : 0.0});
+    gauges.push_back({{"chat_socket_notsent_lowat_bytes", "TCP_NOTSENT_LOWAT of client sockets (0 = unlimited)", 1},
+                      static_cast<double>(tuning.notsent_lowat)});
+    gauges.push_back({{"chat_socket_busy_poll_microseconds", "SO_BUSY_POLL of client sockets (0 = off)", 1},
+                      static_cast<double>(tuning.busy_poll)});
+    gauges.push_back({{"chat_uptime_seconds", "Seconds since server start", 1}, monotonic_seconds() - start_time});
+    gauges.push_back({{"chat_frame_pool_allocated", "Frame buffers allocated by the pool", 1}, static_cast<double>(pool.allocated())});
+    gauges.push_back({{"chat_frame_pool_reused", "Frame buffers reused from the pool", 1}, static_cast<double>(pool.reused())});
+    gauges.push_back({{"chat_log_dropped", "Log lines dropped because of full buffers", 1}, static_cast<double>(AsyncLog::instance().dropped())});
+    gauges.push_back({{"chat_journal_written", "Messages written to the journal", 1}, static_cast<double>(journal.written())});
+    gauges.push_back({{"chat_journal_dropped", "Messages dropped by the journal", 1}, static_cast<double>(journal.dropped())});
+    return gauges;
+}
+
+/**
+ * Obsluha jednoho HTTP požadavku admin portu (GET /metrics)
+ */
+void serve_admin_request(int fd) {
+    timeval timeout{};
+    timeout.tv_sec = ADMIN_RECEIVE_TIMEOUT;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    // Stačí první řádek požadavku; hlavičky se dočítají do prázdného řádku
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < ADMIN_REQUEST_SIZE) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return;
+        request.append(buffer, received);
+    }
+    
+    std::string status = "200 OK";
+    std::string body;
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 14, "GET /metrics?") == 0) {
+        body = ServerMetrics::instance().render_prometheus(admin_gauges());
+    } else {
+        status = "404 Not Found";
+        body = "Dostupné je jen GET /metrics\n";
+    }
+    std::string response = "HTTP/1.0 " + status + "\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n\r\n" + body;
+    size_t offset = 0;
+    while (offset < response.size()) {
+        ssize_t sent = send(fd, response.data() + offset, response.size() - offset, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return;
+        offset += static_cast<size_t>(sent);
+    }
+}
+
+/**
+ * Vlákno admin portu - požadavky obsluhuje postupně (scrape je občasný)
+ */
+void admin_thread(int listener) {
+    while (wait_for_accept(listener)) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EINTR && errno != EAGAIN) LOG_ERROR("Chyba při přijímání spojení na admin portu");
+            continue;
+        }
+        serve_admin_request(fd);
+        close(fd);
+    }
+    close(listener);
+}
+
+/**
+ * Spuštění admin portu (jen na loopbacku - metriky nejsou pro klienty chatu)
+ */
+bool start_admin_server(int port) {
+    int listener = take_inherited_socket("admin", port);
+    if (listener >= 0) {
+        owned_sockets.push_back(HandoverSocket{"admin", listener});
+        std::thread(admin_thread, listener).detach();
+        return true;
+    }
+    listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listener < 0) {
+        return false;
+    }
+    int opt = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, 16) < 0) {
+        close(listener);
+        return false;
+    }
+    owned_sockets.push_back(HandoverSocket{"admin", listener});
+    std::thread(admin_thread, listener).detach();
+    return true;
+}
+
+/**
+ * Accept shard threaded režimu - vlastní SO_REUSEPORT listener na vlastním jádře
+ * Vlákna obsluhy přijatých klientů dědí jeho připnutí, shard tak vlastní
+ * svůj díl spojení. Kapacita se kontroluje dřív, než vlákno vznikne.
+ */
+void accept_shard(int listener, unsigned int index) {
+    pin_current_thread(index);
+    while (wait_for_accept(listener)) {
+        sockaddr_storage peer;
+        socklen_t peer_len = sizeof(peer);
+        int client = accept4(listener, reinterpret_cast<sockaddr*>(&peer), &peer_len, SOCK_CLOEXEC);
         if (client < 0) {
-            std::cerr << "Chyba při přijímání klienta" << std::endl;
+            // EAGAIN: spojení převzal jiný shard nebo proces se stejným socketem
+            if (errno != EINTR && errno != EAGAIN) LOG_ERROR("Chyba při přijímání klienta");
+            continue;
+        }
+        if (!admit_connection(client)) {
             continue;
         }
         
         // Vytvoření nového vlákna pro obsluhu klienta
-        std::thread(handle_client, client).detach();
+        try {
+            std::thread(handle_client, client, peer).detach();
+        } catch (const std::system_error&) {
+            LOG_ERROR("Nelze vytvořit vlákno pro klienta " << client);
+            close(client);
+            release_connection();
+        }
+    }
+    close(listener);
+}
+
+/**
+ * Spuštění serveru v threaded režimu s shard_count accept shardy
+ */
+int run_threaded_server(unsigned int shard_count) {
+    if (shard_count == 1) {
+        pin_threads = false;  // Jediný shard by na jedno jádro připnul všechna vlákna obsluhy
+    }
+    std::vector<int> listeners;
+    for (unsigned int i = 0; i < shard_count; ++i) {
+        int listener = create_reuseport_listener();
+        if (listener < 0) {
+            std::cerr << "Chyba při vytváření naslouchacího socketu: " << std::strerror(errno) << std::endl;
+            for (int fd : listeners) close(fd);
+            return 1;
+        }
+        listeners.push_back(listener);
+    }
+    
+    // Spuštění vlákna časovačů (heartbeat, handshake a idle timeout)
+    std::thread timers(timer_thread);
+    timers.detach();
+    std::cout << "Časovače spojení spuštěny" << std::endl;
+    std::cout << "Režim: thread-per-client, accept shardů: " << shard_count << std::endl;
+    
+    for (unsigned int i = 0; i < listeners.size(); ++i) {
+        std::thread(accept_shard, listeners[i], i).detach();
+    }
+    serve_until_shutdown();
+}
+
+/**
+ * Historie nově vytvořené místnosti ze žurnálu
+ * Žurnál drží textové rámce; binární klienti je dostanou jako systémové
+ * zprávy (id odesílatelů z minulého běhu serveru neplatí).
+ */
+void restore_room_history(const std::string& room, HistoryRing<HistoryEntry>& history) {
+    std::vector<Frame> frames = journal.restore(room, history.capacity());
+    for (const Frame& frame : frames) {
+        // "[COLOR:XX][HH:MM] jméno: zpráva" -> "[HH:MM] jméno: zpráva"
+        size_t start = FRAME_HEADER_SIZE;
+        if (frame->compare(start, 7, "[COLOR:") == 0) {
+            size_t end = frame->find(']', start);
+            if (end != std::string::npos) start = end + 1;
+        }
+        HistoryEntry entry = {{frame, make_system_frame(0, frame->substr(start))}, 0, 0, Username(), 0};
+        history.push(entry);
+    }
+    if (!frames.empty()) {
+        LOG_INFO("Místnost " << room << ": obnoveno " << frames.size() << " zpráv ze žurnálu");
+    }
+}
+
+/**
+ * Výpis nápovědy k parametrům příkazové řádky
+ */
+void print_usage(const char* program) {
+    std::cerr << "Použití: " << program << " [--mode threaded|epoll|uring] [--reactors N] [--accept-threads N]"
+              << " [--backlog N] [--no-pinning]"
+              << " [--queue-size N] [--queue-policy drop-oldest|drop-client|backpressure]"
+              << " [--idle-timeout SECONDS] [--log-level debug|info|warn|error]"
+              << " [--compress-threshold BYTES] [--no-compression] [--history N]"
+              << " [--journal DIR] [--journal-fsync none|interval|batch] [--admin-port PORT]"
+              << " [--resume-window SECONDS] [--port PORT]"
+              << " [--node-id 1-255] [--node-port PORT] [--node-bind ADDRESS] [--node-secret SECRET]"
+              << " [--peer HOST:PORT]..."
+              << " [--rendezvous-port PORT] [--socket-profile chat|bulk|fanout]"
+              << " [--max-clients N] [--max-message-size BYTES] [--buffer-size BYTES]"
+              << " [--heartbeat-interval SECONDS] [--heartbeat-timeout SECONDS]"
+              << " [--rate-limit N] [--rate-window SECONDS] [--drain-timeout SECONDS]"
+              << " [--handover-socket PATH] [--config FILE]" << std::endl;
+}
+
+/**
+ * Hlavní funkce serveru
+ */
+int main(int argc, char* argv[]) {
+    unsigned int reactor_count = std::thread::hardware_concurrency();
+    if (reactor_count == 0) reactor_count = 1;
+    unsigned int accept_threads = reactor_count;
+    
+    // Konfigurační soubor se rozvine do parametrů, příkazová řádka ho přepíše
+    std::vector<std::string> args;
+    std::string config_error;
+    if (!expand_config_args(argc, argv, args, config_error)) {
+        std::cerr << "Chyba konfigurace: " << config_error << std::endl;
+        return 1;
+    }
+    std::vector<char*> arg_pointers;
+    for (std::string& arg : args) {
+        arg_pointers.push_back(&arg[0]);
+    }
+    argc = static_cast<int>(arg_pointers.size());
+    argv = arg_pointers.data();
+    
+    // Zpracování parametrů příkazové řádky
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--mode" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "threaded") {
+                server_mode = ServerMode::THREADED;
+            } else if (mode == "epoll") {
+                server_mode = ServerMode::EPOLL;
+            } else if (mode == "uring") {
+                server_mode = ServerMode::URING;
+            } else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--reactors" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value <= 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            reactor_count = static_cast<unsigned int>(value);
+        } else if (arg == "--accept-threads" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value <= 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            accept_threads = static_cast<unsigned int>(value);
+        } else if (arg == "--backlog" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value <= 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            listen_backlog = value;
+        } else if (arg == "--no-pinning") {
+            pin_threads = false;
+        } else if (arg == "--queue-size" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value <= 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            outbound_queue_capacity = static_cast<size_t>(value);
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            LogLevel level;
+            if (!parse_log_level(argv[++i], level)) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            AsyncLog::instance().set_level(level);
+        } else if (arg == "--idle-timeout" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            idle_timeout = value;
+        } else if (arg == "--compress-threshold" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            compression_threshold = static_cast<size_t>(value);
+        } else if (arg == "--history" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            history_capacity = static_cast<size_t>(value);
+        } else if (arg == "--admin-port" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value < 0 || value > 65535) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            admin_port = value;
+        } else if (arg == "--resume-window" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            detached_sessions.set_ttl(value);
+        } else if (arg == "--port" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value <= 0 || value > 65535) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            server_port = value;
+        } else if (arg == "--node-id" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value <= 0 || value > 255) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            node_id = static_cast<uint8_t>(value);
+        } else if (arg == "--node-port" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value <= 0 || value > 65535) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            node_port = value;
+        } else if (arg == "--node-bind" && i + 1 < argc) {
+            node_bind = argv[++i];
+        } else if (arg == "--node-secret" && i + 1 < argc) {
+            node_secret = argv[++i];
+            if (node_secret.empty() || node_secret.size() > NODE_SECRET_MAX_LENGTH) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--rendezvous-port" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value <= 0 || value > 65535) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            rendezvous_port = value;
+        } else if (arg == "--socket-profile" && i + 1 < argc) {
+            if (!parse_socket_profile(argv[++i], client_socket_profile)) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            client_socket_tuning = socket_profile(client_socket_profile);
+        } else if (arg == "--max-clients" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value <= 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            max_clients = value;
+        } else if (arg == "--max-message-size" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value <= 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            max_message_size = static_cast<uint32_t>(value);
+        } else if (arg == "--buffer-size" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value < 512) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            buffer_size = static_cast<size_t>(value);
+        } else if (arg == "--heartbeat-interval" && i + 1 < argc) {
+            double value = std::atof(argv[++i]);
+            if (value <= 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            heartbeat_interval = value;
+        } else if (arg == "--heartbeat-timeout" && i + 1 < argc) {
+            double value = std::atof(argv[++i]);
+            if (value <= 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            heartbeat_timeout = value;
+        } else if (arg == "--rate-limit" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value <= 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            rate_limit_messages = value;
+        } else if (arg == "--rate-window" && i + 1 < argc) {
+            double value = std::atof(argv[++i]);
+            if (value <= 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            rate_limit_window = value;
+        } else if (arg == "--drain-timeout" && i + 1 < argc) {
+            double value = std::atof(argv[++i]);
+            if (value < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            drain_timeout = value;
+        } else if (arg == "--handover-socket" && i + 1 < argc) {
+            handover_path = argv[++i];
+        } else if (arg == "--peer" && i + 1 < argc) {
+            std::string host;
+            int port;
+            if (!parse_node_address(argv[++i], host, port)) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            node_links.emplace_back(new NodeLink(host, port));
+        } else if (arg == "--journal" && i + 1 < argc) {
+            journal_directory = argv[++i];
+        } else if (arg == "--journal-fsync" && i + 1 < argc) {
+            if (!parse_journal_sync(argv[++i], journal_sync)) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--no-compression") {
+            compression_allowed = false;
+        } else if (arg == "--queue-policy" && i + 1 < argc) {
+            std::string policy = argv[++i];
+            if (policy == "drop-oldest") {
+                outbound_policy = OverflowPolicy::DROP_OLDEST;
+            } else if (policy == "drop-client") {
+                outbound_policy = OverflowPolicy::DROP_CLIENT;
+            } else if (policy == "backpressure") {
+                outbound_policy = OverflowPolicy::BACKPRESSURE;
+            } else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if ((node_port > 0 || !node_links.empty()) && node_id == 0) {
+        std::cerr << "Uzel clusteru potřebuje --node-id (1-255, v clusteru jedinečné)" << std::endl;
+        return 1;
+    }
+    if ((node_port > 0 || !node_links.empty()) && node_secret.empty()) {
+        std::cerr << "Uzel clusteru potřebuje --node-secret (stejné na všech uzlech)" << std::endl;
+        return 1;
+    }
+    // Signály ukončení čte hlavní vlákno přes signalfd - blokované ve všech vláknech
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    shutdown_event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    
+    // Restart bez výpadku - převzetí socketů běžícího procesu (ten zároveň
+    // pozastaví žurnál, takže se dál otevírá úplný)
+    size_t inherited_count = 0;
+    if (!handover_path.empty()) {
+        std::string error;
+        handover_connection = receive_handover(handover_path, inherited_sockets, error);
+        inherited_count = inherited_sockets.size();
+        if (!error.empty()) {
+            std::cerr << "Nelze převzít sockety z " << handover_path << ": " << error << std::endl;
+            return 1;
+        }
+    }
+    
+    // Id klientů jsou jedinečná v celém clusteru (horní byte = id uzlu)
+    next_client_id.store((static_cast<uint32_t>(node_id) << NODE_ID_SHIFT) + 1);
+    rooms.set_history_capacity(history_capacity);
+    
+    // Hrubé hodiny pro časová razítka a rate limit (obnova každých 10 ms)
+    CoarseClock::instance().start(COARSE_CLOCK_TICK);
+    
+    // Logování za běhu jde přes flusher, banner níže se vypisuje přímo
+    AsyncLog::instance().start();
+    
+    // Žurnál zpráv - historie místností se obnoví při jejich vytvoření
+    if (!journal_directory.empty()) {
+        if (!journal.open(journal_directory, journal_sync)) {
+            std::cerr << "Nelze otevřít žurnál v " << journal_directory << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        rooms.set_restore_history(restore_room_history);
+    }
+    
+    // Metriky za běhu (Prometheus text na http://127.0.0.1:PORT/metrics)
+    start_time = monotonic_seconds();
+    if (admin_port > 0 && !start_admin_server(admin_port)) {
+        std::cerr << "Nelze otevřít admin port " << admin_port << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    
+    std::cout << "========================================" << std::endl;
+    std::cout << "C++ Chat Server" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "Server naslouchá na portu " << server_port << "..." << std::endl;
+    std::cout << "Maximální počet klientů: " << max_clients << ", backlog: " << listen_backlog << std::endl;
+    std::cout << "Maximální délka zprávy: " << max_message_size << " B" << std::endl;
+    std::cout << "Heartbeat interval: " << heartbeat_interval << "s, Timeout: " << heartbeat_timeout << "s" << std::endl;
+    std::cout << "Handshake timeout: " << HANDSHAKE_TIMEOUT << "s, idle timeout: ";
+    if (idle_timeout > 0) std::cout << idle_timeout << "s" << std::endl; else std::cout << "vypnuto" << std::endl;
+    std::cout << "Rate limit: " << rate_limit_messages << " zpráv za " << rate_limit_window << "s" << std::endl;
+    std::cout << "Odchozí fronta: " << outbound_queue_capacity << " zpráv na klienta" << std::endl;
+    std::cout << "Historie místností: " << history_capacity << " zpráv" << std::endl;
+    std::cout << "Žurnál zpráv: " << (journal_directory.empty() ? std::string("vypnuto") : journal_directory) << std::endl;
+    std::cout << "Obnovení relace: ";
+    if (detached_sessions.enabled()) std::cout << detached_sessions.ttl() << "s po výpadku" << std::endl; else std::cout << "vypnuto" << std::endl;
+    std::cout << "Metriky: ";
+    if (admin_port > 0) std::cout << "http://127.0.0.1:" << admin_port << "/metrics" << std::endl; else std::cout << "vypnuto" << std::endl;
+    std::cout << "Cluster: ";
+    if (node_id > 0) {
+        std::cout << "uzel " << static_cast<int>(node_id) << ", port uzlů ";
+        if (node_port > 0) std::cout << node_port; else std::cout << "vypnuto";
+        std::cout << ", ostatních uzlů: " << node_links.size() << std::endl;
+    } else {
+        std::cout << "vypnuto" << std::endl;
+    }
+    std::cout << "P2P rendezvous (UDP): ";
+    if (rendezvous_port > 0) std::cout << "port " << rendezvous_port << std::endl; else std::cout << "vypnuto" << std::endl;
+    int rejected_options = 0;
+    effective_socket_tuning = probe_socket_tuning(client_socket_tuning, &rejected_options);
+    std::cout << "Socket profil: " << socket_profile_name(client_socket_profile) << " ("
+              << format_socket_tuning(effective_socket_tuning) << ")";
+    if (rejected_options > 0) std::cout << ", odmítnuto voleb: " << rejected_options;
+    std::cout << std::endl;
+    std::cout << "Komprese (deflate): ";
+    if (compression_allowed) std::cout << "od " << compression_threshold << " B" << std::endl; else std::cout << "vypnuto" << std::endl;
+    std::cout << "Restart bez výpadku: ";
+    if (!handover_path.empty()) {
+        std::cout << handover_path;
+        if (handover_connection >= 0) std::cout << " (převzato socketů: " << inherited_count << ")";
+        std::cout << std::endl;
+    } else {
+        std::cout << "vypnuto" << std::endl;
+    }
+    std::cout << "Vyprázdnění spojení při ukončení: " << drain_timeout << "s" << std::endl;
+    std::cout << "Kompatibilní s: Python klienty" << std::endl;
+    std::cout << "Stiskněte Ctrl+C pro ukončení" << std::endl;
+    std::cout << "========================================" << std::endl;
+    
+    if (rendezvous_port > 0 && !start_rendezvous(rendezvous_port)) {
+        std::cerr << "Nelze otevřít rendezvous port " << rendezvous_port << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    if (node_id > 0 && !start_federation()) {
+        std::cerr << "Nelze otevřít port uzlů " << node_port << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    
+    if (server_mode == ServerMode::EPOLL) {
+        return run_epoll_server(reactor_count);
+    }
+    if (server_mode == ServerMode::URING) {
+        return run_uring_server(reactor_count);
     }
     
-    // Tento kód se nikdy neprovede, ale pro úplnost:
-    close(server_fd);
-    return 0;
+    return run_threaded_server(accept_threads);
 }
@@ -0,0 +1,333 @@
+/**
+ * Metriky serveru za běhu (čítače a histogramy latencí)
+ *
+ * Každé vlákno zapisuje do vlastního shardu (čítače + histogramy), takže
+ * měření na horké cestě je jen relaxed load + store do vlastní cache line -
+ * vlákna spolu nesoupeří o žádnou sdílenou proměnnou ani zámek. Shard si
+ * vlákno zaregistruje při prvním zápisu (stejně jako buffer AsyncLog),
+ * po jeho skončení se hodnoty přičtou do souhrnu ukončených vláken
+ * a shard se použije pro další vlákno (threaded režim vlákna často střídá).
+ *
+ * Snímek (snapshot) sečte všechny shardy pod zámkem registru; zámek drží
+ * jen čtenář a registrace/ukončení vlákna, nikdy zápis metriky.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef SERVER_METRICS_H
+#define SERVER_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "latency_histogram.h"
+
+// Čítače (monotónně rostoucí)
+enum class Counter : size_t {
+    MESSAGES_IN,             // Přijaté zprávy (chat, příkazy, PONG)
+    BYTES_IN,                // Přijaté byty (včetně hlaviček)
+    MESSAGES_OUT,            // Odeslané rámce
+    BYTES_OUT,               // Odeslané byty (po kompresi)
+    BROADCASTS,              // Broadcasty do místnosti
+    BROADCAST_RECIPIENTS,    // Doručení broadcastů do front příjemců
+    RATE_LIMITED,            // Zprávy odmítnuté rate limitem
+    QUEUE_DROPPED,           // Zprávy zahozené z plné fronty (drop-oldest)
+    QUEUE_FULL_DISCONNECTS,  // Odpojení kvůli plné frontě
+    HEARTBEAT_TIMEOUTS,      // Odpojení kvůli neodpovězenému PING
+    IDLE_TIMEOUTS,           // Odpojení kvůli nečinnosti
+    HANDSHAKE_TIMEOUTS,      // Spojení bez úvodní zprávy
+    CONNECTIONS_ACCEPTED,    // Přijatá spojení
+    CONNECTIONS_REJECTED,    // Spojení odmítnutá nad kapacitou serveru
+    SESSIONS_DETACHED,       // Relace uložené po výpadku spojení (resume token)
+    SESSIONS_RESUMED,        // Relace obnovené novým spojením
+    NODE_FRAMES_FORWARDED,   // Rámce zařazené do spojení s ostatními uzly
+    NODE_FRAMES_DROPPED,     // Rámce pro ostatní uzly zahozené (spojení nenavázané nebo plné)
+    NODE_FRAMES_RECEIVED,    // Rámce přijaté od ostatních uzlů
+    RENDEZVOUS_REQUESTS,     // Datagramy UDP rendezvous (P2P hole punching)
+    SOCKET_OPTIONS_REJECTED, // Volby socket profilu, které jádro odmítlo
+    COUNT
+};
+
+// Histogramy (latence v ns, fan-out v počtu příjemců)
+enum class Histogram : size_t {
+    RECEIVE_TO_BROADCAST,  // Od recv() zprávy po zařazení do front příjemců
+    CLIENTS_LOCK_WAIT,     // Čekání na zámek seznamu klientů
+    CLIENTS_LOCK_HOLD,     // Držení zámku seznamu klientů
+    BROADCAST_FANOUT,      // Počet příjemců jednoho broadcastu
+    COUNT
+};
+
+const size_t METRIC_COUNTERS = static_cast<size_t>(Counter::COUNT);
+const size_t METRIC_HISTOGRAMS = static_cast<size_t>(Histogram::COUNT);
+const size_t METRIC_CACHE_LINE = 64;
+
+struct MetricInfo {
+    const char* name;   // Název v Prometheus formátu
+    const char* help;
+    double scale;       // Převod na jednotku názvu (ns -> s), u čítačů 1
+};
+
+const MetricInfo COUNTER_INFO[METRIC_COUNTERS] = {
+    {"chat_messages_received_total", "Messages received from clients", 1},
+    {"chat_received_bytes_total", "Bytes received from clients", 1},
+    {"chat_messages_sent_total", "Frames written to client sockets", 1},
+    {"chat_sent_bytes_total", "Bytes written to client sockets", 1},
+    {"chat_broadcasts_total", "Room broadcasts", 1},
+    {"chat_broadcast_recipients_total", "Broadcast frames queued to recipients", 1},
+    {"chat_rate_limited_total", "Messages rejected by the rate limit", 1},
+    {"chat_queue_dropped_total", "Frames dropped from full outbound queues", 1},
+    {"chat_queue_full_disconnects_total", "Clients disconnected because of a full outbound queue", 1},
+    {"chat_heartbeat_timeouts_total", "Clients disconnected for not answering PING", 1},
+    {"chat_idle_timeouts_total", "Clients disconnected for inactivity", 1},
+    {"chat_handshake_timeouts_total", "Connections closed without a handshake", 1},
+    {"chat_connections_accepted_total", "Accepted connections", 1},
+    {"chat_connections_rejected_total", "Connections rejected over server capacity", 1},
+    {"chat_sessions_detached_total", "Sessions kept for resumption after a dropped connection", 1},
+    {"chat_sessions_resumed_total", "Detached sessions resumed by a new connection", 1},
+    {"chat_node_frames_forwarded_total", "Frames queued to links with other cluster nodes", 1},
+    {"chat_node_frames_dropped_total", "Frames for other cluster nodes dropped (link down or full)", 1},
+    {"chat_node_frames_received_total", "Frames received from other cluster nodes", 1},
+    {"chat_rendezvous_requests_total", "Datagrams received by the P2P rendezvous service", 1},
+    {"chat_socket_options_rejected_total", "Socket profile options rejected by the kernel", 1},
+};
+
+const MetricInfo HISTOGRAM_INFO[METRIC_HISTOGRAMS] = {
+    {"chat_receive_to_broadcast_seconds", "Time from recv() of a chat message to queueing it for all recipients", 1e-9},
+    {"chat_clients_lock_wait_seconds", "Time spent waiting for the clients mutex", 1e-9},
+    {"chat_clients_lock_hold_seconds", "Time the clients mutex was held", 1e-9},
+    {"chat_broadcast_fanout", "Recipients of one broadcast", 1},
+};
+
+// Monotónní čas v ns pro měření latencí
+inline uint64_t metrics_now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * Sečtený stav všech vláken
+ */
+struct MetricsSnapshot {
+    uint64_t counters[METRIC_COUNTERS];
+    LatencyHistogram histograms[METRIC_HISTOGRAMS];
+
+    MetricsSnapshot() {
+        for (size_t i = 0; i < METRIC_COUNTERS; ++i) counters[i] = 0;
+    }
+
+    uint64_t counter(Counter counter) const {
+        return counters[static_cast<size_t>(counter)];
+    }
+
+    const LatencyHistogram& histogram(Histogram histogram) const {
+        return histograms[static_cast<size_t>(histogram)];
+    }
+};
+
+class ServerMetrics {
+public:
+    /**
+     * Sdílený registr procesu
+     * Nikdy se neruší - detached vlákna mohou zapisovat i při ukončení.
+     */
+    static ServerMetrics& instance() {
+        static ServerMetrics* metrics = new ServerMetrics();
+        return *metrics;
+    }
+
+    void add(Counter counter, uint64_t value = 1) {
+        std::atomic<uint64_t>& slot = local_shard()->counters[static_cast<size_t>(counter)];
+        slot.store(slot.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    void record(Histogram histogram, uint64_t value) {
+        local_shard()->histograms[static_cast<size_t>(histogram)].record(value);
+    }
+
+    MetricsSnapshot snapshot() {
+        MetricsSnapshot result;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < METRIC_COUNTERS; ++i) {
+            result.counters[i] = retired_.counters[i];
+        }
+        for (size_t i = 0; i < METRIC_HISTOGRAMS; ++i) {
+            result.histograms[i].merge(retired_.histograms[i]);
+        }
+        for (Shard* shard : shards_) {
+            add_shard(*shard, result);
+        }
+        return result;
+    }
+
+    /**
+     * Snímek v textovém formátu Prometheus (histogramy jako summary s kvantily)
+     * @param gauges Okamžité hodnoty (název, popis, hodnota) doplněné volajícím
+     */
+    std::string render_prometheus(const std::vector<std::pair<MetricInfo, double>>& gauges) {
+        MetricsSnapshot current = snapshot();
+        std::string out;
+        char line[256];
+        for (size_t i = 0; i < METRIC_COUNTERS; ++i) {
+            append_header(out, COUNTER_INFO[i], "counter");
+            std::snprintf(line, sizeof(line), "%s %llu\n", COUNTER_INFO[i].name,
+                          static_cast<unsigned long long>(current.counters[i]));
+            out += line;
+        }
+        for (const auto& gauge : gauges) {
+            append_header(out, gauge.first, "gauge");
+            std::snprintf(line, sizeof(line), "%s %.17g\n", gauge.first.name, gauge.second);
+            out += line;
+        }
+        static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+        for (size_t i = 0; i < METRIC_HISTOGRAMS; ++i) {
+            const MetricInfo& info = HISTOGRAM_INFO[i];
+            const LatencyHistogram& histogram = current.histograms[i];
+            append_header(out, info, "summary");
+            for (double quantile : QUANTILES) {
+                std::snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %.9g\n", info.name, quantile,
+                              histogram.percentile(quantile * 100.0) * info.scale);
+                out += line;
+            }
+            std::snprintf(line, sizeof(line), "%s_sum %.9g\n%s_count %llu\n", info.name,
+                          histogram.mean() * histogram.count() * info.scale, info.name,
+                          static_cast<unsigned long long>(histogram.count()));
+            out += line;
+        }
+        return out;
+    }
+
+private:
+    // Shard jednoho vlákna; čítače mají vlastní cache line (odsazení od
+    // sousedních alokací), histogramy jsou samostatné alokace
+    struct Shard {
+        char padding_before[METRIC_CACHE_LINE];
+        std::atomic<uint64_t> counters[METRIC_COUNTERS];
+        char padding_after[METRIC_CACHE_LINE];
+        SharedHistogram histograms[METRIC_HISTOGRAMS];
+
+        Shard() {
+            for (size_t i = 0; i < METRIC_COUNTERS; ++i) counters[i].store(0, std::memory_order_relaxed);
+        }
+    };
+
+    // Součty ukončených vláken (mění se jen pod zámkem)
+    struct Totals {
+        uint64_t counters[METRIC_COUNTERS];
+        LatencyHistogram histograms[METRIC_HISTOGRAMS];
+
+        Totals() {
+            for (size_t i = 0; i < METRIC_COUNTERS; ++i) counters[i] = 0;
+        }
+    };
+
+    // Při ukončení vlákna přičte jeho shard do souhrnu a uvolní ho pro další vlákno
+    struct ShardOwner {
+        Shard* shard;
+
+        ShardOwner() : shard(nullptr) {}
+        ~ShardOwner() {
+            if (shard != nullptr) ServerMetrics::instance().retire(shard);
+        }
+    };
+
+    ServerMetrics() {}
+    ServerMetrics(const ServerMetrics&);
+    ServerMetrics& operator=(const ServerMetrics&);
+
+    Shard* local_shard() {
+        static thread_local ShardOwner owner;
+        if (owner.shard == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!free_.empty()) {
+                owner.shard = free_.back();
+                free_.pop_back();
+            } else {
+                owner.shard = new Shard();
+            }
+            shards_.push_back(owner.shard);
+        }
+        return owner.shard;
+    }
+
+    void retire(Shard* shard) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < METRIC_COUNTERS; ++i) {
+            retired_.counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+            shard->counters[i].store(0, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < METRIC_HISTOGRAMS; ++i) {
+            shard->histograms[i].snapshot_into(retired_.histograms[i]);
+            shard->histograms[i].reset();
+        }
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            if (shards_[i] == shard) {
+                shards_[i] = shards_.back();
+                shards_.pop_back();
+                break;
+            }
+        }
+        free_.push_back(shard);
+    }
+
+    static void add_shard(const Shard& shard, MetricsSnapshot& out) {
+        for (size_t i = 0; i < METRIC_COUNTERS; ++i) {
+            out.counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < METRIC_HISTOGRAMS; ++i) {
+            shard.histograms[i].snapshot_into(out.histograms[i]);
+        }
+    }
+
+    static void append_header(std::string& out, const MetricInfo& info, const char* type) {
+        out += "# HELP ";
+        out += info.name;
+        out += ' ';
+        out += info.help;
+        out += "\n# TYPE ";
+        out += info.name;
+        out += ' ';
+        out += type;
+        out += '\n';
+    }
+
+    std::mutex mutex_;
+    std::vector<Shard*> shards_;  // Shardy živých vláken
+    std::vector<Shard*> free_;    // Shardy ukončených vláken k dalšímu použití
+    Totals retired_;
+};
+
+/**
+ * Zámek s měřením doby čekání a držení (RAII)
+ */
+class MeteredLock {
+public:
+    MeteredLock(std::mutex& mutex, Histogram wait, Histogram hold) : mutex_(mutex), hold_(hold) {
+        uint64_t start = metrics_now_ns();
+        mutex_.lock();
+        acquired_ = metrics_now_ns();
+        ServerMetrics::instance().record(wait, acquired_ - start);
+    }
+
+    ~MeteredLock() {
+        uint64_t released = metrics_now_ns();
+        mutex_.unlock();
+        ServerMetrics::instance().record(hold_, released - acquired_);
+    }
+
+private:
+    MeteredLock(const MeteredLock&);
+    MeteredLock& operator=(const MeteredLock&);
+
+    std::mutex& mutex_;
+    Histogram hold_;
+    uint64_t acquired_;
+};
+
+#endif // SERVER_METRICS_H
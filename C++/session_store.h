@@ -0,0 +1,142 @@
+/**
+ * Odpojené relace čekající na obnovení (resume token)
+ *
+ * Klient dostane při vstupu do chatu náhodný token. Když spojení spadne
+ * (ne po /quit), server uloží záznam relace pod tímto tokenem na omezenou
+ * dobu; nové spojení se stejným tokenem relaci převezme (id, barva,
+ * místnost) a nechá si přehrát jen zmeškané zprávy. Token se dá použít
+ * jen jednou - po obnovení dostane klient nový.
+ *
+ * Záznamy prošlé po ttl se uklízí líně při dalším odpojení nebo obnovení
+ * (doba platnosti je pro všechny stejná, stačí tedy fronta podle času).
+ * Počet odpojených relací je omezený, nejstarší se při zaplnění zahodí.
+ *
+ * Všechny metody zamykají vlastní zámek (nikdy nevolají ven).
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef SESSION_STORE_H
+#define SESSION_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+const size_t SESSION_TOKEN_BYTES = 16;  // 128 bitů náhody, hex = 32 znaků
+
+template <typename Record>
+class SessionStore {
+public:
+    SessionStore(double ttl, size_t capacity) : ttl_(ttl), capacity_(capacity) {}
+
+    /**
+     * Doba platnosti odpojené relace (sekundy, 0 = obnovení vypnuto)
+     * Nastavit před spuštěním serveru.
+     */
+    void set_ttl(double ttl) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ttl_ = ttl;
+    }
+
+    double ttl() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return ttl_;
+    }
+
+    bool enabled() const {
+        return ttl() > 0;
+    }
+
+    /**
+     * Nový náhodný token (hex)
+     */
+    std::string issue_token() {
+        static const char DIGITS[] = "0123456789abcdef";
+        std::string token;
+        token.reserve(SESSION_TOKEN_BYTES * 2);
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < SESSION_TOKEN_BYTES; i += 4) {
+            uint32_t bits = random_();
+            for (int j = 0; j < 8; ++j) {
+                token += DIGITS[bits & 0xF];
+                bits >>= 4;
+            }
+        }
+        return token;
+    }
+
+    /**
+     * Uložení relace odpojeného klienta pod jeho tokenem
+     */
+    void detach(const std::string& token, const Record& record, double now) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ttl_ <= 0 || token.empty()) {
+            return;
+        }
+        expire_locked(now);
+        while (!expiry_.empty() && entries_.size() >= capacity_) {
+            drop_oldest_locked();
+        }
+        Entry& entry = entries_[token];
+        entry.record = record;
+        entry.expires = now + ttl_;
+        expiry_.push_back(std::make_pair(entry.expires, token));
+    }
+
+    /**
+     * Převzetí odpojené relace (token tím zanikne)
+     * @return false pokud token neexistuje nebo vypršel
+     */
+    bool resume(const std::string& token, double now, Record& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        expire_locked(now);
+        auto found = entries_.find(token);
+        if (found == entries_.end()) {
+            return false;
+        }
+        out = found->second.record;
+        entries_.erase(found);
+        return true;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+private:
+    struct Entry {
+        Record record;
+        double expires;
+    };
+
+    void expire_locked(double now) {
+        while (!expiry_.empty() && expiry_.front().first <= now) {
+            drop_oldest_locked();
+        }
+    }
+
+    // Záznam fronty je neplatný, pokud byl token mezitím obnoven nebo znovu uložen
+    void drop_oldest_locked() {
+        auto found = entries_.find(expiry_.front().second);
+        if (found != entries_.end() && found->second.expires == expiry_.front().first) {
+            entries_.erase(found);
+        }
+        expiry_.pop_front();
+    }
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::deque<std::pair<double, std::string>> expiry_;  // (vypršení, token) podle času
+    std::random_device random_;
+    double ttl_;
+    size_t capacity_;
+};
+
+#endif // SESSION_STORE_H
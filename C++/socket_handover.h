@@ -0,0 +1,188 @@
+/**
+ * Předání naslouchacích socketů novému procesu (restart bez výpadku)
+ *
+ * Běžící server naslouchá na unixovém socketu (--handover-socket CESTA).
+ * Nový proces spuštěný se stejnou cestou se k němu nejdřív připojí a
+ * dostane všechny naslouchací sockety (SCM_RIGHTS) - jde o tytéž sockety
+ * v jádře, takže spojení čekající ve frontě accept() se neztratí a port
+ * není ani na okamžik zavřený. Nový proces sockety převezme, spustí se a
+ * potvrdí převzetí; teprve pak starý proces přestane přijímat a vyprázdní
+ * svá spojení. Pokud nový proces skončí před potvrzením, starý běží dál.
+ *
+ * Zpráva se sockety nese v datech jejich role, jedna na řádek ve stejném
+ * pořadí jako deskriptory:
+ *   client\nclient\nnode\nadmin\nrendezvous\n
+ * Potvrzení je jeden byte HANDOVER_ACK.
+ *
+ * Kompatibilní s: C++11, Linux
+ */
+
+#ifndef SOCKET_HANDOVER_H
+#define SOCKET_HANDOVER_H
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+const size_t HANDOVER_MAX_SOCKETS = 250;       // Jádro přenese nejvýš 253 fd v jedné zprávě
+const size_t HANDOVER_MANIFEST_SIZE = 4096;
+const char HANDOVER_ACK = 'K';
+
+struct HandoverSocket {
+    std::string role;   // client, node, admin, rendezvous
+    int fd;
+};
+
+inline bool handover_address(const std::string& path, sockaddr_un& addr) {
+    if (path.size() >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+/**
+ * Unixový socket pro příští předání (starý soubor se nahradí)
+ * @return fd nebo -1 (errno)
+ */
+inline int open_handover_listener(const std::string& path) {
+    sockaddr_un addr;
+    if (!handover_address(path, addr)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Odeslání socketů novému procesu
+ */
+inline bool send_handover(int connection, const std::vector<HandoverSocket>& sockets) {
+    if (sockets.empty() || sockets.size() > HANDOVER_MAX_SOCKETS) {
+        errno = EINVAL;
+        return false;
+    }
+    std::string manifest;
+    for (const HandoverSocket& socket : sockets) {
+        manifest += socket.role + "\n";
+    }
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * sockets.size()));
+    iovec iov{const_cast<char*>(manifest.data()), manifest.size()};
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * sockets.size());
+    int* fds = reinterpret_cast<int*>(CMSG_DATA(header));
+    for (size_t i = 0; i < sockets.size(); ++i) {
+        fds[i] = sockets[i].fd;
+    }
+    ssize_t sent;
+    do {
+        sent = sendmsg(connection, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == static_cast<ssize_t>(manifest.size());
+}
+
+/**
+ * Převzetí socketů od běžícího procesu
+ * Bez běžícího procesu (cesta neexistuje, nikdo nenaslouchá) vrátí -1
+ * s prázdným error - server pak sockety vytvoří sám.
+ * @return spojení se starým procesem (pro potvrzení) nebo -1
+ */
+inline int receive_handover(const std::string& path, std::vector<HandoverSocket>& sockets, std::string& error) {
+    sockaddr_un addr;
+    if (!handover_address(path, addr)) {
+        error = std::strerror(errno);
+        return -1;
+    }
+    int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connection < 0) {
+        error = std::strerror(errno);
+        return -1;
+    }
+    if (connect(connection, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        if (errno != ENOENT && errno != ECONNREFUSED) error = std::strerror(errno);
+        close(connection);
+        return -1;
+    }
+
+    char manifest[HANDOVER_MANIFEST_SIZE];
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * HANDOVER_MAX_SOCKETS));
+    iovec iov{manifest, sizeof(manifest)};
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+    ssize_t received;
+    do {
+        received = recvmsg(connection, &message, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+
+    std::vector<int> fds;
+    for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+            size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const int* data = reinterpret_cast<const int*>(CMSG_DATA(header));
+            fds.insert(fds.end(), data, data + count);
+        }
+    }
+    std::vector<std::string> roles;
+    std::string text(manifest, received > 0 ? static_cast<size_t>(received) : 0);
+    for (size_t start = 0, end; (end = text.find('\n', start)) != std::string::npos; start = end + 1) {
+        roles.push_back(text.substr(start, end - start));
+    }
+    if (received <= 0 || (message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || roles.size() != fds.size()) {
+        for (int fd : fds) close(fd);
+        error = "neplatná zpráva se sockety";
+        close(connection);
+        return -1;
+    }
+    for (size_t i = 0; i < fds.size(); ++i) {
+        sockets.push_back(HandoverSocket{roles[i], fds[i]});
+    }
+    return connection;
+}
+
+/**
+ * Čekání starého procesu na potvrzení převzetí
+ * @return false pokud nový proces skončil nebo nepotvrdil do limitu
+ */
+inline bool wait_handover_ack(int connection, int timeout_ms) {
+    pollfd pfd{connection, POLLIN, 0};
+    int ready;
+    do {
+        ready = poll(&pfd, 1, timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    char ack = 0;
+    return ready > 0 && recv(connection, &ack, 1, 0) == 1 && ack == HANDOVER_ACK;
+}
+
+inline bool send_handover_ack(int connection) {
+    return send(connection, &HANDOVER_ACK, 1, MSG_NOSIGNAL) == 1;
+}
+
+#endif // SOCKET_HANDOVER_H
@@ -0,0 +1,187 @@
+/**
+ * Profily nastavení TCP socketů (server, klient i P2P peer)
+ *
+ * Profil určuje volby, které se nastaví každému spojení hned po accept()
+ * nebo connect():
+ *   chat   - interaktivní chat s nízkou latencí: TCP_NODELAY, malý
+ *            TCP_NOTSENT_LOWAT (neodeslaná data čekají v aplikaci, ne
+ *            v jádře), busy-poll při čekání na data, keepalive
+ *   bulk   - přenos souborů mezi peery: TCP_NODELAY (rámec jde jedním
+ *            syscallem, Nagle by zdržel jen potvrzení bloků), velké
+ *            buffery pro plné okno na linkách s velkým RTT, keepalive
+ *   fanout - server s mnoha klienty: TCP_NODELAY, pevně malé buffery
+ *            (paměť jádra na spojení je omezená, frontu drží aplikace),
+ *            nízký TCP_NOTSENT_LOWAT, keepalive pro odhalení mrtvých klientů
+ *
+ * Jádro některé hodnoty upraví (SO_SNDBUF/SO_RCVBUF zdvojnásobí, busy-poll
+ * nad hodnotu net.core.busy_read vyžaduje CAP_NET_ADMIN) - skutečný stav
+ * vrátí read_socket_tuning().
+ *
+ * Kompatibilní s: C++11, Linux
+ */
+
+#ifndef SOCKET_TUNING_H
+#define SOCKET_TUNING_H
+
+#include <string>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+enum class SocketProfile {
+    CHAT,
+    BULK,
+    FANOUT
+};
+
+struct SocketTuning {
+    bool nodelay;
+    int send_buffer;          // SO_SNDBUF v bajtech, 0 = automatické ladění jádra
+    int receive_buffer;       // SO_RCVBUF v bajtech, 0 = automatické ladění jádra
+    bool keepalive;
+    int keepalive_idle;       // Sekundy nečinnosti před první sondou
+    int keepalive_interval;   // Sekundy mezi sondami
+    int keepalive_count;      // Počet nezodpovězených sond do odpojení
+    int notsent_lowat;        // TCP_NOTSENT_LOWAT v bajtech, 0 = bez omezení
+    int busy_poll;            // SO_BUSY_POLL v µs, 0 = vypnuto
+};
+
+inline const char* socket_profile_name(SocketProfile profile) {
+    switch (profile) {
+        case SocketProfile::CHAT: return "chat";
+        case SocketProfile::BULK: return "bulk";
+        case SocketProfile::FANOUT: return "fanout";
+    }
+    return "?";
+}
+
+inline bool parse_socket_profile(const std::string& name, SocketProfile& out) {
+    if (name == "chat") {
+        out = SocketProfile::CHAT;
+    } else if (name == "bulk") {
+        out = SocketProfile::BULK;
+    } else if (name == "fanout") {
+        out = SocketProfile::FANOUT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline SocketTuning socket_profile(SocketProfile profile) {
+    switch (profile) {
+        case SocketProfile::CHAT:
+            return SocketTuning{true, 0, 0, true, 60, 10, 5, 16 * 1024, 50};
+        case SocketProfile::BULK:
+            return SocketTuning{true, 4 * 1024 * 1024, 4 * 1024 * 1024, true, 60, 10, 5, 0, 0};
+        case SocketProfile::FANOUT:
+            return SocketTuning{true, 64 * 1024, 32 * 1024, true, 60, 10, 5, 16 * 1024, 0};
+    }
+    return SocketTuning{true, 0, 0, false, 0, 0, 0, 0, 0};
+}
+
+/**
+ * Nastavení voleb profilu na socket
+ * Nenulové hodnoty se nastaví, nulové zůstanou ve výchozím stavu jádra.
+ * @return počet voleb, které jádro odmítlo (spojení funguje i tak)
+ */
+inline int apply_socket_tuning(int fd, const SocketTuning& tuning) {
+    int failed = 0;
+    int on = tuning.nodelay ? 1 : 0;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) < 0) failed++;
+    if (tuning.send_buffer > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &tuning.send_buffer, sizeof(tuning.send_buffer)) < 0) {
+        failed++;
+    }
+    if (tuning.receive_buffer > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &tuning.receive_buffer, sizeof(tuning.receive_buffer)) < 0) {
+        failed++;
+    }
+    if (tuning.keepalive) {
+        on = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on)) < 0 ||
+            setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &tuning.keepalive_idle, sizeof(int)) < 0 ||
+            setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &tuning.keepalive_interval, sizeof(int)) < 0 ||
+            setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &tuning.keepalive_count, sizeof(int)) < 0) {
+            failed++;
+        }
+    }
+    if (tuning.notsent_lowat > 0 &&
+        setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &tuning.notsent_lowat, sizeof(int)) < 0) {
+        failed++;
+    }
+#ifdef SO_BUSY_POLL
+    if (tuning.busy_poll > 0 && setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &tuning.busy_poll, sizeof(int)) < 0) {
+        failed++;
+    }
+#endif
+    return failed;
+}
+
+/**
+ * Skutečné hodnoty voleb na socketu (po úpravách jádra)
+ */
+inline SocketTuning read_socket_tuning(int fd) {
+    SocketTuning tuning{false, 0, 0, false, 0, 0, 0, 0, 0};
+    int value = 0;
+    socklen_t length = sizeof(value);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, &length) == 0) tuning.nodelay = value != 0;
+    length = sizeof(int);
+    getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &tuning.send_buffer, &length);
+    length = sizeof(int);
+    getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &tuning.receive_buffer, &length);
+    length = sizeof(value);
+    if (getsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &value, &length) == 0) tuning.keepalive = value != 0;
+    length = sizeof(int);
+    getsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &tuning.keepalive_idle, &length);
+    length = sizeof(int);
+    getsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &tuning.keepalive_interval, &length);
+    length = sizeof(int);
+    getsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &tuning.keepalive_count, &length);
+    length = sizeof(int);
+    getsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &tuning.notsent_lowat, &length);
+    if (tuning.notsent_lowat < 0) tuning.notsent_lowat = 0;   // Výchozí UINT_MAX = bez omezení
+#ifdef SO_BUSY_POLL
+    length = sizeof(int);
+    getsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &tuning.busy_poll, &length);
+#endif
+    return tuning;
+}
+
+/**
+ * Hodnoty, které profil na tomto systému skutečně dá (zkušební socket)
+ * Volby se nastaví na nepřipojený TCP socket a přečtou zpět - pro výpis
+ * a metriky bez čekání na první spojení.
+ */
+inline SocketTuning probe_socket_tuning(const SocketTuning& tuning, int* failed = nullptr) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return SocketTuning{false, 0, 0, false, 0, 0, 0, 0, 0};
+    }
+    int rejected = apply_socket_tuning(fd, tuning);
+    if (failed != nullptr) *failed = rejected;
+    SocketTuning effective = read_socket_tuning(fd);
+    close(fd);
+    return effective;
+}
+
+/**
+ * Jednořádkový popis voleb pro výpis při startu / připojení
+ */
+inline std::string format_socket_tuning(const SocketTuning& tuning) {
+    std::string text = std::string("TCP_NODELAY=") + (tuning.nodelay ? "1" : "0") +
+                       " SO_SNDBUF=" + std::to_string(tuning.send_buffer) +
+                       " SO_RCVBUF=" + std::to_string(tuning.receive_buffer) + " keepalive=";
+    if (tuning.keepalive) {
+        text += std::to_string(tuning.keepalive_idle) + "/" + std::to_string(tuning.keepalive_interval) + "/" +
+                std::to_string(tuning.keepalive_count);
+    } else {
+        text += "0";
+    }
+    text += " TCP_NOTSENT_LOWAT=" + std::to_string(tuning.notsent_lowat) +
+            " SO_BUSY_POLL=" + std::to_string(tuning.busy_poll);
+    return text;
+}
+
+#endif // SOCKET_TUNING_H
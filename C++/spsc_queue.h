@@ -0,0 +1,76 @@
+/**
+ * Fronta jednoho producenta a jednoho konzumenta bez zámku
+ *
+ * Kruhový buffer s kapacitou mocniny 2. Producent zapisuje jen tail_,
+ * konzument jen head_ (každý na vlastní cache line), výměna dat je
+ * release/acquire - žádná zamčená instrukce ani mutex. Uspání konzumenta
+ * řeší volající (např. eventfd), fronta sama nikdy neblokuje.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+const size_t SPSC_CACHE_LINE = 64;
+
+template <typename T>
+class SpscQueue {
+public:
+    // Kapacita se zaokrouhlí nahoru na mocninu 2
+    explicit SpscQueue(size_t capacity) : head_(0), tail_(0) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    /**
+     * Vložení prvku (jen producent)
+     * @return false pokud je fronta plná
+     */
+    bool try_push(T value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) > mask_) {
+            return false;
+        }
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Vyzvednutí prvku (jen konzument)
+     * @return false pokud je fronta prázdná
+     */
+    bool try_pop(T& out) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        out = std::move(slots_[head & mask_]);
+        slots_[head & mask_] = T();
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    SpscQueue(const SpscQueue&);
+    SpscQueue& operator=(const SpscQueue&);
+
+    std::vector<T> slots_;
+    size_t mask_;
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> head_;  // Další prvek ke čtení (konzument)
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> tail_;  // Další volný slot (producent)
+};
+
+#endif // SPSC_QUEUE_H
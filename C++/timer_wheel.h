@@ -0,0 +1,221 @@
+/**
+ * Hierarchické časovací kolo (hierarchical timer wheel)
+ *
+ * Časovače jsou intrusivní (žijí ve struktuře spojení), přidání, přeplánování
+ * i zrušení je O(1). Nejnižší úroveň má 256 slotů po jednom ticku, každá další
+ * 64 slotů, jejichž časovače se při přetočení nižší úrovně přesunou níž
+ * (kaskáda). Čtyři úrovně pokrývají 2^26 ticků (při ticku 100 ms ~77 dní).
+ *
+ * Kolo samo nezamyká - používá ho buď jediný vlastník (reaktor), nebo
+ * volající drží zámek. Callbacky se volají uvnitř advance() a smí rušit
+ * či plánovat libovolné časovače včetně vlastního.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+class TimerWheel {
+public:
+    /**
+     * Jeden časovač; callback se nastavuje jednou, plánovat ho lze opakovaně
+     * Časovač nesmí být zničen, dokud je naplánovaný (jinak ho zruší destruktor).
+     */
+    class Timer {
+    public:
+        Timer() : prev_(nullptr), next_(nullptr), expires_(0), wheel_(nullptr) {}
+        explicit Timer(std::function<void()> callback)
+            : prev_(nullptr), next_(nullptr), expires_(0), wheel_(nullptr), callback_(callback) {}
+        ~Timer() {
+            if (wheel_ != nullptr) wheel_->cancel(*this);
+        }
+
+        void set_callback(std::function<void()> callback) {
+            callback_ = callback;
+        }
+
+        bool armed() const {
+            return wheel_ != nullptr;
+        }
+
+    private:
+        Timer(const Timer&);
+        Timer& operator=(const Timer&);
+
+        friend class TimerWheel;
+        Timer* prev_;
+        Timer* next_;
+        uint64_t expires_;      // Tick, ve kterém časovač vyprší
+        TimerWheel* wheel_;     // Kolo, ve kterém je naplánovaný (nullptr = nenaplánovaný)
+        std::function<void()> callback_;
+    };
+
+    TimerWheel(double tick_seconds, double now)
+        : tick_(tick_seconds), current_(to_tick(now)), count_(0) {
+        for (size_t i = 0; i < ROOT_SLOTS; ++i) init_list(root_[i]);
+        for (size_t level = 0; level < LEVELS; ++level) {
+            for (size_t i = 0; i < LEVEL_SLOTS; ++i) init_list(levels_[level][i]);
+        }
+    }
+
+    size_t size() const {
+        return count_;
+    }
+
+    /**
+     * Naplánování (nebo přeplánování) časovače za delay sekund od now
+     */
+    void schedule(Timer& timer, double now, double delay) {
+        if (timer.wheel_ != nullptr) cancel(timer);
+        uint64_t expires = to_tick(now + (delay > 0 ? delay : 0));
+        timer.expires_ = expires > current_ ? expires : current_ + 1;
+        timer.wheel_ = this;
+        place(timer);
+        ++count_;
+    }
+
+    void cancel(Timer& timer) {
+        if (timer.wheel_ != this) return;
+        unlink(timer);
+        timer.wheel_ = nullptr;
+        --count_;
+    }
+
+    /**
+     * Posun kola do času now a spuštění callbacků vypršelých časovačů
+     */
+    void advance(double now) {
+        uint64_t target = to_tick(now);
+        while (current_ < target) {
+            ++current_;
+            size_t index = current_ & ROOT_MASK;
+            if (index == 0) {
+                cascade();
+            }
+            run_slot(root_[index]);
+        }
+    }
+
+    /**
+     * Doba do nejbližšího ticku s časovačem v milisekundách (-1 = nic naplánováno)
+     * Časovače ve vyšších úrovních se počítají jako vypršení na konci kořenové
+     * úrovně, kdy se přesunou níž.
+     */
+    int next_timeout_ms(double now) const {
+        if (count_ == 0) return -1;
+        uint64_t ticks = ROOT_SLOTS - (current_ & ROOT_MASK);
+        for (uint64_t offset = 1; offset < ticks; ++offset) {
+            const Timer& head = root_[(current_ + offset) & ROOT_MASK];
+            if (head.next_ != &head) {
+                ticks = offset;
+                break;
+            }
+        }
+        double remaining = (current_ + ticks) * tick_ - now;
+        if (remaining <= 0) return 0;
+        return static_cast<int>(remaining * 1000.0) + 1;
+    }
+
+private:
+    static const size_t ROOT_BITS = 8;
+    static const size_t LEVEL_BITS = 6;
+    static const size_t LEVELS = 3;
+    static const size_t ROOT_SLOTS = size_t(1) << ROOT_BITS;
+    static const size_t LEVEL_SLOTS = size_t(1) << LEVEL_BITS;
+    static const uint64_t ROOT_MASK = ROOT_SLOTS - 1;
+    static const uint64_t LEVEL_MASK = LEVEL_SLOTS - 1;
+    static const uint64_t MAX_DELTA = (uint64_t(1) << (ROOT_BITS + LEVELS * LEVEL_BITS)) - 1;
+
+    uint64_t to_tick(double seconds) const {
+        return static_cast<uint64_t>(seconds / tick_);
+    }
+
+    static void init_list(Timer& head) {
+        head.prev_ = &head;
+        head.next_ = &head;
+    }
+
+    static void unlink(Timer& timer) {
+        timer.prev_->next_ = timer.next_;
+        timer.next_->prev_ = timer.prev_;
+        timer.prev_ = nullptr;
+        timer.next_ = nullptr;
+    }
+
+    static void append(Timer& head, Timer& timer) {
+        timer.prev_ = head.prev_;
+        timer.next_ = &head;
+        head.prev_->next_ = &timer;
+        head.prev_ = &timer;
+    }
+
+    // Zařazení do slotu podle vzdálenosti od aktuálního ticku
+    void place(Timer& timer) {
+        uint64_t delta = timer.expires_ - current_;
+        if (delta > MAX_DELTA) {
+            timer.expires_ = current_ + MAX_DELTA;
+            delta = MAX_DELTA;
+        }
+        if (delta < ROOT_SLOTS) {
+            append(root_[timer.expires_ & ROOT_MASK], timer);
+            return;
+        }
+        for (size_t level = 0; level < LEVELS; ++level) {
+            size_t shift = ROOT_BITS + (level + 1) * LEVEL_BITS;
+            if (level + 1 == LEVELS || delta < (uint64_t(1) << shift)) {
+                size_t index = (timer.expires_ >> (shift - LEVEL_BITS)) & LEVEL_MASK;
+                append(levels_[level][index], timer);
+                return;
+            }
+        }
+    }
+
+    // Přesun časovačů z vyšších úrovní po přetočení kořenové úrovně
+    void cascade() {
+        for (size_t level = 0; level < LEVELS; ++level) {
+            size_t shift = ROOT_BITS + level * LEVEL_BITS;
+            size_t index = (current_ >> shift) & LEVEL_MASK;
+            Timer& head = levels_[level][index];
+            while (head.next_ != &head) {
+                Timer& timer = *head.next_;
+                unlink(timer);
+                place(timer);
+            }
+            if (index != 0) break;
+        }
+    }
+
+    // Vypršení slotu - seznam se nejdřív přesune stranou, callback smí
+    // rušit i plánovat ostatní časovače (včetně těch ze stejného slotu)
+    void run_slot(Timer& slot) {
+        if (slot.next_ == &slot) return;
+        Timer expired;
+        init_list(expired);
+        expired.next_ = slot.next_;
+        expired.prev_ = slot.prev_;
+        slot.next_->prev_ = &expired;
+        slot.prev_->next_ = &expired;
+        init_list(slot);
+
+        while (expired.next_ != &expired) {
+            Timer& timer = *expired.next_;
+            unlink(timer);
+            timer.wheel_ = nullptr;
+            --count_;
+            if (timer.callback_) timer.callback_();
+        }
+    }
+
+    double tick_;
+    uint64_t current_;
+    size_t count_;
+    Timer root_[ROOT_SLOTS];
+    Timer levels_[LEVELS][LEVEL_SLOTS];
+};
+
+#endif // TIMER_WHEEL_H
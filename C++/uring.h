@@ -0,0 +1,300 @@
+/**
+ * Tenká obálka io_uring nad přímými syscally (bez liburing)
+ *
+ * Kruh se namapuje z jádra (SQ/CQ ringy + pole SQE), požadavky se plní
+ * do SQE a odešlou se všechny najednou jedním io_uring_enter(), který
+ * zároveň počká na dokončení (s timeoutem přes IORING_ENTER_EXT_ARG).
+ * Kruh smí používat jen vlákno, které ho vytvořilo (IORING_SETUP_SINGLE_ISSUER).
+ *
+ * Součástí je kruh poskytnutých bufferů (IORING_REGISTER_PBUF_RING):
+ * multishot recv si z něj buffer vybere samo jádro, takže přijímací
+ * buffer není přidělený každému spojení, ale jen tomu, kdo právě přijímá.
+ *
+ * Vyžaduje Linux 6.0+ (multishot recv, pbuf ring), jinak init() selže.
+ *
+ * Kompatibilní s: C++11, Linux
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const unsigned URING_REQUIRED_FEATURES = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_EXT_ARG;
+
+class IoUring {
+public:
+    IoUring()
+        : fd_(-1), ring_(nullptr), ring_size_(0), sqes_(nullptr), sqes_size_(0),
+          sq_head_(nullptr), sq_tail_(nullptr), sq_array_(nullptr), sq_mask_(0), sq_entries_(0),
+          cq_head_(nullptr), cq_tail_(nullptr), cqes_(nullptr), cq_mask_(0),
+          sq_local_tail_(0), submitted_tail_(0),
+          buffers_(nullptr), buffers_size_(0), buffer_memory_(nullptr), buffer_memory_size_(0),
+          buffer_count_(0), buffer_size_(0), buffer_group_(0) {}
+
+    ~IoUring() {
+        if (buffers_ != nullptr) {
+            io_uring_buf_reg reg;
+            std::memset(&reg, 0, sizeof(reg));
+            reg.bgid = buffer_group_;
+            syscall(__NR_io_uring_register, fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+            munmap(buffers_, buffers_size_);
+            munmap(buffer_memory_, buffer_memory_size_);
+        }
+        if (sqes_ != nullptr) munmap(sqes_, sqes_size_);
+        if (ring_ != nullptr) munmap(ring_, ring_size_);
+        if (fd_ >= 0) close(fd_);
+    }
+
+    /**
+     * Vytvoření kruhu s entries SQE (CQ má dvojnásobek)
+     * @return false při chybě (errno nastaveno, ENOSYS pro staré jádro)
+     */
+    bool init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0 && errno == EINVAL) {
+            // Starší jádro bez SINGLE_ISSUER / COOP_TASKRUN
+            std::memset(&params, 0, sizeof(params));
+            fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        }
+        if (fd_ < 0) {
+            return false;
+        }
+        if ((params.features & URING_REQUIRED_FEATURES) != URING_REQUIRED_FEATURES) {
+            errno = ENOSYS;
+            return false;
+        }
+
+        // SQ i CQ ring v jednom mapování (IORING_FEAT_SINGLE_MMAP)
+        size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        ring_size_ = sq_size > cq_size ? sq_size : cq_size;
+        ring_ = static_cast<char*>(mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING));
+        if (ring_ == MAP_FAILED) {
+            ring_ = nullptr;
+            return false;
+        }
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        sq_head_ = reinterpret_cast<unsigned*>(ring_ + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(ring_ + params.sq_off.tail);
+        sq_array_ = reinterpret_cast<unsigned*>(ring_ + params.sq_off.array);
+        sq_mask_ = *reinterpret_cast<unsigned*>(ring_ + params.sq_off.ring_mask);
+        sq_entries_ = params.sq_entries;
+        cq_head_ = reinterpret_cast<unsigned*>(ring_ + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(ring_ + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(ring_ + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(ring_ + params.cq_off.cqes);
+        sq_local_tail_ = submitted_tail_ = *sq_tail_;
+        return true;
+    }
+
+    /**
+     * Volné SQE (vynulované); při plné frontě se nejdřív odešlou čekající
+     * @return nullptr jen pokud odeslání selhalo
+     */
+    io_uring_sqe* get_sqe() {
+        if (sq_local_tail_ - load_acquire(sq_head_) >= sq_entries_) {
+            if (submit(0, -1) < 0 || sq_local_tail_ - load_acquire(sq_head_) >= sq_entries_) {
+                return nullptr;
+            }
+        }
+        unsigned index = sq_local_tail_ & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[index] = index;
+        ++sq_local_tail_;
+        return sqe;
+    }
+
+    /**
+     * Odeslání všech připravených SQE a čekání na alespoň wait_nr dokončení
+     * @param timeout_ms Max. doba čekání (-1 = bez limitu)
+     * @return počet odeslaných SQE nebo -1 (ETIME/EINTR při vypršení čekání nejsou chyba)
+     */
+    int submit(unsigned wait_nr, int timeout_ms) {
+        unsigned to_submit = sq_local_tail_ - submitted_tail_;
+        store_release(sq_tail_, sq_local_tail_);
+        unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+        __kernel_timespec ts;
+        io_uring_getevents_arg arg;
+        std::memset(&arg, 0, sizeof(arg));
+        if (wait_nr > 0 && timeout_ms >= 0) {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+        flags |= IORING_ENTER_EXT_ARG;
+
+        while (true) {
+            int result = static_cast<int>(syscall(__NR_io_uring_enter, fd_, to_submit, wait_nr, flags, &arg, sizeof(arg)));
+            if (result >= 0) {
+                submitted_tail_ += static_cast<unsigned>(result);
+                return result;
+            }
+            if (errno == ETIME || errno == EINTR) {
+                // Vypršení čekání - SQE byly přesto odeslány
+                submitted_tail_ = sq_local_tail_;
+                return 0;
+            }
+            if (errno == EBUSY || errno == EAGAIN) {
+                // Plná CQ - volající nejdřív vybere dokončení
+                return 0;
+            }
+            return -1;
+        }
+    }
+
+    /**
+     * Zpracování všech dostupných dokončení
+     * @param handler Volá se s const io_uring_cqe&
+     */
+    template <typename Handler>
+    unsigned for_each_cqe(Handler handler) {
+        unsigned head = *cq_head_;
+        unsigned tail = load_acquire(cq_tail_);
+        unsigned seen = 0;
+        while (head != tail) {
+            handler(cqes_[head & cq_mask_]);
+            ++head;
+            ++seen;
+            // Po každém dokončení uvolnit místo (handler může plnit další SQE)
+            store_release(cq_head_, head);
+            if (head == tail) tail = load_acquire(cq_tail_);
+        }
+        return seen;
+    }
+
+    /**
+     * Kruh count poskytnutých bufferů po size bytech ve skupině group
+     * (count je mocnina 2, nejvýše 32768)
+     */
+    bool setup_buffer_ring(uint16_t group, unsigned count, size_t size) {
+        buffers_size_ = count * sizeof(io_uring_buf);
+        void* ring = mmap(nullptr, buffers_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED) {
+            return false;
+        }
+        buffer_memory_size_ = count * size;
+        void* memory = mmap(nullptr, buffer_memory_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            munmap(ring, buffers_size_);
+            return false;
+        }
+
+        io_uring_buf_reg reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+        reg.ring_entries = count;
+        reg.bgid = group;
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            int error = errno;
+            munmap(ring, buffers_size_);
+            munmap(memory, buffer_memory_size_);
+            errno = error;
+            return false;
+        }
+
+        buffers_ = static_cast<io_uring_buf*>(ring);
+        buffer_memory_ = static_cast<char*>(memory);
+        buffer_count_ = count;
+        buffer_size_ = size;
+        buffer_group_ = group;
+        for (unsigned i = 0; i < count; ++i) {
+            put_buffer(static_cast<uint16_t>(i), i);
+        }
+        publish_buffers(count);
+        return true;
+    }
+
+    uint16_t buffer_group() const {
+        return buffer_group_;
+    }
+
+    // Data poskytnutého bufferu (id z cqe.flags >> IORING_CQE_BUFFER_SHIFT)
+    const char* buffer(uint16_t id) const {
+        return buffer_memory_ + static_cast<size_t>(id) * buffer_size_;
+    }
+
+    // Vrácení zpracovaného bufferu jádru
+    void recycle_buffer(uint16_t id) {
+        put_buffer(id, 0);
+        publish_buffers(1);
+    }
+
+private:
+    IoUring(const IoUring&);
+    IoUring& operator=(const IoUring&);
+
+    static unsigned load_acquire(const unsigned* pointer) {
+        return __atomic_load_n(pointer, __ATOMIC_ACQUIRE);
+    }
+
+    static void store_release(unsigned* pointer, unsigned value) {
+        __atomic_store_n(pointer, value, __ATOMIC_RELEASE);
+    }
+
+    // Položky kruhu se adresují přímo: io_uring_buf_ring.bufs je v C++
+    // posunuté (prázdná struktura z __DECLARE_FLEX_ARRAY má velikost 1)
+    // a tail leží v resv první položky
+    uint16_t* buffer_tail() const {
+        return &buffers_[0].resv;
+    }
+
+    void put_buffer(uint16_t id, unsigned offset) {
+        io_uring_buf& entry = buffers_[(*buffer_tail() + offset) & (buffer_count_ - 1)];
+        entry.addr = reinterpret_cast<uint64_t>(buffer_memory_ + static_cast<size_t>(id) * buffer_size_);
+        entry.len = static_cast<uint32_t>(buffer_size_);
+        entry.bid = id;
+    }
+
+    void publish_buffers(unsigned count) {
+        __atomic_store_n(buffer_tail(), static_cast<uint16_t>(*buffer_tail() + count), __ATOMIC_RELEASE);
+    }
+
+    int fd_;
+    char* ring_;
+    size_t ring_size_;
+    io_uring_sqe* sqes_;
+    size_t sqes_size_;
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_array_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    io_uring_cqe* cqes_;
+    unsigned cq_mask_;
+    unsigned sq_local_tail_;   // Připravené SQE (viditelné jádru až po submit)
+    unsigned submitted_tail_;  // SQE převzaté jádrem
+
+    io_uring_buf* buffers_;
+    size_t buffers_size_;
+    char* buffer_memory_;
+    size_t buffer_memory_size_;
+    unsigned buffer_count_;
+    size_t buffer_size_;
+    uint16_t buffer_group_;
+};
+
+#endif // URING_H
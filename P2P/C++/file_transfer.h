@@ -0,0 +1,371 @@
+/**
+ * Přenos souborů mezi peery po blocích s obnovením po přerušení
+ *
+ * Odesílatel soubor namapuje do paměti (mmap) jen kvůli kontrolním součtům
+ * bloků, data bloků jdou do socketu přes sendfile() přímo z page cache -
+ * přes uživatelský prostor se nekopírují. Příjemce soubor předem alokuje
+ * (posix_fallocate) a bloky zapisuje pozičním zápisem (pwrite) na jejich
+ * offset, pořadí příchodu tedy nehraje roli. Odesílatel má rozeslaných
+ * nejvýše FILE_WINDOW nepotvrzených bloků (posuvné okno), každý blok
+ * příjemce potvrdí po kontrole CRC32 a zápisu.
+ *
+ * Příjemce si vede mapu přijatých bloků v souboru <jméno>.part.state vedle
+ * rozpracovaného <jméno>.part. Nová nabídka stejného souboru (jméno,
+ * velikost, CRC32 celku) po přerušení spojení mapu načte a odesílatel
+ * pošle jen chybějící bloky. Mapa se při zápisu bloku nesynchronizuje
+ * na disk (fsync) - obnova počítá s výpadkem spojení, ne systému; po pádu
+ * systému zachytí poškozený soubor až kontrola CRC celku.
+ *
+ * Existující soubor se nikdy nepřepíše: nabídku jména, které už v cílovém
+ * adresáři je, příjemce odmítne a hotový soubor dostane cílové jméno přes
+ * link() (selže, pokud mezitím jméno vzniklo). Velikost nabídky je omezená
+ * FILE_MAX_SIZE, jinak by jediná zpráva předalokovala celý disk.
+ *
+ * Zprávy (textové rámce, blok dat je samostatný rámec hned za FILE_CHUNK):
+ *   FILE_OFFER:<id>:<velikost>:<velikost bloku>:<crc32 celku>:<jméno>
+ *   FILE_ACCEPT:<id>:<přijaté bloky "0-3,7">   FILE_REJECT:<id>:<důvod>
+ *   FILE_CHUNK:<id>:<index>:<crc32 bloku> + [rámec s daty bloku]
+ *   FILE_ACK:<id>:<index>                      FILE_NACK:<id>:<index> (CRC nesedí)
+ *   FILE_DONE:<id>
+ *   FILE_COMPLETE:<id>                         FILE_FAILED:<id>:<důvod>
+ *
+ * Kompatibilní s: C++11, Linux (sendfile, posix_fallocate), zlib
+ */
+
+#ifndef FILE_TRANSFER_H
+#define FILE_TRANSFER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+const size_t FILE_CHUNK_SIZE = 256 * 1024;   // Velikost bloku (jeden sendfile)
+const size_t FILE_WINDOW = 16;               // Nepotvrzené bloky na cestě (4 MiB)
+const int FILE_ACK_TIMEOUT = 30;             // Bez potvrzení tak dlouho (s) = přenos selhal
+const uint64_t FILE_MAX_SIZE = 8ULL << 30;   // Větší nabídka se odmítne (8 GiB)
+
+const char* const FILE_OFFER = "FILE_OFFER:";
+const char* const FILE_ACCEPT = "FILE_ACCEPT:";
+const char* const FILE_REJECT = "FILE_REJECT:";
+const char* const FILE_CHUNK = "FILE_CHUNK:";
+const char* const FILE_ACK = "FILE_ACK:";
+const char* const FILE_NACK = "FILE_NACK:";
+const char* const FILE_DONE = "FILE_DONE:";
+const char* const FILE_COMPLETE = "FILE_COMPLETE:";
+const char* const FILE_FAILED = "FILE_FAILED:";
+
+inline bool has_file_prefix(const std::string& message, const char* prefix) {
+    return message.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+/**
+ * Pole zprávy za prefixem oddělená ':' (poslední pole může ':' obsahovat)
+ */
+inline std::vector<std::string> split_file_fields(const std::string& message, const char* prefix, size_t count) {
+    std::vector<std::string> fields;
+    size_t start = std::strlen(prefix);
+    while (fields.size() + 1 < count) {
+        size_t colon = message.find(':', start);
+        if (colon == std::string::npos) break;
+        fields.push_back(message.substr(start, colon - start));
+        start = colon + 1;
+    }
+    if (start <= message.size()) fields.push_back(message.substr(start));
+    return fields;
+}
+
+inline uint32_t checksum(const unsigned char* data, size_t length) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    // crc32 bere délku jako uInt - po částech kvůli souborům nad 4 GiB
+    while (length > 0) {
+        uInt part = static_cast<uInt>(length > (1u << 30) ? (1u << 30) : length);
+        crc = crc32(crc, data, part);
+        data += part;
+        length -= part;
+    }
+    return static_cast<uint32_t>(crc);
+}
+
+inline std::string hex32(uint32_t value) {
+    char text[9];
+    std::snprintf(text, sizeof(text), "%08x", value);
+    return text;
+}
+
+inline size_t chunk_count(uint64_t size, size_t chunk_size) {
+    return static_cast<size_t>((size + chunk_size - 1) / chunk_size);
+}
+
+inline size_t chunk_length(uint64_t size, size_t chunk_size, size_t index) {
+    uint64_t offset = static_cast<uint64_t>(index) * chunk_size;
+    return static_cast<size_t>(size - offset < chunk_size ? size - offset : chunk_size);
+}
+
+/**
+ * Přijaté bloky jako intervaly "0-3,7,9-12"
+ */
+inline std::string encode_chunk_ranges(const std::vector<bool>& chunks) {
+    std::string text;
+    size_t i = 0;
+    while (i < chunks.size()) {
+        if (!chunks[i]) {
+            ++i;
+            continue;
+        }
+        size_t end = i;
+        while (end + 1 < chunks.size() && chunks[end + 1]) ++end;
+        if (!text.empty()) text += ',';
+        text += std::to_string(i);
+        if (end != i) text += "-" + std::to_string(end);
+        i = end + 1;
+    }
+    return text;
+}
+
+inline void parse_chunk_ranges(const std::string& text, std::vector<bool>& chunks) {
+    const char* p = text.c_str();
+    while (*p) {
+        char* end = nullptr;
+        unsigned long first = std::strtoul(p, &end, 10);
+        if (end == p) return;
+        unsigned long last = first;
+        p = end;
+        if (*p == '-') {
+            last = std::strtoul(p + 1, &end, 10);
+            p = end;
+        }
+        for (unsigned long i = first; i <= last && i < chunks.size(); ++i) {
+            chunks[i] = true;
+        }
+        if (*p == ',') ++p;
+        else if (*p) return;
+    }
+}
+
+/**
+ * Je jméno souboru bezpečné pro zápis do adresáře stahování? (bez cesty)
+ */
+inline bool valid_file_name(const std::string& name) {
+    return !name.empty() && name.size() <= 255 && name[0] != '.' && name.find('/') == std::string::npos;
+}
+
+/**
+ * Začátek dvojice rámců bloku: délka a hlavička, za ní délka dat
+ * Data bloku (length bytů) za prefix doplní sendfile() bez kopie z page
+ * cache; prefix jde jedním send() s MSG_MORE.
+ */
+inline std::string file_frames_prefix(const std::string& header, size_t length) {
+    std::string prefix(4, '\0');
+    uint32_t header_length = htonl(static_cast<uint32_t>(header.size()));
+    std::memcpy(&prefix[0], &header_length, 4);
+    prefix += header;
+    uint32_t data_length = htonl(static_cast<uint32_t>(length));
+    prefix.append(reinterpret_cast<const char*>(&data_length), 4);
+    return prefix;
+}
+
+/**
+ * Zdrojový soubor odesílatele (deskriptor pro sendfile, mapování pro CRC)
+ */
+class SourceFile {
+public:
+    SourceFile() : fd_(-1), data_(nullptr), size_(0) {}
+    ~SourceFile() {
+        if (data_) munmap(data_, static_cast<size_t>(size_));
+        if (fd_ >= 0) close(fd_);
+    }
+
+    bool open(const std::string& path) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (fd_ < 0 || fstat(fd_, &info) < 0 || !S_ISREG(info.st_mode)) {
+            return false;
+        }
+        size_ = static_cast<uint64_t>(info.st_size);
+        if (size_ > 0) {
+            void* data = mmap(nullptr, static_cast<size_t>(size_), PROT_READ, MAP_SHARED, fd_, 0);
+            if (data == MAP_FAILED) return false;
+            data_ = static_cast<unsigned char*>(data);
+            madvise(data_, static_cast<size_t>(size_), MADV_SEQUENTIAL);
+        }
+        return true;
+    }
+
+    int fd() const { return fd_; }
+    uint64_t size() const { return size_; }
+
+    uint32_t checksum_range(uint64_t offset, size_t length) const {
+        return checksum(data_ ? data_ + offset : nullptr, data_ ? length : 0);
+    }
+
+private:
+    SourceFile(const SourceFile&);
+    SourceFile& operator=(const SourceFile&);
+
+    int fd_;
+    unsigned char* data_;
+    uint64_t size_;
+};
+
+/**
+ * Rozpracovaný soubor příjemce (<jméno>.part) s mapou přijatých bloků
+ */
+class PartialFile {
+public:
+    PartialFile() : fd_(-1), state_fd_(-1), size_(0), chunk_size_(0), crc_(0), received_(0) {}
+    ~PartialFile() {
+        if (fd_ >= 0) close(fd_);
+        if (state_fd_ >= 0) close(state_fd_);
+    }
+
+    /**
+     * Otevření nebo založení rozpracovaného souboru
+     * Mapa z dřívějška platí jen pro stejnou velikost, blok a CRC celku.
+     */
+    bool open(const std::string& path, uint64_t size, size_t chunk_size, uint32_t crc) {
+        path_ = path;
+        size_ = size;
+        chunk_size_ = chunk_size;
+        crc_ = crc;
+        chunks_.assign(chunk_count(size, chunk_size), false);
+        header_ = "P2PFILE " + std::to_string(size) + " " + std::to_string(chunk_size) + " " + hex32(crc) + "\n";
+
+        std::string state_path = path + ".part.state";
+        state_fd_ = ::open(state_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        fd_ = ::open((path + ".part").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0 || state_fd_ < 0) {
+            return false;
+        }
+
+        std::vector<unsigned char> bitmap((chunks_.size() + 7) / 8, 0);
+        std::string stored(header_.size(), '\0');
+        bool resumed = pread(state_fd_, &stored[0], stored.size(), 0) == static_cast<ssize_t>(stored.size()) &&
+                       stored == header_ &&
+                       pread(state_fd_, bitmap.data(), bitmap.size(), static_cast<off_t>(header_.size())) ==
+                           static_cast<ssize_t>(bitmap.size());
+        if (resumed) {
+            for (size_t i = 0; i < chunks_.size(); ++i) {
+                if (bitmap[i / 8] & (1u << (i % 8))) {
+                    chunks_[i] = true;
+                    received_++;
+                }
+            }
+        } else {
+            std::fill(bitmap.begin(), bitmap.end(), 0);
+            if (ftruncate(state_fd_, 0) < 0 ||
+                pwrite(state_fd_, header_.data(), header_.size(), 0) != static_cast<ssize_t>(header_.size()) ||
+                pwrite(state_fd_, bitmap.data(), bitmap.size(), static_cast<off_t>(header_.size())) !=
+                    static_cast<ssize_t>(bitmap.size()) ||
+                ftruncate(fd_, 0) < 0) {
+                return false;
+            }
+        }
+
+        // Předalokace celého souboru (bloky se pak jen přepisují na místě)
+        if (size_ > 0 && posix_fallocate(fd_, 0, static_cast<off_t>(size_)) != 0 &&
+            ftruncate(fd_, static_cast<off_t>(size_)) < 0) {
+            return false;
+        }
+        return true;
+    }
+
+    const std::vector<bool>& chunks() const { return chunks_; }
+    bool complete() const { return received_ == chunks_.size(); }
+    size_t received() const { return received_; }
+
+    /**
+     * Zápis ověřeného bloku na jeho místo a označení v mapě
+     */
+    bool write_chunk(size_t index, const char* data, size_t size) {
+        if (index >= chunks_.size() || size != chunk_length(size_, chunk_size_, index)) {
+            return false;
+        }
+        off_t offset = static_cast<off_t>(index) * static_cast<off_t>(chunk_size_);
+        size_t written = 0;
+        while (written < size) {
+            ssize_t n = pwrite(fd_, data + written, size - written, offset + static_cast<off_t>(written));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            written += static_cast<size_t>(n);
+        }
+        if (!chunks_[index]) {
+            chunks_[index] = true;
+            received_++;
+            // Byte mapy s tímto blokem (ostatní bity téhož bytu podle paměti)
+            unsigned char byte = 0;
+            size_t first = index / 8 * 8;
+            for (size_t i = first; i < first + 8 && i < chunks_.size(); ++i) {
+                if (chunks_[i]) byte |= static_cast<unsigned char>(1u << (i % 8));
+            }
+            if (pwrite(state_fd_, &byte, 1, static_cast<off_t>(header_.size() + index / 8)) != 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Kontrola CRC celku a přejmenování na cílové jméno
+     * Cílové jméno vznikne přes link() - existující soubor se nepřepíše.
+     */
+    bool finish(std::string& error) {
+        if (!complete()) {
+            error = "chybí bloky";
+            return false;
+        }
+        uint32_t crc = checksum(nullptr, 0);
+        if (size_ > 0) {
+            void* data = mmap(nullptr, static_cast<size_t>(size_), PROT_READ, MAP_SHARED, fd_, 0);
+            if (data == MAP_FAILED) {
+                error = std::strerror(errno);
+                return false;
+            }
+            crc = checksum(static_cast<const unsigned char*>(data), static_cast<size_t>(size_));
+            munmap(data, static_cast<size_t>(size_));
+        }
+        if (crc != crc_) {
+            // Poškozený soubor - příští nabídka začne znovu od nuly
+            ftruncate(state_fd_, 0);
+            error = "CRC souboru nesedí";
+            return false;
+        }
+        if (link((path_ + ".part").c_str(), path_.c_str()) < 0) {
+            error = errno == EEXIST ? "soubor už existuje" : std::strerror(errno);
+            return false;
+        }
+        unlink((path_ + ".part").c_str());
+        unlink((path_ + ".part.state").c_str());
+        return true;
+    }
+
+private:
+    PartialFile(const PartialFile&);
+    PartialFile& operator=(const PartialFile&);
+
+    int fd_;
+    int state_fd_;
+    std::string path_;
+    std::string header_;
+    uint64_t size_;
+    size_t chunk_size_;
+    uint32_t crc_;
+    std::vector<bool> chunks_;
+    size_t received_;
+};
+
+#endif // FILE_TRANSFER_H
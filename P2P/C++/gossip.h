@@ -0,0 +1,141 @@
+/**
+ * Gossip broadcast v P2P síti (epidemické šíření s TTL)
+ *
+ * Místo rozeslání zprávy všem přímým spojením pošle peer zprávu jen
+ * GOSSIP_FANOUT náhodně vybraným sousedům (náhodný pohled na síť). Každý
+ * příjemce zprávu zobrazí a se sníženým TTL ji stejně přepošle dál - kromě
+ * souseda, od kterého přišla. Duplikáty (zpráva dorazí více cestami)
+ * zahodí podle id v cache viděných zpráv. Náklad odesílatele je tak
+ * konstantní a počet kroků k pokrytí sítě roste s logaritmem její
+ * velikosti - síť může být mnohem větší než MAX_PEERS přímých spojení.
+ *
+ * Textový formát (jedna zpráva na rámec, kompatibilní rámování):
+ *   GOSSIP:<id hex>:<ttl>:<původce>:<text>
+ * Id je náhodné 64bitové číslo přidělené původcem, jméno původce nesmí
+ * obsahovat ':'.
+ *
+ * Kompatibilní s: C++11
+ */
+
+#ifndef GOSSIP_H
+#define GOSSIP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+const char* const GOSSIP_PREFIX = "GOSSIP:";
+const int GOSSIP_TTL = 8;                       // Nejvíc kroků zprávy od původce
+const size_t GOSSIP_FANOUT = 4;                 // Počet sousedů, kterým peer zprávu pošle
+const size_t GOSSIP_SEEN_CAPACITY = 16384;      // Počet pamatovaných id zpráv
+
+struct GossipMessage {
+    uint64_t id;
+    int ttl;
+    std::string origin;
+    std::string text;
+};
+
+inline std::string format_gossip(const GossipMessage& message) {
+    static const char DIGITS[] = "0123456789abcdef";
+    std::string id(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        id[i] = DIGITS[(message.id >> ((15 - i) * 4)) & 0xF];
+    }
+    return GOSSIP_PREFIX + id + ":" + std::to_string(message.ttl) + ":" + message.origin + ":" + message.text;
+}
+
+/**
+ * @return false pokud zpráva není platná gossip zpráva
+ */
+inline bool parse_gossip(const std::string& data, GossipMessage& out) {
+    if (data.compare(0, 7, GOSSIP_PREFIX) != 0) {
+        return false;
+    }
+    size_t id_end = data.find(':', 7);
+    size_t ttl_end = id_end == std::string::npos ? id_end : data.find(':', id_end + 1);
+    size_t origin_end = ttl_end == std::string::npos ? ttl_end : data.find(':', ttl_end + 1);
+    if (origin_end == std::string::npos || id_end - 7 != 16) {
+        return false;
+    }
+    char* end = nullptr;
+    out.id = std::strtoull(data.c_str() + 7, &end, 16);
+    if (end != data.c_str() + id_end) {
+        return false;
+    }
+    out.ttl = std::atoi(data.c_str() + id_end + 1);
+    out.origin = data.substr(ttl_end + 1, origin_end - ttl_end - 1);
+    out.text = data.substr(origin_end + 1);
+    return out.ttl >= 0 && !out.origin.empty();
+}
+
+/**
+ * Náhodné id nové zprávy
+ */
+inline uint64_t new_gossip_id() {
+    static std::mutex mutex;
+    static std::mt19937_64 generator(std::random_device{}());
+    std::lock_guard<std::mutex> lock(mutex);
+    return generator();
+}
+
+/**
+ * Cache naposledy viděných id zpráv (při zaplnění zapomene nejstarší)
+ * Id se pamatují v kruhu pevné velikosti, množina slouží k vyhledání.
+ * Zpráva starší než kapacita kruhu by prošla znovu - TTL ji ale mezitím
+ * dávno ukončí.
+ */
+class SeenCache {
+public:
+    explicit SeenCache(size_t capacity) : ring_(capacity), next_(0) {
+        seen_.reserve(capacity);
+    }
+
+    /**
+     * Označení id jako viděného
+     * @return true pokud je id nové (zprávu zpracovat), false u duplikátu
+     */
+    bool insert(uint64_t id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!seen_.insert(id).second) {
+            return false;
+        }
+        if (seen_.size() > ring_.size()) {
+            seen_.erase(ring_[next_]);
+        }
+        ring_[next_] = id;
+        next_ = (next_ + 1) % ring_.size();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_set<uint64_t> seen_;
+    std::vector<uint64_t> ring_;
+    size_t next_;
+};
+
+/**
+ * Náhodný výběr nejvýše count prvků (částečné Fisher-Yates zamíchání)
+ */
+template <typename T>
+std::vector<T> random_sample(std::vector<T> items, size_t count) {
+    static thread_local std::minstd_rand generator(std::random_device{}());
+    if (count >= items.size()) {
+        return items;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        std::uniform_int_distribution<size_t> pick(i, items.size() - 1);
+        std::swap(items[i], items[pick(generator)]);
+    }
+    items.resize(count);
+    return items;
+}
+
+#endif // GOSSIP_H
@@ -5,17 +5,46 @@
  * Kompatibilní s: Python peery (stejný protokol)
  * 
  * Kompilace:
- *   g++ -std=c++11 -pthread peer2peer.cpp -o peer2peer
+ *   g++ -std=c++11 -pthread peer2peer.cpp -o peer2peer -lz
  * 
  * Spuštění:
  *   ./peer2peer
+ *   ./peer2peer --port 8082 --rendezvous chat.example.com:8079 --rendezvous-token TOKEN
+ *
+ * S --rendezvous se peer ohlásí UDP rendezvous službě serveru (server
+ * --rendezvous-port) ze svého P2P portu a příkazem /punch <jméno> si
+ * otevře přímou UDP cestu k peeru i přes NAT (viz C++/rendezvous.h).
+ * Jméno peera doloží token, který vydá příkaz /rvtoken přihlášenému
+ * uživateli chatu se stejným jménem.
+ * Broadcast pak jde i UDP peerům. TCP listener i UDP socket jsou
+ * dual-stack (IPv4 i IPv6).
+ *
+ * S --gossip se broadcast šíří sítí epidemicky (gossip.h): jen několika
+ * náhodným sousedům, kteří zprávu s TTL přeposílají dál. Gossip zprávy
+ * ostatních peerů se přeposílají vždy.
+ *
+ * /send <peer> <soubor> pošle soubor přímo peeru po blocích (file_transfer.h),
+ * přerušený přenos se dalším /send téhož souboru dokončí. Přijaté soubory
+ * se ukládají do --download-dir (výchozí aktuální adresář).
+ *
+ * Všechna spojení s peery obsluhuje jedna smyčka událostí (epoll, peer_pool.h):
+ * connect() je neblokující s limitem CONNECTION_TIMEOUT, takže --connect
+ * HOST:PORT (opakovatelně) i /connect vytáčí víc peerů současně. Odchozí
+ * spojení se po výpadku obnovují, nečinným peerům jde každých
+ * HEARTBEAT_INTERVAL PING a peer bez odezvy 3 intervaly se odpojí.
+ *
+ * Parametry lze zadat i souborem (--config, viz C++/config_file.h), například
+ * limit peerů --max-peers. Ctrl+C (SIGINT) nebo SIGTERM ukončí peer stejně
+ * jako /quit - spojení se zavřou a přenosy zůstanou navazovatelné.
  */
 
 #include <iostream>
 #include <thread>
+#include <atomic>
 #include <vector>
 #include <mutex>
 #include <map>
+#include <memory>
 #include <string>
 #include <cstring>
 #include <cstdint>
@@ -25,253 +54,1375 @@
 #include <arpa/inet.h>
 #include <ctime>
 #include <chrono>
+#include <cstdlib>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "../../C++/config_file.h"
+#include "../../C++/framing.h"
+#include "../../C++/rendezvous.h"
+#include "../../C++/socket_tuning.h"
+#include "file_transfer.h"
+#include "gossip.h"
+#include "peer_pool.h"
 
 // Konfigurace
 const int DEFAULT_PORT = 8081;
-const int MAX_PEERS = 50;
+const int MAX_PEERS = 50;               // Výchozí limit spojených peerů (--max-peers)
 const size_t BUFFER_SIZE = 4096;
 const uint32_t MAX_MESSAGE_SIZE = 40960;
 const int CONNECTION_TIMEOUT = 10;
 const int HEARTBEAT_INTERVAL = 30;
+const size_t PEER_SEND_BUFFER_LIMIT = 4 * 1024 * 1024;  // Neodeslané zprávy jednoho peera
+
+/**
+ * Socket spojení s peerem a jeho odchozí buffer
+ * Odesílá se z více vláken (smyčka událostí, příkazy, přenosy souborů), na
+ * socket ale nikdo nečeká: send() zprávu zařadí a zkusí neblokující zápis,
+ * zbytek dopíše smyčka událostí při EPOLLOUT (flush). Peer, který přestal
+ * číst, tak zdrží jen sám sebe - a když jeho neodeslané zprávy přerostou
+ * PEER_SEND_BUFFER_LIMIT, spojení se ukončí. Blok souboru drží buffer jako
+ * odkaz na zdrojový soubor, data jdou přes sendfile(). Socket se zavře
+ * s posledním odkazem, odesílatel se snímkem odkazů tak nikdy nepíše do
+ * cizího fd.
+ */
+struct PeerChannel {
+    // Volá se pod zámkem kanálu při změně stavu bufferu (true = čekají data)
+    typedef std::function<void(bool)> PendingCallback;
+
+    explicit PeerChannel(int fd) : socket(fd), buffered_(0), closed_(false), pending_(false) {}
+    ~PeerChannel() {
+        close(socket);
+    }
+
+    void set_pending_callback(PendingCallback callback) {
+        std::lock_guard<std::mutex> lock(send_mutex);
+        on_pending_ = std::move(callback);
+    }
+
+    /**
+     * Zařazení zprávy (nikdy nečeká na socket)
+     * @return false pokud je spojení zavřené nebo přetížené
+     */
+    bool send(const std::string& message) {
+        OutboundItem item;
+        uint32_t length = htonl(static_cast<uint32_t>(message.size()));
+        item.data.reserve(FRAME_HEADER_SIZE + message.size());
+        item.data.append(reinterpret_cast<const char*>(&length), FRAME_HEADER_SIZE);
+        item.data += message;
+        return enqueue(std::move(item));
+    }
+
+    // Hlavička bloku souboru a data přes sendfile (viz file_transfer.h)
+    bool send_file_chunk(const std::string& header, const std::shared_ptr<const SourceFile>& file,
+                         off_t offset, size_t length) {
+        OutboundItem item;
+        item.data = file_frames_prefix(header, length);
+        item.file = file;
+        item.offset = offset;
+        item.length = length;
+        return enqueue(std::move(item));
+    }
+
+    /**
+     * Dopsání bufferu (smyčka událostí při EPOLLOUT)
+     * @return false při chybě zápisu - spojení je třeba zavřít
+     */
+    bool flush() {
+        std::lock_guard<std::mutex> lock(send_mutex);
+        return closed_ || flush_locked();
+    }
+
+    /**
+     * Zavření kanálu smyčkou událostí: buffer se zahodí, další send() selže
+     */
+    void close_channel() {
+        std::lock_guard<std::mutex> lock(send_mutex);
+        closed_ = true;
+        items_.clear();
+        buffered_ = 0;
+        on_pending_ = nullptr;
+    }
+
+    int socket;
+    std::mutex send_mutex;
+
+private:
+    struct OutboundItem {
+        OutboundItem() : sent(0), offset(0), length(0) {}
+
+        std::string data;                        // Rámec (u bloku souboru hlavička a délka dat)
+        size_t sent;
+        std::shared_ptr<const SourceFile> file;  // Blok souboru - data se čtou až při zápisu
+        off_t offset;
+        size_t length;                           // Zbývající byty bloku
+    };
+
+    bool enqueue(OutboundItem item) {
+        std::lock_guard<std::mutex> lock(send_mutex);
+        if (closed_) {
+            return false;
+        }
+        if (buffered_ + item.data.size() > PEER_SEND_BUFFER_LIMIT) {
+            // Peer nečte - smyčka událostí spojení zavře
+            closed_ = true;
+            shutdown(socket, SHUT_RDWR);
+            return false;
+        }
+        buffered_ += item.data.size();
+        items_.push_back(std::move(item));
+        if (!flush_locked()) {
+            closed_ = true;
+            shutdown(socket, SHUT_RDWR);
+            return false;
+        }
+        return true;
+    }
+
+    // Neblokující zápis od začátku bufferu, dokud socket data přijímá
+    bool flush_locked() {
+        while (!items_.empty()) {
+            OutboundItem& item = items_.front();
+            if (item.sent < item.data.size()) {
+                int more = item.file ? MSG_MORE : 0;
+                ssize_t sent = ::send(socket, item.data.data() + item.sent, item.data.size() - item.sent,
+                                      MSG_NOSIGNAL | MSG_DONTWAIT | more);
+                if (sent < 0) {
+                    if (errno == EINTR) continue;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                    return false;
+                }
+                item.sent += static_cast<size_t>(sent);
+                buffered_ -= static_cast<size_t>(sent);
+                continue;
+            }
+            if (item.length > 0) {
+                // Socket je neblokující - sendfile() vrátí EAGAIN místo čekání
+                ssize_t sent = sendfile(socket, item.file->fd(), &item.offset, item.length);
+                if (sent < 0) {
+                    if (errno == EINTR) continue;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                    return false;
+                }
+                if (sent == 0) {
+                    return false;  // Soubor se mezitím zkrátil
+                }
+                item.length -= static_cast<size_t>(sent);
+                continue;
+            }
+            items_.pop_front();
+        }
+        bool pending = !items_.empty();
+        if (pending != pending_ && on_pending_) {
+            on_pending_(pending);
+        }
+        pending_ = pending;
+        return true;
+    }
+
+    std::deque<OutboundItem> items_;
+    size_t buffered_;            // Neodeslané byty zpráv (data bloků souborů se nepočítají)
+    bool closed_;
+    bool pending_;               // Smyčka událostí čeká na EPOLLOUT
+    PendingCallback on_pending_;
+};
+
+typedef std::shared_ptr<PeerChannel> PeerChannelPtr;
 
 // Struktura pro peer informace
 struct PeerInfo {
-    int socket;
+    PeerChannelPtr channel;
     std::string username;
-    time_t last_heartbeat;
+    bool outbound;        // Spojení z poolu (/connect), po výpadku se obnoví
+};
+
+// Peer s UDP cestou přes rendezvous (hole punching)
+struct UdpPeer {
+    sockaddr_storage addr;
+    socklen_t length;
+    bool open;            // Od peera přišel PUNCH/PUNCH_ACK - cesta je průchozí
+    double punch_until;   // Do kdy se posílají PUNCH datagramy
+    double next_punch;
 };
 
 // Globální stav
 std::map<std::pair<std::string, int>, PeerInfo> connected_peers;
 std::mutex peers_mutex;
-bool peer_running = true;
+std::atomic<bool> peer_running(true);  // false po /quit nebo signálu ukončení
 int listener_socket = -1;
 std::string username = "Peer";
+int listen_port = DEFAULT_PORT;
+int max_peers = MAX_PEERS;
+bool gossip_mode = false;
+// Volby socketů peerů (--socket-profile), výchozí bulk kvůli přenosu souborů
+SocketProfile peer_socket_profile = SocketProfile::BULK;
+SocketTuning peer_socket_tuning = socket_profile(SocketProfile::BULK);
+SeenCache seen_gossip(GOSSIP_SEEN_CAPACITY);
+
+// Odchozí přenos souboru (vlákno odesílatele + potvrzení ze čtecího vlákna)
+struct OutgoingTransfer {
+    enum Phase { OFFERED, SENDING, FINISHING, COMPLETE, FAILED };
+    enum ChunkState : uint8_t { PENDING, IN_FLIGHT, ACKED };
+
+    std::string id;
+    std::string name;
+    std::string peer;
+    PeerChannelPtr channel;
+    SourceFile source;
+    std::mutex mutex;
+    std::condition_variable changed;
+    Phase phase = OFFERED;
+    std::vector<uint8_t> chunks;
+    std::deque<size_t> resend;    // Bloky s NACK - odešlou se přednostně
+    size_t in_flight = 0;
+    size_t acked = 0;
+    size_t resumed = 0;           // Bloky, které příjemce měl z dřívějška
+    std::string error;
+};
+
+// Příchozí přenos (jen ve čtecím vlákně spojení, zámek kvůli odpojení)
+struct IncomingTransfer {
+    const PeerChannel* channel;
+    std::string name;
+    std::string peer;
+    uint64_t size;
+    size_t chunk_size;
+    PartialFile file;
+};
+
+std::map<std::string, std::shared_ptr<OutgoingTransfer>> outgoing_transfers;
+std::map<std::string, std::shared_ptr<IncomingTransfer>> incoming_transfers;
+std::mutex transfers_mutex;
+std::string download_dir = ".";
+
+// UDP rendezvous (volitelné)
+int udp_socket = -1;
+int udp_family = AF_INET6;
+sockaddr_storage rendezvous_addr;
+socklen_t rendezvous_length = 0;
+std::string rendezvous_token;  // Z /rvtoken v chatu (--rendezvous-token)
+std::map<std::string, UdpPeer> udp_peers;
+std::mutex udp_mutex;
+
+double monotonic_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// SIGINT/SIGTERM: bez SA_RESTART přeruší čtení příkazu v hlavním vlákně
+void handle_shutdown_signal(int) {
+    peer_running.store(false);
+}
 
 /**
- * Odešle zprávu s prefixem délky
+ * Pracovní vlákno se zablokovanými signály ukončení
+ * Signál tak vždy dostane hlavní vlákno, kde ukončí std::getline.
  */
-bool send_message(int sock, const std::string& message) {
-    uint32_t message_length = htonl(static_cast<uint32_t>(message.length()));
-    
-    if (send(sock, &message_length, 4, 0) != 4) {
-        return false;
+template <typename... Args>
+std::thread worker_thread(Args&&... args) {
+    sigset_t signals;
+    sigset_t previous;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous);
+    try {
+        std::thread thread(std::forward<Args>(args)...);
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+        return thread;
+    } catch (...) {
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+        throw;
+    }
+}
+
+/**
+ * Odeslání zprávy náhodným sousedům z pohledu (kromě except)
+ * Odkazy na spojení se vyberou pod zámkem, odesílá se bez něj.
+ * @return počet sousedů, kterým zpráva odešla
+ */
+int send_to_random_peers(const std::string& message, size_t fanout, const PeerChannel* except) {
+    std::vector<PeerChannelPtr> view;
+    {
+        std::lock_guard<std::mutex> lock(peers_mutex);
+        view.reserve(connected_peers.size());
+        for (const auto& pair : connected_peers) {
+            if (pair.second.channel.get() != except) {
+                view.push_back(pair.second.channel);
+            }
+        }
     }
     
-    if (message.length() > 0) {
-        if (send(sock, message.c_str(), message.length(), 0) != static_cast<ssize_t>(message.length())) {
-            return false;
+    int sent_count = 0;
+    for (const PeerChannelPtr& channel : random_sample(view, fanout)) {
+        if (channel->send(message)) {
+            sent_count++;
         }
     }
+    return sent_count;
+}
+
+/**
+ * Přijatá gossip zpráva: zobrazení a přeposlání se sníženým TTL
+ * Duplikát (už viděná zpráva) se zahodí.
+ */
+void handle_gossip(const GossipMessage& message, const PeerChannel* from) {
+    if (!seen_gossip.insert(message.id) || message.origin == username) {
+        return;
+    }
+    std::cout << "\n[" << message.origin << "] " << message.text << std::endl;
+    if (message.ttl > 1) {
+        GossipMessage forward = message;
+        forward.ttl--;
+        send_to_random_peers(format_gossip(forward), GOSSIP_FANOUT, from);
+    }
+}
+
+std::shared_ptr<OutgoingTransfer> find_outgoing(const std::string& id) {
+    std::lock_guard<std::mutex> lock(transfers_mutex);
+    auto found = outgoing_transfers.find(id);
+    return found != outgoing_transfers.end() ? found->second : std::shared_ptr<OutgoingTransfer>();
+}
+
+void fail_transfer(OutgoingTransfer& transfer, const std::string& error) {
+    std::lock_guard<std::mutex> lock(transfer.mutex);
+    if (transfer.phase != OutgoingTransfer::COMPLETE && transfer.phase != OutgoingTransfer::FAILED) {
+        transfer.phase = OutgoingTransfer::FAILED;
+        transfer.error = error;
+    }
+    transfer.changed.notify_all();
+}
+
+/**
+ * Odpověď příjemce na odchozí přenos (FILE_ACCEPT/ACK/NACK/...)
+ */
+void handle_transfer_reply(const std::string& message) {
+    bool accept = has_file_prefix(message, FILE_ACCEPT);
+    bool ack = has_file_prefix(message, FILE_ACK);
+    bool nack = has_file_prefix(message, FILE_NACK);
+    bool complete = has_file_prefix(message, FILE_COMPLETE);
+    bool failed = has_file_prefix(message, FILE_REJECT) || has_file_prefix(message, FILE_FAILED);
+    if (!accept && !ack && !nack && !complete && !failed) {
+        return;
+    }
+    const char* prefix = accept ? FILE_ACCEPT : ack ? FILE_ACK : nack ? FILE_NACK : complete ? FILE_COMPLETE :
+                         has_file_prefix(message, FILE_REJECT) ? FILE_REJECT : FILE_FAILED;
+    std::vector<std::string> fields = split_file_fields(message, prefix, 2);
+    std::shared_ptr<OutgoingTransfer> transfer = find_outgoing(fields[0]);
+    if (!transfer) {
+        return;
+    }
     
-    return true;
+    if (failed) {
+        fail_transfer(*transfer, fields.size() > 1 ? fields[1] : "odmítnuto");
+        return;
+    }
+    std::lock_guard<std::mutex> lock(transfer->mutex);
+    if (accept && transfer->phase == OutgoingTransfer::OFFERED) {
+        // Bloky, které příjemce už má (obnovení přerušeného přenosu)
+        std::vector<bool> present(transfer->chunks.size(), false);
+        if (fields.size() > 1) parse_chunk_ranges(fields[1], present);
+        for (size_t i = 0; i < present.size(); ++i) {
+            if (present[i]) {
+                transfer->chunks[i] = OutgoingTransfer::ACKED;
+                transfer->acked++;
+            }
+        }
+        transfer->resumed = transfer->acked;
+        transfer->phase = OutgoingTransfer::SENDING;
+    } else if ((ack || nack) && fields.size() > 1) {
+        size_t index = std::strtoul(fields[1].c_str(), nullptr, 10);
+        if (index < transfer->chunks.size() && transfer->chunks[index] == OutgoingTransfer::IN_FLIGHT) {
+            transfer->in_flight--;
+            if (ack) {
+                transfer->chunks[index] = OutgoingTransfer::ACKED;
+                transfer->acked++;
+            } else {
+                transfer->chunks[index] = OutgoingTransfer::PENDING;
+                transfer->resend.push_back(index);
+            }
+        }
+    } else if (complete && transfer->phase == OutgoingTransfer::FINISHING) {
+        transfer->phase = OutgoingTransfer::COMPLETE;
+    }
+    transfer->changed.notify_all();
 }
 
 /**
- * Přijme zprávu s prefixem délky
+ * Vlákno odesílatele souboru: nabídka, posuvné okno bloků, dokončení
  */
-std::string receive_message(int sock) {
-    uint32_t message_length_net;
-    if (recv(sock, &message_length_net, 4, MSG_WAITALL) != 4) {
-        return "";
+void run_outgoing_transfer(std::shared_ptr<OutgoingTransfer> transfer) {
+    OutgoingTransfer& t = *transfer;
+    auto start = std::chrono::steady_clock::now();
+    const std::chrono::seconds timeout(FILE_ACK_TIMEOUT);
+    uint64_t size = t.source.size();
+    // Zařazené bloky drží zdrojový soubor, dokud neodejdou (i po konci přenosu)
+    std::shared_ptr<const SourceFile> source(transfer, &t.source);
+    
+    t.channel->send(FILE_OFFER + t.id + ":" + std::to_string(size) + ":" + std::to_string(FILE_CHUNK_SIZE) + ":" +
+                    hex32(t.source.checksum_range(0, static_cast<size_t>(size))) + ":" + t.name);
+    
+    std::vector<size_t> batch;
+    size_t next = 0;
+    std::unique_lock<std::mutex> lock(t.mutex);
+    while (t.phase == OutgoingTransfer::OFFERED || t.phase == OutgoingTransfer::SENDING) {
+        if (t.phase == OutgoingTransfer::SENDING && t.acked == t.chunks.size()) {
+            t.phase = OutgoingTransfer::FINISHING;
+            lock.unlock();
+            t.channel->send(FILE_DONE + t.id);
+            lock.lock();
+            break;
+        }
+        
+        // Doplnění okna: nejdřív bloky s NACK, pak další v pořadí
+        batch.clear();
+        while (t.phase == OutgoingTransfer::SENDING && t.in_flight + batch.size() < FILE_WINDOW) {
+            size_t index;
+            if (!t.resend.empty()) {
+                index = t.resend.front();
+                t.resend.pop_front();
+            } else {
+                while (next < t.chunks.size() && t.chunks[next] != OutgoingTransfer::PENDING) ++next;
+                if (next == t.chunks.size()) break;
+                index = next++;
+            }
+            t.chunks[index] = OutgoingTransfer::IN_FLIGHT;
+            batch.push_back(index);
+        }
+        
+        if (!batch.empty()) {
+            t.in_flight += batch.size();
+            lock.unlock();
+            bool sent = true;
+            for (size_t index : batch) {
+                uint64_t offset = static_cast<uint64_t>(index) * FILE_CHUNK_SIZE;
+                size_t length = chunk_length(size, FILE_CHUNK_SIZE, index);
+                std::string header = FILE_CHUNK + t.id + ":" + std::to_string(index) + ":" +
+                                     hex32(t.source.checksum_range(offset, length));
+                if (!t.channel->send_file_chunk(header, source, static_cast<off_t>(offset), length)) {
+                    sent = false;
+                    break;
+                }
+            }
+            lock.lock();
+            if (!sent && t.phase != OutgoingTransfer::FAILED) {
+                t.phase = OutgoingTransfer::FAILED;
+                t.error = "spojení přerušeno";
+            }
+            continue;
+        }
+        
+        // Okno je plné (nebo se čeká na FILE_ACCEPT) - čekání na odpověď
+        size_t acked = t.acked;
+        OutgoingTransfer::Phase phase = t.phase;
+        if (!t.changed.wait_for(lock, timeout, [&]() {
+                return t.acked != acked || t.phase != phase || !t.resend.empty();
+            })) {
+            t.phase = OutgoingTransfer::FAILED;
+            t.error = "vypršel čas potvrzení";
+        }
     }
     
-    uint32_t message_length = ntohl(message_length_net);
+    if (t.phase == OutgoingTransfer::FINISHING &&
+        !t.changed.wait_for(lock, timeout, [&]() { return t.phase != OutgoingTransfer::FINISHING; })) {
+        t.phase = OutgoingTransfer::FAILED;
+        t.error = "vypršel čas potvrzení";
+    }
     
-    if (message_length > MAX_MESSAGE_SIZE) {
-        return "";
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (t.phase == OutgoingTransfer::COMPLETE) {
+        std::cout << "\n[SOUBOR] " << t.name << " odeslán peeru " << t.peer << " (" << size << " B za "
+                  << seconds << " s";
+        if (t.resumed > 0) std::cout << ", " << t.resumed << " bloků už příjemce měl";
+        std::cout << ")" << std::endl;
+    } else {
+        std::cout << "\n[SOUBOR] Odeslání " << t.name << " selhalo: " << t.error << " (potvrzeno "
+                  << t.acked << "/" << t.chunks.size() << " bloků, další /send přenos dokončí)" << std::endl;
     }
+    lock.unlock();
     
-    std::string message(message_length, '\0');
-    if (message_length > 0) {
-        if (recv(sock, &message[0], message_length, MSG_WAITALL) != static_cast<ssize_t>(message_length)) {
-            return "";
+    std::lock_guard<std::mutex> transfers_lock(transfers_mutex);
+    outgoing_transfers.erase(t.id);
+}
+
+/**
+ * Zahájení odeslání souboru peeru
+ */
+bool start_file_transfer(const PeerChannelPtr& channel, const std::string& peer, const std::string& path) {
+    std::shared_ptr<OutgoingTransfer> transfer = std::make_shared<OutgoingTransfer>();
+    if (!transfer->source.open(path)) {
+        std::cout << "Chyba: Soubor " << path << " nelze otevřít" << std::endl;
+        return false;
+    }
+    size_t slash = path.rfind('/');
+    transfer->name = slash == std::string::npos ? path : path.substr(slash + 1);
+    if (!valid_file_name(transfer->name)) {
+        std::cout << "Chyba: Neplatné jméno souboru " << transfer->name << std::endl;
+        return false;
+    }
+    char id[17];
+    std::snprintf(id, sizeof(id), "%016llx", static_cast<unsigned long long>(new_gossip_id()));
+    transfer->id = id;
+    transfer->peer = peer;
+    transfer->channel = channel;
+    transfer->chunks.assign(chunk_count(transfer->source.size(), FILE_CHUNK_SIZE), OutgoingTransfer::PENDING);
+    {
+        std::lock_guard<std::mutex> lock(transfers_mutex);
+        outgoing_transfers[transfer->id] = transfer;
+    }
+    std::cout << "Nabídka souboru " << transfer->name << " (" << transfer->source.size() << " B) odeslána peeru "
+              << peer << std::endl;
+    worker_thread(run_outgoing_transfer, transfer).detach();
+    return true;
+}
+
+/**
+ * Data bloku souboru (rámec hned za hlavičkou FILE_CHUNK)
+ * Blok neznámého přenosu nebo přenosu nabídnutého jiným spojením se zahodí.
+ */
+void handle_file_chunk(const PeerChannelPtr& channel, const std::string& header, const MessageView& data) {
+    std::vector<std::string> fields = split_file_fields(header, FILE_CHUNK, 3);
+    std::shared_ptr<IncomingTransfer> transfer;
+    {
+        std::lock_guard<std::mutex> lock(transfers_mutex);
+        auto found = incoming_transfers.find(fields[0]);
+        if (found != incoming_transfers.end()) transfer = found->second;
+    }
+    if (!transfer || transfer->channel != channel.get() || fields.size() < 3) {
+        return;
+    }
+    uint32_t crc = static_cast<uint32_t>(std::strtoul(fields[2].c_str(), nullptr, 16));
+    bool valid = checksum(reinterpret_cast<const unsigned char*>(data.data), data.size) == crc &&
+                 transfer->file.write_chunk(std::strtoul(fields[1].c_str(), nullptr, 10), data.data, data.size);
+    channel->send((valid ? FILE_ACK : FILE_NACK) + fields[0] + ":" + fields[1]);
+}
+
+/**
+ * Zpráva přenosu souboru (kromě FILE_CHUNK) ve smyčce událostí
+ */
+void handle_file_message(const PeerChannelPtr& channel, const std::string& peer_username, const std::string& message) {
+    if (has_file_prefix(message, FILE_OFFER)) {
+        std::vector<std::string> fields = split_file_fields(message, FILE_OFFER, 5);
+        if (fields.size() < 5) {
+            return;
         }
+        std::shared_ptr<IncomingTransfer> transfer = std::make_shared<IncomingTransfer>();
+        transfer->channel = channel.get();
+        transfer->name = fields[4];
+        transfer->peer = peer_username;
+        transfer->size = std::strtoull(fields[1].c_str(), nullptr, 10);
+        transfer->chunk_size = std::strtoul(fields[2].c_str(), nullptr, 10);
+        uint32_t crc = static_cast<uint32_t>(std::strtoul(fields[3].c_str(), nullptr, 16));
+        
+        std::string error;
+        struct stat existing;
+        if (!valid_file_name(transfer->name)) {
+            error = "neplatné jméno souboru";
+        } else if (transfer->chunk_size == 0 || transfer->chunk_size > FILE_CHUNK_SIZE) {
+            error = "nepodporovaná velikost bloku";
+        } else if (transfer->size > FILE_MAX_SIZE) {
+            error = "soubor je příliš velký";
+        } else if (lstat((download_dir + "/" + transfer->name).c_str(), &existing) == 0) {
+            error = "soubor už existuje";
+        } else if (!transfer->file.open(download_dir + "/" + transfer->name, transfer->size, transfer->chunk_size, crc)) {
+            error = std::string("nelze zapsat: ") + std::strerror(errno);
+        }
+        if (!error.empty()) {
+            std::cout << "\n[SOUBOR] Odmítnuto " << transfer->name << " od " << peer_username << ": " << error << std::endl;
+            channel->send(FILE_REJECT + fields[0] + ":" + error);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(transfers_mutex);
+            auto found = incoming_transfers.find(fields[0]);
+            if (found != incoming_transfers.end() && found->second->channel != channel.get()) {
+                error = "id přenosu je obsazené";
+            } else {
+                incoming_transfers[fields[0]] = transfer;
+            }
+        }
+        if (!error.empty()) {
+            std::cout << "\n[SOUBOR] Odmítnuto " << transfer->name << " od " << peer_username << ": " << error << std::endl;
+            channel->send(FILE_REJECT + fields[0] + ":" + error);
+            return;
+        }
+        std::cout << "\n[SOUBOR] Přijímám " << transfer->name << " (" << transfer->size << " B) od " << peer_username;
+        if (transfer->file.received() > 0) {
+            std::cout << ", obnoveno " << transfer->file.received() << "/" << transfer->file.chunks().size() << " bloků";
+        }
+        std::cout << std::endl;
+        channel->send(FILE_ACCEPT + fields[0] + ":" + encode_chunk_ranges(transfer->file.chunks()));
+        return;
     }
     
-    return message;
+    if (has_file_prefix(message, FILE_DONE)) {
+        std::string id = message.substr(std::strlen(FILE_DONE));
+        std::shared_ptr<IncomingTransfer> transfer;
+        {
+            std::lock_guard<std::mutex> lock(transfers_mutex);
+            auto found = incoming_transfers.find(id);
+            if (found == incoming_transfers.end() || found->second->channel != channel.get()) return;
+            transfer = found->second;
+            incoming_transfers.erase(found);
+        }
+        std::string error;
+        if (transfer->file.finish(error)) {
+            std::cout << "\n[SOUBOR] " << transfer->name << " přijat od " << transfer->peer << " ("
+                      << transfer->size << " B)" << std::endl;
+            channel->send(FILE_COMPLETE + id);
+        } else {
+            std::cout << "\n[SOUBOR] Příjem " << transfer->name << " selhal: " << error << std::endl;
+            channel->send(FILE_FAILED + id + ":" + error);
+        }
+        return;
+    }
+    
+    handle_transfer_reply(message);
 }
 
 /**
- * Obsluha příchozího peera
+ * Ukončení přenosů spojení po odpojení peera
+ * Rozpracované příchozí soubory zůstanou na disku pro obnovení.
  */
-void handle_incoming_peer(int peer_sock, std::string peer_host, int peer_port) {
-    std::pair<std::string, int> peer_address = std::make_pair(peer_host, peer_port);
-    std::string peer_username = "Peer_" + std::to_string(peer_port);
-    
-    try {
-        // Přijetí uživatelského jména
-        std::string welcome_msg = receive_message(peer_sock);
-        if (!welcome_msg.empty() && welcome_msg.find("USERNAME:") == 0) {
-            peer_username = welcome_msg.substr(9);
-            if (peer_username.length() > 20) peer_username = peer_username.substr(0, 20);
+void drop_peer_transfers(const PeerChannel* channel) {
+    std::vector<std::shared_ptr<OutgoingTransfer>> outgoing;
+    {
+        std::lock_guard<std::mutex> lock(transfers_mutex);
+        for (auto it = incoming_transfers.begin(); it != incoming_transfers.end();) {
+            it = it->second->channel == channel ? incoming_transfers.erase(it) : std::next(it);
+        }
+        for (const auto& pair : outgoing_transfers) {
+            if (pair.second->channel.get() == channel) outgoing.push_back(pair.second);
+        }
+    }
+    for (const auto& transfer : outgoing) {
+        fail_transfer(*transfer, "spojení přerušeno");
+    }
+}
+
+/**
+ * Spojení s peerem ve smyčce událostí (jen vlákno smyčky)
+ */
+struct PeerConnection {
+    enum Stage {
+        AWAIT_USERNAME,   // Příchozí spojení čeká na USERNAME:
+        AWAIT_WELCOME,    // Odchozí spojení čeká na uvítání protějšku
+        OPEN
+    };
+
+    PeerConnection() : decoder(FILE_CHUNK_SIZE) {}
+
+    PeerChannelPtr channel;
+    std::pair<std::string, int> address;  // Klíč v connected_peers (u odchozích cíl z poolu)
+    std::string username;
+    FrameDecoder decoder;
+    Stage stage;
+    bool outbound;
+    std::string pending_chunk;            // Hlavička FILE_CHUNK, další rámec jsou data bloku
+    double opened;
+    double last_received;
+    double last_ping;
+};
+
+/**
+ * Odchozí spojení v poolu (klíč host:port z /connect nebo --connect)
+ * Spojený peer se po výpadku vytáčí znovu, dokud ho /disconnect neodebere.
+ */
+struct PoolEntry {
+    enum State { BACKOFF, CONNECTING, CONNECTED };
+
+    std::vector<SocketAddress> addresses;
+    State state = BACKOFF;
+    int fd = -1;                 // Vytáčený nebo spojený socket
+    size_t attempt = 0;          // Zkoušená adresa
+    double deadline = 0;         // Konec limitu vytáčení
+    double retry_at = 0;
+    ReconnectBackoff backoff;
+    bool reported = false;       // Neúspěch už byl vypsán (bez opakování při každém pokusu)
+};
+
+// Požadavek jiného vlákna na smyčku událostí
+struct LoopRequest {
+    enum Type { DIAL, DISCONNECT };
+    Type type;
+    std::pair<std::string, int> target;
+    std::vector<SocketAddress> addresses;
+    std::string peer;            // DISCONNECT: jméno nebo host:port
+};
+
+std::deque<LoopRequest> loop_requests;
+std::mutex loop_mutex;
+int loop_wakeup = -1;            // eventfd - probuzení smyčky kvůli požadavku
+
+void post_loop_request(const LoopRequest& request) {
+    {
+        std::lock_guard<std::mutex> lock(loop_mutex);
+        loop_requests.push_back(request);
+    }
+    uint64_t one = 1;
+    if (write(loop_wakeup, &one, sizeof(one)) < 0) {
+        // Čítač eventfd je nenulový i tak, smyčka se probudí
+    }
+}
+
+/**
+ * Sdílená smyčka událostí pro všechna spojení s peery
+ * Jedno vlákno s epoll přijímá příchozí spojení, dokončuje neblokující
+ * connect() odchozích, čte zprávy ze všech spojení a hlídá časové limity
+ * a heartbeat. Nikdy nečeká na zápis: odesílatelé (tato smyčka i ostatní
+ * vlákna) zprávy jen zařadí do bufferu spojení (PeerChannel) a co socket
+ * hned nepřijme, smyčka dopíše při EPOLLOUT.
+ */
+class PeerLoop {
+public:
+    explicit PeerLoop(int listener) : listener_(listener), epoll_(epoll_create1(EPOLL_CLOEXEC)) {}
+
+    bool valid() const {
+        return epoll_ >= 0;
+    }
+
+    void run() {
+        watch(listener_, EPOLLIN, EPOLL_CTL_ADD);
+        watch(loop_wakeup, EPOLLIN, EPOLL_CTL_ADD);
+        epoll_event events[64];
+        double next_check = 0;
+        while (peer_running) {
+            // Časové limity stačí hlídat s přesností na desetiny sekundy
+            int count = epoll_wait(epoll_, events, 64, 100);
+            double now = monotonic_seconds();
+            for (int i = 0; i < count; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listener_) {
+                    accept_peers(now);
+                } else if (fd == loop_wakeup) {
+                    uint64_t value;
+                    if (read(loop_wakeup, &value, sizeof(value)) < 0) {
+                        // Přečteno jiným probuzením
+                    }
+                    process_requests(now);
+                } else if (dialing_.count(fd)) {
+                    finish_connect(fd, now);
+                } else if (connections_.count(fd)) {
+                    if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                        read_peer(fd, now);
+                    }
+                    if ((events[i].events & EPOLLOUT) && connections_.count(fd) && !connections_[fd]->channel->flush()) {
+                        close_connection(fd, now);
+                    }
+                }
+            }
+            if (now >= next_check) {
+                check_timers(now);
+                next_check = now + 0.1;
+            }
         }
         
-        // Přidání peera
+        while (!connections_.empty()) {
+            close_connection(connections_.begin()->first, monotonic_seconds());
+        }
+        for (const auto& pair : dialing_) {
+            close(pair.first);
+        }
+        close(epoll_);
+    }
+
+private:
+    void watch(int fd, uint32_t events, int operation) {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd;
+        epoll_ctl(epoll_, operation, fd, &event);
+    }
+
+    void add_connection(int fd, const std::pair<std::string, int>& address, bool outbound, double now) {
+        std::unique_ptr<PeerConnection> connection(new PeerConnection());
+        connection->channel = std::make_shared<PeerChannel>(fd);
+        // Neodeslaná data zapnou EPOLLOUT, vyprázdněný buffer ho vypne (epoll_ctl smí kterékoli vlákno)
+        int epoll = epoll_;
+        connection->channel->set_pending_callback([epoll, fd](bool pending) {
+            epoll_event event{};
+            event.events = pending ? EPOLLIN | EPOLLOUT : EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &event);
+        });
+        connection->address = address;
+        connection->username = "Peer_" + std::to_string(address.second);
+        connection->stage = outbound ? PeerConnection::AWAIT_WELCOME : PeerConnection::AWAIT_USERNAME;
+        connection->outbound = outbound;
+        connection->opened = connection->last_received = connection->last_ping = now;
+        connections_[fd] = std::move(connection);
+    }
+
+    void accept_peers(double now) {
+        while (true) {
+            sockaddr_storage peer_addr;
+            socklen_t addr_len = sizeof(peer_addr);
+            int peer_sock = accept4(listener_, (sockaddr*)&peer_addr, &addr_len, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (peer_sock < 0) {
+                return;
+            }
+            apply_socket_tuning(peer_sock, peer_socket_tuning);
+            watch(peer_sock, EPOLLIN, EPOLL_CTL_ADD);
+            add_connection(peer_sock, std::make_pair(address_text(peer_addr), address_port(peer_addr)), false, now);
+        }
+    }
+
+    void process_requests(double now) {
+        std::deque<LoopRequest> requests;
         {
-            std::lock_guard<std::mutex> lock(peers_mutex);
-            if (connected_peers.size() >= MAX_PEERS) {
-                send_message(peer_sock, "ERROR: Maximální počet peerů dosažen");
-                close(peer_sock);
+            std::lock_guard<std::mutex> lock(loop_mutex);
+            requests.swap(loop_requests);
+        }
+        for (LoopRequest& request : requests) {
+            if (request.type == LoopRequest::DIAL) {
+                if (pool_.count(request.target)) {
+                    std::cout << "Již jste připojeni k " << endpoint_text(request.target.first, request.target.second)
+                              << std::endl;
+                    continue;
+                }
+                PoolEntry& entry = pool_[request.target];
+                entry.addresses.swap(request.addresses);
+                dial(request.target, entry, now);
+            } else {
+                disconnect(request.peer, now);
+            }
+        }
+    }
+
+    /**
+     * Vytočení další adresy peera (neblokující connect)
+     */
+    void dial(const std::pair<std::string, int>& target, PoolEntry& entry, double now) {
+        int error = 0;
+        while (entry.attempt < entry.addresses.size()) {
+            int fd = start_connect(entry.addresses[entry.attempt], peer_socket_tuning);
+            if (fd >= 0) {
+                entry.fd = fd;
+                entry.state = PoolEntry::CONNECTING;
+                entry.deadline = now + CONNECTION_TIMEOUT;
+                dialing_[fd] = target;
+                watch(fd, EPOLLOUT, EPOLL_CTL_ADD);
                 return;
             }
-            PeerInfo info;
-            info.socket = peer_sock;
-            info.username = peer_username;
-            info.last_heartbeat = time(nullptr);
-            connected_peers[peer_address] = info;
-            std::cout << "Peer připojen: " << peer_username << " (" << peer_host << ":" << peer_port << ")" << std::endl;
+            error = errno;
+            entry.attempt++;
+        }
+        retry_later(target, entry, std::strerror(error), now);
+    }
+
+    void retry_later(const std::pair<std::string, int>& target, PoolEntry& entry, const std::string& reason, double now) {
+        double delay = entry.backoff.next();
+        entry.fd = -1;
+        entry.attempt = 0;
+        entry.state = PoolEntry::BACKOFF;
+        entry.retry_at = now + delay;
+        if (!entry.reported) {
+            std::cout << "\nChyba: Nelze se připojit k " << endpoint_text(target.first, target.second) << " (" << reason
+                      << "), zkouším znovu (/disconnect zruší)" << std::endl;
+            entry.reported = true;
         }
+    }
+
+    // Neúspěšný pokus: další adresa, jinak nový pokus po prodlevě
+    void dial_failed(const std::pair<std::string, int>& target, PoolEntry& entry, int error, double now) {
+        dialing_.erase(entry.fd);
+        close(entry.fd);
+        entry.fd = -1;
+        entry.attempt++;
+        if (entry.attempt < entry.addresses.size()) {
+            dial(target, entry, now);
+        } else {
+            retry_later(target, entry, std::strerror(error), now);
+        }
+    }
+
+    void finish_connect(int fd, double now) {
+        std::pair<std::string, int> target = dialing_[fd];
+        PoolEntry& entry = pool_[target];
+        int error = connect_result(fd);
+        if (error != 0) {
+            dial_failed(target, entry, error, now);
+            return;
+        }
+        dialing_.erase(fd);
+        entry.state = PoolEntry::CONNECTED;
+        add_connection(fd, target, true, now);
+        watch(fd, EPOLLIN, EPOLL_CTL_MOD);
+        connections_[fd]->channel->send("USERNAME:" + username);
+    }
+
+    void read_peer(int fd, double now) {
+        PeerConnection& connection = *connections_[fd];
+        ssize_t received = connection.decoder.fill(fd, MSG_DONTWAIT);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+            close_connection(fd, now);
+            return;
+        }
+        connection.last_received = now;
         
-        // Odeslání uvítací zprávy
-        send_message(peer_sock, "Vítejte v P2P síti, " + peer_username + "! Jste připojeni k " + username + ".");
+        MessageView message;
+        FrameDecoder::Status status;
+        while ((status = connection.decoder.next(message)) == FrameDecoder::FRAME) {
+            if (!handle_frame(connection, message)) {
+                close_connection(fd, now);
+                return;
+            }
+        }
+        if (status == FrameDecoder::TOO_LARGE) {
+            close_connection(fd, now);
+        }
+    }
+
+    /**
+     * Jedna přijatá zpráva
+     * @return false pokud se spojení má zavřít
+     */
+    bool handle_frame(PeerConnection& connection, const MessageView& frame) {
+        if (!connection.pending_chunk.empty()) {
+            std::string header;
+            header.swap(connection.pending_chunk);
+            handle_file_chunk(connection.channel, header, frame);
+            return true;
+        }
+        if (frame.size > MAX_MESSAGE_SIZE) {
+            return false;
+        }
+        std::string message = frame.str();
         
-        // Hlavní smyčka
-        while (peer_running) {
-            std::string message = receive_message(peer_sock);
-            
-            if (message.empty()) {
-                break;
+        if (connection.stage == PeerConnection::AWAIT_USERNAME) {
+            // Přijetí uživatelského jména
+            if (message.find("USERNAME:") == 0) {
+                connection.username = message.substr(9);
+                if (connection.username.length() > 20) connection.username = connection.username.substr(0, 20);
             }
-            
-            // Aktualizace heartbeat
+            // Přidání peera
             {
                 std::lock_guard<std::mutex> lock(peers_mutex);
-                if (connected_peers.find(peer_address) != connected_peers.end()) {
-                    connected_peers[peer_address].last_heartbeat = time(nullptr);
+                if (connected_peers.size() >= static_cast<size_t>(max_peers)) {
+                    connection.channel->send("ERROR: Maximální počet peerů dosažen");
+                    return false;
                 }
+                register_peer(connection);
+                std::cout << "\nPeer připojen: " << connection.username << " ("
+                          << endpoint_text(connection.address.first, connection.address.second) << ")" << std::endl;
             }
-            
-            // Zpracování zprávy
-            if (message == "/quit") {
-                send_message(peer_sock, "Odpojování...");
-                break;
-            } else {
-                send_message(peer_sock, "Echo: " + message);
+            // Odeslání uvítací zprávy
+            connection.channel->send("Vítejte v P2P síti, " + connection.username + "! Jste připojeni k " + username + ".");
+            return true;
+        }
+        
+        if (connection.stage == PeerConnection::AWAIT_WELCOME) {
+            std::cout << "\n✓ " << message << std::endl;
+            // Jméno protějšku z uvítání "... Jste připojeni k <jméno>." (C++ i Python peer)
+            const std::string connected_to = "Jste připojeni k ";
+            size_t name_pos = message.rfind(connected_to);
+            if (name_pos != std::string::npos && message.size() > name_pos + connected_to.size() + 1 &&
+                message.back() == '.') {
+                name_pos += connected_to.size();
+                connection.username = message.substr(name_pos, message.size() - name_pos - 1);
+            }
+            if (message.find("ERROR:") == 0) {
+                return false;
             }
+            PoolEntry& entry = pool_[connection.address];
+            entry.backoff.reset();
+            entry.reported = false;
+            std::lock_guard<std::mutex> lock(peers_mutex);
+            register_peer(connection);
+            return true;
         }
-    } catch (...) {
-        // Chyba
+        
+        // Zpracování zprávy
+        GossipMessage gossip;
+        if (has_file_prefix(message, FILE_CHUNK)) {
+            connection.pending_chunk = message;
+        } else if (message.compare(0, 5, "FILE_") == 0) {
+            handle_file_message(connection.channel, connection.username, message);
+        } else if (parse_gossip(message, gossip)) {
+            handle_gossip(gossip, connection.channel.get());
+        } else if (message == "/quit") {
+            connection.channel->send("Odpojování...");
+            return false;
+        } else if (message == "PING") {
+            connection.channel->send("PONG");
+        } else if (message == "PONG" || message == "Echo: PING") {
+            // Odpověď na heartbeat (Python peer PING jen vrátí jako Echo)
+        } else {
+            std::cout << "\n[" << connection.username << "] " << message << std::endl;
+            if (!connection.outbound) {
+                connection.channel->send("Echo: " + message);
+            }
+        }
+        return true;
     }
-    
-    // Odstranění peera
-    {
-        std::lock_guard<std::mutex> lock(peers_mutex);
-        connected_peers.erase(peer_address);
-        std::cout << "Peer odpojen: " << peer_username << std::endl;
+
+    // Volá se pod peers_mutex
+    void register_peer(PeerConnection& connection) {
+        PeerInfo info;
+        info.channel = connection.channel;
+        info.username = connection.username;
+        info.outbound = connection.outbound;
+        connected_peers[connection.address] = info;
+        connection.stage = PeerConnection::OPEN;
+    }
+
+    void close_connection(int fd, double now) {
+        std::unique_ptr<PeerConnection> connection = std::move(connections_[fd]);
+        connections_.erase(fd);
+        epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+        // Odesílatelé s odkazem na kanál skončí chybou, fd zavře poslední odkaz
+        connection->channel->close_channel();
+        shutdown(fd, SHUT_RDWR);
+        drop_peer_transfers(connection->channel.get());
+        
+        if (connection->stage == PeerConnection::OPEN) {
+            std::lock_guard<std::mutex> lock(peers_mutex);
+            auto found = connected_peers.find(connection->address);
+            if (found != connected_peers.end() && found->second.channel == connection->channel) {
+                connected_peers.erase(found);
+            }
+            std::cout << "\nPeer odpojen: " << connection->username << std::endl;
+        }
+        
+        // Odchozí spojení z poolu se vytočí znovu
+        auto entry = pool_.find(connection->address);
+        if (connection->outbound && entry != pool_.end() && entry->second.fd == fd && peer_running) {
+            if (connection->stage == PeerConnection::OPEN) {
+                std::cout << "Spojení s " << endpoint_text(connection->address.first, connection->address.second)
+                          << " se obnoví" << std::endl;
+                entry->second.reported = true;
+            }
+            retry_later(connection->address, entry->second, "spojení přerušeno", now);
+        }
+    }
+
+    /**
+     * /disconnect - odebrání z poolu (bez obnovy) a zavření spojení
+     */
+    void disconnect(const std::string& peer, double now) {
+        std::vector<int> targets;
+        for (const auto& pair : connections_) {
+            const PeerConnection& connection = *pair.second;
+            if (connection.username == peer || endpoint_text(connection.address.first, connection.address.second) == peer) {
+                targets.push_back(pair.first);
+                pool_.erase(connection.address);
+            }
+        }
+        for (auto it = pool_.begin(); it != pool_.end();) {
+            if (endpoint_text(it->first.first, it->first.second) != peer) {
+                ++it;
+                continue;
+            }
+            if (it->second.state == PoolEntry::CONNECTING) {
+                dialing_.erase(it->second.fd);
+                close(it->second.fd);
+            }
+            it = pool_.erase(it);
+            targets.push_back(-1);
+        }
+        for (int fd : targets) {
+            if (fd >= 0) close_connection(fd, now);
+        }
+        std::cout << (targets.empty() ? "Peer " + peer + " není připojen" : "Odpojeno: " + peer) << std::endl;
+    }
+
+    /**
+     * Časové limity vytáčení a handshake, obnova spojení, heartbeat
+     */
+    void check_timers(double now) {
+        for (auto& pair : pool_) {
+            PoolEntry& entry = pair.second;
+            if (entry.state == PoolEntry::CONNECTING && now >= entry.deadline) {
+                dial_failed(pair.first, entry, ETIMEDOUT, now);
+            } else if (entry.state == PoolEntry::BACKOFF && now >= entry.retry_at) {
+                dial(pair.first, entry, now);
+            }
+        }
+        
+        std::vector<int> expired;
+        for (auto& pair : connections_) {
+            PeerConnection& connection = *pair.second;
+            double idle = now - connection.last_received;
+            if (connection.stage != PeerConnection::OPEN) {
+                if (now - connection.opened > CONNECTION_TIMEOUT) expired.push_back(pair.first);
+            } else if (idle > 3 * HEARTBEAT_INTERVAL) {
+                // Peer neodpovídá ani na PING
+                expired.push_back(pair.first);
+            } else if (idle >= HEARTBEAT_INTERVAL && now - connection.last_ping >= HEARTBEAT_INTERVAL) {
+                connection.channel->send("PING");
+                connection.last_ping = now;
+            }
+        }
+        for (int fd : expired) {
+            close_connection(fd, now);
+        }
     }
-    
-    close(peer_sock);
-}
+
+    int listener_;
+    int epoll_;
+    std::map<int, std::unique_ptr<PeerConnection>> connections_;
+    std::map<int, std::pair<std::string, int>> dialing_;       // fd -> klíč v poolu
+    std::map<std::pair<std::string, int>, PoolEntry> pool_;
+};
 
 /**
- * Vlákno pro naslouchání
+ * Naslouchací socket pro peery (dual-stack IPv6, bez podpory IPv6 jen IPv4)
  */
-void listener_thread_func() {
-    listener_socket = socket(AF_INET, SOCK_STREAM, 0);
-    
-    if (listener_socket < 0) {
-        return;
+int open_peer_listener(int port) {
+    int opt = 1;
+    int off = 0;
+    int listener = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener >= 0) {
+        setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        sockaddr_in6 addr6{};
+        addr6.sin6_family = AF_INET6;
+        addr6.sin6_port = htons(port);
+        addr6.sin6_addr = in6addr_any;
+        if (bind(listener, (sockaddr*)&addr6, sizeof(addr6)) == 0 && listen(listener, max_peers) == 0) {
+            return listener;
+        }
+        close(listener);
     }
     
-    int opt = 1;
-    setsockopt(listener_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        return -1;
+    }
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
     
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
-    addr.sin_port = htons(DEFAULT_PORT);
+    addr.sin_port = htons(port);
     addr.sin_addr.s_addr = INADDR_ANY;
     
-    if (bind(listener_socket, (sockaddr*)&addr, sizeof(addr)) < 0) {
-        close(listener_socket);
-        return;
-    }
-    
-    listen(listener_socket, MAX_PEERS);
-    std::cout << "P2P listener naslouchá na portu " << DEFAULT_PORT << std::endl;
-    
-    while (peer_running) {
-        sockaddr_in peer_addr;
-        socklen_t addr_len = sizeof(peer_addr);
-        int peer_sock = accept(listener_socket, (sockaddr*)&peer_addr, &addr_len);
-        
-        if (peer_sock < 0) {
-            continue;
-        }
-        
-        char peer_host[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &peer_addr.sin_addr, peer_host, INET_ADDRSTRLEN);
-        int peer_port = ntohs(peer_addr.sin_port);
-        
-        std::thread(handle_incoming_peer, peer_sock, std::string(peer_host), peer_port).detach();
+    if (bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, max_peers) < 0) {
+        close(listener);
+        return -1;
     }
-    
-    close(listener_socket);
+    return listener;
 }
 
 /**
- * Připojení k peeru
+ * Připojení k peeru (přidání do poolu, vytáčí smyčka událostí)
+ * Adresa se přeloží tady - getaddrinfo by smyčku zablokovalo.
  */
 bool connect_to_peer(const std::string& host, int port) {
-    std::pair<std::string, int> peer_address = std::make_pair(host, port);
-    
-    {
-        std::lock_guard<std::mutex> lock(peers_mutex);
-        if (connected_peers.find(peer_address) != connected_peers.end()) {
-            std::cout << "Již jste připojeni k " << host << ":" << port << std::endl;
-            return false;
-        }
-    }
-    
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
+    LoopRequest request;
+    request.type = LoopRequest::DIAL;
+    request.target = std::make_pair(host, port);
+    std::string error = resolve_peer_addresses(host, port, request.addresses);
+    if (!error.empty()) {
+        std::cout << "Chyba: Neznámá adresa " << host << " (" << error << ")" << std::endl;
         return false;
     }
-    
-    sockaddr_in server_addr{};
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    
-    if (inet_pton(AF_INET, host.c_str(), &server_addr.sin_addr) <= 0) {
-        close(sock);
+    post_loop_request(request);
+    return true;
+}
+
+void send_datagram(const std::string& text, const sockaddr_storage& addr, socklen_t length) {
+    sendto(udp_socket, text.data(), text.size(), MSG_NOSIGNAL, (const sockaddr*)&addr, length);
+}
+
+/**
+ * Adresa "host:port" ("[::1]:8079" pro IPv6) pro UDP socket
+ */
+bool resolve_udp_endpoint(const std::string& text, sockaddr_storage& out, socklen_t& length) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos || colon == 0) {
         return false;
     }
+    std::string host = text.substr(0, colon);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    int port = std::atoi(text.c_str() + colon + 1);
     
-    if (connect(sock, (sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        close(sock);
-        std::cout << "Chyba: Nelze se připojit k " << host << ":" << port << std::endl;
+    addrinfo hints{};
+    hints.ai_family = udp_family == AF_INET6 ? AF_UNSPEC : AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* addresses = nullptr;
+    if (port <= 0 || port > 65535 || getaddrinfo(host.c_str(), nullptr, &hints, &addresses) != 0) {
         return false;
     }
-    
-    send_message(sock, "USERNAME:" + username);
-    
-    std::string welcome = receive_message(sock);
-    if (!welcome.empty()) {
-        std::cout << "✓ " << welcome << std::endl;
+    sockaddr_storage found;
+    std::memcpy(&found, addresses->ai_addr, addresses->ai_addrlen);
+    freeaddrinfo(addresses);
+    return socket_address(address_text(found), port, udp_family, out, length);
+}
+
+/**
+ * Začátek hole punchingu k peeru s danou adresou (z PEER nebo INTRODUCE)
+ */
+void start_punch(const std::string& name, const std::string& ip, int port) {
+    UdpPeer peer;
+    if (!socket_address(ip, port, udp_family, peer.addr, peer.length)) {
+        return;
     }
+    double now = monotonic_seconds();
+    std::lock_guard<std::mutex> lock(udp_mutex);
+    auto found = udp_peers.find(name);
+    peer.open = found != udp_peers.end() && found->second.open &&
+                std::memcmp(&found->second.addr, &peer.addr, peer.length) == 0;
+    peer.punch_until = now + PUNCH_TIMEOUT;
+    peer.next_punch = now;
+    udp_peers[name] = peer;
+}
+
+/**
+ * Je k peeru otevřená UDP cesta z této adresy? (zprávy od jiných se zahazují)
+ */
+bool udp_peer_open(const std::string& name, const sockaddr_storage& from) {
+    std::lock_guard<std::mutex> lock(udp_mutex);
+    auto found = udp_peers.find(name);
+    return found != udp_peers.end() && found->second.open && same_endpoint(found->second.addr, from);
+}
+
+void handle_datagram(const std::string& message, const sockaddr_storage& from, socklen_t from_length) {
+    std::string name, ip;
+    int port = 0;
+    bool from_rendezvous = from_length == rendezvous_length &&
+                           std::memcmp(&from, &rendezvous_addr, from_length) == 0;
     
-    {
-        std::lock_guard<std::mutex> lock(peers_mutex);
-        PeerInfo info;
-        info.socket = sock;
-        info.username = "Peer_" + std::to_string(port);
-        info.last_heartbeat = time(nullptr);
-        connected_peers[peer_address] = info;
+    if (from_rendezvous) {
+        if (message.compare(0, 9, RENDEZVOUS_ENDPOINT) == 0) {
+            // Veřejný endpoint se vypíše jen při změně (REGISTER se opakuje)
+            static std::string public_endpoint;
+            if (message.substr(9) != public_endpoint) {
+                public_endpoint = message.substr(9);
+                std::cout << "\n[UDP] Veřejný endpoint u rendezvous: " << public_endpoint << std::endl;
+            }
+            return;
+        }
+        if (message.compare(0, 7, RENDEZVOUS_DENIED) == 0) {
+            // REGISTER se opakuje - odmítnutí se vypíše jen jednou
+            static bool reported = false;
+            if (!reported) {
+                std::cout << "\n[UDP] Rendezvous odmítl registraci jména " << message.substr(7)
+                          << " - token je neplatný nebo prošlý, nový vydá příkaz /rvtoken v chatu" << std::endl;
+                reported = true;
+            }
+            return;
+        }
+        if (message.compare(0, 5, RENDEZVOUS_PEER) == 0 && parse_named_endpoint(message.substr(5), name, ip, port)) {
+            std::cout << "\n[UDP] " << name << " je na " << endpoint_text(ip, port) << ", otevírám cestu..." << std::endl;
+            start_punch(name, ip, port);
+        } else if (message.compare(0, 10, RENDEZVOUS_INTRODUCE) == 0 &&
+                   parse_named_endpoint(message.substr(10), name, ip, port)) {
+            // Protistrana nás hledá - PUNCH z naší strany otevře NAT i pro ni
+            start_punch(name, ip, port);
+        } else if (message.compare(0, 8, RENDEZVOUS_UNKNOWN) == 0) {
+            std::cout << "\n[UDP] Peer " << message.substr(8) << " není u rendezvous registrován" << std::endl;
+        }
+        return;
     }
     
-    return true;
+    if (message.compare(0, 6, PUNCH_REQUEST) == 0 || message.compare(0, 10, PUNCH_ACK) == 0) {
+        bool request = message[5] == ':';
+        std::string sender = message.substr(request ? 6 : 10);
+        bool opened = false;
+        {
+            // Jen peer, kterého ohlásil rendezvous (PEER/INTRODUCE) a jehož punching
+            // ještě běží, z IP od rendezvous - port se za NATem může lišit.
+            // Otevřená cesta přijímá jen ze svého endpointu. Jinak by kdokoli
+            // mohl převzít jméno peera a přesměrovat na sebe jeho UDP broadcast.
+            std::lock_guard<std::mutex> lock(udp_mutex);
+            auto found = udp_peers.find(sender);
+            if (found == udp_peers.end()) return;
+            UdpPeer& peer = found->second;
+            bool punching = monotonic_seconds() < peer.punch_until && address_text(peer.addr) == address_text(from);
+            if (!punching && !(peer.open && same_endpoint(peer.addr, from))) return;
+            opened = !peer.open;
+            peer.addr = from;
+            peer.length = from_length;
+            peer.open = true;
+            peer.punch_until = 0;
+        }
+        if (request) {
+            send_datagram(PUNCH_ACK + username, from, from_length);
+        }
+        if (opened) {
+            std::cout << "\n[UDP] Přímá cesta k " << sender << " (" << endpoint_text(address_text(from), address_port(from))
+                      << ") otevřena" << std::endl;
+        }
+    } else if (message.compare(0, 4, PUNCH_MESSAGE) == 0) {
+        size_t colon = message.find(':', 4);
+        std::string sender = message.substr(4, colon == std::string::npos ? std::string::npos : colon - 4);
+        if (colon != std::string::npos && udp_peer_open(sender, from)) {
+            std::cout << "\n[UDP " << sender << "] " << message.substr(colon + 1) << std::endl;
+        }
+    }
 }
 
 /**
- * Broadcast všem peerům
+ * UDP vlákno: REGISTER u rendezvous, PUNCH datagramy a příjem
+ */
+void udp_thread_func() {
+    double next_register = 0;
+    char buffer[RENDEZVOUS_DATAGRAM_SIZE];
+    while (peer_running) {
+        double now = monotonic_seconds();
+        if (now >= next_register) {
+            send_datagram(RENDEZVOUS_REGISTER + username + ":" + rendezvous_token, rendezvous_addr, rendezvous_length);
+            next_register = now + RENDEZVOUS_KEEPALIVE;
+        }
+        {
+            std::lock_guard<std::mutex> lock(udp_mutex);
+            for (auto& pair : udp_peers) {
+                UdpPeer& peer = pair.second;
+                if (now < peer.punch_until && now >= peer.next_punch) {
+                    send_datagram(PUNCH_REQUEST + username, peer.addr, peer.length);
+                    peer.next_punch = now + PUNCH_INTERVAL;
+                }
+            }
+        }
+        
+        pollfd descriptor = {udp_socket, POLLIN, 0};
+        if (poll(&descriptor, 1, static_cast<int>(PUNCH_INTERVAL * 1000)) <= 0) {
+            continue;
+        }
+        sockaddr_storage from;
+        socklen_t from_length = sizeof(from);
+        ssize_t received = recvfrom(udp_socket, buffer, sizeof(buffer), 0, (sockaddr*)&from, &from_length);
+        if (received > 0) {
+            handle_datagram(std::string(buffer, static_cast<size_t>(received)), from, from_length);
+        }
+    }
+}
+
+/**
+ * Broadcast všem peerům (TCP spojení i otevřené UDP cesty)
+ * V gossip režimu jde zpráva jen GOSSIP_FANOUT náhodným sousedům, kteří ji
+ * šíří dál.
  */
 int broadcast_to_all_peers(const std::string& message) {
     int sent_count = 0;
     
-    std::lock_guard<std::mutex> lock(peers_mutex);
-    for (auto& pair : connected_peers) {
-        if (send_message(pair.second.socket, message)) {
-            sent_count++;
+    if (gossip_mode) {
+        GossipMessage gossip;
+        gossip.id = new_gossip_id();
+        gossip.ttl = GOSSIP_TTL;
+        gossip.origin = username;
+        gossip.text = message;
+        seen_gossip.insert(gossip.id);
+        sent_count = send_to_random_peers(format_gossip(gossip), GOSSIP_FANOUT, nullptr);
+    } else {
+        sent_count = send_to_random_peers(message, max_peers, nullptr);
+    }
+    
+    std::string datagram = PUNCH_MESSAGE + username + ":" + message;
+    if (udp_socket >= 0 && datagram.size() <= RENDEZVOUS_DATAGRAM_SIZE) {
+        std::lock_guard<std::mutex> lock(udp_mutex);
+        for (const auto& pair : udp_peers) {
+            if (pair.second.open) {
+                send_datagram(datagram, pair.second.addr, pair.second.length);
+                sent_count++;
+            }
         }
     }
     
@@ -281,7 +1432,64 @@ int broadcast_to_all_peers(const std::string& message) {
 /**
  * Hlavní funkce
  */
-int main() {
+int main(int argc, char* argv[]) {
+    std::string rendezvous;
+    std::vector<std::string> bootstrap;   // --connect: peery vytočené hned po startu (paralelně)
+    std::vector<std::string> args;        // Parametry z --config a příkazové řádky (ta má přednost)
+    std::string config_error;
+    if (!expand_config_args(argc, argv, args, config_error)) {
+        std::cerr << "Chyba konfigurace: " << config_error << std::endl;
+        return 1;
+    }
+    std::vector<char*> arg_pointers;
+    for (std::string& arg : args) {
+        arg_pointers.push_back(&arg[0]);
+    }
+    argc = static_cast<int>(arg_pointers.size());
+    argv = arg_pointers.data();
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            listen_port = std::atoi(argv[++i]);
+        } else if (arg == "--rendezvous" && i + 1 < argc) {
+            rendezvous = argv[++i];
+        } else if (arg == "--rendezvous-token" && i + 1 < argc) {
+            rendezvous_token = argv[++i];
+        } else if (arg == "--gossip") {
+            gossip_mode = true;
+        } else if (arg == "--download-dir" && i + 1 < argc) {
+            download_dir = argv[++i];
+        } else if (arg == "--connect" && i + 1 < argc) {
+            bootstrap.push_back(argv[++i]);
+        } else if (arg == "--max-peers" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            max_peers = std::atoi(argv[++i]);
+        } else if (arg == "--socket-profile" && i + 1 < argc && parse_socket_profile(argv[i + 1], peer_socket_profile)) {
+            peer_socket_tuning = socket_profile(peer_socket_profile);
+            ++i;
+        } else {
+            std::cerr << "Použití: " << argv[0] << " [--port PORT] [--rendezvous HOST:PORT --rendezvous-token TOKEN] [--gossip]"
+                      << " [--download-dir DIR] [--connect HOST:PORT]... [--socket-profile chat|bulk|fanout]"
+                      << " [--max-peers N] [--config FILE]" << std::endl;
+            return 1;
+        }
+    }
+    if (listen_port <= 0 || listen_port > 65535) {
+        std::cerr << "Neplatný port" << std::endl;
+        return 1;
+    }
+    if (!rendezvous.empty() && rendezvous_token.empty()) {
+        std::cerr << "Rendezvous potřebuje --rendezvous-token (vydá ho příkaz /rvtoken v chatu pod stejným jménem)" << std::endl;
+        return 1;
+    }
+    
+    // sendfile() do zavřeného spojení nemá MSG_NOSIGNAL
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction shutdown_action{};
+    shutdown_action.sa_handler = handle_shutdown_signal;
+    sigemptyset(&shutdown_action.sa_mask);
+    sigaction(SIGINT, &shutdown_action, nullptr);
+    sigaction(SIGTERM, &shutdown_action, nullptr);
+    
     std::cout << "========================================" << std::endl;
     std::cout << "C++ P2P Aplikace" << std::endl;
     std::cout << "========================================" << std::endl;
@@ -292,26 +1500,78 @@ int main() {
     if (!username_input.empty()) {
         username = username_input.substr(0, 20);
     }
+    // ':' odděluje pole gossip a rendezvous zpráv
+    for (char& c : username) {
+        if (c == ':') c = '_';
+    }
+    
+    // Spuštění smyčky událostí (listener i všechna spojení s peery)
+    listener_socket = open_peer_listener(listen_port);
+    loop_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (listener_socket < 0 || loop_wakeup < 0) {
+        std::cerr << "Nelze naslouchat na portu " << listen_port << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    PeerLoop loop(listener_socket);
+    if (!loop.valid()) {
+        std::cerr << "Nelze vytvořit epoll: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::cout << "P2P listener naslouchá na portu " << listen_port << std::endl;
+    std::thread loop_thread = worker_thread(&PeerLoop::run, &loop);
+    for (const std::string& peer : bootstrap) {
+        size_t colon = peer.rfind(':');
+        std::string host = colon == std::string::npos ? peer : peer.substr(0, colon);
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+        int port = colon == std::string::npos ? 0 : std::atoi(peer.c_str() + colon + 1);
+        if (port > 0 && port <= 65535) {
+            connect_to_peer(host, port);
+        } else {
+            std::cerr << "Neplatná adresa peera: " << peer << std::endl;
+        }
+    }
     
-    // Spuštění listeneru
-    std::thread listener_thread(listener_thread_func);
-    listener_thread.detach();
+    // UDP socket na stejném portu jako TCP listener - rendezvous vidí
+    // endpoint, na kterém peer opravdu přijímá
+    if (!rendezvous.empty()) {
+        udp_socket = open_udp_socket(listen_port, udp_family);
+        if (udp_socket < 0 || !resolve_udp_endpoint(rendezvous, rendezvous_addr, rendezvous_length)) {
+            std::cerr << "Rendezvous " << rendezvous << " nelze použít" << std::endl;
+            return 1;
+        }
+        worker_thread(udp_thread_func).detach();
+    }
     
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
     
     std::cout << "\nVaše jméno: " << username << std::endl;
-    std::cout << "Nasloucháte na portu: " << DEFAULT_PORT << std::endl;
+    std::cout << "Nasloucháte na portu: " << listen_port << " (max. " << max_peers << " peerů)" << std::endl;
+    std::cout << "Socket profil: " << socket_profile_name(peer_socket_profile) << " ("
+              << format_socket_tuning(probe_socket_tuning(peer_socket_tuning)) << ")" << std::endl;
+    if (udp_socket >= 0) {
+        std::cout << "Rendezvous (UDP): " << rendezvous << std::endl;
+    }
+    if (gossip_mode) {
+        std::cout << "Gossip broadcast: " << GOSSIP_FANOUT << " sousedů, TTL " << GOSSIP_TTL << std::endl;
+    }
     std::cout << "\nDostupné příkazy:" << std::endl;
-    std::cout << "  /connect <host> <port>  - Připojení k peeru" << std::endl;
+    std::cout << "  /connect <host> <port>  - Připojení k peeru (po výpadku se obnoví)" << std::endl;
+    std::cout << "  /disconnect <peer>     - Odpojení peera (jméno nebo host:port)" << std::endl;
     std::cout << "  /list                  - Seznam peerů" << std::endl;
     std::cout << "  /broadcast <msg>       - Broadcast zpráva" << std::endl;
+    std::cout << "  /send <peer> <soubor>  - Odeslání souboru peeru (jméno nebo host:port)" << std::endl;
+    if (udp_socket >= 0) {
+        std::cout << "  /punch <jméno>         - Přímá UDP cesta přes rendezvous" << std::endl;
+    }
     std::cout << "  /quit                  - Ukončení" << std::endl;
     std::cout << "========================================" << std::endl << std::endl;
     
     std::string command;
     while (peer_running) {
         std::cout << "> ";
-        std::getline(std::cin, command);
+        if (!std::getline(std::cin, command)) {
+            break;
+        }
         
         if (command.empty()) continue;
         
@@ -319,20 +1579,59 @@ int main() {
             break;
         } else if (command.find("/connect ") == 0) {
             size_t pos1 = command.find(' ', 9);
-            size_t pos2 = command.find(' ', pos1 + 1);
-            if (pos1 != std::string::npos && pos2 != std::string::npos) {
+            if (pos1 != std::string::npos) {
                 std::string host = command.substr(9, pos1 - 9);
-                int port = std::stoi(command.substr(pos1 + 1, pos2 - pos1 - 1));
-                connect_to_peer(host, port);
+                int port = std::atoi(command.c_str() + pos1 + 1);
+                if (port > 0 && port <= 65535) {
+                    connect_to_peer(host, port);
+                }
             }
+        } else if (command.find("/disconnect ") == 0) {
+            LoopRequest request;
+            request.type = LoopRequest::DISCONNECT;
+            request.peer = command.substr(12);
+            post_loop_request(request);
         } else if (command == "/list") {
             std::lock_guard<std::mutex> lock(peers_mutex);
             std::cout << "\nPřipojení peery:" << std::endl;
             for (const auto& pair : connected_peers) {
                 std::cout << "  - " << pair.second.username << " (" 
-                          << pair.first.first << ":" << pair.first.second << ")" << std::endl;
+                          << endpoint_text(pair.first.first, pair.first.second) << ")" << std::endl;
+            }
+            if (udp_socket >= 0) {
+                std::lock_guard<std::mutex> udp_lock(udp_mutex);
+                for (const auto& pair : udp_peers) {
+                    std::cout << "  - " << pair.first << " (UDP "
+                              << endpoint_text(address_text(pair.second.addr), address_port(pair.second.addr))
+                              << (pair.second.open ? "" : ", neotevřeno") << ")" << std::endl;
+                }
             }
             std::cout << std::endl;
+        } else if (command.find("/punch ") == 0 && udp_socket >= 0) {
+            std::string target = command.substr(7);
+            send_datagram(RENDEZVOUS_LOOKUP + target + ":" + username, rendezvous_addr, rendezvous_length);
+        } else if (command.find("/send ") == 0) {
+            size_t space = command.find(' ', 6);
+            if (space == std::string::npos) {
+                std::cout << "Použití: /send <peer> <soubor>" << std::endl;
+                continue;
+            }
+            std::string peer = command.substr(6, space - 6);
+            PeerChannelPtr channel;
+            {
+                std::lock_guard<std::mutex> lock(peers_mutex);
+                for (const auto& pair : connected_peers) {
+                    if (pair.second.username == peer || endpoint_text(pair.first.first, pair.first.second) == peer) {
+                        channel = pair.second.channel;
+                        break;
+                    }
+                }
+            }
+            if (!channel) {
+                std::cout << "Peer " << peer << " není připojen" << std::endl;
+            } else {
+                start_file_transfer(channel, peer, command.substr(space + 1));
+            }
         } else if (command.find("/broadcast ") == 0) {
             std::string msg = command.substr(11);
             int count = broadcast_to_all_peers(msg);
@@ -346,15 +1645,13 @@ int main() {
         }
     }
     
+    // Smyčka událostí zavře všechna spojení
     peer_running = false;
-    
-    {
-        std::lock_guard<std::mutex> lock(peers_mutex);
-        for (auto& pair : connected_peers) {
-            close(pair.second.socket);
-        }
-        connected_peers.clear();
+    uint64_t one = 1;
+    if (write(loop_wakeup, &one, sizeof(one)) < 0) {
+        // Smyčka skončí nejpozději po dalším epoll_wait
     }
+    loop_thread.join();
     
     if (listener_socket >= 0) {
         close(listener_socket);
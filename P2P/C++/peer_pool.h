@@ -0,0 +1,110 @@
+/**
+ * Neblokující navazování spojení s peery a obnova spojení po výpadku
+ *
+ * Adresy peera se přeloží předem (getaddrinfo blokuje), samotné connect()
+ * je neblokující - smyčka událostí tak vytáčí libovolně peerů současně a
+ * každý pokus má vlastní časový limit. Selže-li všechny adresy, další pokus
+ * přijde po prodlevě, která se s každým neúspěchem zdvojnásobí (0.5 - 10 s)
+ * a po navázání spojení se vrátí na začátek.
+ *
+ * Kompatibilní s: C++11, POSIX
+ */
+
+#ifndef PEER_POOL_H
+#define PEER_POOL_H
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../../C++/socket_tuning.h"
+
+const double PEER_RECONNECT_MIN_DELAY = 0.5;   // První prodleva před novým pokusem (sekundy)
+const double PEER_RECONNECT_MAX_DELAY = 10.0;  // Nejdelší prodleva
+
+struct SocketAddress {
+    sockaddr_storage addr;
+    socklen_t length;
+};
+
+/**
+ * Všechny adresy peera (IPv4, IPv6 i jméno hostitele) v pořadí od resolveru
+ * @return text chyby, prázdný při úspěchu
+ */
+inline std::string resolve_peer_addresses(const std::string& host, int port, std::vector<SocketAddress>& out) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    int result = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses);
+    if (result != 0) {
+        return gai_strerror(result);
+    }
+    for (addrinfo* address = addresses; address; address = address->ai_next) {
+        SocketAddress entry;
+        std::memcpy(&entry.addr, address->ai_addr, address->ai_addrlen);
+        entry.length = address->ai_addrlen;
+        out.push_back(entry);
+    }
+    freeaddrinfo(addresses);
+    return std::string();
+}
+
+/**
+ * Zahájení neblokujícího connect()
+ * Volby socketu se nastaví před connect(), aby buffery platily už pro handshake.
+ * @return fd (spojení se dokončí, až bude zapisovatelný) nebo -1
+ */
+inline int start_connect(const SocketAddress& address, const SocketTuning& tuning) {
+    int fd = socket(address.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    apply_socket_tuning(fd, tuning);
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address.addr), address.length) < 0 && errno != EINPROGRESS) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Výsledek dokončeného neblokujícího connect() (0 = spojeno, jinak errno)
+ */
+inline int connect_result(int fd) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+        return errno;
+    }
+    return error;
+}
+
+/**
+ * Prodleva před dalším pokusem o spojení (exponenciální)
+ */
+class ReconnectBackoff {
+public:
+    ReconnectBackoff() : delay_(PEER_RECONNECT_MIN_DELAY) {}
+
+    double next() {
+        double delay = delay_;
+        delay_ = delay_ * 2 < PEER_RECONNECT_MAX_DELAY ? delay_ * 2 : PEER_RECONNECT_MAX_DELAY;
+        return delay;
+    }
+
+    void reset() {
+        delay_ = PEER_RECONNECT_MIN_DELAY;
+    }
+
+private:
+    double delay_;
+};
+
+#endif // PEER_POOL_H
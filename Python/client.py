@@ -142,12 +142,12 @@ def receive_messages_thread(sock: socket.socket, running: threading.Event):
                 
                 # Zpracování P2P informací
                 if message.startswith("PEER_INFO:"):
-                    # Formát: PEER_INFO:username:ip:port
-                    parts = message.split(":")
-                    if len(parts) >= 4:
-                        peer_username = parts[1]
-                        peer_ip = parts[2]
-                        peer_port = parts[3]
+                    # Formát: PEER_INFO:username:ip:port (IPv6 adresa obsahuje ':')
+                    rest = message[len("PEER_INFO:"):]
+                    name_part, _, endpoint = rest.partition(":")
+                    peer_ip, _, peer_port = endpoint.rpartition(":")
+                    if name_part and peer_ip and peer_port:
+                        peer_username = name_part
                         print(f"\n[INFO] P2P informace o {peer_username}:")
                         print(f"  IP: {peer_ip}")
                         print(f"  Port: {peer_port}")